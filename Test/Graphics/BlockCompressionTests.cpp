@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains BlockCompression tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Graphics/BlockCompression.h>
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace Magic3D;
+
+
+/** Fixture for BlockCompression tests
+ */
+class Graphics_BlockCompressionTests : public ::testing::Test
+{
+protected:
+    unsigned char pixels[16 * 4];
+    unsigned char block[16];
+    unsigned char decoded[16 * 4];
+
+    /// get the largest difference of any channel of any pixel, but alpha
+    inline int getColorError() const
+    {
+        int error = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                int difference = std::abs(this->pixels[i * 4 + c] - this->decoded[i * 4 + c]);
+                error = difference > error ? difference : error;
+            }
+        }
+        return error;
+    }
+};
+
+
+TEST_F(Graphics_BlockCompressionTests, BC1SolidColor)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        pixels[i * 4] = 200;
+        pixels[i * 4 + 1] = 100;
+        pixels[i * 4 + 2] = 50;
+        pixels[i * 4 + 3] = 255;
+    }
+    BlockCompression::encodeBC1(pixels, block);
+    BlockCompression::decodeBC1(block, decoded);
+
+    // only 565 quantization is lost
+    EXPECT_LE(getColorError(), 4);
+    for (int i = 0; i < 16; i++)
+        EXPECT_EQ(255, decoded[i * 4 + 3]);
+}
+
+TEST_F(Graphics_BlockCompressionTests, BC1Gradient)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        pixels[i * 4] = (unsigned char)(i * 16);
+        pixels[i * 4 + 1] = (unsigned char)(255 - i * 16);
+        pixels[i * 4 + 2] = 128;
+        pixels[i * 4 + 3] = 255;
+    }
+    BlockCompression::encodeBC1(pixels, block);
+    BlockCompression::decodeBC1(block, decoded);
+
+    // four colors spread over the gradient, each a quarter of it
+    EXPECT_LE(getColorError(), 32);
+
+    // and in its order
+    for (int i = 1; i < 16; i++)
+    {
+        EXPECT_GE(decoded[i * 4], decoded[(i - 1) * 4]);
+        EXPECT_LE(decoded[i * 4 + 1], decoded[(i - 1) * 4 + 1]);
+    }
+}
+
+TEST_F(Graphics_BlockCompressionTests, BC4Gradient)
+{
+    for (int i = 0; i < 16; i++)
+        pixels[i * 4] = (unsigned char)(20 + i * 10);
+    BlockCompression::encodeBC4(pixels, 4, block);
+    BlockCompression::decodeBC4(block, decoded, 4);
+
+    // eight values spread over 150 are at most 11 off
+    for (int i = 0; i < 16; i++)
+        EXPECT_LE(std::abs(pixels[i * 4] - decoded[i * 4]), 11);
+    EXPECT_EQ(20, decoded[0]);
+    EXPECT_EQ(170, decoded[15 * 4]);
+}
+
+TEST_F(Graphics_BlockCompressionTests, BC5KeepsBothChannels)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        pixels[i * 4] = (unsigned char)(i * 17);
+        pixels[i * 4 + 1] = (unsigned char)(255 - i * 17);
+        pixels[i * 4 + 2] = 0;
+        pixels[i * 4 + 3] = 255;
+    }
+    BlockCompression::encodeBC5(pixels, block);
+    BlockCompression::decodeBC4(block, decoded, 4);
+    BlockCompression::decodeBC4(block + 8, decoded + 1, 4);
+
+    for (int i = 0; i < 16; i++)
+    {
+        EXPECT_LE(std::abs(pixels[i * 4] - decoded[i * 4]), 19);
+        EXPECT_LE(std::abs(pixels[i * 4 + 1] - decoded[i * 4 + 1]), 19);
+    }
+}
+
+/// the simd encoders give exactly the scalar blocks
+TEST_F(Graphics_BlockCompressionTests, SimdMatchesScalar)
+{
+    unsigned char simdBlock[16];
+    srand(7);
+    for (int n = 0; n < 1000; n++)
+    {
+        // noise, smooth gradients and few distinct colors
+        for (int i = 0; i < 16 * 4; i++)
+        {
+            if (n % 3 == 0)
+                pixels[i] = (unsigned char)(rand() % 256);
+            else if (n % 3 == 1)
+                pixels[i] = (unsigned char)((n * 7 + (i / 4) * (i % 4 + 1) * 5) % 256);
+            else
+                pixels[i] = (unsigned char)((rand() % 3) * 120);
+        }
+
+        BlockCompression::encodeBC1(pixels, block, false);
+        BlockCompression::encodeBC1(pixels, simdBlock, true);
+        ASSERT_EQ(0, memcmp(block, simdBlock, 8));
+
+        BlockCompression::encodeBC3(pixels, block, false);
+        BlockCompression::encodeBC3(pixels, simdBlock, true);
+        ASSERT_EQ(0, memcmp(block, simdBlock, 16));
+
+        BlockCompression::encodeBC5(pixels, block, false);
+        BlockCompression::encodeBC5(pixels, simdBlock, true);
+        ASSERT_EQ(0, memcmp(block, simdBlock, 16));
+    }
+}
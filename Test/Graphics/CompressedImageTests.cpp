@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains CompressedImage tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Graphics/CompressedImage.h>
+#include <Graphics/MipmapBuilder.h>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace Magic3D;
+
+
+/** Fixture for CompressedImage tests
+ */
+class Graphics_CompressedImageTests : public ::testing::Test
+{
+protected:
+    /// an image of a gradient, sized so levels have partial blocks
+    inline Image makeImage(int channels)
+    {
+        Image image(13, 6, channels);
+        unsigned char* data = image.getMutableRawData();
+        for (int i = 0; i < 13 * 6 * channels; i++)
+            data[i] = (unsigned char)(i * 7);
+        return image;
+    }
+};
+
+
+TEST_F(Graphics_CompressedImageTests, EncodeMipmaps)
+{
+    ThreadPool pool(2);
+    Image image = makeImage(3);
+    CompressedImage compressed = CompressedImage::encode(image,
+        MipmapBuilder::build(image, MipmapBuilder::Options(), pool),
+        CompressedImage::Format::BC1, pool);
+
+    ASSERT_EQ(4u, compressed.getLevelCount());
+    int sizes[4][2] = { { 13, 6 }, { 6, 3 }, { 3, 1 }, { 1, 1 } };
+    for (size_t i = 0; i < compressed.getLevelCount(); i++)
+    {
+        const CompressedImage::Level& level = compressed.getLevel(i);
+        EXPECT_EQ(sizes[i][0], level.width);
+        EXPECT_EQ(sizes[i][1], level.height);
+        EXPECT_EQ((size_t)((level.width + 3) / 4 * ((level.height + 3) / 4) * 8), level.size);
+    }
+}
+
+TEST_F(Graphics_CompressedImageTests, ChooseFormat)
+{
+    EXPECT_EQ(CompressedImage::Format::BC1, CompressedImage::chooseFormat(makeImage(3), false));
+    EXPECT_EQ(CompressedImage::Format::BC5, CompressedImage::chooseFormat(makeImage(3), true));
+    EXPECT_EQ(CompressedImage::Format::BC4, CompressedImage::chooseFormat(makeImage(1), false));
+    EXPECT_EQ(CompressedImage::Format::BC3, CompressedImage::chooseFormat(makeImage(4), false));
+    EXPECT_EQ(CompressedImage::Format::BC1,
+        CompressedImage::chooseFormat(Image(4, 4, 4, Color::WHITE), false));
+}
+
+TEST_F(Graphics_CompressedImageTests, DdsRoundTrip)
+{
+    const char* path = "CompressedImageTests.dds";
+    Image image = makeImage(4);
+    CompressedImage compressed = CompressedImage::encode(image, MipmapBuilder::build(image),
+        CompressedImage::Format::BC3);
+    compressed.setSourceHash(0x0123456789ABCDEFULL);
+    compressed.writeDds(path);
+
+    {
+        CompressedImage read = CompressedImage::readDds(ResourceData::mapFile(path));
+        EXPECT_EQ(0x0123456789ABCDEFULL, read.getSourceHash());
+        EXPECT_EQ(CompressedImage::Format::BC3, read.getFormat());
+        EXPECT_EQ(13, read.getWidth());
+        EXPECT_EQ(6, read.getHeight());
+        ASSERT_EQ(compressed.getLevelCount(), read.getLevelCount());
+        for (size_t i = 0; i < read.getLevelCount(); i++)
+        {
+            ASSERT_EQ(compressed.getLevel(i).size, read.getLevel(i).size);
+            EXPECT_EQ(0, memcmp(compressed.getLevelData(i), read.getLevelData(i),
+                read.getLevel(i).size));
+        }
+    }
+    std::remove(path);
+}
@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains GraphicsState tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Graphics/GraphicsState.h>
+
+using namespace Magic3D;
+
+
+/** Fixture for GraphicsState tests, all state changes go to a
+ * recording backend so no GL context is needed
+ */
+class Graphics_GraphicsStateTests : public ::testing::Test
+{
+protected:
+    RecordingStateBackend backend;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        GraphicsState::getSingleton().setBackend(&backend);
+        GraphicsState::getSingleton().resetCounters();
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        GraphicsState::getSingleton().setBackend(nullptr);
+    }
+};
+
+
+/// the first change of any state is always issued
+TEST_F(Graphics_GraphicsStateTests, FirstChangeIssued)
+{
+    GraphicsState& state = GraphicsState::getSingleton();
+    state.useProgram(0);
+    state.setDepthMask(true);
+    state.enable(GraphicsState::CULL_FACE);
+
+    EXPECT_EQ(1u, backend.getCallCount(RecordingStateBackend::USE_PROGRAM));
+    EXPECT_EQ(1u, backend.getCallCount(RecordingStateBackend::DEPTH_MASK));
+    EXPECT_EQ(1u, backend.getCallCount(RecordingStateBackend::SET_CAPABILITY));
+    EXPECT_EQ(0u, state.getFilteredCount());
+}
+
+/// repeated changes to the same value are filtered
+TEST_F(Graphics_GraphicsStateTests, RedundantChangesFiltered)
+{
+    GraphicsState& state = GraphicsState::getSingleton();
+    for (int i = 0; i < 10; i++)
+    {
+        state.useProgram(3);
+        state.bindVertexArray(5);
+        state.setPolygonMode(GL_FILL);
+        state.setPolygonOffset(4.0f, 4.0f);
+        state.disable(GraphicsState::BLEND);
+    }
+
+    EXPECT_EQ(1u, backend.getCallCount(RecordingStateBackend::USE_PROGRAM));
+    EXPECT_EQ(1u, backend.getCallCount(RecordingStateBackend::BIND_VERTEX_ARRAY));
+    EXPECT_EQ(1u, backend.getCallCount(RecordingStateBackend::POLYGON_MODE));
+    EXPECT_EQ(1u, backend.getCallCount(RecordingStateBackend::POLYGON_OFFSET));
+    EXPECT_EQ(1u, backend.getCallCount(RecordingStateBackend::SET_CAPABILITY));
+    EXPECT_EQ(5u, state.getIssuedCount());
+    EXPECT_EQ(45u, state.getFilteredCount());
+}
+
+/// texture binds are tracked per texture unit
+TEST_F(Graphics_GraphicsStateTests, TextureUnitsTrackedSeparately)
+{
+    GraphicsState& state = GraphicsState::getSingleton();
+    state.bindTexture(0, GL_TEXTURE_2D, 7);
+    state.bindTexture(8, GL_TEXTURE_2D, 7);
+    state.bindTexture(0, GL_TEXTURE_2D, 7);
+    state.bindTexture(8, GL_TEXTURE_2D, 7);
+
+    EXPECT_EQ(2u, backend.getCallCount(RecordingStateBackend::BIND_TEXTURE));
+    EXPECT_EQ(4u, backend.getCallCount(RecordingStateBackend::ACTIVE_TEXTURE));
+
+    // deleting a texture unbinds it, so binding a new one with the same id is issued
+    state.textureDeleted(7);
+    state.bindTexture(8, GL_TEXTURE_2D, 7);
+    EXPECT_EQ(3u, backend.getCallCount(RecordingStateBackend::BIND_TEXTURE));
+}
+
+/// invalidating forgets all shadowed state
+TEST_F(Graphics_GraphicsStateTests, InvalidateForgetsState)
+{
+    GraphicsState& state = GraphicsState::getSingleton();
+    state.useProgram(3);
+    state.invalidate();
+    state.useProgram(3);
+
+    EXPECT_EQ(2u, backend.getCallCount(RecordingStateBackend::USE_PROGRAM));
+}
@@ -0,0 +1,159 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains MipmapBuilder tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Graphics/MipmapBuilder.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Magic3D;
+
+
+/** Fixture for MipmapBuilder tests
+ */
+class Graphics_MipmapBuilderTests : public ::testing::Test
+{
+protected:
+    ThreadPool pool;
+
+    inline Graphics_MipmapBuilderTests() : pool(2) {}
+
+    /// an image of black and white pixels in a checkerboard
+    inline Image makeCheckerboard(int size, int channels)
+    {
+        Image image(size, size, channels);
+        unsigned char* data = image.getMutableRawData();
+        for (int i = 0; i < size * size; i++)
+        {
+            unsigned char value = (i % size + i / size) % 2 == 0 ? 0 : 255;
+            for (int c = 0; c < channels; c++)
+                data[i * channels + c] = value;
+        }
+        return image;
+    }
+};
+
+
+TEST_F(Graphics_MipmapBuilderTests, LevelSizes)
+{
+    Image image(13, 6, 3, Color::WHITE);
+    auto levels = MipmapBuilder::build(image, MipmapBuilder::Options(), pool);
+
+    ASSERT_EQ(3u, levels.size());
+    EXPECT_EQ(4, MipmapBuilder::getLevelCount(13, 6));
+    int sizes[3][2] = { { 6, 3 }, { 3, 1 }, { 1, 1 } };
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        EXPECT_EQ(sizes[i][0], levels[i]->getWidth());
+        EXPECT_EQ(sizes[i][1], levels[i]->getHeight());
+        EXPECT_EQ(3, levels[i]->getChannelCount());
+    }
+
+    EXPECT_TRUE(MipmapBuilder::build(Image(1, 1, 4, Color::WHITE)).empty());
+}
+
+TEST_F(Graphics_MipmapBuilderTests, KeepsFlatColor)
+{
+    Image image(16, 16, 4, Color(200, 100, 50, 150));
+    for (MipmapBuilder::Filter filter : { MipmapBuilder::Filter::BOX, MipmapBuilder::Filter::KAISER })
+    {
+        auto levels = MipmapBuilder::build(image, MipmapBuilder::Options(filter, true), pool);
+        const unsigned char* pixel = levels.back()->getRawData();
+        EXPECT_NEAR(200, pixel[0], 1);
+        EXPECT_NEAR(100, pixel[1], 1);
+        EXPECT_NEAR(50, pixel[2], 1);
+        EXPECT_NEAR(150, pixel[3], 1);
+    }
+}
+
+TEST_F(Graphics_MipmapBuilderTests, FiltersSrgbInLinearSpace)
+{
+    Image image = makeCheckerboard(8, 3);
+
+    // half of the light is 188 in sRGB, not 128
+    auto levels = MipmapBuilder::build(image,
+        MipmapBuilder::Options(MipmapBuilder::Filter::BOX, true), pool);
+    EXPECT_NEAR(188, levels[0]->getRawData()[0], 1);
+
+    levels = MipmapBuilder::build(image,
+        MipmapBuilder::Options(MipmapBuilder::Filter::BOX, false), pool);
+    EXPECT_NEAR(128, levels[0]->getRawData()[0], 1);
+}
+
+TEST_F(Graphics_MipmapBuilderTests, RenormalizesNormals)
+{
+    // normals tilted left and right in turn average to straight up, with
+    // the image wrapping around so the edges keep the pattern
+    Image image(8, 8, 3);
+    unsigned char* data = image.getMutableRawData();
+    for (int i = 0; i < 64; i++)
+    {
+        data[i * 3] = i % 2 == 0 ? 37 : 218;
+        data[i * 3 + 1] = 128;
+        data[i * 3 + 2] = 218;
+    }
+
+    auto levels = MipmapBuilder::build(image,
+        MipmapBuilder::Options(MipmapBuilder::Filter::KAISER, false, true, true), pool);
+    for (const auto& level : levels)
+    {
+        const unsigned char* pixel = level->getRawData();
+        float x = pixel[0] / 127.5f - 1.0f;
+        float y = pixel[1] / 127.5f - 1.0f;
+        float z = pixel[2] / 127.5f - 1.0f;
+        EXPECT_NEAR(1.0f, std::sqrt(x * x + y * y + z * z), 0.02f);
+        EXPECT_NEAR(1.0f, z, 0.02f);
+    }
+}
+
+/// the simd filters give exactly the scalar levels
+TEST_F(Graphics_MipmapBuilderTests, SimdMatchesScalar)
+{
+    srand(5);
+    for (int channels = 1; channels <= 4; channels++)
+    {
+        Image image(37, 23, channels);
+        unsigned char* data = image.getMutableRawData();
+        for (int i = 0; i < 37 * 23 * channels; i++)
+            data[i] = (unsigned char)(rand() % 256);
+
+        for (int variant = 0; variant < 4; variant++)
+        {
+            MipmapBuilder::Options options(variant % 2 == 0 ? MipmapBuilder::Filter::KAISER :
+                MipmapBuilder::Filter::BOX, variant == 0, variant == 1, variant == 2);
+            auto simdLevels = MipmapBuilder::build(image, options, pool);
+            options.useSimd = false;
+            auto scalarLevels = MipmapBuilder::build(image, options, pool);
+
+            ASSERT_EQ(scalarLevels.size(), simdLevels.size());
+            for (size_t i = 0; i < scalarLevels.size(); i++)
+            {
+                size_t size = (size_t)scalarLevels[i]->getWidth() * scalarLevels[i]->getHeight() * channels;
+                EXPECT_EQ(0, memcmp(scalarLevels[i]->getRawData(), simdLevels[i]->getRawData(), size));
+            }
+        }
+    }
+}
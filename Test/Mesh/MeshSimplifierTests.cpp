@@ -0,0 +1,168 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains MeshSimplifier tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Mesh/MeshSimplifier.h>
+
+#include <set>
+#include <vector>
+
+using namespace Magic3D;
+
+
+/** Fixture for MeshSimplifier tests, works on a flat grid of quads
+ */
+class Mesh_MeshSimplifierTests : public ::testing::Test
+{
+protected:
+    static const unsigned int GRID_SIZE = 16;
+
+    std::vector<unsigned int> indices;
+    std::vector<Scalar> positions;
+    unsigned int vertexCount;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        const unsigned int row = GRID_SIZE + 1;
+        vertexCount = row * row;
+        for (unsigned int y = 0; y < row; y++)
+        {
+            for (unsigned int x = 0; x < row; x++)
+            {
+                positions.push_back((Scalar)x);
+                positions.push_back(0.0f);
+                positions.push_back((Scalar)y);
+            }
+        }
+
+        for (unsigned int y = 0; y < GRID_SIZE; y++)
+        {
+            for (unsigned int x = 0; x < GRID_SIZE; x++)
+            {
+                unsigned int a = y * row + x;
+                unsigned int quad[] = { a, a + row, a + 1, a + 1, a + row, a + row + 1 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+
+    /// get the vertices used by the first indexCount indices
+    std::set<unsigned int> getUsedVertices(size_t indexCount)
+    {
+        return std::set<unsigned int>(indices.begin(), indices.begin() + indexCount);
+    }
+
+    /// get the y component of the normal of a triangle
+    Scalar getNormalY(size_t triangle)
+    {
+        const Scalar* a = &positions[indices[triangle * 3] * 3];
+        const Scalar* b = &positions[indices[triangle * 3 + 1] * 3];
+        const Scalar* c = &positions[indices[triangle * 3 + 2] * 3];
+        return (b[2] - a[2]) * (c[0] - a[0]) - (b[0] - a[0]) * (c[2] - a[2]);
+    }
+};
+
+
+/// a flat grid simplifies without error and without flipping triangles
+TEST_F(Mesh_MeshSimplifierTests, FlatGridSimplifies)
+{
+    Scalar error = -1.0f;
+    size_t target = indices.size() / 4;
+    size_t result = MeshSimplifier::simplify(&indices[0], indices.size(), &positions[0], 3,
+        vertexCount, target, &error);
+
+    EXPECT_LE(result, target);
+    EXPECT_EQ(0u, result % 3);
+    EXPECT_NEAR(0.0f, error, 0.0001f);
+
+    Scalar facing = getNormalY(0);
+    for (size_t t = 0; t < result / 3; t++)
+    {
+        EXPECT_LT(0.0f, getNormalY(t) * facing);
+        EXPECT_NE(indices[t * 3], indices[t * 3 + 1]);
+        EXPECT_NE(indices[t * 3 + 1], indices[t * 3 + 2]);
+        EXPECT_NE(indices[t * 3], indices[t * 3 + 2]);
+    }
+}
+
+/// vertices on the outline of an open mesh are never removed
+TEST_F(Mesh_MeshSimplifierTests, BordersAreKept)
+{
+    size_t result = MeshSimplifier::simplify(&indices[0], indices.size(), &positions[0], 3,
+        vertexCount, 0);
+    auto used = getUsedVertices(result);
+
+    const unsigned int row = GRID_SIZE + 1;
+    for (unsigned int i = 0; i < row; i++)
+    {
+        EXPECT_EQ(1u, used.count(i));
+        EXPECT_EQ(1u, used.count(GRID_SIZE * row + i));
+        EXPECT_EQ(1u, used.count(i * row));
+        EXPECT_EQ(1u, used.count(i * row + GRID_SIZE));
+    }
+}
+
+/// vertices sharing a position with another vertex are never removed
+TEST_F(Mesh_MeshSimplifierTests, SeamsAreKept)
+{
+    // split the grid along its middle column, as a texture seam would
+    const unsigned int row = GRID_SIZE + 1;
+    const unsigned int seam = GRID_SIZE / 2;
+    std::set<unsigned int> seamVertices;
+    for (unsigned int y = 0; y < row; y++)
+    {
+        unsigned int original = y * row + seam;
+        unsigned int copy = vertexCount++;
+        positions.insert(positions.end(), &positions[original * 3], &positions[original * 3] + 3);
+        seamVertices.insert(original);
+        seamVertices.insert(copy);
+
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            bool rightSide = false;
+            for (int k = 0; k < 3; k++)
+                rightSide |= indices[i + k] % row > seam;
+            for (int k = 0; k < 3 && rightSide; k++)
+            {
+                if (indices[i + k] == original)
+                    indices[i + k] = copy;
+            }
+        }
+    }
+
+    size_t result = MeshSimplifier::simplify(&indices[0], indices.size(), &positions[0], 3,
+        vertexCount, indices.size() / 4);
+    auto used = getUsedVertices(result);
+
+    EXPECT_LT(result, indices.size() / 2);
+    for (unsigned int v : seamVertices)
+        EXPECT_EQ(1u, used.count(v));
+}
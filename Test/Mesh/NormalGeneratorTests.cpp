@@ -0,0 +1,203 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains NormalGenerator tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Mesh/NormalGenerator.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Magic3D;
+
+
+/** Fixture for NormalGenerator tests, works on random triangles over
+ * random vertices, large enough to be split across threads
+ */
+class Mesh_NormalGeneratorTests : public ::testing::Test
+{
+protected:
+    static const unsigned int VERTEX_COUNT = 5000;
+    static const unsigned int FACE_COUNT = 20003;
+
+    std::vector<unsigned int> indices;
+    std::vector<Scalar> positions;
+    std::vector<Scalar> texCoords;
+    NormalGenerator::Adjacency adjacency;
+
+    static Scalar random()
+    {
+        return (Scalar)rand() / RAND_MAX * 2.0f - 1.0f;
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        srand(2468);
+        for (unsigned int v = 0; v < VERTEX_COUNT; v++)
+        {
+            positions.push_back(random());
+            positions.push_back(random());
+            positions.push_back(random());
+            positions.push_back(1.0f);
+            texCoords.push_back(random());
+            texCoords.push_back(random());
+        }
+        for (unsigned int i = 0; i < FACE_COUNT * 3; i++)
+            indices.push_back(rand() % VERTEX_COUNT);
+
+        // a face with degenerate texture coordinates
+        texCoords[indices[3] * 2] = texCoords[indices[4] * 2] = texCoords[indices[5] * 2];
+        texCoords[indices[3] * 2 + 1] = texCoords[indices[4] * 2 + 1] = texCoords[indices[5] * 2 + 1];
+
+        NormalGenerator::buildAdjacency(&indices[0], FACE_COUNT, VERTEX_COUNT, adjacency);
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+};
+
+
+/// the simd face pass gives exactly the scalar results
+TEST_F(Mesh_NormalGeneratorTests, SimdMatchesScalar)
+{
+    std::vector<Scalar> simdNormals(FACE_COUNT * 3), simdTangents(FACE_COUNT * 3);
+    std::vector<Scalar> scalarNormals(FACE_COUNT * 3), scalarTangents(FACE_COUNT * 3);
+
+    NormalGenerator::calculateFaceVectors(&indices[0], 0, FACE_COUNT, &positions[0],
+        &texCoords[0], &simdNormals[0], &simdTangents[0], true);
+    NormalGenerator::calculateFaceVectors(&indices[0], 0, FACE_COUNT, &positions[0],
+        &texCoords[0], &scalarNormals[0], &scalarTangents[0], false);
+
+    EXPECT_EQ(0, memcmp(&simdNormals[0], &scalarNormals[0], simdNormals.size() * sizeof(Scalar)));
+    EXPECT_EQ(0, memcmp(&simdTangents[0], &scalarTangents[0], simdTangents.size() * sizeof(Scalar)));
+    EXPECT_EQ(0.0f, simdTangents[3]);
+}
+
+/// results are the same bit for bit on one thread and on many
+TEST_F(Mesh_NormalGeneratorTests, ThreadCountDoesNotChangeResults)
+{
+    ThreadPool serial(1), parallel(4);
+    std::vector<Scalar> serialNormals(VERTEX_COUNT * 3), serialTangents(VERTEX_COUNT * 3);
+    std::vector<Scalar> parallelNormals(VERTEX_COUNT * 3), parallelTangents(VERTEX_COUNT * 3);
+
+    NormalGenerator::calculate(&indices[0], FACE_COUNT, VERTEX_COUNT, adjacency, &positions[0],
+        &texCoords[0], &serialNormals[0], &serialTangents[0], serial);
+    NormalGenerator::calculate(&indices[0], FACE_COUNT, VERTEX_COUNT, adjacency, &positions[0],
+        &texCoords[0], &parallelNormals[0], &parallelTangents[0], parallel);
+
+    EXPECT_EQ(0, memcmp(&serialNormals[0], &parallelNormals[0], serialNormals.size() * sizeof(Scalar)));
+    EXPECT_EQ(0, memcmp(&serialTangents[0], &parallelTangents[0], serialTangents.size() * sizeof(Scalar)));
+}
+
+/// a flat quad gets the plane normal and the u axis as tangent
+TEST_F(Mesh_NormalGeneratorTests, FlatQuad)
+{
+    Scalar quadPositions[] = { 0, 0, 0, 1,  1, 0, 0, 1,  0, 0, -1, 1,  1, 0, -1, 1 };
+    Scalar quadTexCoords[] = { 0, 0,  1, 0,  0, 1,  1, 1 };
+    unsigned int quadIndices[] = { 0, 1, 2,  2, 1, 3 };
+    NormalGenerator::Adjacency quadAdjacency;
+    NormalGenerator::buildAdjacency(quadIndices, 2, 5, quadAdjacency);
+
+    // the last vertex is unused
+    Scalar normals[15], tangents[15];
+    ThreadPool pool(1);
+    NormalGenerator::calculate(quadIndices, 2, 5, quadAdjacency, quadPositions, quadTexCoords,
+        normals, tangents, pool);
+
+    for (int v = 0; v < 4; v++)
+    {
+        EXPECT_FLOAT_EQ(0.0f, normals[v * 3]);
+        EXPECT_FLOAT_EQ(1.0f, normals[v * 3 + 1]);
+        EXPECT_FLOAT_EQ(0.0f, normals[v * 3 + 2]);
+        EXPECT_FLOAT_EQ(1.0f, tangents[v * 3]);
+        EXPECT_FLOAT_EQ(0.0f, tangents[v * 3 + 1]);
+        EXPECT_FLOAT_EQ(0.0f, tangents[v * 3 + 2]);
+    }
+    EXPECT_EQ(0.0f, normals[12]);
+    EXPECT_EQ(0.0f, tangents[12]);
+}
+
+/// mirrored positions land in separate groups, equal positions in one
+TEST_F(Mesh_NormalGeneratorTests, GroupByPosition)
+{
+    // every sign combination of (1, 2, 3), each twice, plus one within rounding
+    std::vector<Scalar> points;
+    for (int copy = 0; copy < 2; copy++)
+    {
+        for (int signs = 0; signs < 8; signs++)
+        {
+            points.push_back(signs & 1 ? -1.0f : 1.0f);
+            points.push_back(signs & 2 ? -2.0f : 2.0f);
+            points.push_back(signs & 4 ? -3.0f : 3.0f);
+            points.push_back(1.0f);
+        }
+    }
+    Scalar near[] = { 1.0004f, 2.0f, 3.0f, 1.0f };
+    points.insert(points.end(), near, near + 4);
+
+    std::vector<unsigned int> order, groupStarts;
+    NormalGenerator::groupByPosition(&points[0], 17, 0.001f, order, groupStarts);
+
+    ASSERT_EQ(9u, groupStarts.size());
+    EXPECT_EQ(17u, groupStarts.back());
+    for (size_t g = 0; g + 1 < groupStarts.size(); g++)
+    {
+        unsigned int first = order[groupStarts[g]];
+        for (unsigned int i = groupStarts[g]; i < groupStarts[g + 1]; i++)
+        {
+            unsigned int v = order[i];
+            EXPECT_TRUE(v % 8 == first % 8 || (v == 16 && first % 8 == 0) ||
+                (first == 16 && v % 8 == 0));
+        }
+        EXPECT_EQ(first % 8 == 0 || first == 16 ? 3u : 2u, groupStarts[g + 1] - groupStarts[g]);
+    }
+}
+
+/// only normals within the threshold angle are merged
+TEST_F(Mesh_NormalGeneratorTests, SmoothGroupsByAngle)
+{
+    Scalar normals[] = { 0, 1, 0,  0.5f, 1, 0,  1, 0, 0 };
+    Scalar tangents[] = { 1, 0, 0,  1, 0, 0,  0, 0, 1 };
+    std::vector<unsigned int> order = { 0, 1, 2 };
+    std::vector<unsigned int> groupStarts = { 0, 3 };
+
+    ThreadPool pool(1);
+    NormalGenerator::smoothGroups(order, groupStarts, normals, tangents,
+        Scalar(60.0 * M_PI / 180.0), pool);
+
+    // the first two are about 27 degrees apart and the last 63 from the second
+    Scalar length = std::sqrt(0.5f * 0.5f + 2.0f * 2.0f);
+    EXPECT_FLOAT_EQ(0.5f / length, normals[0]);
+    EXPECT_FLOAT_EQ(2.0f / length, normals[1]);
+    EXPECT_FLOAT_EQ(normals[0], normals[3]);
+    EXPECT_FLOAT_EQ(normals[1], normals[4]);
+    EXPECT_FLOAT_EQ(1.0f, tangents[0]);
+    EXPECT_FLOAT_EQ(1.0f, normals[6]);
+    EXPECT_FLOAT_EQ(1.0f, tangents[8]);
+}
@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains TriangleMeshOptimizer tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Mesh/TriangleMeshOptimizer.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+using namespace Magic3D;
+
+
+/** Fixture for TriangleMeshOptimizer tests, works on a grid of quads
+ * with its triangles in random order
+ */
+class Mesh_TriangleMeshOptimizerTests : public ::testing::Test
+{
+protected:
+    static const unsigned int GRID_SIZE = 32;
+
+    std::vector<unsigned int> indices;
+    std::vector<Scalar> positions;
+    unsigned int vertexCount;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        const unsigned int row = GRID_SIZE + 1;
+        vertexCount = row * row;
+        for (unsigned int y = 0; y < row; y++)
+        {
+            for (unsigned int x = 0; x < row; x++)
+            {
+                positions.push_back((Scalar)x);
+                positions.push_back(0.0f);
+                positions.push_back((Scalar)y);
+            }
+        }
+
+        std::vector<std::array<unsigned int, 3>> triangles;
+        for (unsigned int y = 0; y < GRID_SIZE; y++)
+        {
+            for (unsigned int x = 0; x < GRID_SIZE; x++)
+            {
+                unsigned int a = y * row + x;
+                triangles.push_back({ { a, a + row, a + 1 } });
+                triangles.push_back({ { a + 1, a + row, a + row + 1 } });
+            }
+        }
+
+        srand(4321);
+        for (size_t i = triangles.size() - 1; i > 0; i--)
+            std::swap(triangles[i], triangles[rand() % (i + 1)]);
+
+        for (auto& triangle : triangles)
+            indices.insert(indices.end(), triangle.begin(), triangle.end());
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+
+    /// get the triangles of an index list, rotated to start at their
+    /// smallest index and sorted, for comparing lists
+    static std::vector<std::array<unsigned int, 3>> getTriangleSet(
+        const std::vector<unsigned int>& indices)
+    {
+        std::vector<std::array<unsigned int, 3>> triangles;
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            std::array<unsigned int, 3> triangle = { { indices[i], indices[i + 1], indices[i + 2] } };
+            std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()),
+                triangle.end());
+            triangles.push_back(triangle);
+        }
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+};
+
+
+/// known cache behavior for tiny lists
+TEST_F(Mesh_TriangleMeshOptimizerTests, AnalyzeKnownLists)
+{
+    unsigned int single[] = { 0, 1, 2 };
+    auto stats = TriangleMeshOptimizer::analyzeVertexCache(single, 3, 3);
+    EXPECT_EQ(3u, stats.transformed);
+    EXPECT_FLOAT_EQ(3.0f, stats.acmr);
+    EXPECT_FLOAT_EQ(1.0f, stats.atvr);
+
+    unsigned int quad[] = { 0, 1, 2, 2, 1, 3 };
+    stats = TriangleMeshOptimizer::analyzeVertexCache(quad, 6, 4);
+    EXPECT_EQ(4u, stats.transformed);
+    EXPECT_FLOAT_EQ(2.0f, stats.acmr);
+    EXPECT_FLOAT_EQ(1.0f, stats.atvr);
+
+    // a cache of 3 loses vertex 0 before it is used again
+    unsigned int strip[] = { 0, 1, 2, 3, 4, 5, 0, 4, 5 };
+    stats = TriangleMeshOptimizer::analyzeVertexCache(strip, 9, 6, 3);
+    EXPECT_EQ(7u, stats.transformed);
+}
+
+/// the vertex cache pass keeps all triangles and lowers the miss ratio
+TEST_F(Mesh_TriangleMeshOptimizerTests, VertexCacheImprovesAcmr)
+{
+    auto before = TriangleMeshOptimizer::analyzeVertexCache(&indices[0], indices.size(), vertexCount);
+    auto expected = getTriangleSet(indices);
+
+    TriangleMeshOptimizer::optimizeVertexCache(&indices[0], indices.size(), vertexCount);
+    auto after = TriangleMeshOptimizer::analyzeVertexCache(&indices[0], indices.size(), vertexCount);
+
+    EXPECT_EQ(expected, getTriangleSet(indices));
+    EXPECT_LT(after.acmr, before.acmr);
+    EXPECT_LT(after.acmr, 1.0f);
+    EXPECT_LT(after.atvr, before.atvr);
+}
+
+/// vertices are renumbered in first use order
+TEST_F(Mesh_TriangleMeshOptimizerTests, VertexFetchUsesFirstUseOrder)
+{
+    std::vector<unsigned int> original = indices;
+    auto remap = TriangleMeshOptimizer::optimizeVertexFetch(&indices[0], indices.size(), vertexCount);
+
+    ASSERT_EQ(vertexCount, remap.size());
+    unsigned int next = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        EXPECT_EQ(remap[original[i]], indices[i]);
+        EXPECT_LE(indices[i], next);
+        if (indices[i] == next)
+            next++;
+    }
+
+    // remap is a permutation
+    std::vector<unsigned int> sorted = remap;
+    std::sort(sorted.begin(), sorted.end());
+    for (unsigned int v = 0; v < vertexCount; v++)
+        EXPECT_EQ(v, sorted[v]);
+}
+
+/// the overdraw pass only moves whole triangles and mostly keeps cache order
+TEST_F(Mesh_TriangleMeshOptimizerTests, OverdrawKeepsTriangles)
+{
+    TriangleMeshOptimizer::optimizeVertexCache(&indices[0], indices.size(), vertexCount);
+    auto before = TriangleMeshOptimizer::analyzeVertexCache(&indices[0], indices.size(), vertexCount);
+    auto expected = getTriangleSet(indices);
+
+    TriangleMeshOptimizer::optimizeOverdraw(&indices[0], indices.size(), &positions[0], 3,
+        vertexCount, 1.05f);
+    auto after = TriangleMeshOptimizer::analyzeVertexCache(&indices[0], indices.size(), vertexCount);
+
+    EXPECT_EQ(expected, getTriangleSet(indices));
+    EXPECT_LT(after.acmr, before.acmr * 1.25f);
+}
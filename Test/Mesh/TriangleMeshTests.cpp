@@ -0,0 +1,168 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains TriangleMesh tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Mesh/TriangleMesh.h>
+
+#include <memory>
+#include <set>
+#include <vector>
+
+using namespace Magic3D;
+
+
+/** Fixture for TriangleMesh tests, works on grids of quads written the way
+ * BoundedPlane does, with six unshared vertices per quad. Meshes are never
+ * uploaded, so no graphics context is needed.
+ */
+class Mesh_TriangleMeshTests : public ::testing::Test
+{
+protected:
+    /// make a grid of quads with positions, normals and texture coordinates
+    static std::shared_ptr<TriangleMesh> makeQuadSoup(unsigned int slices, unsigned int stacks)
+    {
+        std::set<GpuProgram::AttributeType> types;
+        types.insert(GpuProgram::AttributeType::VERTEX);
+        types.insert(GpuProgram::AttributeType::NORMAL);
+        types.insert(GpuProgram::AttributeType::TEX_COORD_0);
+        unsigned int vertexCount = slices * stacks * 6;
+        auto mesh = std::make_shared<TriangleMesh>(vertexCount, vertexCount / 3, types);
+
+        // top left, bottom left, top right, top right, bottom left, bottom right
+        const unsigned int cornerX[6] = { 0, 0, 1, 1, 0, 1 };
+        const unsigned int cornerZ[6] = { 0, 1, 0, 0, 1, 1 };
+
+        unsigned int v = 0;
+        for (unsigned int j = 0; j < stacks; j++)
+        {
+            for (unsigned int i = 0; i < slices; i++)
+            {
+                for (int c = 0; c < 6; c++, v++)
+                {
+                    Scalar x = (Scalar)(i + cornerX[c]), z = (Scalar)(j + cornerZ[c]);
+                    Scalar position[4] = { x, 0.0f, z, 1.0f };
+                    Scalar normal[3] = { 0.0f, 1.0f, 0.0f };
+                    Scalar texCoord[2] = { x / slices, z / stacks };
+                    mesh->setAttributeData(v, GpuProgram::AttributeType::VERTEX, position);
+                    mesh->setAttributeData(v, GpuProgram::AttributeType::NORMAL, normal);
+                    mesh->setAttributeData(v, GpuProgram::AttributeType::TEX_COORD_0, texCoord);
+                }
+            }
+        }
+
+        for (unsigned int f = 0; f < mesh->getFaceCount(); f++)
+            mesh->setFace(f, TriangleMesh::Face(f * 3, f * 3 + 1, f * 3 + 2));
+        return mesh;
+    }
+
+    /// get the positions of the corners of every face, in face order
+    static std::vector<Scalar> getCornerPositions(const TriangleMesh& mesh)
+    {
+        std::vector<Scalar> corners;
+        for (unsigned int f = 0; f < mesh.getFaceCount(); f++)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                const Scalar* position = mesh.getAttributeData(mesh.getFace(f).indices[i],
+                    GpuProgram::AttributeType::VERTEX);
+                corners.insert(corners.end(), position, position + 4);
+            }
+        }
+        return corners;
+    }
+};
+
+
+/// a single quad shares its diagonal once welded
+TEST_F(Mesh_TriangleMeshTests, WeldQuad)
+{
+    auto mesh = makeQuadSoup(1, 1);
+    ASSERT_EQ(6u, mesh->getVertexCount());
+
+    EXPECT_EQ(2u, mesh->weld());
+    EXPECT_EQ(4u, mesh->getVertexCount());
+    EXPECT_EQ(2u, mesh->getFaceCount());
+
+    // nothing is left to weld
+    EXPECT_EQ(0u, mesh->weld());
+    EXPECT_EQ(4u, mesh->getVertexCount());
+}
+
+/// vertices at the same position with other normals or texture coordinates are seams
+TEST_F(Mesh_TriangleMeshTests, WeldKeepsSeams)
+{
+    Scalar normal[3] = { 1.0f, 0.0f, 0.0f };
+    auto mesh = makeQuadSoup(1, 1);
+    mesh->setAttributeData(3, GpuProgram::AttributeType::NORMAL, normal);
+    EXPECT_EQ(1u, mesh->weld());
+    EXPECT_EQ(5u, mesh->getVertexCount());
+
+    Scalar texCoord[2] = { 0.0f, 0.5f };
+    mesh = makeQuadSoup(1, 1);
+    mesh->setAttributeData(4, GpuProgram::AttributeType::TEX_COORD_0, texCoord);
+    EXPECT_EQ(1u, mesh->weld());
+    EXPECT_EQ(5u, mesh->getVertexCount());
+
+    // differences within the epsilon are not seams
+    Scalar position[4] = { 1.000001f, 0.0f, 0.0f, 1.0f };
+    mesh = makeQuadSoup(1, 1);
+    mesh->setAttributeData(3, GpuProgram::AttributeType::VERTEX, position);
+    EXPECT_EQ(2u, mesh->weld());
+    EXPECT_EQ(4u, mesh->getVertexCount());
+}
+
+/// faces keep their corners, now through shared vertices
+TEST_F(Mesh_TriangleMeshTests, WeldRemapsFaces)
+{
+    const unsigned int slices = 8, stacks = 5;
+    auto mesh = makeQuadSoup(slices, stacks);
+    std::vector<Scalar> before = getCornerPositions(*mesh);
+
+    EXPECT_EQ(slices * stacks * 6 - (slices + 1) * (stacks + 1), mesh->weld());
+    ASSERT_EQ((slices + 1) * (stacks + 1), mesh->getVertexCount());
+    ASSERT_EQ(slices * stacks * 2, mesh->getFaceCount());
+    EXPECT_EQ(before, getCornerPositions(*mesh));
+
+    // every vertex left is used
+    std::vector<bool> used(mesh->getVertexCount(), false);
+    for (unsigned int f = 0; f < mesh->getFaceCount(); f++)
+    {
+        for (int i = 0; i < 3; i++)
+            used[mesh->getFace(f).indices[i]] = true;
+    }
+    for (unsigned int v = 0; v < mesh->getVertexCount(); v++)
+        EXPECT_TRUE(used[v]);
+}
+
+/// welding below 65536 vertices switches the element array to 16-bit indices
+TEST_F(Mesh_TriangleMeshTests, WeldShortensIndices)
+{
+    auto mesh = makeQuadSoup(110, 100);
+    ASSERT_EQ(66000u, mesh->getVertexCount());
+    EXPECT_EQ(VertexArray::UNSIGNED_INT, mesh->getIndexType());
+
+    mesh->weld();
+    EXPECT_EQ(111u * 101u, mesh->getVertexCount());
+    EXPECT_EQ(VertexArray::UNSIGNED_SHORT, mesh->getIndexType());
+}
@@ -0,0 +1,218 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains MeshCache tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Resources/MeshCache.h>
+#include <Objects/Model.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Magic3D;
+
+
+/** Fixture for MeshCache tests, saves a model of a quad with a one
+ * triangle level of detail. Meshes are never uploaded, so no graphics
+ * context is needed.
+ */
+class Resources_MeshCacheTests : public ::testing::Test
+{
+protected:
+    static const uint64_t SOURCE_HASH = 0x1234;
+    static const uint64_t OPTIONS_HASH = 0x5678;
+
+    std::string path;
+    std::shared_ptr<TriangleMesh> quad;
+    std::shared_ptr<TriangleMesh> triangle;
+    Model model;
+
+    /// make a mesh with positions, normals and texture coordinates
+    static std::shared_ptr<TriangleMesh> makeMesh(unsigned int vertexCount,
+        const std::vector<TriangleMesh::Face>& faces)
+    {
+        std::set<GpuProgram::AttributeType> types;
+        types.insert(GpuProgram::AttributeType::VERTEX);
+        types.insert(GpuProgram::AttributeType::NORMAL);
+        types.insert(GpuProgram::AttributeType::TEX_COORD_0);
+        auto mesh = std::make_shared<TriangleMesh>(vertexCount, (unsigned int)faces.size(), types);
+
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            Scalar position[4] = { (Scalar)(v % 2), 0.0f, (Scalar)(v / 2), 1.0f };
+            Scalar normal[3] = { 0.0f, 1.0f, 0.0f };
+            Scalar texCoord[2] = { (Scalar)(v % 2), (Scalar)(v / 2) };
+            mesh->setAttributeData(v, GpuProgram::AttributeType::VERTEX, position);
+            mesh->setAttributeData(v, GpuProgram::AttributeType::NORMAL, normal);
+            mesh->setAttributeData(v, GpuProgram::AttributeType::TEX_COORD_0, texCoord);
+        }
+        mesh->setFaceData(0, &faces[0], (unsigned int)faces.size());
+
+        // known bounds, so the collision shape is never built
+        mesh->setBoundingVolumes(Vector3(0.5f, 0, 0.5f), 0.75f, Vector3(0.5f, 0, 0.5f), 1.0f);
+        return mesh;
+    }
+
+    /// read the saved cache file
+    std::vector<char> readFile()
+    {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    /// replace the cache file
+    void writeFile(const std::vector<char>& contents)
+    {
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), contents.size());
+    }
+
+    /// load the cache file with the hashes it was saved with
+    std::shared_ptr<Model> load()
+    {
+        return MeshCache::load(path, SOURCE_HASH, OPTIONS_HASH, TriangleMesh::VertexLayout::SEPARATE);
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        path = "MeshCacheTests.m3dmesh";
+
+        std::vector<TriangleMesh::Face> quadFaces;
+        quadFaces.push_back(TriangleMesh::Face(0, 2, 1));
+        quadFaces.push_back(TriangleMesh::Face(1, 2, 3));
+        quad = makeMesh(4, quadFaces);
+        triangle = makeMesh(3, std::vector<TriangleMesh::Face>(1, TriangleMesh::Face(0, 2, 1)));
+
+        model.setMeshes(quad);
+        model.addLod(std::vector<std::shared_ptr<Geometry>>(1, triangle), 0.25f);
+        ASSERT_TRUE(MeshCache::save(path, model, SOURCE_HASH, OPTIONS_HASH));
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        std::remove(path.c_str());
+    }
+};
+
+
+/// meshes, levels of detail and bounds come back as they were saved
+TEST_F(Resources_MeshCacheTests, RoundTrip)
+{
+    auto loaded = load();
+    ASSERT_NE(nullptr, loaded);
+    ASSERT_EQ(2u, loaded->getLodCount());
+    EXPECT_FLOAT_EQ(0.25f, loaded->getLodScreenSize(1));
+
+    for (unsigned int level = 0; level < 2; level++)
+    {
+        ASSERT_EQ(1u, loaded->getLodMeshes(level).size());
+        const TriangleMesh& expected = model.getLodMeshes(level)[0]->getTriangleMesh();
+        const TriangleMesh& mesh = loaded->getLodMeshes(level)[0]->getTriangleMesh();
+
+        EXPECT_TRUE(mesh.isUsingSharedStorage());
+        ASSERT_EQ(expected.getVertexCount(), mesh.getVertexCount());
+        ASSERT_EQ(expected.getFaceCount(), mesh.getFaceCount());
+        EXPECT_TRUE(mesh.hasType(GpuProgram::AttributeType::NORMAL));
+        EXPECT_FALSE(mesh.hasType(GpuProgram::AttributeType::TANGENT));
+
+        for (int t = 0; t < GpuProgram::MAX_ATTRIBUTE_TYPES; t++)
+        {
+            if (!mesh.hasType((GpuProgram::AttributeType)t))
+                continue;
+            EXPECT_EQ(0, memcmp(expected.getAttributeData(0, (GpuProgram::AttributeType)t),
+                mesh.getAttributeData(0, (GpuProgram::AttributeType)t),
+                GpuProgram::attributeTypeCompCount[t] * sizeof(Scalar) * mesh.getVertexCount()));
+        }
+        EXPECT_EQ(0, memcmp(expected.getFaceData(0), mesh.getFaceData(0),
+            sizeof(TriangleMesh::Face) * mesh.getFaceCount()));
+
+        EXPECT_FLOAT_EQ(0.75f, mesh.getBoundingSphere().getRadius());
+        EXPECT_FLOAT_EQ(0.5f, mesh.getBoundingSphere().getTranslation().x());
+    }
+}
+
+/// a cache of another source or made with other options is not used
+TEST_F(Resources_MeshCacheTests, RejectsOtherHashes)
+{
+    EXPECT_NE(nullptr, load());
+    EXPECT_EQ(nullptr, MeshCache::load(path, SOURCE_HASH + 1, OPTIONS_HASH,
+        TriangleMesh::VertexLayout::SEPARATE));
+    EXPECT_EQ(nullptr, MeshCache::load(path, SOURCE_HASH, OPTIONS_HASH + 1,
+        TriangleMesh::VertexLayout::SEPARATE));
+    EXPECT_EQ(nullptr, MeshCache::load("MeshCacheTests.missing", SOURCE_HASH, OPTIONS_HASH,
+        TriangleMesh::VertexLayout::SEPARATE));
+}
+
+/// cut short files are not read past their end
+TEST_F(Resources_MeshCacheTests, RejectsTruncated)
+{
+    std::vector<char> contents = readFile();
+
+    // the faces of the last mesh, padded to 16 bytes, end the file
+    writeFile(std::vector<char>(contents.begin(), contents.end() - 16));
+    EXPECT_EQ(nullptr, load());
+
+    // in the middle of the mesh table
+    writeFile(std::vector<char>(contents.begin(), contents.begin() + 80));
+    EXPECT_EQ(nullptr, load());
+
+    // in the middle of the header
+    writeFile(std::vector<char>(contents.begin(), contents.begin() + 20));
+    EXPECT_EQ(nullptr, load());
+
+    writeFile(contents);
+    EXPECT_NE(nullptr, load());
+}
+
+/// faces that index past the vertices are not used
+TEST_F(Resources_MeshCacheTests, RejectsIndicesOutOfRange)
+{
+    std::vector<char> contents = readFile();
+
+    // the table of meshes follows the 48 byte header and the 16 byte level
+    // of detail, the first field after the counts is the offset of the faces
+    uint64_t faceOffset;
+    memcpy(&faceOffset, &contents[48 + 16 + 8], sizeof(faceOffset));
+    ASSERT_LT(faceOffset + sizeof(TriangleMesh::Face), contents.size());
+
+    unsigned int index;
+    memcpy(&index, &contents[(size_t)faceOffset], sizeof(index));
+    EXPECT_EQ(0u, index);
+
+    index = quad->getVertexCount();
+    memcpy(&contents[(size_t)faceOffset], &index, sizeof(index));
+    writeFile(contents);
+    EXPECT_EQ(nullptr, load());
+
+    index = quad->getVertexCount() - 1;
+    memcpy(&contents[(size_t)faceOffset], &index, sizeof(index));
+    writeFile(contents);
+    EXPECT_NE(nullptr, load());
+}
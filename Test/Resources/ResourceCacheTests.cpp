@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains ResourceCache tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Resources/ResourceCache.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Magic3D;
+
+
+/** Fixture for ResourceCache tests
+ */
+class Resources_ResourceCacheTests : public ::testing::Test
+{
+protected:
+    ResourceCache cache;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        // no setup
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+};
+
+
+/// asking for a resource while it loads joins the load, once loaded it is returned
+TEST_F(Resources_ResourceCacheTests, JoinsLoadThenReturnsLoaded)
+{
+    auto first = cache.acquire<int>("a", true);
+    ASSERT_NE(nullptr, first.promise);
+
+    auto second = cache.acquire<int>("a", false);
+    EXPECT_EQ(nullptr, second.promise);
+    EXPECT_EQ(nullptr, second.loaded);
+    EXPECT_TRUE(second.async);
+
+    auto resource = std::make_shared<int>(5);
+    cache.complete("a", resource);
+    first.promise->set_value(resource);
+    EXPECT_EQ(resource, second.loading.get());
+
+    auto third = cache.acquire<int>("a", false);
+    EXPECT_EQ(nullptr, third.promise);
+    EXPECT_EQ(resource, third.loaded);
+}
+
+/// the same name as another type is a different resource
+TEST_F(Resources_ResourceCacheTests, KeysByType)
+{
+    auto asInt = cache.acquire<int>("a", false);
+    auto asFloat = cache.acquire<float>("a", false);
+    EXPECT_NE(nullptr, asInt.promise);
+    EXPECT_NE(nullptr, asFloat.promise);
+}
+
+/// failed and destroyed resources are loaded again
+TEST_F(Resources_ResourceCacheTests, ReloadsFailedAndDestroyed)
+{
+    cache.acquire<int>("a", false);
+    cache.fail<int>("a");
+    EXPECT_NE(nullptr, cache.acquire<int>("a", false).promise);
+
+    cache.complete("a", std::make_shared<int>(5));
+    EXPECT_NE(nullptr, cache.acquire<int>("a", false).promise);
+}
+
+/// entries of destroyed resources are pruned, others kept
+TEST_F(Resources_ResourceCacheTests, PrunesDestroyed)
+{
+    auto kept = std::make_shared<int>(1);
+    cache.acquire<int>("kept", false);
+    cache.complete("kept", kept);
+    cache.acquire<int>("destroyed", false);
+    cache.complete("destroyed", std::make_shared<int>(2));
+    cache.acquire<int>("loading", false);
+
+    EXPECT_EQ(1u, cache.prune());
+    EXPECT_EQ(2u, cache.getSize());
+}
+
+/// threads asking for the same resource at once claim a single load
+TEST_F(Resources_ResourceCacheTests, ConcurrentAcquireClaimsOnce)
+{
+    std::atomic<int> claims(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++)
+    {
+        threads.push_back(std::thread([this, &claims]() {
+            for (int j = 0; j < 100; j++)
+            {
+                if (cache.acquire<int>(std::to_string(j), false).promise != nullptr)
+                    claims++;
+            }
+        }));
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(100, claims);
+}
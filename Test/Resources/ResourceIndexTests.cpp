@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains ResourceIndex tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Resources/ResourceIndex.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+// include dependent on OS (Windows or everyone else)
+#ifdef _WIN32
+#include <direct.h>
+#define makeDir(path) _mkdir(path)
+#define removeDir(path) _rmdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define makeDir(path) mkdir(path, 0755)
+#define removeDir(path) rmdir(path)
+#endif
+
+using namespace Magic3D;
+
+
+/** Fixture for ResourceIndex tests, works on two resource directories
+ * made for each test
+ */
+class Resources_ResourceIndexTests : public ::testing::Test
+{
+protected:
+    ResourceIndex index;
+
+    /// write an empty file
+    void writeFile(const std::string& path)
+    {
+        std::ofstream out(path.c_str());
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        makeDir("IndexTestsA");
+        makeDir("IndexTestsA/images");
+        makeDir("IndexTestsB");
+        writeFile("IndexTestsA/images/a.tga");
+        writeFile("IndexTestsA/shared.txt");
+        writeFile("IndexTestsB/shared.txt");
+        writeFile("IndexTestsB/b.txt");
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        std::remove("IndexTestsA/images/a.tga");
+        std::remove("IndexTestsA/shared.txt");
+        std::remove("IndexTestsB/shared.txt");
+        std::remove("IndexTestsB/b.txt");
+        std::remove("IndexTestsB/new.txt");
+        removeDir("IndexTestsA/images");
+        removeDir("IndexTestsA");
+        removeDir("IndexTestsB");
+    }
+};
+
+
+/// files are found in subdirectories, the directory added first wins
+TEST_F(Resources_ResourceIndexTests, FindsFiles)
+{
+    index.addDir("IndexTestsA");
+    index.addDir("IndexTestsB");
+
+    EXPECT_EQ(3u, index.getSize());
+    EXPECT_EQ("IndexTestsA/images/a.tga", index.find("images/a.tga").getFullPath());
+    EXPECT_EQ("IndexTestsA/images/a.tga", index.find("images\\a.tga").getFullPath());
+    EXPECT_EQ("IndexTestsA/shared.txt", index.find("shared.txt").getFullPath());
+    EXPECT_EQ("IndexTestsB/b.txt", index.find("b.txt").getFullPath());
+    EXPECT_FALSE(index.contains("images"));
+    EXPECT_FALSE(index.contains("missing.txt"));
+}
+
+/// files added later are found once refreshed
+TEST_F(Resources_ResourceIndexTests, Refresh)
+{
+    index.addDir("IndexTestsA");
+    index.addDir("IndexTestsB");
+    writeFile("IndexTestsB/new.txt");
+    EXPECT_FALSE(index.contains("new.txt"));
+
+    index.refresh();
+    EXPECT_EQ("IndexTestsB/new.txt", index.find("new.txt").getFullPath());
+    EXPECT_EQ("IndexTestsA/shared.txt", index.find("shared.txt").getFullPath());
+}
@@ -0,0 +1,153 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains ResourcePack tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Resources/ResourcePack.h>
+#include <Resources/ResourceIndex.h>
+#include <Exceptions/MagicException.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+// include dependent on OS (Windows or everyone else)
+#ifdef _WIN32
+#include <direct.h>
+#define makeDir(path) _mkdir(path)
+#define removeDir(path) _rmdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define makeDir(path) mkdir(path, 0755)
+#define removeDir(path) rmdir(path)
+#endif
+
+using namespace Magic3D;
+
+
+/** Fixture for ResourcePack tests, packs a directory made for each test
+ */
+class Resources_ResourcePackTests : public ::testing::Test
+{
+protected:
+    std::string text;
+    std::string binary;
+
+    /// write a file
+    void writeFile(const std::string& path, const std::string& contents)
+    {
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), contents.size());
+    }
+
+    /// check data read holds the contents given
+    void expectContents(const std::string& contents, const ResourceData& data)
+    {
+        ASSERT_EQ(contents.size(), data.getSize());
+        if (!contents.empty())
+        {
+            EXPECT_EQ(0, memcmp(contents.data(), data.getData(), contents.size()));
+        }
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        for (int i = 0; i < 100; i++)
+            text += "<material name=\"bricks\"/>\n";
+        for (int i = 0; i < 100; i++)
+            binary += (char)(i * 7919 % 251);
+
+        makeDir("PackTests");
+        makeDir("PackTests/shaders");
+        writeFile("PackTests/shaders/text.xml", text);
+        writeFile("PackTests/binary.tga", binary);
+        writeFile("PackTests/empty.txt", "");
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        std::remove("PackTests/shaders/text.xml");
+        std::remove("PackTests/binary.tga");
+        std::remove("PackTests/empty.txt");
+        std::remove("PackTests.m3dpak");
+        removeDir("PackTests/shaders");
+        removeDir("PackTests");
+    }
+};
+
+
+/// every file is packed and reads back the same, compressed only if it pays
+TEST_F(Resources_ResourcePackTests, BuildAndRead)
+{
+    ResourcePack::BuildStats stats = ResourcePack::build("PackTests", "PackTests.m3dpak", true);
+    EXPECT_EQ(3u, stats.fileCount);
+    EXPECT_EQ(1u, stats.compressedCount);
+    EXPECT_EQ(text.size() + binary.size(), stats.size);
+
+    ResourcePack pack("PackTests.m3dpak");
+    ASSERT_EQ(3u, pack.getEntryCount());
+
+    size_t entry;
+    ASSERT_TRUE(pack.find("shaders/text.xml", entry));
+    EXPECT_EQ(ResourcePack::Compression::LZ4, pack.getCompression(entry));
+    expectContents(text, pack.read(entry));
+
+    ASSERT_TRUE(pack.find("shaders\\text.xml", entry));
+    ASSERT_TRUE(pack.find("binary.tga", entry));
+    EXPECT_EQ(ResourcePack::Compression::NONE, pack.getCompression(entry));
+    expectContents(binary, pack.read(entry));
+
+    ASSERT_TRUE(pack.find("empty.txt", entry));
+    expectContents("", pack.read(entry));
+
+    EXPECT_FALSE(pack.find("missing.txt", entry));
+}
+
+/// packs are indexed alongside directories, the one added first wins
+TEST_F(Resources_ResourcePackTests, MountedInIndex)
+{
+    ResourcePack::build("PackTests", "PackTests.m3dpak", false);
+    auto pack = std::make_shared<ResourcePack>("PackTests.m3dpak");
+
+    ResourceIndex index;
+    index.addPack(pack);
+    index.addDir("PackTests");
+
+    ResourceIndex::File file = index.find("shaders/text.xml");
+    ASSERT_TRUE(file.exists());
+    EXPECT_TRUE(file.isPacked());
+    EXPECT_EQ("PackTests.m3dpak/shaders/text.xml", file.getFullPath());
+    expectContents(text, file.read());
+}
+
+/// files that are not packs are rejected
+TEST_F(Resources_ResourcePackTests, RejectsInvalidPack)
+{
+    writeFile("PackTests.m3dpak", text);
+    EXPECT_THROW(ResourcePack pack("PackTests.m3dpak"), MagicException);
+}
@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains ProgramCache tests, of what needs no GL context
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Shaders/ProgramCache.h>
+
+using namespace Magic3D;
+
+
+/** Fixture for ProgramCache tests
+ */
+class Shaders_ProgramCacheTests : public ::testing::Test
+{
+protected:
+    std::vector<std::pair<std::string, GpuProgram::AttributeType>> attributes;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        attributes.push_back(std::make_pair(std::string("vertex"), GpuProgram::VERTEX));
+        attributes.push_back(std::make_pair(std::string("normal"), GpuProgram::NORMAL));
+    }
+};
+
+
+TEST_F(Shaders_ProgramCacheTests, KeyCoversSourcesAndBindings)
+{
+    uint64_t key = ProgramCache::hashSources("vertex", "fragment", attributes);
+    EXPECT_EQ(key, ProgramCache::hashSources("vertex", "fragment", attributes));
+
+    EXPECT_NE(key, ProgramCache::hashSources("vertex ", "fragment", attributes));
+    EXPECT_NE(key, ProgramCache::hashSources("vertex", "fragment ", attributes));
+
+    // text moved between the shaders is another program
+    EXPECT_NE(key, ProgramCache::hashSources("vertexf", "ragment", attributes));
+
+    auto rebound = attributes;
+    rebound[1].second = GpuProgram::TANGENT;
+    EXPECT_NE(key, ProgramCache::hashSources("vertex", "fragment", rebound));
+
+    auto renamed = attributes;
+    renamed[1].first = "normal2";
+    EXPECT_NE(key, ProgramCache::hashSources("vertex", "fragment", renamed));
+}
+
+TEST_F(Shaders_ProgramCacheTests, CachePath)
+{
+    EXPECT_EQ("shaders/Full.gpu.xml.m3dprog",
+        ProgramCache::getCachePath("shaders/Full.gpu.xml", ""));
+
+    std::string first = ProgramCache::getCachePath("a/Full.gpu.xml", "cache");
+    std::string second = ProgramCache::getCachePath("b/Full.gpu.xml", "cache");
+    EXPECT_EQ(0u, first.find("cache/"));
+    EXPECT_NE(first, second);
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Shader tests, of what needs no GL context
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Shaders/Shader.h>
+
+using namespace Magic3D;
+
+
+/** Fixture for Shader tests
+ */
+class Shaders_ShaderTests : public ::testing::Test
+{
+protected:
+    std::vector<std::string> defines;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        defines.push_back("NORMAL_MAPPING");
+        defines.push_back("SHADOW_MAPPING");
+    }
+};
+
+TEST_F(Shaders_ShaderTests, DefinesFollowVersion)
+{
+    std::string source = "// comment\n#version 420 core\n\nvoid main(void) {}\n";
+    EXPECT_EQ("// comment\n#version 420 core\n#define NORMAL_MAPPING\n#define SHADOW_MAPPING\n"
+        "#line 3\n\nvoid main(void) {}\n", Shader::addDefines(source, defines));
+}
+
+TEST_F(Shaders_ShaderTests, DefinesWithoutVersion)
+{
+    std::string source = "void main(void) {}\n";
+    EXPECT_EQ("#define NORMAL_MAPPING\n#define SHADOW_MAPPING\n#line 1\nvoid main(void) {}\n",
+        Shader::addDefines(source, defines));
+    EXPECT_EQ(source, Shader::addDefines(source, std::vector<std::string>()));
+}
+
+TEST_F(Shaders_ShaderTests, DeclarationsFollowDefines)
+{
+    std::string source = "#version 420 core\nvoid main(void) {}\n";
+    EXPECT_EQ("#version 420 core\n#define NORMAL_MAPPING\n#define SHADOW_MAPPING\n"
+        "uniform float shared;\n#line 2\nvoid main(void) {}\n",
+        Shader::addDefines(source, defines, "uniform float shared;"));
+    EXPECT_EQ("#version 420 core\nuniform float shared;\n#line 2\nvoid main(void) {}\n",
+        Shader::addDefines(source, std::vector<std::string>(), "uniform float shared;\n"));
+}
@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains Lz4 tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Util/Lz4.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace Magic3D;
+
+
+/** Fixture for Lz4 tests
+ */
+class Util_Lz4Tests : public ::testing::Test
+{
+protected:
+    /// compress and decompress, checking the result is the same
+    void roundTrip(const std::vector<unsigned char>& data)
+    {
+        std::vector<unsigned char> compressed = Lz4::compress(data.data(), data.size());
+        EXPECT_LE(compressed.size(), Lz4::getMaxCompressedSize(data.size()));
+
+        std::vector<unsigned char> out(data.size() + 1);
+        ASSERT_TRUE(Lz4::decompress(compressed.data(), compressed.size(), out.data(), data.size()));
+        out.resize(data.size());
+        EXPECT_EQ(data, out);
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        // no setup
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+};
+
+
+/// repetitive data gets smaller and comes back the same
+TEST_F(Util_Lz4Tests, CompressesRepetitiveData)
+{
+    std::string text;
+    for (int i = 0; i < 200; i++)
+        text += "<texture name=\"bricks\" wrap=\"repeat\"/>\n";
+    std::vector<unsigned char> data(text.begin(), text.end());
+
+    EXPECT_LT(Lz4::compress(data.data(), data.size()).size(), data.size() / 10);
+    roundTrip(data);
+}
+
+/// data that does not compress, and tiny or empty data, still round trips
+TEST_F(Util_Lz4Tests, RoundTripsAnyData)
+{
+    std::vector<unsigned char> data;
+    roundTrip(data);
+
+    srand(1);
+    for (size_t size : { 1, 5, 12, 13, 300, 70000 })
+    {
+        data.resize(size);
+        for (size_t i = 0; i < size; i++)
+            data[i] = (unsigned char)(rand() % 4 == 0 ? rand() : 'a' + i % 3);
+        roundTrip(data);
+    }
+}
+
+/// corrupt blocks are rejected instead of reading or writing out of bounds
+TEST_F(Util_Lz4Tests, RejectsCorruptData)
+{
+    std::vector<unsigned char> data(1000, 'x');
+    std::vector<unsigned char> compressed = Lz4::compress(data.data(), data.size());
+    std::vector<unsigned char> out(data.size());
+
+    EXPECT_FALSE(Lz4::decompress(compressed.data(), compressed.size(), out.data(), 999));
+    EXPECT_FALSE(Lz4::decompress(compressed.data(), compressed.size() - 1, out.data(), out.size()));
+
+    // a match before the start of the output
+    unsigned char badOffset[] = { 0x10, 'x', 0x05, 0x00, 0x00 };
+    EXPECT_FALSE(Lz4::decompress(badOffset, sizeof(badOffset), out.data(), out.size()));
+}
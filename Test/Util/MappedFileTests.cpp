@@ -0,0 +1,90 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains MappedFile tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Util/MappedFile.h>
+#include <Exceptions/MagicException.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+using namespace Magic3D;
+
+
+/** Fixture for MappedFile tests, works on a file written for each test
+ */
+class Util_MappedFileTests : public ::testing::Test
+{
+protected:
+    std::string path;
+
+    /// write the file to map
+    void writeFile(const std::string& contents)
+    {
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), contents.size());
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        path = "MappedFileTests.tmp";
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        std::remove(path.c_str());
+    }
+};
+
+
+/// the mapping holds the contents of the file
+TEST_F(Util_MappedFileTests, MapsContents)
+{
+    std::string contents("mapped\0contents", 15);
+    writeFile(contents);
+
+    MappedFile file(path);
+    ASSERT_EQ(contents.size(), file.getSize());
+    EXPECT_EQ(0, memcmp(contents.data(), file.getData(), contents.size()));
+}
+
+/// empty files map to nothing instead of failing
+TEST_F(Util_MappedFileTests, EmptyFile)
+{
+    writeFile("");
+
+    MappedFile file(path);
+    EXPECT_EQ(0u, file.getSize());
+    EXPECT_EQ(nullptr, file.getData());
+}
+
+/// files that do not exist cannot be mapped
+TEST_F(Util_MappedFileTests, MissingFileThrows)
+{
+    EXPECT_THROW(MappedFile file("MappedFileTests.missing"), MagicException);
+}
@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains ThreadPool tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <Util/ThreadPool.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace Magic3D;
+
+
+/** Fixture for ThreadPool tests
+ */
+class Util_ThreadPoolTests : public ::testing::Test
+{
+protected:
+    ThreadPool pool;
+
+    Util_ThreadPoolTests() : pool(4) {}
+
+    /// setup method
+    virtual void SetUp()
+    {
+        // no setup
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+};
+
+
+/// every index is visited exactly once
+TEST_F(Util_ThreadPoolTests, ParallelForCoversRange)
+{
+    EXPECT_EQ(4u, pool.getThreadCount());
+
+    std::vector<std::atomic<int>> visits(10007);
+    for (auto& count : visits)
+        count = 0;
+
+    pool.parallelFor(3, visits.size(), 100, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            visits[i]++;
+    });
+
+    for (size_t i = 0; i < visits.size(); i++)
+        EXPECT_EQ(i < 3 ? 0 : 1, visits[i].load());
+}
+
+/// loops smaller than the grain size run on the caller in one chunk
+TEST_F(Util_ThreadPoolTests, SmallLoopRunsOnCaller)
+{
+    std::thread::id caller = std::this_thread::get_id();
+    int chunks = 0;
+    pool.parallelFor(0, 50, 100, [&](size_t begin, size_t end) {
+        EXPECT_EQ(caller, std::this_thread::get_id());
+        EXPECT_EQ(0u, begin);
+        EXPECT_EQ(50u, end);
+        chunks++;
+    });
+    EXPECT_EQ(1, chunks);
+}
+
+/// exceptions thrown by a chunk reach the caller
+TEST_F(Util_ThreadPoolTests, ExceptionsArePropagated)
+{
+    EXPECT_THROW(pool.parallelFor(0, 1000, 1, [](size_t begin, size_t end) {
+        if (begin > 0)
+            throw std::runtime_error("chunk failed");
+    }), std::runtime_error);
+
+    // the pool is still usable afterwards
+    std::atomic<int> total(0);
+    pool.parallelFor(0, 1000, 1, [&](size_t begin, size_t end) {
+        total += (int)(end - begin);
+    });
+    EXPECT_EQ(1000, total.load());
+}
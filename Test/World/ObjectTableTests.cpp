@@ -0,0 +1,148 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains ObjectTable tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <World/ObjectTable.h>
+
+using namespace Magic3D;
+
+
+/** Fixture for ObjectTable tests
+ */
+class World_ObjectTableTests : public ::testing::Test
+{
+protected:
+    ObjectTable table;
+
+    // stand-ins for objects and models, only their addresses are used
+    int objects[4];
+    int model;
+
+    inline Object* object(int i)
+    {
+        return (Object*)&objects[i];
+    }
+
+    /// setup method
+    virtual void SetUp()
+    {
+        table.clear();
+    }
+};
+
+TEST_F(World_ObjectTableTests, HandlesSurviveRemoval)
+{
+    ObjectHandle a = table.add(object(0), (Model*)&model, false);
+    ObjectHandle b = table.add(object(1), (Model*)&model, true);
+    ObjectHandle c = table.add(object(2), (Model*)&model, false);
+    table.setBounds(table.getRow(c), Vector3(1, 2, 3), 4);
+    table.setLodLevel(table.getRow(c), 2);
+
+    // removing a row moves the last one into its place
+    EXPECT_TRUE(table.remove(a));
+    EXPECT_EQ(2u, table.getSize());
+    EXPECT_EQ(object(1), table.get(b));
+    EXPECT_EQ(object(2), table.get(c));
+    EXPECT_TRUE(table.isStatic(table.getRow(b)));
+    EXPECT_FALSE(table.isStatic(table.getRow(c)));
+    EXPECT_EQ(4, table.getRadius(table.getRow(c)));
+    EXPECT_EQ(2, table.getCenter(table.getRow(c)).y());
+    EXPECT_EQ(2u, table.getLodLevel(table.getRow(c)));
+    EXPECT_EQ((Model*)&model, table.getModel(table.getRow(c)));
+
+    // a removed handle stays invalid when its slot is used again
+    EXPECT_FALSE(table.contains(a));
+    EXPECT_FALSE(table.remove(a));
+    ObjectHandle d = table.add(object(3), (Model*)&model, false);
+    EXPECT_EQ(a.slot, d.slot);
+    EXPECT_NE(a, d);
+    EXPECT_EQ(nullptr, table.get(a));
+    EXPECT_EQ(object(3), table.get(d));
+    EXPECT_FALSE(table.contains(ObjectHandle()));
+
+    table.clear();
+    EXPECT_EQ(0u, table.getSize());
+    EXPECT_FALSE(table.contains(b));
+}
+
+TEST_F(World_ObjectTableTests, CullAndDepth)
+{
+    // spheres along the z axis, viewed from the origin looking down -z
+    for (int i = 0; i < 4; i++)
+    {
+        ObjectHandle h = table.add(object(i), (Model*)&model, false);
+        table.setBounds(table.getRow(h), Vector3(0, 0, -10.0f * i), 1);
+    }
+
+    table.computeDepths(Vector3(0, 0, 0), Vector3(0, 0, -1));
+    for (size_t row = 0; row < table.getSize(); row++)
+        EXPECT_FLOAT_EQ(10.0f * row, table.getDepth(row));
+
+    // keep what is between z = -5 and z = -25, spheres touching count
+    Scalar planes[2][4] = {
+        { 0, 0, -1, -5 },
+        { 0, 0, 1, 25 }
+    };
+    std::vector<uint32_t> visible;
+    table.cull(planes, 2, visible);
+    ASSERT_EQ(2u, visible.size());
+    EXPECT_EQ(1u, visible[0]);
+    EXPECT_EQ(2u, visible[1]);
+
+    planes[1][3] = 31;
+    table.cull(planes, 2, visible);
+    EXPECT_EQ(3u, visible.size());
+}
+
+TEST_F(World_ObjectTableTests, MovedOnce)
+{
+    ObjectHandle a = table.add(object(0), (Model*)&model, false);
+    ObjectHandle b = table.add(object(1), (Model*)&model, false);
+    ObjectHandle c = table.add(object(2), (Model*)&model, false);
+    std::vector<uint32_t> rows;
+
+    // marked twice, given once
+    table.markMoved(c);
+    table.markMoved(a);
+    table.markMoved(c);
+    table.takeMoved(rows);
+    ASSERT_EQ(2u, rows.size());
+    EXPECT_EQ(object(2), table.getObject(rows[0]));
+    EXPECT_EQ(object(0), table.getObject(rows[1]));
+
+    // marks are cleared once taken
+    table.takeMoved(rows);
+    EXPECT_TRUE(rows.empty());
+
+    // removed objects are left out, moved rows are followed
+    table.markMoved(a);
+    table.markMoved(c);
+    table.remove(a);
+    table.markMoved(b);
+    table.markMoved(a);
+    table.takeMoved(rows);
+    ASSERT_EQ(2u, rows.size());
+    EXPECT_EQ(object(2), table.getObject(rows[0]));
+    EXPECT_EQ(object(1), table.getObject(rows[1]));
+}
@@ -0,0 +1,175 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Contains RenderQueue tests
+ */
+
+// include google test framework
+#include <gtest/gtest.h>
+
+#include <World/RenderQueue.h>
+#include <Util/RadixSort.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace Magic3D;
+
+
+/** Fixture for RenderQueue tests
+ */
+class World_RenderQueueTests : public ::testing::Test
+{
+protected:
+    RenderQueue queue;
+
+    // stand-ins for state objects, only their addresses are used
+    int programA, programB;
+    int textureA, textureB;
+    int materialA, materialB;
+
+    /// setup method
+    virtual void SetUp()
+    {
+        queue.clear();
+    }
+
+    /// teardown method
+    virtual void TearDown()
+    {
+        // no teardown
+    }
+};
+
+
+/// opaque items must always come before transparent items
+TEST_F(World_RenderQueueTests, OpaqueBeforeTransparent)
+{
+    queue.push(queue.makeKey(true, &programA, &textureA, &materialA, nullptr, 1.0f, 100.0f), 0);
+    queue.push(queue.makeKey(false, &programB, &textureB, &materialB, nullptr, 99.0f, 100.0f), 1);
+    queue.sort();
+
+    ASSERT_EQ(2u, queue.size());
+    EXPECT_EQ(1u, queue[0].index);
+    EXPECT_EQ(0u, queue[1].index);
+}
+
+/// opaque items sharing state are drawn front to back
+TEST_F(World_RenderQueueTests, OpaqueFrontToBack)
+{
+    queue.push(queue.makeKey(false, &programA, &textureA, &materialA, nullptr, 50.0f, 100.0f), 0);
+    queue.push(queue.makeKey(false, &programA, &textureA, &materialA, nullptr, 10.0f, 100.0f), 1);
+    queue.push(queue.makeKey(false, &programA, &textureA, &materialA, nullptr, 90.0f, 100.0f), 2);
+    queue.sort();
+
+    EXPECT_EQ(1u, queue[0].index);
+    EXPECT_EQ(0u, queue[1].index);
+    EXPECT_EQ(2u, queue[2].index);
+}
+
+/// opaque items are grouped by state before depth
+TEST_F(World_RenderQueueTests, OpaqueGroupedByState)
+{
+    queue.push(queue.makeKey(false, &programA, &textureA, &materialA, nullptr, 10.0f, 100.0f), 0);
+    queue.push(queue.makeKey(false, &programB, &textureB, &materialB, nullptr, 20.0f, 100.0f), 1);
+    queue.push(queue.makeKey(false, &programA, &textureA, &materialA, nullptr, 30.0f, 100.0f), 2);
+    queue.push(queue.makeKey(false, &programB, &textureB, &materialB, nullptr, 5.0f, 100.0f), 3);
+    queue.sort();
+
+    EXPECT_EQ(0u, queue[0].index);
+    EXPECT_EQ(2u, queue[1].index);
+    EXPECT_EQ(3u, queue[2].index);
+    EXPECT_EQ(1u, queue[3].index);
+}
+
+/// transparent items are drawn back to front regardless of state
+TEST_F(World_RenderQueueTests, TransparentBackToFront)
+{
+    queue.push(queue.makeKey(true, &programA, &textureA, &materialA, nullptr, 10.0f, 100.0f), 0);
+    queue.push(queue.makeKey(true, &programB, &textureB, &materialB, nullptr, 80.0f, 100.0f), 1);
+    queue.push(queue.makeKey(true, &programA, &textureA, &materialA, nullptr, 40.0f, 100.0f), 2);
+    queue.sort();
+
+    EXPECT_EQ(1u, queue[0].index);
+    EXPECT_EQ(2u, queue[1].index);
+    EXPECT_EQ(0u, queue[2].index);
+}
+
+/// items of the same mesh are kept together within a state group
+TEST_F(World_RenderQueueTests, OpaqueGroupedByMesh)
+{
+    int meshA = 0, meshB = 0;
+    queue.push(queue.makeKey(false, &programA, &textureA, &materialA, &meshA, 10.0f, 100.0f), 0);
+    queue.push(queue.makeKey(false, &programA, &textureA, &materialA, &meshB, 20.0f, 100.0f), 1);
+    queue.push(queue.makeKey(false, &programA, &textureA, &materialA, &meshA, 30.0f, 100.0f), 2);
+    queue.sort();
+
+    EXPECT_EQ(0u, queue[0].index);
+    EXPECT_EQ(2u, queue[1].index);
+    EXPECT_EQ(1u, queue[2].index);
+}
+
+/// ids are handed out again after a clear, so they never outlive a frame
+TEST_F(World_RenderQueueTests, ClearForgetsIds)
+{
+    uint64_t key = queue.makeKey(false, &programA, &textureA, &materialA, nullptr, 10.0f, 100.0f);
+    EXPECT_NE(key, queue.makeKey(false, &programB, &textureB, &materialB, nullptr, 10.0f, 100.0f));
+
+    queue.clear();
+    EXPECT_EQ(key, queue.makeKey(false, &programB, &textureB, &materialB, nullptr, 10.0f, 100.0f));
+}
+
+/// depth is clamped to the quantization range
+TEST_F(World_RenderQueueTests, QuantizeDepthClamps)
+{
+    const unsigned int maxValue = (1u << RenderQueue::DEPTH_BITS) - 1;
+    EXPECT_EQ(0u, RenderQueue::quantizeDepth(-5.0f, 100.0f));
+    EXPECT_EQ(0u, RenderQueue::quantizeDepth(5.0f, 0.0f));
+    EXPECT_EQ(maxValue, RenderQueue::quantizeDepth(150.0f, 100.0f));
+    EXPECT_LT(RenderQueue::quantizeDepth(25.0f, 100.0f),
+        RenderQueue::quantizeDepth(75.0f, 100.0f));
+}
+
+/// radix sort matches a stable comparison sort
+TEST_F(World_RenderQueueTests, RadixSortMatchesStableSort)
+{
+    std::vector<RenderQueue::Item> items, scratch;
+    srand(1234);
+    for (unsigned int i = 0; i < 5000; i++)
+    {
+        RenderQueue::Item item;
+        // limit key range to force duplicates and skipped digits
+        item.key = ((uint64_t)(rand() % 64) << 40) | (uint64_t)(rand() % 512);
+        item.index = i;
+        items.push_back(item);
+    }
+
+    std::vector<RenderQueue::Item> expected = items;
+    std::stable_sort(expected.begin(), expected.end(),
+        [](const RenderQueue::Item& a, const RenderQueue::Item& b) { return a.key < b.key; });
+
+    radixSort(items, scratch, [](const RenderQueue::Item& item) { return item.key; });
+
+    ASSERT_EQ(expected.size(), items.size());
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        EXPECT_EQ(expected[i].key, items[i].key);
+        EXPECT_EQ(expected[i].index, items[i].index);
+    }
+}
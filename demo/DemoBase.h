@@ -35,6 +35,7 @@ private:
 
 protected:
 	World* world;
+	ResourceManager* resourceManager;
 	GraphicsSystem graphics;
 	PhysicsSystem physics;
 	EventSystem events;
@@ -42,7 +43,7 @@ protected:
 
 public:
 
-	inline DemoBase(ResourceManager manager)
+	inline DemoBase(ResourceManager& manager) : resourceManager(&manager)
 	{
 		graphics.init();
 		graphics.setDisplaySize( 1280, 1024 );
@@ -93,6 +94,9 @@ public:
 			if (stop)
 				break;
 	        
+			// finish resources loaded in the background, a little each frame
+			resourceManager->processUploads();
+
 			this->tick();
 	    
 			world->stepPhysics();
@@ -0,0 +1,120 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Times normal and tangent generation on the 3ds models in the resources
+ * directory. Run it on two builds to compare a change before and after.
+ * Meshes are loaded without uploading them, so no graphics context or
+ * display is needed.
+ *
+ * usage: MeshBench [iterations]
+ */
+
+#define NOMINMAX
+
+// 3DMagic includes
+#include <3DMagic.h>
+#include <Resources/models/ModelLoader3DS.h>
+using namespace Magic3D;
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+using std::cout;
+using std::endl;
+
+static const char* models[] = {
+    "models/sphere.3ds",
+    "models/chainLink.3ds"
+};
+
+static const char* resourceDirs[] = {
+    "../../../../resources/",
+    "../../../../../resources/",
+    "resources/"
+};
+
+/// find a model in the resource directories, empty if it is in none
+static std::string findModel(const char* path)
+{
+    for (const char* dir : resourceDirs)
+    {
+        std::string fullPath = std::string(dir) + path;
+        if (std::ifstream(fullPath.c_str()).good())
+            return fullPath;
+    }
+    return std::string();
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 100;
+
+    // meshes are only processed on the cpu, so they are loaded as they are
+    // in the file and never uploaded
+    ModelLoader3DS loader;
+    MeshLoadOptions options;
+    options.weld = false;
+    options.optimize = false;
+    options.cache = false;
+
+    ThreadPool serial(1);
+    ThreadPool& parallel = ThreadPool::getSingleton();
+
+    cout << "calculateNormalsAndTangents, " << iterations << " iterations, "
+         << parallel.getThreadCount() << " threads" << endl;
+    for (const char* path : models)
+    {
+        std::string fullPath = findModel(path);
+        if (fullPath.empty())
+        {
+            cout << "could not find " << path << endl;
+            return 1;
+        }
+        std::shared_ptr<Model> model = loader.getModelFile(fullPath, options);
+
+        unsigned int vertexCount = 0, faceCount = 0;
+        double serialMs = 0, parallelMs = 0;
+        for (auto& geometry : model->getMeshes())
+        {
+            TriangleMesh mesh(geometry->getTriangleMesh());
+            vertexCount += mesh.getVertexCount();
+            faceCount += mesh.getFaceCount();
+
+            for (ThreadPool* pool : { &serial, &parallel })
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < iterations; i++)
+                    mesh.calculateNormalsAndTangents(*pool);
+                auto end = std::chrono::high_resolution_clock::now();
+
+                (pool == &serial ? serialMs : parallelMs) +=
+                    std::chrono::duration<double, std::milli>(end - start).count();
+            }
+        }
+
+        cout << std::setw(24) << std::left << path
+             << vertexCount << " vertices, " << faceCount << " faces: "
+             << std::fixed << std::setprecision(3) << (serialMs / iterations)
+             << " ms serial, " << (parallelMs / iterations) << " ms parallel" << endl;
+    }
+
+    return 0;
+}
@@ -731,6 +731,7 @@ public:
 
         auto sphere = std::make_shared<Sphere>(2 * FOOT);
         sphereModel = std::make_shared<Model>(sphere, floorMaterial, sphere);
+        sphereModel->generateLods();
 
 		// set eye level
 		camera.setLocation(Vector3(0.0f, 6 * FOOT, ROOM_SIZE));
@@ -2,119 +2,107 @@
 
 precision highp float;
 
-uniform struct Transforms
-{
-    mat4   mvMatrix;        // transforms from model space to view space
-    mat4   vMatrix;         // transforms from world space to view space
-    mat4   mMatrix;         // transforms from model space to world space
-	mat4   mvpMatrix;   // transforms from model space to clip space
-} transforms;
+// constants of the frame are declared by the resource manager as "frame",
+// see FrameUniforms
 
 uniform sampler2D textureMap;
+#ifdef NORMAL_MAPPING
 uniform sampler2D normalMap;
-uniform float normalMapping = 0.0;
+#endif
 uniform struct Material 
 {
     vec3 specularColor;
     float specularPower;
 } material;
 
-uniform struct Light
-{
-    vec4    position;
-    float   attenuationFactor;
-    float   intensity;
-    vec3    color;
-    float   ambientFactor;
-    vec3    direction;
-    float   angle;
-    mat4    shadowMatrix;    // transforms from model space to light view space
-} light;
+#ifdef SHADOW_MAPPING
 uniform sampler2DShadow shadowMap; // depth buffer from light's viewpoint
-uniform float shadowMapping = 0.0;
+#endif
 
 uniform vec3 gammaCorrectionFactor = vec3(1.0/2.2);
 
 // input from previous stage
 in VS_OUT
 {
-    vec4 position;      // position of fragment in model space
-    vec3 normal;        // normal vector in model space
-    vec3 tangent;       // tangent vector in model space
+    vec3 worldPosition; // position of fragment in world space
+    vec3 viewPosition;  // position of fragment in view space
+    vec3 normal;        // normal vector in view space
+    vec3 tangent;       // tangent vector in view space
+    vec4 shadowCoord;   // position of fragment in light view space
     vec2 texCoord;      // texture coordinate
 } fragment;
 
 float calculateLightAttenFactor()
 {
     // location-less (directional) lighting has no attenuation
-    if (light.position.w == 0.0)
+    if (frame.light.position.w == 0.0)
         return 1.0;
 
     // check for outside of cone
     float atten = 1.0;
-    if (light.angle > 0.0)
+    if (frame.light.angle > 0.0)
     {
-        vec3 L = normalize(
-            light.position.xyz - 
-            (transforms.mMatrix * fragment.position).xyz
-        );    
+        vec3 L = normalize(frame.light.position.xyz - fragment.worldPosition);
     
-        float lightToSurfaceAngle = degrees(acos(dot(-L, normalize(light.direction))));
-        atten = max(0.0, 1.0 - (lightToSurfaceAngle / light.angle));
+        float lightToSurfaceAngle = degrees(acos(dot(-L, normalize(frame.light.direction))));
+        atten = max(0.0, 1.0 - (lightToSurfaceAngle / frame.light.angle));
     }
 
-    vec3 worldPos = (transforms.mMatrix * fragment.position).xyz;
-    float distance = distance(light.position.xyz, worldPos.xyz);
-    atten *= 1.0 / (1.0 + light.attenuationFactor * pow(distance,2));
+    float distance = distance(frame.light.position.xyz, fragment.worldPosition);
+    atten *= 1.0 / (1.0 + frame.light.attenuationFactor * pow(distance,2));
     return atten;
 }
 
 void main(void)
 {
-    vec3 N = normalize(mat3(transforms.mvMatrix) * fragment.normal);
+    vec3 N = normalize(fragment.normal);
     vec3 L = normalize(
-        (transforms.vMatrix * vec4(light.position.xyz, 1.0)).xyz - 
-        (transforms.mvMatrix * fragment.position).xyz
+        (frame.vMatrix * vec4(frame.light.position.xyz, 1.0)).xyz - 
+        fragment.viewPosition
     );
-    vec3 V = normalize(-(transforms.mvMatrix * fragment.position).xyz); 
+    vec3 V = normalize(-fragment.viewPosition); 
     
     // location-less (directional) lighting
-    if (light.position.w == 0.0)
+    if (frame.light.position.w == 0.0)
     {
-        L = normalize( (mat3(transforms.vMatrix) * light.direction).xyz );
+        L = normalize( (mat3(frame.vMatrix) * frame.light.direction).xyz );
     }
     
     // recalculate vectors for normal mapping (if enabled)
-    if (normalMapping != 0.0)
+#ifdef NORMAL_MAPPING
     {
-        vec3 T = normalize(mat3(transforms.mvMatrix) * fragment.tangent);
+        vec3 T = normalize(fragment.tangent);
         vec3 B = cross(N, T);
     
         L = normalize(vec3(dot(L,T), dot(L,B), dot(L,N)));
         V = normalize(vec3(dot(V,T), dot(V,B), dot(V,N)));
         
-        // calculate real normal from normal map
-        N = normalize(texture2D(normalMap, fragment.texCoord).rgb * 2.0 - vec3(1.0));
+        // calculate real normal from normal map, z is rebuilt from x and y
+        // as two channel compressed normal maps only keep those
+        vec2 normalXY = texture2D(normalMap, fragment.texCoord).rg * 2.0 - vec2(1.0);
+        N = normalize(vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0))));
     }
+#endif
     
     float shadowFactor = 1.0f;
-    if (shadowMapping != 0.0)
-    {
-        shadowFactor = textureProj(shadowMap, light.shadowMatrix * fragment.position);
-    }
+#ifdef SHADOW_MAPPING
+    shadowFactor = textureProj(shadowMap, fragment.shadowCoord);
+#endif
     
-    float lightFactor = calculateLightAttenFactor() * light.intensity;
-    
-    vec3 H = normalize(L + V);
+    float lightFactor = calculateLightAttenFactor() * frame.light.intensity;
     
     vec4 diffuseColor = texture2D(textureMap, fragment.texCoord);
     
-    vec3 ambient = diffuseColor.rgb * light.color.rgb * light.ambientFactor * lightFactor;
-    vec3 diffuse = max(dot(N,L), 0.0) * diffuseColor.rgb * light.color.rgb * lightFactor * 
+    vec3 ambient = diffuseColor.rgb * frame.light.color.rgb * frame.light.ambientFactor * lightFactor;
+    vec3 diffuse = max(dot(N,L), 0.0) * diffuseColor.rgb * frame.light.color.rgb * lightFactor * 
         shadowFactor;
-    vec3 specular = pow(max(dot(N,H), 0.0), material.specularPower) * material.specularColor * 
-        light.color.rgb * lightFactor * shadowFactor; 
+    vec3 color = ambient + diffuse;
+    
+#ifdef SPECULAR_HIGHLIGHT
+    vec3 H = normalize(L + V);
+    color += pow(max(dot(N,H), 0.0), material.specularPower) * material.specularColor * 
+        frame.light.color.rgb * lightFactor * shadowFactor; 
+#endif
     
-    vec3 color = ambient + diffuse + specular;
     gl_FragColor = vec4(pow(color,gammaCorrectionFactor), diffuseColor.a);
 }
\ No newline at end of file
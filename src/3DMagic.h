@@ -31,6 +31,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include "Util/Units.h"
 #include "Util/Character.h"
 #include "Util/StaticFont.h"
+#include "Util/ThreadPool.h"
 
 // math
 #include "Math/Math.h"
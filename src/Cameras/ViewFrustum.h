@@ -37,6 +37,16 @@ public:
     {
         return (d + normal.dotProduct(p));
     }
+
+    inline const Vector3& getNormal() const
+    {
+        return normal;
+    }
+
+    inline float getD() const
+    {
+        return d;
+    }
 };
 
 class Rectangle
@@ -142,6 +152,19 @@ public:
         pl[FARP].update(farRec.topRight, farRec.topLeft, farRec.bottomLeft);
     }
 
+    /// get the planes as a, b, c and d of ax + by + cz + d = 0, with
+    /// normals pointing inside, see ObjectTable::cull
+    void getPlanes(Scalar planes[6][4]) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            planes[i][0] = pl[i].getNormal().x();
+            planes[i][1] = pl[i].getNormal().y();
+            planes[i][2] = pl[i].getNormal().z();
+            planes[i][3] = pl[i].getD();
+        }
+    }
+
     bool sphereInFrustum(Vector3 &p, float raio) 
     {
         float distance;
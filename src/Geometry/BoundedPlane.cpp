@@ -92,6 +92,9 @@ const TriangleMesh& BoundedPlane::getTriangleMesh() const
     mesh->positionTransform(this->transform);
     mesh->calculateNormalsAndTangents();
 
+    // quads were written with unshared vertices
+    mesh->weld();
+
     return *mesh;
 }
 
@@ -158,6 +158,9 @@ const TriangleMesh& Box::getTriangleMesh() const
     triangleMesh->positionTransform(this->transform);
     triangleMesh->calculateNormalsAndTangents();
 
+    // share the vertices within each side, sides keep their own normals
+    triangleMesh->weld();
+
     return *triangleMesh;
 }
 
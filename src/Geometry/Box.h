@@ -28,11 +28,16 @@ public:
     inline Box(Scalar width, Scalar height, Scalar depth) :
         dimensions(width, height, depth) {}
 
-    inline const Vector3& getDimensions()
+    inline const Vector3& getDimensions() const
     {
         return this->dimensions;
     }
 
+    inline const Vector3& getTranslation() const
+    {
+        return this->transform.translation;
+    }
+
     virtual void positionTransform(const Geometry::Transform& transform)
     {
         // copy over rotatation and translation to use later when 
@@ -0,0 +1,635 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Graphics\BlockCompression.h>
+#include <Util\simd.h>
+
+#include <cmath>
+#include <cstdint>
+
+namespace Magic3D
+{
+
+static inline int clampByte(float value)
+{
+    return value < 0.0f ? 0 : value > 255.0f ? 255 : (int)(value + 0.5f);
+}
+
+static inline int to565(int r, int g, int b)
+{
+    return (((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255);
+}
+
+static inline void from565(int color, int* rgb)
+{
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+/// get the four colors of a BC1 block in four color mode
+static inline void getPalette(int color0, int color1, int palette[4][3])
+{
+    from565(color0, palette[0]);
+    from565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+}
+
+/// get the eight values of a BC4 block in eight value mode
+static inline void getValuePalette(int high, int low, int palette[8])
+{
+    palette[0] = high;
+    palette[1] = low;
+    for (int p = 2; p < 8; p++)
+        palette[p] = ((8 - p) * high + (p - 1) * low + 3) / 7;
+}
+
+/// pick the closest color of the palette for each pixel, returns the squared error
+static int selectColorsScalar(const unsigned char* rgba, const int palette[4][3],
+    uint32_t& indices)
+{
+    indices = 0;
+    int error = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        const unsigned char* pixel = rgba + i * 4;
+        int best = 0;
+        int bestDistance = 0x7FFFFFFF;
+        for (int p = 0; p < 4; p++)
+        {
+            int dr = pixel[0] - palette[p][0];
+            int dg = pixel[1] - palette[p][1];
+            int db = pixel[2] - palette[p][2];
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= (uint32_t)best << (i * 2);
+        error += bestDistance;
+    }
+    return error;
+}
+
+/// get the covariance of the color channels of the pixels, as
+/// [rr, rg, rb, gg, gb, bb]
+static void getCovarianceScalar(const unsigned char* rgba, float covariance[6])
+{
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            mean[c] += rgba[i * 4 + c];
+    }
+    for (int c = 0; c < 3; c++)
+        mean[c] /= 16.0f;
+
+    for (int c = 0; c < 6; c++)
+        covariance[c] = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float r = rgba[i * 4] - mean[0];
+        float g = rgba[i * 4 + 1] - mean[1];
+        float b = rgba[i * 4 + 2] - mean[2];
+        covariance[0] += r * r;
+        covariance[1] += r * g;
+        covariance[2] += r * b;
+        covariance[3] += g * g;
+        covariance[4] += g * b;
+        covariance[5] += b * b;
+    }
+}
+
+/// project the color of each pixel on an axis
+static void projectScalar(const unsigned char* rgba, const float axis[3], float projections[16])
+{
+    for (int i = 0; i < 16; i++)
+        projections[i] = rgba[i * 4] * axis[0] + rgba[i * 4 + 1] * axis[1] + rgba[i * 4 + 2] * axis[2];
+}
+
+/// get the range of 16 values and, if not all equal, pick the closest
+/// value of the palette between them for each
+static void selectValuesScalar(const unsigned char* values, int& low, int& high,
+    uint64_t& indices)
+{
+    low = 255;
+    high = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        low = values[i] < low ? values[i] : low;
+        high = values[i] > high ? values[i] : high;
+    }
+
+    indices = 0;
+    if (high <= low)
+        return;
+
+    int palette[8];
+    getValuePalette(high, low, palette);
+    for (int i = 0; i < 16; i++)
+    {
+        int value = values[i];
+        int best = 0;
+        int bestDistance = 256;
+        for (int p = 0; p < 8; p++)
+        {
+            int distance = value > palette[p] ? value - palette[p] : palette[p] - value;
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= (uint64_t)best << (i * 3);
+    }
+}
+
+#ifdef MAGIC3D_SSE2
+
+/* The simd code does the same operations as the scalar code, in the same
+ * order for each sum, so the blocks are the same bit for bit. Pixels are
+ * handled four at a time, one per 32-bit lane, and values sixteen at a
+ * time, one per byte.
+ */
+
+/// get the channels of 4 rgba pixels as floats, one pixel per lane
+static inline void loadChannels(const unsigned char* rgba, __m128& r, __m128& g, __m128& b)
+{
+    __m128i pixels = _mm_loadu_si128((const __m128i*)rgba);
+    __m128i mask = _mm_set1_epi32(0xFF);
+    r = _mm_cvtepi32_ps(_mm_and_si128(pixels, mask));
+    g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), mask));
+    b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), mask));
+}
+
+/// get one rgba pixel as floats, one channel per lane
+static inline __m128 loadPixel(const unsigned char* rgba)
+{
+    uint32_t bytes = rgba[0] | (rgba[1] << 8) | (rgba[2] << 16) | ((uint32_t)rgba[3] << 24);
+    __m128i pixel = _mm_cvtsi32_si128((int)bytes);
+    __m128i zero = _mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(pixel, zero), zero));
+}
+
+static int selectColorsSse(const unsigned char* rgba, const int palette[4][3],
+    uint32_t& indices)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i colorMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    __m128i colors[4];
+    for (int p = 0; p < 4; p++)
+    {
+        colors[p] = _mm_set_epi16(0, (short)palette[p][2], (short)palette[p][1], (short)palette[p][0],
+            0, (short)palette[p][2], (short)palette[p][1], (short)palette[p][0]);
+    }
+
+    indices = 0;
+    int error = 0;
+    for (int group = 0; group < 4; group++)
+    {
+        // two pixels per register as 16-bit channels, alpha cleared
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(rgba + group * 16));
+        __m128i low = _mm_and_si128(_mm_unpacklo_epi8(pixels, zero), colorMask);
+        __m128i high = _mm_and_si128(_mm_unpackhi_epi8(pixels, zero), colorMask);
+
+        __m128i bestDistance = zero, best = zero;
+        for (int p = 0; p < 4; p++)
+        {
+            // dr*dr + dg*dg and db*db of each pixel, added pairwise
+            __m128i dl = _mm_sub_epi16(low, colors[p]);
+            __m128i dh = _mm_sub_epi16(high, colors[p]);
+            __m128 sl = _mm_castsi128_ps(_mm_madd_epi16(dl, dl));
+            __m128 sh = _mm_castsi128_ps(_mm_madd_epi16(dh, dh));
+            __m128i distance = _mm_add_epi32(
+                _mm_castps_si128(_mm_shuffle_ps(sl, sh, _MM_SHUFFLE(2, 0, 2, 0))),
+                _mm_castps_si128(_mm_shuffle_ps(sl, sh, _MM_SHUFFLE(3, 1, 3, 1))));
+
+            if (p == 0)
+            {
+                bestDistance = distance;
+                continue;
+            }
+            __m128i closer = _mm_cmplt_epi32(distance, bestDistance);
+            bestDistance = _mm_or_si128(_mm_and_si128(closer, distance),
+                _mm_andnot_si128(closer, bestDistance));
+            best = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)),
+                _mm_andnot_si128(closer, best));
+        }
+
+        int32_t distances[4], bests[4];
+        _mm_storeu_si128((__m128i*)distances, bestDistance);
+        _mm_storeu_si128((__m128i*)bests, best);
+        for (int i = 0; i < 4; i++)
+        {
+            indices |= (uint32_t)bests[i] << ((group * 4 + i) * 2);
+            error += distances[i];
+        }
+    }
+    return error;
+}
+
+static void getCovarianceSse(const unsigned char* rgba, float covariance[6])
+{
+    __m128 mean = _mm_setzero_ps();
+    for (int i = 0; i < 16; i++)
+        mean = _mm_add_ps(mean, loadPixel(rgba + i * 4));
+    mean = _mm_div_ps(mean, _mm_set1_ps(16.0f));
+
+    // [rr, rg, rb, gg] and [gb, bb, -, -]
+    __m128 first = _mm_setzero_ps(), second = _mm_setzero_ps();
+    for (int i = 0; i < 16; i++)
+    {
+        __m128 d = _mm_sub_ps(loadPixel(rgba + i * 4), mean);
+        first = _mm_add_ps(first, _mm_mul_ps(_mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 0, 0)),
+            _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 2, 1, 0))));
+        second = _mm_add_ps(second, _mm_mul_ps(_mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 2, 2, 1)),
+            _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 2, 2, 2))));
+    }
+
+    float sums[8];
+    _mm_storeu_ps(sums, first);
+    _mm_storeu_ps(sums + 4, second);
+    for (int c = 0; c < 6; c++)
+        covariance[c] = sums[c];
+}
+
+static void projectSse(const unsigned char* rgba, const float axis[3], float projections[16])
+{
+    __m128 x = _mm_set1_ps(axis[0]), y = _mm_set1_ps(axis[1]), z = _mm_set1_ps(axis[2]);
+    for (int group = 0; group < 4; group++)
+    {
+        __m128 r, g, b;
+        loadChannels(rgba + group * 16, r, g, b);
+        _mm_storeu_ps(projections + group * 4, _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(r, x), _mm_mul_ps(g, y)), _mm_mul_ps(b, z)));
+    }
+}
+
+/// get the smallest or largest of 16 bytes in every byte
+static inline __m128i minBytes(__m128i v)
+{
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 4));
+    v = _mm_min_epu8(v, _mm_srli_si128(v, 2));
+    return _mm_min_epu8(v, _mm_srli_si128(v, 1));
+}
+static inline __m128i maxBytes(__m128i v)
+{
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+    v = _mm_max_epu8(v, _mm_srli_si128(v, 2));
+    return _mm_max_epu8(v, _mm_srli_si128(v, 1));
+}
+
+static void selectValuesSse(const unsigned char* values, int& low, int& high,
+    uint64_t& indices)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*)values);
+    low = _mm_cvtsi128_si32(minBytes(v)) & 0xFF;
+    high = _mm_cvtsi128_si32(maxBytes(v)) & 0xFF;
+
+    indices = 0;
+    if (high <= low)
+        return;
+
+    int palette[8];
+    getValuePalette(high, low, palette);
+    __m128i bestDistance = _mm_setzero_si128(), best = _mm_setzero_si128();
+    for (int p = 0; p < 8; p++)
+    {
+        __m128i value = _mm_set1_epi8((char)palette[p]);
+        __m128i distance = _mm_or_si128(_mm_subs_epu8(v, value), _mm_subs_epu8(value, v));
+        if (p == 0)
+        {
+            bestDistance = distance;
+            continue;
+        }
+
+        // unsigned bytes only compare equal, closer is smaller and not equal
+        __m128i closer = _mm_andnot_si128(_mm_cmpeq_epi8(distance, bestDistance),
+            _mm_cmpeq_epi8(_mm_min_epu8(distance, bestDistance), distance));
+        bestDistance = _mm_min_epu8(distance, bestDistance);
+        best = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi8((char)p)),
+            _mm_andnot_si128(closer, best));
+    }
+
+    unsigned char bests[16];
+    _mm_storeu_si128((__m128i*)bests, best);
+    for (int i = 0; i < 16; i++)
+        indices |= (uint64_t)bests[i] << (i * 3);
+}
+
+#endif
+
+static inline int selectColors(const unsigned char* rgba, const int palette[4][3],
+    uint32_t& indices, bool useSimd)
+{
+#ifdef MAGIC3D_SSE2
+    if (useSimd)
+        return selectColorsSse(rgba, palette, indices);
+#endif
+    return selectColorsScalar(rgba, palette, indices);
+}
+
+static inline void getCovariance(const unsigned char* rgba, float covariance[6], bool useSimd)
+{
+#ifdef MAGIC3D_SSE2
+    if (useSimd)
+        return getCovarianceSse(rgba, covariance);
+#endif
+    getCovarianceScalar(rgba, covariance);
+}
+
+static inline void project(const unsigned char* rgba, const float axis[3], float projections[16],
+    bool useSimd)
+{
+#ifdef MAGIC3D_SSE2
+    if (useSimd)
+        return projectSse(rgba, axis, projections);
+#endif
+    projectScalar(rgba, axis, projections);
+}
+
+static inline void selectValues(const unsigned char* values, int& low, int& high,
+    uint64_t& indices, bool useSimd)
+{
+#ifdef MAGIC3D_SSE2
+    if (useSimd)
+        return selectValuesSse(values, low, high, indices);
+#endif
+    selectValuesScalar(values, low, high, indices);
+}
+
+/** Find the endpoints that best fit the pixels for the indices chosen,
+ * by least squares
+ * @return false if the indices do not allow a fit, like all the same
+ */
+static bool fitEndpoints(const unsigned char* rgba, uint32_t indices, int& color0, int& color1)
+{
+    // share of the first endpoint in the color of each index
+    static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+    float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+    float ax[3] = { 0.0f, 0.0f, 0.0f };
+    float bx[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 16; i++)
+    {
+        float a = weights[(indices >> (i * 2)) & 3];
+        float b = 1.0f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int c = 0; c < 3; c++)
+        {
+            ax[c] += a * rgba[i * 4 + c];
+            bx[c] += b * rgba[i * 4 + c];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+        return false;
+
+    int first[3], second[3];
+    for (int c = 0; c < 3; c++)
+    {
+        first[c] = clampByte((ax[c] * bb - bx[c] * ab) / determinant);
+        second[c] = clampByte((bx[c] * aa - ax[c] * ab) / determinant);
+    }
+    color0 = to565(first[0], first[1], first[2]);
+    color1 = to565(second[0], second[1], second[2]);
+    return true;
+}
+
+/// write a BC1 block, in four color mode
+static inline void writeColorBlock(int color0, int color1, uint32_t indices, unsigned char* block)
+{
+    // four color mode needs the first endpoint to be the larger, equal
+    // endpoints mean three color mode, where only the first index is safe
+    if (color0 < color1)
+    {
+        int swap = color0;
+        color0 = color1;
+        color1 = swap;
+        indices ^= 0x55555555;
+    }
+    else if (color0 == color1)
+        indices = 0;
+
+    block[0] = (unsigned char)(color0 & 0xFF);
+    block[1] = (unsigned char)(color0 >> 8);
+    block[2] = (unsigned char)(color1 & 0xFF);
+    block[3] = (unsigned char)(color1 >> 8);
+    for (int i = 0; i < 4; i++)
+        block[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+bool BlockCompression::hasSimd()
+{
+#ifdef MAGIC3D_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+void BlockCompression::encodeBC1(const unsigned char* rgba, unsigned char* block, bool useSimd)
+{
+    // the colors spread along the principal axis of the block the most,
+    // found by power iteration on their covariance
+    float covariance[6];
+    getCovariance(rgba, covariance, useSimd);
+
+    // start from the row of the channel that varies the most, which is
+    // not orthogonal to the axis
+    float axis[3] = { covariance[0], covariance[1], covariance[2] };
+    if (covariance[3] > covariance[0] && covariance[3] >= covariance[5])
+    {
+        axis[0] = covariance[1];
+        axis[1] = covariance[3];
+        axis[2] = covariance[4];
+    }
+    else if (covariance[5] > covariance[0] && covariance[5] > covariance[3])
+    {
+        axis[0] = covariance[2];
+        axis[1] = covariance[4];
+        axis[2] = covariance[5];
+    }
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float x = axis[0] * covariance[0] + axis[1] * covariance[1] + axis[2] * covariance[2];
+        float y = axis[0] * covariance[1] + axis[1] * covariance[3] + axis[2] * covariance[4];
+        float z = axis[0] * covariance[2] + axis[1] * covariance[4] + axis[2] * covariance[5];
+        float length = std::fabs(x) > std::fabs(y) ? std::fabs(x) : std::fabs(y);
+        length = std::fabs(z) > length ? std::fabs(z) : length;
+        if (length < 1e-6f)
+            break;
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    // endpoints start at the pixels furthest along the axis
+    float projections[16];
+    project(rgba, axis, projections, useSimd);
+    int minPixel = 0, maxPixel = 0;
+    float minProjection = 1e30f, maxProjection = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float projection = projections[i];
+        if (projection < minProjection)
+        {
+            minProjection = projection;
+            minPixel = i;
+        }
+        if (projection > maxProjection)
+        {
+            maxProjection = projection;
+            maxPixel = i;
+        }
+    }
+
+    const unsigned char* maxColor = rgba + maxPixel * 4;
+    const unsigned char* minColor = rgba + minPixel * 4;
+    int color0 = to565(maxColor[0], maxColor[1], maxColor[2]);
+    int color1 = to565(minColor[0], minColor[1], minColor[2]);
+
+    int palette[4][3];
+    getPalette(color0, color1, palette);
+    uint32_t indices;
+    int error = selectColors(rgba, palette, indices, useSimd);
+
+    // refine the endpoints to the indices chosen, while that helps
+    for (int iteration = 0; iteration < 4 && error > 0; iteration++)
+    {
+        int fit0, fit1;
+        if (!fitEndpoints(rgba, indices, fit0, fit1))
+            break;
+        getPalette(fit0, fit1, palette);
+        uint32_t fitIndices;
+        int fitError = selectColors(rgba, palette, fitIndices, useSimd);
+        if (fitError >= error)
+            break;
+        color0 = fit0;
+        color1 = fit1;
+        indices = fitIndices;
+        error = fitError;
+    }
+
+    writeColorBlock(color0, color1, indices, block);
+}
+
+void BlockCompression::encodeBC3(const unsigned char* rgba, unsigned char* block, bool useSimd)
+{
+    encodeBC4(rgba + 3, 4, block, useSimd);
+    encodeBC1(rgba, block + 8, useSimd);
+}
+
+void BlockCompression::encodeBC4(const unsigned char* values, int stride, unsigned char* block,
+    bool useSimd)
+{
+    unsigned char packed[16];
+    for (int i = 0; i < 16; i++)
+        packed[i] = values[i * stride];
+
+    int low, high;
+    uint64_t indices;
+    selectValues(packed, low, high, indices, useSimd);
+
+    // eight value mode, the first endpoint the larger
+    block[0] = (unsigned char)high;
+    block[1] = (unsigned char)low;
+    for (int i = 0; i < 6; i++)
+        block[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+void BlockCompression::encodeBC5(const unsigned char* rgba, unsigned char* block, bool useSimd)
+{
+    encodeBC4(rgba, 4, block, useSimd);
+    encodeBC4(rgba + 1, 4, block + 8, useSimd);
+}
+
+void BlockCompression::decodeBC1(const unsigned char* block, unsigned char* rgba)
+{
+    int color0 = block[0] | (block[1] << 8);
+    int color1 = block[2] | (block[3] << 8);
+
+    int palette[4][4];
+    from565(color0, palette[0]);
+    from565(color1, palette[1]);
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+    for (int c = 0; c < 3; c++)
+    {
+        if (color0 > color1)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+    if (color0 <= color1)
+        palette[3][3] = 0;
+
+    for (int i = 0; i < 16; i++)
+    {
+        int index = (block[4 + i / 4] >> ((i % 4) * 2)) & 3;
+        for (int c = 0; c < 4; c++)
+            rgba[i * 4 + c] = (unsigned char)palette[index][c];
+    }
+}
+
+void BlockCompression::decodeBC4(const unsigned char* block, unsigned char* values, int stride)
+{
+    int palette[8];
+    palette[0] = block[0];
+    palette[1] = block[1];
+    if (palette[0] > palette[1])
+    {
+        for (int p = 2; p < 8; p++)
+            palette[p] = ((8 - p) * palette[0] + (p - 1) * palette[1] + 3) / 7;
+    }
+    else
+    {
+        for (int p = 2; p < 6; p++)
+            palette[p] = ((6 - p) * palette[0] + (p - 1) * palette[1] + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++)
+        indices |= (uint64_t)block[2 + i] << (i * 8);
+    for (int i = 0; i < 16; i++)
+        values[i * stride] = (unsigned char)palette[(indices >> (i * 3)) & 7];
+}
+
+};
@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for BlockCompression class
+ *
+ * @file BlockCompression.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_BLOCK_COMPRESSION_H
+#define MAGIC3D_BLOCK_COMPRESSION_H
+
+namespace Magic3D
+{
+
+/** Encoding and decoding of single 4x4 blocks of the BC texture formats
+ * graphics hardware samples directly:
+ *  - BC1: rgb, 8 bytes, two 565 endpoints and 2-bit indices
+ *  - BC3: rgba, 16 bytes, a BC4 block of alpha followed by a BC1 block
+ *  - BC4: one channel, 8 bytes, two 8-bit endpoints and 3-bit indices
+ *  - BC5: two channels, 16 bytes, a BC4 block for each
+ *
+ * Pixels are row by row, four per row. Colors are encoded as they are,
+ * which is right for both linear and sRGB data as the format only changes
+ * how the hardware reads them.
+ *
+ * The encoders use simd instructions when available, unless useSimd is
+ * false. Both ways give the same blocks.
+ */
+class BlockCompression
+{
+public:
+    /// whether the encoders can use simd instructions in this build
+    static bool hasSimd();
+
+    /// encode 16 rgba pixels to a BC1 block, alpha is ignored
+    static void encodeBC1(const unsigned char* rgba, unsigned char* block, bool useSimd = true);
+
+    /// encode 16 rgba pixels to a BC3 block
+    static void encodeBC3(const unsigned char* rgba, unsigned char* block, bool useSimd = true);
+
+    /** encode one channel of 16 pixels to a BC4 block
+     * @param values    first value of the channel
+     * @param stride    bytes from one pixel to the next
+     * @param block     the block to write
+     * @param useSimd   whether to use simd instructions when available
+     */
+    static void encodeBC4(const unsigned char* values, int stride, unsigned char* block,
+        bool useSimd = true);
+
+    /// encode the first two channels of 16 rgba pixels to a BC5 block
+    static void encodeBC5(const unsigned char* rgba, unsigned char* block, bool useSimd = true);
+
+    /// decode a BC1 block to 16 rgba pixels
+    static void decodeBC1(const unsigned char* block, unsigned char* rgba);
+
+    /// decode a BC4 block to one channel of 16 pixels, see encodeBC4
+    static void decodeBC4(const unsigned char* block, unsigned char* values, int stride);
+};
+
+};
+
+#endif
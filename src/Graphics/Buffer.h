@@ -222,6 +222,17 @@ public:
 		Buffer::bindBuffer(point, bufferId);
 	}
 	
+	/** bind the buffer to an indexed binding point, for uniform blocks
+	 * and transform feedback, which also binds it to the point itself
+	 * @param point the binding point to bind to
+	 * @param index the index of the binding point
+	 */
+	inline void bindBase(BindingPoints point, GLuint index) const
+	{
+		Buffer::bindBuffer(point, bufferId);
+		glBindBufferBase(point, index, bufferId);
+	}
+	
 	/// unbind this buffer
 	inline void unBind() const
 	{
@@ -233,6 +244,12 @@ public:
 	{
 		return Buffer::getBindPoint(bufferId);
 	}
+
+	/// get buffer id
+	inline GLuint getID() const
+	{
+		return this->bufferId;
+	}
 	
 	/** (re)allocate the buffer data
 	 * @param size the size to allocate
@@ -0,0 +1,401 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for CompressedImage class
+ *
+ * @file CompressedImage.cpp
+ * @author Andrew Keating
+ */
+#include <Graphics\CompressedImage.h>
+#include <Graphics\BlockCompression.h>
+#include <Exceptions\MagicException.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+namespace Magic3D
+{
+
+static const uint32_t DDS_MAGIC = 0x20534444;  // "DDS "
+
+static inline uint32_t fourCC(char a, char b, char c, char d)
+{
+    return (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24);
+}
+
+struct DdsPixelFormat
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t rgbBitCount;
+    uint32_t masks[4];
+};
+
+struct DdsHeader
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t height;
+    uint32_t width;
+    uint32_t pitchOrLinearSize;
+    uint32_t depth;
+    uint32_t mipMapCount;
+    uint32_t reserved1[11];
+    DdsPixelFormat pixelFormat;
+    uint32_t caps;
+    uint32_t caps2;
+    uint32_t caps3;
+    uint32_t caps4;
+    uint32_t reserved2;
+};
+
+struct DdsHeaderDx10
+{
+    uint32_t dxgiFormat;
+    uint32_t resourceDimension;
+    uint32_t miscFlag;
+    uint32_t arraySize;
+    uint32_t miscFlags2;
+};
+
+static const uint32_t DDSD_CAPS = 0x1;
+static const uint32_t DDSD_HEIGHT = 0x2;
+static const uint32_t DDSD_WIDTH = 0x4;
+static const uint32_t DDSD_PIXELFORMAT = 0x1000;
+static const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+static const uint32_t DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDSCAPS_COMPLEX = 0x8;
+static const uint32_t DDSCAPS_TEXTURE = 0x1000;
+static const uint32_t DDSCAPS_MIPMAP = 0x400000;
+static const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+static const uint32_t DDSCAPS2_VOLUME = 0x200000;
+static const uint32_t DX10_TEXTURE2D = 3;
+
+/// marks the source hash in the first reserved words of the header
+static const uint32_t SOURCE_HASH_TAG = 0x4844334D;  // "M3DH"
+
+/// DXGI_FORMAT values of the formats, unorm and srgb
+static const uint32_t DXGI_BC1[2] = { 71, 72 };
+static const uint32_t DXGI_BC3[2] = { 77, 78 };
+static const uint32_t DXGI_BC4 = 80;
+static const uint32_t DXGI_BC5 = 83;
+
+static inline int blocksAcross(int pixels)
+{
+    return (pixels + 3) / 4;
+}
+
+/// get the rgba of a whole image, missing channels filled in
+static std::vector<unsigned char> expandToRgba(const Image& image)
+{
+    int channels = image.getChannelCount();
+    size_t pixels = (size_t)image.getWidth() * image.getHeight();
+    const unsigned char* source = image.getRawData();
+
+    std::vector<unsigned char> rgba(pixels * 4);
+    for (size_t i = 0; i < pixels; i++)
+    {
+        const unsigned char* in = source + i * channels;
+        unsigned char* out = &rgba[i * 4];
+        switch (channels)
+        {
+        case 1:
+            out[0] = out[1] = out[2] = in[0];
+            out[3] = 255;
+            break;
+        case 2:
+            out[0] = in[0];
+            out[1] = in[1];
+            out[2] = 0;
+            out[3] = 255;
+            break;
+        case 3:
+            memcpy(out, in, 3);
+            out[3] = 255;
+            break;
+        default:
+            memcpy(out, in, 4);
+        }
+    }
+    return rgba;
+}
+
+/// compress one rgba level into blocks
+static void encodeLevel(const unsigned char* rgba, int width, int height,
+    CompressedImage::Format format, unsigned char* blocks, ThreadPool& pool)
+{
+    int rowBlocks = blocksAcross(width);
+    size_t blockSize = CompressedImage::getBlockSize(format);
+
+    pool.parallelFor(0, blocksAcross(height), 4, [=](size_t begin, size_t end) {
+        unsigned char pixels[16 * 4];
+        for (size_t blockY = begin; blockY < end; blockY++)
+        {
+            for (int blockX = 0; blockX < rowBlocks; blockX++)
+            {
+                // blocks past the edge repeat the last row and column
+                for (int y = 0; y < 4; y++)
+                {
+                    int sourceY = (int)blockY * 4 + y;
+                    sourceY = sourceY < height ? sourceY : height - 1;
+                    for (int x = 0; x < 4; x++)
+                    {
+                        int sourceX = blockX * 4 + x;
+                        sourceX = sourceX < width ? sourceX : width - 1;
+                        memcpy(&pixels[(y * 4 + x) * 4], &rgba[((size_t)sourceY * width + sourceX) * 4], 4);
+                    }
+                }
+
+                unsigned char* block = blocks + (blockY * rowBlocks + blockX) * blockSize;
+                switch (format)
+                {
+                case CompressedImage::Format::BC1:
+                    BlockCompression::encodeBC1(pixels, block);
+                    break;
+                case CompressedImage::Format::BC3:
+                    BlockCompression::encodeBC3(pixels, block);
+                    break;
+                case CompressedImage::Format::BC4:
+                    BlockCompression::encodeBC4(pixels, 4, block);
+                    break;
+                case CompressedImage::Format::BC5:
+                    BlockCompression::encodeBC5(pixels, block);
+                    break;
+                }
+            }
+        }
+    });
+}
+
+CompressedImage::Format CompressedImage::chooseFormat(const Image& image, bool normalMap)
+{
+    int channels = image.getChannelCount();
+    if (normalMap || channels == 2)
+        return Format::BC5;
+    if (channels == 1)
+        return Format::BC4;
+    if (channels == 4)
+    {
+        const unsigned char* data = image.getRawData();
+        size_t pixels = (size_t)image.getWidth() * image.getHeight();
+        for (size_t i = 0; i < pixels; i++)
+        {
+            if (data[i * 4 + 3] != 255)
+                return Format::BC3;
+        }
+    }
+    return Format::BC1;
+}
+
+CompressedImage CompressedImage::encode(const Image& image,
+    const std::vector<std::shared_ptr<Image>>& mipmaps, Format format, ThreadPool& pool)
+{
+    MAGIC_THROW(image.getWidth() <= 0 || image.getHeight() <= 0, "Cannot compress an empty image");
+
+    // lay out the levels first, so all are written into one buffer
+    std::vector<Level> levels;
+    size_t blockSize = getBlockSize(format);
+    size_t size = 0;
+    for (size_t i = 0; i <= mipmaps.size(); i++)
+    {
+        const Image& source = i == 0 ? image : *mipmaps[i - 1];
+        Level level;
+        level.width = source.getWidth();
+        level.height = source.getHeight();
+        level.offset = size;
+        level.size = (size_t)blocksAcross(level.width) * blocksAcross(level.height) * blockSize;
+        levels.push_back(level);
+        size += level.size;
+    }
+
+    auto blocks = std::make_shared<std::vector<unsigned char>>(size);
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        std::vector<unsigned char> rgba = expandToRgba(i == 0 ? image : *mipmaps[i - 1]);
+        encodeLevel(rgba.data(), levels[i].width, levels[i].height, format,
+            blocks->data() + levels[i].offset, pool);
+    }
+
+    return CompressedImage(format, ResourceData(blocks->data(), blocks->size(), blocks), levels);
+}
+
+CompressedImage CompressedImage::readDds(const ResourceData& data)
+{
+    const unsigned char* bytes = data.getData();
+    size_t size = data.getSize();
+
+    uint32_t magic;
+    DdsHeader header;
+    if (size < sizeof(magic) + sizeof(header))
+        throw_MagicException("DDS file is too small");
+    memcpy(&magic, bytes, sizeof(magic));
+    memcpy(&header, bytes + sizeof(magic), sizeof(header));
+    if (magic != DDS_MAGIC || header.size != sizeof(header) ||
+        header.pixelFormat.size != sizeof(DdsPixelFormat))
+        throw_MagicException("File is not a DDS file");
+    if ((header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) != 0)
+        throw_MagicException("DDS file is not a 2D texture");
+    if ((header.pixelFormat.flags & DDPF_FOURCC) == 0)
+        throw_MagicException("DDS file is not block compressed");
+
+    size_t offset = sizeof(magic) + sizeof(header);
+    Format format;
+    uint32_t code = header.pixelFormat.fourCC;
+    if (code == fourCC('D', 'X', '1', '0'))
+    {
+        DdsHeaderDx10 dx10;
+        if (size < offset + sizeof(dx10))
+            throw_MagicException("DDS file is too small");
+        memcpy(&dx10, bytes + offset, sizeof(dx10));
+        offset += sizeof(dx10);
+        if (dx10.resourceDimension != DX10_TEXTURE2D || dx10.arraySize > 1)
+            throw_MagicException("DDS file is not a 2D texture");
+
+        if (dx10.dxgiFormat == DXGI_BC1[0] || dx10.dxgiFormat == DXGI_BC1[1])
+            format = Format::BC1;
+        else if (dx10.dxgiFormat == DXGI_BC3[0] || dx10.dxgiFormat == DXGI_BC3[1])
+            format = Format::BC3;
+        else if (dx10.dxgiFormat == DXGI_BC4)
+            format = Format::BC4;
+        else if (dx10.dxgiFormat == DXGI_BC5)
+            format = Format::BC5;
+        else
+            throw_MagicException("DDS file has an unsupported format");
+    }
+    else if (code == fourCC('D', 'X', 'T', '1'))
+        format = Format::BC1;
+    else if (code == fourCC('D', 'X', 'T', '5'))
+        format = Format::BC3;
+    else if (code == fourCC('A', 'T', 'I', '1') || code == fourCC('B', 'C', '4', 'U'))
+        format = Format::BC4;
+    else if (code == fourCC('A', 'T', 'I', '2') || code == fourCC('B', 'C', '5', 'U'))
+        format = Format::BC5;
+    else
+        throw_MagicException("DDS file has an unsupported format");
+
+    if (header.width == 0 || header.height == 0)
+        throw_MagicException("DDS file is empty");
+    uint32_t levelCount = (header.flags & DDSD_MIPMAPCOUNT) != 0 && header.mipMapCount > 0 ?
+        header.mipMapCount : 1;
+
+    std::vector<Level> levels;
+    size_t blockSize = getBlockSize(format);
+    int width = (int)header.width;
+    int height = (int)header.height;
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.offset = offset;
+        level.size = (size_t)blocksAcross(width) * blocksAcross(height) * blockSize;
+        if (level.size > size - offset)
+            throw_MagicException("DDS file is truncated");
+        levels.push_back(level);
+        offset += level.size;
+
+        if (width == 1 && height == 1)
+            break;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+
+    CompressedImage image(format, data, levels);
+    if (header.reserved1[0] == SOURCE_HASH_TAG)
+        image.sourceHash = (uint64_t)header.reserved1[1] | ((uint64_t)header.reserved1[2] << 32);
+    return image;
+}
+
+void CompressedImage::writeDds(const std::string& path) const
+{
+    DdsHeader header;
+    memset(&header, 0, sizeof(header));
+    header.size = sizeof(header);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+        DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.height = (uint32_t)this->getHeight();
+    header.width = (uint32_t)this->getWidth();
+    header.pitchOrLinearSize = (uint32_t)this->levels[0].size;
+    header.mipMapCount = (uint32_t)this->levels.size();
+    header.pixelFormat.size = sizeof(DdsPixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+    header.pixelFormat.fourCC = fourCC('D', 'X', '1', '0');
+    header.caps = DDSCAPS_TEXTURE;
+    if (this->sourceHash != 0)
+    {
+        header.reserved1[0] = SOURCE_HASH_TAG;
+        header.reserved1[1] = (uint32_t)this->sourceHash;
+        header.reserved1[2] = (uint32_t)(this->sourceHash >> 32);
+    }
+    if (this->levels.size() > 1)
+        header.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+    DdsHeaderDx10 dx10;
+    memset(&dx10, 0, sizeof(dx10));
+    switch (this->format)
+    {
+    case Format::BC1:
+        dx10.dxgiFormat = DXGI_BC1[0];
+        break;
+    case Format::BC3:
+        dx10.dxgiFormat = DXGI_BC3[0];
+        break;
+    case Format::BC4:
+        dx10.dxgiFormat = DXGI_BC4;
+        break;
+    case Format::BC5:
+        dx10.dxgiFormat = DXGI_BC5;
+        break;
+    }
+    dx10.resourceDimension = DX10_TEXTURE2D;
+    dx10.arraySize = 1;
+
+    // write beside the file and move it in place once complete, so a
+    // failed write never leaves a damaged file behind
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out.good())
+        throw_MagicException("Could not write DDS file");
+
+    out.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)&dx10, sizeof(dx10));
+    for (size_t i = 0; i < this->levels.size(); i++)
+        out.write((const char*)this->getLevelData(i), (std::streamsize)this->levels[i].size);
+
+    out.close();
+    if (!out.good())
+    {
+        std::remove(tempPath.c_str());
+        throw_MagicException("Could not write DDS file");
+    }
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        throw_MagicException("Could not write DDS file");
+    }
+}
+
+};
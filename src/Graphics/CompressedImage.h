@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for CompressedImage class
+ *
+ * @file CompressedImage.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_COMPRESSED_IMAGE_H
+#define MAGIC3D_COMPRESSED_IMAGE_H
+
+#include "Image.h"
+#include "../Resources/ResourceData.h"
+#include "../Util/ThreadPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Magic3D
+{
+
+/** Image data compressed to one of the BC formats, with all its mipmap
+ * levels, ready to be copied to video memory as it is. Compressing is
+ * slow, so images are compressed when resources are built and stored in
+ * DDS files, see BlockCompression for the formats.
+ */
+class CompressedImage
+{
+public:
+    enum class Format
+    {
+        BC1,    // rgb
+        BC3,    // rgba
+        BC4,    // one channel
+        BC5     // two channels, for normal maps
+    };
+
+    /// a mipmap level
+    struct Level
+    {
+        int width;
+        int height;
+
+        /// bytes from the start of the data
+        size_t offset;
+        size_t size;
+    };
+
+private:
+    Format format;
+    ResourceData data;
+    std::vector<Level> levels;
+
+    /// hash of the file the image was compressed from, 0 if not known
+    uint64_t sourceHash;
+
+public:
+    /** @param format   format of all levels
+     * @param data      the levels, largest first
+     * @param levels    where each level is in the data
+     */
+    inline CompressedImage(Format format, const ResourceData& data, const std::vector<Level>& levels) :
+        format(format), data(data), levels(levels), sourceHash(0) {}
+
+    /// get the bytes of each 4x4 block of a format
+    static inline size_t getBlockSize(Format format)
+    {
+        return format == Format::BC1 || format == Format::BC4 ? 8 : 16;
+    }
+
+    /** Pick the smallest format that keeps what an image needs: BC5 for
+     * normal maps and two channels, BC4 for one channel, BC3 if any pixel
+     * is not opaque and BC1 otherwise
+     */
+    static Format chooseFormat(const Image& image, bool normalMap);
+
+    /** Compress an image, spreading rows of blocks across threads
+     * @param image     the image
+     * @param mipmaps   its smaller levels, see MipmapBuilder, or none
+     * @param format    format to compress to
+     * @param pool      threads to use
+     */
+    static CompressedImage encode(const Image& image,
+        const std::vector<std::shared_ptr<Image>>& mipmaps, Format format,
+        ThreadPool& pool = ThreadPool::getSingleton());
+
+    /// read the contents of a DDS file, throws if it is not a 2D texture
+    /// in one of the formats
+    static CompressedImage readDds(const ResourceData& data);
+
+    /// write to a DDS file, throws if it cannot be written. The source
+    /// hash goes in the reserved words of the header, other readers skip it
+    void writeDds(const std::string& path) const;
+
+    /// get the hash of the file the image was compressed from, so a DDS
+    /// file older than its image can be told apart, 0 if not known
+    inline uint64_t getSourceHash() const
+    {
+        return this->sourceHash;
+    }
+
+    inline void setSourceHash(uint64_t hash)
+    {
+        this->sourceHash = hash;
+    }
+
+    inline Format getFormat() const
+    {
+        return this->format;
+    }
+
+    inline int getWidth() const
+    {
+        return this->levels[0].width;
+    }
+
+    inline int getHeight() const
+    {
+        return this->levels[0].height;
+    }
+
+    inline size_t getLevelCount() const
+    {
+        return this->levels.size();
+    }
+
+    inline const Level& getLevel(size_t level) const
+    {
+        return this->levels[level];
+    }
+
+    /// get the blocks of a level, row by row
+    inline const unsigned char* getLevelData(size_t level) const
+    {
+        return this->data.getData() + this->levels[level].offset;
+    }
+};
+
+};
+
+#endif
@@ -0,0 +1,124 @@
+/* 
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for GraphicsState class
+ * 
+ * @file GraphicsState.cpp
+ * @author Andrew Keating
+ */
+
+#include <Graphics/GraphicsState.h>
+
+namespace Magic3D
+{
+
+GraphicsStateBackend::~GraphicsStateBackend()
+{
+    /* intentionally left blank */
+}
+
+void GLStateBackend::useProgram(GLuint program)
+{
+    glUseProgram(program);
+}
+
+void GLStateBackend::bindVertexArray(GLuint array)
+{
+#ifndef MAGIC3D_NO_VERTEX_ARRAYS
+    glBindVertexArray(array); //openGL 3
+#endif
+}
+
+void GLStateBackend::activeTexture(unsigned int unit)
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLStateBackend::bindTexture(GLenum target, GLuint texture)
+{
+    glBindTexture(target, texture);
+}
+
+void GLStateBackend::depthMask(bool enabled)
+{
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void GLStateBackend::polygonMode(GLenum mode)
+{
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void GLStateBackend::polygonOffset(float factor, float units)
+{
+    glPolygonOffset(factor, units);
+}
+
+void GLStateBackend::setCapability(GLenum capability, bool enabled)
+{
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+
+const GLenum GraphicsState::capabilityEnums[MAX_CAPABILITIES] =
+{
+    GL_BLEND,
+    GL_CULL_FACE,
+    GL_DEPTH_TEST,
+    GL_POLYGON_OFFSET_FILL,
+    GL_LINE_SMOOTH
+};
+
+GraphicsState::GraphicsState(): backend(&glBackend), issuedCount(0), filteredCount(0)
+{
+    this->invalidate();
+}
+
+GraphicsState& GraphicsState::getSingleton()
+{
+    static GraphicsState* state = nullptr;
+    if (state == nullptr)
+        state = new GraphicsState();
+    return *state;
+}
+
+void GraphicsState::invalidate()
+{
+    this->program = UNKNOWN;
+    this->vertexArray = UNKNOWN;
+    this->activeUnit = UNKNOWN;
+    for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+    {
+        this->textures[i] = UNKNOWN;
+        this->textureTargets[i] = 0;
+    }
+    this->depthMaskEnabled = UNKNOWN;
+    this->polygonModeValue = UNKNOWN;
+    this->polygonOffsetKnown = false;
+    this->polygonOffsetFactor = 0.0f;
+    this->polygonOffsetUnits = 0.0f;
+    for (int i = 0; i < MAX_CAPABILITIES; i++)
+        this->capabilities[i] = UNKNOWN;
+}
+
+
+};
@@ -0,0 +1,347 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for GraphicsState class
+ *
+ * @file GraphicsState.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_GRAPHICS_STATE_H
+#define MAGIC3D_GRAPHICS_STATE_H
+
+// include opengl
+#ifdef _WIN32
+#include <gl/glew.h>
+#include <gl/gl.h>
+#else
+#include <glew.h>
+#include <gl.h>
+#endif
+
+#include "../Exceptions/MagicException.h"
+#include "../Util/magic_throw.h"
+
+namespace Magic3D
+{
+
+/** Receives the state changes that made it through the GraphicsState
+ * cache. The default backend issues them to OpenGL.
+ */
+class GraphicsStateBackend
+{
+public:
+    virtual ~GraphicsStateBackend();
+
+    virtual void useProgram(GLuint program) = 0;
+    virtual void bindVertexArray(GLuint array) = 0;
+    virtual void activeTexture(unsigned int unit) = 0;
+    virtual void bindTexture(GLenum target, GLuint texture) = 0;
+    virtual void depthMask(bool enabled) = 0;
+    virtual void polygonMode(GLenum mode) = 0;
+    virtual void polygonOffset(float factor, float units) = 0;
+    virtual void setCapability(GLenum capability, bool enabled) = 0;
+};
+
+/** Backend that issues state changes to OpenGL
+ */
+class GLStateBackend : public GraphicsStateBackend
+{
+public:
+    virtual void useProgram(GLuint program);
+    virtual void bindVertexArray(GLuint array);
+    virtual void activeTexture(unsigned int unit);
+    virtual void bindTexture(GLenum target, GLuint texture);
+    virtual void depthMask(bool enabled);
+    virtual void polygonMode(GLenum mode);
+    virtual void polygonOffset(float factor, float units);
+    virtual void setCapability(GLenum capability, bool enabled);
+};
+
+/** Backend that only counts the state changes it receives, usable
+ * without a GL context to measure how many calls reach the driver
+ */
+class RecordingStateBackend : public GraphicsStateBackend
+{
+public:
+    /// kinds of calls that are counted
+    enum CallType
+    {
+        USE_PROGRAM = 0,
+        BIND_VERTEX_ARRAY,
+        ACTIVE_TEXTURE,
+        BIND_TEXTURE,
+        DEPTH_MASK,
+        POLYGON_MODE,
+        POLYGON_OFFSET,
+        SET_CAPABILITY,
+        MAX_CALL_TYPES
+    };
+
+private:
+    unsigned int calls[MAX_CALL_TYPES];
+
+public:
+    inline RecordingStateBackend()
+    {
+        this->reset();
+    }
+
+    inline void reset()
+    {
+        for (int i = 0; i < MAX_CALL_TYPES; i++)
+            this->calls[i] = 0;
+    }
+
+    inline unsigned int getCallCount(CallType type) const
+    {
+        return this->calls[type];
+    }
+
+    inline unsigned int getTotalCallCount() const
+    {
+        unsigned int total = 0;
+        for (int i = 0; i < MAX_CALL_TYPES; i++)
+            total += this->calls[i];
+        return total;
+    }
+
+    virtual void useProgram(GLuint program) { calls[USE_PROGRAM]++; }
+    virtual void bindVertexArray(GLuint array) { calls[BIND_VERTEX_ARRAY]++; }
+    virtual void activeTexture(unsigned int unit) { calls[ACTIVE_TEXTURE]++; }
+    virtual void bindTexture(GLenum target, GLuint texture) { calls[BIND_TEXTURE]++; }
+    virtual void depthMask(bool enabled) { calls[DEPTH_MASK]++; }
+    virtual void polygonMode(GLenum mode) { calls[POLYGON_MODE]++; }
+    virtual void polygonOffset(float factor, float units) { calls[POLYGON_OFFSET]++; }
+    virtual void setCapability(GLenum capability, bool enabled) { calls[SET_CAPABILITY]++; }
+};
+
+
+/** Shadows the pipeline state that is changed while rendering so that
+ * changes that would not do anything never reach the driver.
+ *
+ * All program, vertex array and texture binds as well as the raster state
+ * set by the renderer must go through here, otherwise the shadowed state
+ * no longer matches the real state. If state is changed behind its back,
+ * invalidate() must be called.
+ */
+class GraphicsState
+{
+public:
+    /// capabilities that are shadowed
+    enum Capability
+    {
+        BLEND = 0,
+        CULL_FACE,
+        DEPTH_TEST,
+        POLYGON_OFFSET_FILL,
+        LINE_SMOOTH,
+        MAX_CAPABILITIES
+    };
+
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+private:
+    /// value used for state that is not known
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+    GLStateBackend glBackend;
+    GraphicsStateBackend* backend;
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint activeUnit;
+    GLuint textures[MAX_TEXTURE_UNITS];
+    GLenum textureTargets[MAX_TEXTURE_UNITS];
+    GLuint depthMaskEnabled;
+    GLenum polygonModeValue;
+    bool polygonOffsetKnown;
+    float polygonOffsetFactor;
+    float polygonOffsetUnits;
+    GLuint capabilities[MAX_CAPABILITIES];
+
+    unsigned int issuedCount;
+    unsigned int filteredCount;
+
+    static const GLenum capabilityEnums[MAX_CAPABILITIES];
+
+    GraphicsState();
+
+    inline bool filter(bool redundant)
+    {
+        if (redundant)
+            this->filteredCount++;
+        else
+            this->issuedCount++;
+        return redundant;
+    }
+
+public:
+    static GraphicsState& getSingleton();
+
+    /** Set the backend state changes are sent to
+     * @param backend the backend to use, or nullptr to use OpenGL
+     */
+    inline void setBackend(GraphicsStateBackend* backend)
+    {
+        this->backend = backend == nullptr ? &this->glBackend : backend;
+        this->invalidate();
+    }
+
+    /// forget all shadowed state, the next change of each is always issued
+    void invalidate();
+
+    inline void useProgram(GLuint program)
+    {
+        if (filter(this->program == program))
+            return;
+        this->program = program;
+        this->backend->useProgram(program);
+    }
+
+    inline void bindVertexArray(GLuint array)
+    {
+        if (filter(this->vertexArray == array))
+            return;
+        this->vertexArray = array;
+        this->backend->bindVertexArray(array);
+    }
+
+    inline void activeTexture(unsigned int unit)
+    {
+        MAGIC_THROW(unit >= MAX_TEXTURE_UNITS, "Tried to use an unsupported texture unit.");
+        if (filter(this->activeUnit == unit))
+            return;
+        this->activeUnit = unit;
+        this->backend->activeTexture(unit);
+    }
+
+    /// bind a texture to the currently active texture unit
+    inline void bindTexture(GLenum target, GLuint texture)
+    {
+        unsigned int unit = this->activeUnit;
+        if (unit == UNKNOWN)
+        {
+            this->activeTexture(0);
+            unit = 0;
+        }
+        if (filter(this->textures[unit] == texture && this->textureTargets[unit] == target))
+            return;
+        this->textures[unit] = texture;
+        this->textureTargets[unit] = target;
+        this->backend->bindTexture(target, texture);
+    }
+
+    /// bind a texture to a specific texture unit
+    inline void bindTexture(unsigned int unit, GLenum target, GLuint texture)
+    {
+        this->activeTexture(unit);
+        this->bindTexture(target, texture);
+    }
+
+    inline void setDepthMask(bool enabled)
+    {
+        if (filter(this->depthMaskEnabled == (GLuint)enabled))
+            return;
+        this->depthMaskEnabled = enabled;
+        this->backend->depthMask(enabled);
+    }
+
+    inline void setPolygonMode(GLenum mode)
+    {
+        if (filter(this->polygonModeValue == mode))
+            return;
+        this->polygonModeValue = mode;
+        this->backend->polygonMode(mode);
+    }
+
+    inline void setPolygonOffset(float factor, float units)
+    {
+        if (filter(this->polygonOffsetKnown && this->polygonOffsetFactor == factor &&
+            this->polygonOffsetUnits == units))
+            return;
+        this->polygonOffsetKnown = true;
+        this->polygonOffsetFactor = factor;
+        this->polygonOffsetUnits = units;
+        this->backend->polygonOffset(factor, units);
+    }
+
+    inline void setCapability(Capability capability, bool enabled)
+    {
+        if (filter(this->capabilities[capability] == (GLuint)enabled))
+            return;
+        this->capabilities[capability] = enabled;
+        this->backend->setCapability(capabilityEnums[capability], enabled);
+    }
+
+    inline void enable(Capability capability)
+    {
+        this->setCapability(capability, true);
+    }
+
+    inline void disable(Capability capability)
+    {
+        this->setCapability(capability, false);
+    }
+
+    /// notify of a program being deleted, as it may still be in use
+    inline void programDeleted(GLuint program)
+    {
+        if (this->program == program)
+            this->program = UNKNOWN;
+    }
+
+    /// notify of a vertex array being deleted, which unbinds it
+    inline void vertexArrayDeleted(GLuint array)
+    {
+        if (this->vertexArray == array)
+            this->vertexArray = 0;
+    }
+
+    /// notify of a texture being deleted, which unbinds it from all units
+    inline void textureDeleted(GLuint texture)
+    {
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+        {
+            if (this->textures[i] == texture)
+                this->textures[i] = 0;
+        }
+    }
+
+    /// get the number of state changes that were passed on to the backend
+    inline unsigned int getIssuedCount() const
+    {
+        return this->issuedCount;
+    }
+
+    /// get the number of redundant state changes that were filtered out
+    inline unsigned int getFilteredCount() const
+    {
+        return this->filteredCount;
+    }
+
+    inline void resetCounters()
+    {
+        this->issuedCount = 0;
+        this->filteredCount = 0;
+    }
+};
+
+};
+
+#endif
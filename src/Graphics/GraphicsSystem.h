@@ -39,6 +39,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../Exceptions/MagicException.h"
 #include "../Util/Color.h"
+#include "GraphicsState.h"
 
 namespace Magic3D
 {
@@ -126,30 +127,30 @@ public:
     
     inline void enableBlending()
     {
-        glEnable (GL_BLEND); 
+        GraphicsState::getSingleton().enable(GraphicsState::BLEND);
         glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     }
 
     inline void setDepthOffset(float offset )
     {
-        glPolygonOffset(offset, offset);   
-        glEnable(GL_POLYGON_OFFSET_FILL);
+        GraphicsState::getSingleton().setPolygonOffset(offset, offset);
+        GraphicsState::getSingleton().enable(GraphicsState::POLYGON_OFFSET_FILL);
     }
     
     inline void disableDepthOffset()
     {
-        glDisable(GL_POLYGON_OFFSET_FILL);
+        GraphicsState::getSingleton().disable(GraphicsState::POLYGON_OFFSET_FILL);
     }
     
     inline void enableDepthTest()
     {
-        glEnable(GL_DEPTH_TEST);
-		glEnable(GL_CULL_FACE);
+        GraphicsState::getSingleton().enable(GraphicsState::DEPTH_TEST);
+        GraphicsState::getSingleton().enable(GraphicsState::CULL_FACE);
     }
     
     inline void disableDepthTest()
     {
-        glDisable(GL_DEPTH_TEST);
+        GraphicsState::getSingleton().disable(GraphicsState::DEPTH_TEST);
     }
     
     inline void setClearColor( const Color& color )
@@ -0,0 +1,443 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for MipmapBuilder class
+ *
+ * @file MipmapBuilder.cpp
+ * @author Andrew Keating
+ */
+#include <Graphics\MipmapBuilder.h>
+#include <Util\simd.h>
+
+#include <cmath>
+
+namespace Magic3D
+{
+
+static const float PI = 3.14159265358979f;
+
+/// radius of the kaiser filter, in pixels of the smaller level
+static const float KAISER_WIDTH = 3.0f;
+
+/// shape of the kaiser window, higher trades sharpness for less ringing
+static const float KAISER_ALPHA = 4.0f;
+
+/// a level being built, channels interleaved
+struct Level
+{
+    int width;
+    int height;
+    std::vector<float> data;
+};
+
+/// source pixels and weights of each pixel of the smaller level, in one
+/// dimension, pixels past the edges are clamped or wrapped
+struct Taps
+{
+    std::vector<int> first;     // index into pixels and weights, per pixel
+    std::vector<int> pixels;
+    std::vector<float> weights;
+};
+
+/// zeroth order modified bessel function of the first kind
+static float besselI0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 20; k++)
+    {
+        float factor = x / (2.0f * k);
+        term *= factor * factor;
+        sum += term;
+        if (term < sum * 1e-7f)
+            break;
+    }
+    return sum;
+}
+
+static float kaiser(float distance)
+{
+    float t = distance / KAISER_WIDTH;
+    if (t <= -1.0f || t >= 1.0f)
+        return 0.0f;
+    float sinc = distance == 0.0f ? 1.0f : std::sin(PI * distance) / (PI * distance);
+    return sinc * besselI0(KAISER_ALPHA * std::sqrt(1.0f - t * t)) / besselI0(KAISER_ALPHA);
+}
+
+static Taps makeTaps(int size, int smallerSize, const MipmapBuilder::Options& options)
+{
+    Taps taps;
+    MipmapBuilder::Filter filter = options.filter;
+    float scale = (float)size / smallerSize;
+    float radius = filter == MipmapBuilder::Filter::KAISER ? KAISER_WIDTH * scale : scale * 0.5f;
+    for (int i = 0; i < smallerSize; i++)
+    {
+        taps.first.push_back((int)taps.pixels.size());
+
+        // pixel centers are at half pixels
+        float center = (i + 0.5f) * scale;
+        int begin = (int)std::floor(center - radius);
+        int end = (int)std::ceil(center + radius);
+        float total = 0.0f;
+        size_t start = taps.weights.size();
+        for (int pixel = begin; pixel < end; pixel++)
+        {
+            float weight;
+            if (filter == MipmapBuilder::Filter::KAISER)
+                weight = kaiser((pixel + 0.5f - center) / scale);
+            else
+            {
+                // part of the pixel inside the box
+                float low = pixel > center - radius ? (float)pixel : center - radius;
+                float high = pixel + 1 < center + radius ? (float)(pixel + 1) : center + radius;
+                weight = high > low ? high - low : 0.0f;
+            }
+            if (weight == 0.0f)
+                continue;
+
+            if (options.wrap)
+                taps.pixels.push_back((pixel % size + size) % size);
+            else
+                taps.pixels.push_back(pixel < 0 ? 0 : pixel >= size ? size - 1 : pixel);
+            taps.weights.push_back(weight);
+            total += weight;
+        }
+        for (size_t j = start; j < taps.weights.size(); j++)
+            taps.weights[j] /= total;
+    }
+    taps.first.push_back((int)taps.pixels.size());
+    return taps;
+}
+
+static inline float srgbToLinear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static inline float linearToSrgb(float value)
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+/// get the number of channels of an image that hold sRGB colors
+static inline int getSrgbChannels(int channels, const MipmapBuilder::Options& options)
+{
+    return options.srgb && !options.normalMap && channels >= 3 ? 3 : 0;
+}
+
+/// get the number of channels of an image that hold normals
+static inline int getNormalChannels(int channels, const MipmapBuilder::Options& options)
+{
+    if (!options.normalMap || channels < 2)
+        return 0;
+    return channels == 2 ? 2 : 3;
+}
+
+static Level toLevel(const Image& image, const MipmapBuilder::Options& options)
+{
+    int channels = image.getChannelCount();
+    int srgbChannels = getSrgbChannels(channels, options);
+    int normalChannels = getNormalChannels(channels, options);
+
+    float table[256], srgbTable[256], normalTable[256];
+    for (int i = 0; i < 256; i++)
+    {
+        table[i] = i / 255.0f;
+        srgbTable[i] = srgbToLinear(table[i]);
+        normalTable[i] = table[i] * 2.0f - 1.0f;
+    }
+
+    Level level;
+    level.width = image.getWidth();
+    level.height = image.getHeight();
+    level.data.resize((size_t)level.width * level.height * channels);
+    const unsigned char* data = image.getRawData();
+    for (size_t i = 0; i < level.data.size(); i += channels)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            const float* channelTable = c < srgbChannels ? srgbTable :
+                c < normalChannels ? normalTable : table;
+            level.data[i + c] = channelTable[data[i + c]];
+        }
+    }
+    return level;
+}
+
+static std::shared_ptr<Image> toImage(const Level& level, int channels,
+    const MipmapBuilder::Options& options)
+{
+    int srgbChannels = getSrgbChannels(channels, options);
+    int normalChannels = getNormalChannels(channels, options);
+
+    auto image = std::make_shared<Image>(level.width, level.height, channels);
+    unsigned char* data = image->getMutableRawData();
+    for (size_t i = 0; i < level.data.size(); i += channels)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            float value = level.data[i + c];
+            if (c < srgbChannels)
+                value = linearToSrgb(value);
+            else if (c < normalChannels)
+                value = value * 0.5f + 0.5f;
+            data[i + c] = (unsigned char)(value * 255.0f + 0.5f);
+        }
+    }
+    return image;
+}
+
+/// filter one row across, into a row of the smaller width
+static void filterRowScalar(const float* in, float* out, int width, int channels,
+    const Taps& columns)
+{
+    for (int x = 0; x < width; x++)
+    {
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int tap = columns.first[x]; tap < columns.first[x + 1]; tap++)
+        {
+            const float* pixel = in + columns.pixels[tap] * channels;
+            float weight = columns.weights[tap];
+            for (int c = 0; c < channels; c++)
+                sum[c] += pixel[c] * weight;
+        }
+        for (int c = 0; c < channels; c++)
+            out[x * channels + c] = sum[c];
+    }
+}
+
+/// add a weighted row to a sum of rows
+static void addRowScalar(const float* in, float weight, float* out, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        out[i] += in[i] * weight;
+}
+
+/// keep values in [0, 1]
+static void clampRowScalar(float* out, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        out[i] = out[i] < 0.0f ? 0.0f : out[i] > 1.0f ? 1.0f : out[i];
+}
+
+#ifdef MAGIC3D_SSE2
+
+/* The simd passes do the same operations as the scalar ones, in the same
+ * order for each sum, so the levels are the same bit for bit. Across rows
+ * a pixel's channels are filtered together, one per lane, and down rows
+ * four values are filtered at a time.
+ */
+
+/// load the channels of a pixel, unused lanes are zero
+static inline __m128 loadPixel(const float* pixel, int channels)
+{
+    switch (channels)
+    {
+    case 1:
+        return _mm_load_ss(pixel);
+    case 2:
+        return _mm_castpd_ps(_mm_load_sd((const double*)pixel));
+    case 3:
+        return _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((const double*)pixel)), _mm_load_ss(pixel + 2));
+    default:
+        return _mm_loadu_ps(pixel);
+    }
+}
+
+static inline void storePixel(float* pixel, __m128 value, int channels)
+{
+    if (channels == 4)
+    {
+        _mm_storeu_ps(pixel, value);
+        return;
+    }
+    float values[4];
+    _mm_storeu_ps(values, value);
+    for (int c = 0; c < channels; c++)
+        pixel[c] = values[c];
+}
+
+static void filterRowSse(const float* in, float* out, int width, int channels,
+    const Taps& columns)
+{
+    for (int x = 0; x < width; x++)
+    {
+        __m128 sum = _mm_setzero_ps();
+        for (int tap = columns.first[x]; tap < columns.first[x + 1]; tap++)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(loadPixel(in + columns.pixels[tap] * channels, channels),
+                _mm_set1_ps(columns.weights[tap])));
+        }
+        storePixel(out + x * channels, sum, channels);
+    }
+}
+
+static void addRowSse(const float* in, float weight, float* out, size_t size)
+{
+    __m128 w = _mm_set1_ps(weight);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), w)));
+    addRowScalar(in + i, weight, out + i, size - i);
+}
+
+static void clampRowSse(float* out, size_t size)
+{
+    // the bound goes first, so values that are not numbers pass through
+    // as they do in the scalar pass
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4)
+        _mm_storeu_ps(out + i, _mm_min_ps(one, _mm_max_ps(zero, _mm_loadu_ps(out + i))));
+    clampRowScalar(out + i, size - i);
+}
+
+#endif
+
+static inline void filterRow(const float* in, float* out, int width, int channels,
+    const Taps& columns, bool useSimd)
+{
+#ifdef MAGIC3D_SSE2
+    if (useSimd)
+        return filterRowSse(in, out, width, channels, columns);
+#endif
+    filterRowScalar(in, out, width, channels, columns);
+}
+
+static inline void addRow(const float* in, float weight, float* out, size_t size, bool useSimd)
+{
+#ifdef MAGIC3D_SSE2
+    if (useSimd)
+        return addRowSse(in, weight, out, size);
+#endif
+    addRowScalar(in, weight, out, size);
+}
+
+static inline void clampRow(float* out, size_t size, bool useSimd)
+{
+#ifdef MAGIC3D_SSE2
+    if (useSimd)
+        return clampRowSse(out, size);
+#endif
+    clampRowScalar(out, size);
+}
+
+/// filter a level down to the next, both dimensions at once
+static Level shrink(const Level& source, int channels, const MipmapBuilder::Options& options,
+    ThreadPool& pool)
+{
+    Level level;
+    level.width = source.width > 1 ? source.width / 2 : 1;
+    level.height = source.height > 1 ? source.height / 2 : 1;
+    Taps columns = makeTaps(source.width, level.width, options);
+    Taps rows = makeTaps(source.height, level.height, options);
+
+    // across each row first, into rows as tall as the source
+    std::vector<float> across((size_t)level.width * source.height * channels);
+    size_t grainSize = 1 + 16384 / ((size_t)source.width * channels);
+    pool.parallelFor(0, source.height, grainSize, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++)
+        {
+            filterRow(&source.data[y * source.width * channels], &across[y * level.width * channels],
+                level.width, channels, columns, options.useSimd);
+        }
+    });
+
+    // then down whole rows, then keep values in range, ringing of the
+    // kaiser filter would otherwise build up level after level
+    int normalChannels = getNormalChannels(channels, options);
+    size_t rowSize = (size_t)level.width * channels;
+    level.data.resize(rowSize * level.height);
+    grainSize = 1 + 16384 / rowSize;
+    pool.parallelFor(0, level.height, grainSize, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; y++)
+        {
+            float* out = &level.data[y * rowSize];
+            for (int tap = rows.first[y]; tap < rows.first[y + 1]; tap++)
+                addRow(&across[rows.pixels[tap] * rowSize], rows.weights[tap], out, rowSize, options.useSimd);
+
+            // without normals all channels are kept in [0, 1]
+            if (normalChannels == 0)
+            {
+                clampRow(out, rowSize, options.useSimd);
+                continue;
+            }
+            for (size_t i = 0; i < rowSize; i += channels)
+            {
+                float* pixel = out + i;
+                for (int c = 0; c < channels; c++)
+                {
+                    float low = c < normalChannels ? -1.0f : 0.0f;
+                    pixel[c] = pixel[c] < low ? low : pixel[c] > 1.0f ? 1.0f : pixel[c];
+                }
+
+                float length = 0.0f;
+                for (int c = 0; c < normalChannels; c++)
+                    length += pixel[c] * pixel[c];
+                length = std::sqrt(length);
+                if (normalChannels == 3 ? length > 1e-6f : length > 1.0f)
+                {
+                    for (int c = 0; c < normalChannels; c++)
+                        pixel[c] /= length;
+                }
+            }
+        }
+    });
+    return level;
+}
+
+bool MipmapBuilder::hasSimd()
+{
+#ifdef MAGIC3D_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+int MipmapBuilder::getLevelCount(int width, int height)
+{
+    int count = 1;
+    while (width > 1 || height > 1)
+    {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        count++;
+    }
+    return count;
+}
+
+std::vector<std::shared_ptr<Image>> MipmapBuilder::build(const Image& image,
+    const Options& options, ThreadPool& pool)
+{
+    std::vector<std::shared_ptr<Image>> levels;
+    int channels = image.getChannelCount();
+    if (image.getWidth() <= 1 && image.getHeight() <= 1)
+        return levels;
+
+    Level level = toLevel(image, options);
+    while (level.width > 1 || level.height > 1)
+    {
+        level = shrink(level, channels, options, pool);
+        levels.push_back(toImage(level, channels, options));
+    }
+    return levels;
+}
+
+};
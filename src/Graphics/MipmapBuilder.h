@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for MipmapBuilder class
+ *
+ * @file MipmapBuilder.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_MIPMAP_BUILDER_H
+#define MAGIC3D_MIPMAP_BUILDER_H
+
+#include "Image.h"
+#include "../Util/ThreadPool.h"
+
+#include <memory>
+#include <vector>
+
+namespace Magic3D
+{
+
+/** Builds the mipmap levels of images on the cpu, so textures do not need
+ * the driver to generate them on the graphics thread each time they load.
+ * Each level is filtered from the one above it, kept at full precision
+ * until it is stored, with rows spread across threads.
+ */
+class MipmapBuilder
+{
+public:
+    enum class Filter
+    {
+        BOX,    // average of the pixels covered, fast but blurs and aliases
+        KAISER  // windowed sinc, keeps detail sharper
+    };
+
+    struct Options
+    {
+        Filter filter;
+
+        /// whether the color channels (not alpha) are sRGB encoded, if so
+        /// they are filtered in linear space
+        bool srgb;
+
+        /// whether the first three channels are normals, which are then
+        /// renormalized, two channel normal maps are kept in the unit circle
+        bool normalMap;
+
+        /// whether the image repeats, so filters wrap around its edges
+        /// instead of clamping to them
+        bool wrap;
+
+        /// whether to filter with simd instructions when available, both
+        /// ways give the same levels
+        bool useSimd;
+
+        inline Options(Filter filter = Filter::KAISER, bool srgb = false, bool normalMap = false,
+            bool wrap = false) : filter(filter), srgb(srgb), normalMap(normalMap), wrap(wrap),
+            useSimd(true) {}
+    };
+
+    /// whether the filters can use simd instructions in this build
+    static bool hasSimd();
+
+    /// get the number of levels of an image of a size, itself included
+    static int getLevelCount(int width, int height);
+
+    /** Build the levels of an image, each half the size of the one before
+     * down to 1x1
+     * @param image     the image, the largest level
+     * @param options   how to filter
+     * @param pool      threads to use
+     * @return the levels below the image, largest first
+     */
+    static std::vector<std::shared_ptr<Image>> build(const Image& image,
+        const Options& options = Options(), ThreadPool& pool = ThreadPool::getSingleton());
+};
+
+};
+
+#endif
@@ -24,6 +24,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include <Graphics/Texture.h>
+#include <Graphics/MipmapBuilder.h>
 #include <Util/magic_assert.h>
 
 namespace Magic3D
@@ -51,10 +52,31 @@ Texture::Texture(const Image& image, bool removeGammaCorrection, bool generateMi
     this->set(image, removeGammaCorrection, generateMipmaps);
 }
 
+Texture::Texture(const Image& image, const std::vector<std::shared_ptr<Image>>& mipmaps,
+    bool removeGammaCorrection) :
+    width(image.getWidth()), height(image.getHeight())
+{
+	glGenTextures(1, &tid);
+
+    this->set(image, mipmaps, removeGammaCorrection);
+}
+
 void Texture::set(const Image& image, bool removeGammaCorrection, bool generateMipmaps)
+{
+	std::vector<std::shared_ptr<Image>> mipmaps;
+	if (generateMipmaps)
+	{
+		MipmapBuilder::Options options(MipmapBuilder::Filter::KAISER, removeGammaCorrection);
+		mipmaps = MipmapBuilder::build(image, options);
+	}
+	this->set(image, mipmaps, removeGammaCorrection);
+}
+
+void Texture::set(const Image& image, const std::vector<std::shared_ptr<Image>>& mipmaps,
+    bool removeGammaCorrection)
 {
     // bind to our state
-	glBindTexture(GL_TEXTURE_2D, tid);
+	this->bind();
 	
 	// no row alignment in Image class
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -94,33 +116,99 @@ void Texture::set(const Image& image, bool removeGammaCorrection, bool generateM
 		    MAGIC_ASSERT(false);
 	}
 	
-	// unpack data into graphics memory
-	glTexImage2D(GL_TEXTURE_2D,			// 2D image data 
-				 0, 					// base mipmap level
-				 internalFormat,	    // the graphics memory format we want it in
-				 image.getWidth(),			// width of image
-				 image.getHeight(),		    // height of image
-				 0,					    // this parameter is always 0. :?
-				 format,		        // format of image (layout of channels) 
-				 GL_UNSIGNED_BYTE,      // image data type (size per channel)
-				 image.getRawData());           // actual data
-				 
-	// generate mipmaps if instructed to
-	if (generateMipmaps)
-		 glGenerateMipmap(GL_TEXTURE_2D);
-	else
+	// unpack data into graphics memory, level by level
+	GLsizei levelCount = (GLsizei)mipmaps.size() + 1;
+	for (GLsizei i = 0; i < levelCount; i++)
+	{
+		const Image& level = i == 0 ? image : *mipmaps[i - 1];
+		glTexImage2D(GL_TEXTURE_2D,			// 2D image data 
+					 i, 					// mipmap level
+					 internalFormat,	    // the graphics memory format we want it in
+					 level.getWidth(),		// width of image
+					 level.getHeight(),		// height of image
+					 0,					    // this parameter is always 0. :?
+					 format,		        // format of image (layout of channels) 
+					 GL_UNSIGNED_BYTE,      // image data type (size per channel)
+					 level.getRawData());   // actual data
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+	if (levelCount == 1)
 	{
 		// if there is no mipmap, then set the min filter to something that
 		// will work without a mipmap
 		this->setMinFilter(Texture::MinFilters::LINEAR);
 	}
+	else
+		this->setMinFilter(Texture::MinFilters::LINEAR_MIPMAP_LINEAR);
+
+    this->width = image.getWidth();
+    this->height = image.getHeight();
 }
 	
+Texture::Texture(const CompressedImage& image, bool removeGammaCorrection) :
+    width(image.getWidth()), height(image.getHeight())
+{
+	glGenTextures(1, &tid);
+
+    this->set(image, removeGammaCorrection);
+}
+
+void Texture::set(const CompressedImage& image, bool removeGammaCorrection)
+{
+	this->bind();
+
+	GLenum internalFormat = 0;
+	switch (image.getFormat())
+	{
+		case CompressedImage::Format::BC1:
+			internalFormat = removeGammaCorrection ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT :
+				GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			break;
+
+		case CompressedImage::Format::BC3:
+			internalFormat = removeGammaCorrection ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT :
+				GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			break;
+
+		case CompressedImage::Format::BC4:
+			internalFormat = GL_COMPRESSED_RED_RGTC1;
+			break;
+
+		case CompressedImage::Format::BC5:
+			internalFormat = GL_COMPRESSED_RG_RGTC2;
+			break;
+
+		default:
+			MAGIC_ASSERT(false);
+	}
+
+	// the blocks go to graphics memory as they are, level by level
+	GLsizei levelCount = (GLsizei)image.getLevelCount();
+	for (GLsizei i = 0; i < levelCount; i++)
+	{
+		const CompressedImage::Level& level = image.getLevel(i);
+		glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height,
+			0, (GLsizei)level.size, image.getLevelData(i));
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+	// without mipmaps, set the min filter to something that will work
+	if (levelCount == 1)
+		this->setMinFilter(Texture::MinFilters::LINEAR);
+	else
+		this->setMinFilter(Texture::MinFilters::LINEAR_MIPMAP_LINEAR);
+
+    this->width = image.getWidth();
+    this->height = image.getHeight();
+}
+
 /// destructor
 Texture::~Texture()
 {
 	// delete texture state and graphics memory
 	glDeleteTextures(1, &tid);
+	GraphicsState::getSingleton().textureDeleted(tid);
 }
 	
 	
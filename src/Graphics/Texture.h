@@ -36,7 +36,11 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include "../Exceptions/MagicException.h"
 
 #include "Image.h"
+#include "CompressedImage.h"
+#include "GraphicsState.h"
 
+#include <memory>
+#include <vector>
 
 namespace Magic3D
 {
@@ -100,6 +104,22 @@ public:
 	 * @param generateMipmaps whether to generate mipmaps or not
 	 */
 	Texture(const Image& image, bool removeGammaCorrection = true, bool generateMipmaps = false);
+
+	/** Constructor for an image with mipmap levels built already
+	 * @param image the image, the largest level
+	 * @param mipmaps the smaller levels, see MipmapBuilder
+	 * @param removeGammaCorrection whether the colors are sRGB
+	 */
+	Texture(const Image& image, const std::vector<std::shared_ptr<Image>>& mipmaps,
+		bool removeGammaCorrection = true);
+
+	/** Constructor for compressed image data, copied as it is with all its
+	 * mipmap levels
+	 * @param image the compressed image
+	 * @param removeGammaCorrection whether the colors are sRGB, only BC1
+	 * and BC3 can be
+	 */
+	Texture(const CompressedImage& image, bool removeGammaCorrection = true);
 	
 	/// copy constructor
 	inline Texture(const Texture& copy)
@@ -111,11 +131,17 @@ public:
 	/// destructor
 	virtual ~Texture();
 
+    /// generated mipmaps are built on the cpu, see MipmapBuilder
     void set(const Image& image, bool removeGammaCorrection = true, bool generateMipmaps = false);
+
+    void set(const Image& image, const std::vector<std::shared_ptr<Image>>& mipmaps,
+        bool removeGammaCorrection = true);
+
+    void set(const CompressedImage& image, bool removeGammaCorrection = true);
 	
 	/// bind this texture to be the current texture state
 	inline void bind()
-	{ glBindTexture(GL_TEXTURE_2D, tid); }
+	{ GraphicsState::getSingleton().bindTexture(GL_TEXTURE_2D, tid); }
 	
 	/// get texture id
 	inline GLuint getID() const
@@ -0,0 +1,99 @@
+/* 
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for TextureBuffer class
+ *
+ * @file TextureBuffer.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_TEXTURE_BUFFER_H
+#define MAGIC3D_TEXTURE_BUFFER_H
+
+// include opengl
+#ifdef _WIN32
+#include <gl/glew.h>
+#include <gl/gl.h>
+#else
+#include <glew.h>
+#include <gl.h>
+#endif
+
+#include "Buffer.h"
+#include "GraphicsState.h"
+
+namespace Magic3D
+{
+
+/** Buffer texture, exposes the contents of a Buffer to shaders as a
+ * samplerBuffer that can be read with texelFetch
+ */
+class TextureBuffer
+{
+private:
+    /// texture id
+    GLuint tid;
+
+    /// buffer holding the texel data
+    Buffer buffer;
+
+    /// private copy constructor, copying not allowed
+    TextureBuffer(const TextureBuffer&);
+
+public:
+    /** Standard constructor
+     * @param internalFormat the format of the texels in the buffer
+     */
+    inline TextureBuffer(GLenum internalFormat)
+    {
+        // buffer object must exist before it can be attached
+        buffer.allocate(4 * sizeof(float), NULL, Buffer::STREAM_DRAW);
+
+        glGenTextures(1, &tid);
+        this->bind();
+        glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer.getID());
+    }
+
+    inline ~TextureBuffer()
+    {
+        glDeleteTextures(1, &tid);
+        GraphicsState::getSingleton().textureDeleted(tid);
+    }
+
+    /// bind this texture buffer to the active texture unit
+    inline void bind()
+    {
+        GraphicsState::getSingleton().bindTexture(GL_TEXTURE_BUFFER, tid);
+    }
+
+    /// get texture id
+    inline GLuint getID() const
+    {
+        return this->tid;
+    }
+
+    /// get the buffer that holds the texel data
+    inline Buffer& getBuffer()
+    {
+        return this->buffer;
+    }
+};
+
+};
+
+#endif
@@ -29,8 +29,6 @@ namespace Magic3D
 {
 	
 	
-GLuint VertexArray::boundArrayId = 0;
-	
 	
 	
 	
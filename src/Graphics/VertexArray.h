@@ -34,7 +34,9 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 #include "Buffer.h"
+#include "GraphicsState.h"
 #include "../Exceptions/MagicException.h"
+#include "../Util/magic_gl_check.h"
 
 namespace Magic3D
 {
@@ -49,9 +51,6 @@ class VertexArray
 private:
 	/// opengl id of this vertex array
 	GLuint arrayId;
-	
-	/// used to ensure we don't unbind someone else's vertex array
-	static GLuint boundArrayId;
 
 
 public:
@@ -122,9 +121,9 @@ public:
 	/// destructor
 	inline ~VertexArray()
 	{
-		unBind();
 #ifndef MAGIC3D_NO_VERTEX_ARRAYS
 		glDeleteVertexArrays(1, &arrayId); //openGL 3
+		GraphicsState::getSingleton().vertexArrayDeleted(arrayId);
 #endif
 	}
 	
@@ -132,10 +131,7 @@ public:
 	inline void bind() const
 	{
 #ifndef MAGIC3D_NO_VERTEX_ARRAYS
-		if (VertexArray::boundArrayId == arrayId)
-			return; // already bound
-		VertexArray::boundArrayId = arrayId;
-		glBindVertexArray(arrayId); //openGL 3
+		GraphicsState::getSingleton().bindVertexArray(arrayId);
 #endif
 	}
 	
@@ -143,10 +139,7 @@ public:
 	inline void unBind() const
 	{
 #ifndef MAGIC3D_NO_VERTEX_ARRAYS
-		if (arrayId != VertexArray::boundArrayId)
-			return; // TODO: should throw exception here
-		glBindVertexArray(0); // openGL 3
-		VertexArray::boundArrayId = 0;
+		GraphicsState::getSingleton().bindVertexArray(0);
 #endif
 	}
 	
@@ -155,9 +148,12 @@ public:
 	 * @param components the number of components per vertex (vector size in shader)
 	 * @param type data type/size for each component
 	 * @param buffer the buffer to be used as the attribute array
+	 * @param stride bytes between consecutive vertices, 0 for tightly packed
+	 * @param offset byte offset of the first vertex in the buffer
 	 */
 	inline void setAttributeArray(unsigned int index, int components, DataTypes type, 
-								  const Buffer& buffer)
+								  const Buffer& buffer, unsigned int stride = 0,
+								  unsigned int offset = 0)
 	{
 		this->bind();
 		glEnableVertexAttribArray(index);
@@ -166,11 +162,10 @@ public:
 							  components,   // number of components per vertex
 							  type, 		// the data type of each component
 							  GL_FALSE, 	// no normalizing
-							  0, 			// no padding
-							  0				// no offset to start at
+							  stride, 		// padding between vertices
+							  (const void*)(size_t)offset // offset to start at
 							 );
 		buffer.unBind();
-		this->unBind();
 		
 		if (glGetError() != GL_NO_ERROR)
 			throw_MagicException("Failed to set attribute array");
@@ -181,7 +176,6 @@ public:
 	{
 		this->bind();
 		glDisableVertexAttribArray(index);
-		this->unBind();
 	}
 	 
 	/** render a number of verticies using this vertex array as the 
@@ -194,19 +188,65 @@ public:
 	{
 		this->bind();
 		glDrawArrays(primitive, startingVertex, vertexCount);
-		this->unBind();
-		if (glGetError() != GL_NO_ERROR)
-			throw_MagicException("Failed to draw");
+		MAGIC_GL_CHECK("Failed to draw");
 	}
 
-    inline void drawIndexed(Primitives primitive, unsigned int vertexCount, 
-        const unsigned int* vertexIndices) const
+    /** set the element array buffer that indices are read from for
+     * indexed draws
+     * @param buffer the buffer holding the indices
+     */
+    inline void setElementArray(const Buffer& buffer)
     {
         this->bind();
-        glDrawElements(primitive, vertexCount, GL_UNSIGNED_INT, vertexIndices);
-        this->unBind();
+        // the element array binding is part of the vertex array state, so
+        // bypass the buffer binding cache as unbinding it later through the
+        // cache would detach it from whichever vertex array is bound
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.getID());
+
         if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Failed to draw");
+            throw_MagicException("Failed to set element array");
+    }
+
+    /** render a number of indexed verticies using this vertex array as
+     * the data for each vertex, indices are read from the element array
+     * @param primitive the type of the primitives to draw
+     * @param indexCount the number of indices to render
+     * @param indexType the type of the indices in the element array
+     * @param firstIndex the index in the element array to start at
+     */
+    inline void drawIndexed(Primitives primitive, unsigned int indexCount,
+        DataTypes indexType, unsigned int firstIndex = 0) const
+    {
+        this->bind();
+        glDrawElements(primitive, indexCount, indexType,
+            getIndexOffset(indexType, firstIndex));
+        MAGIC_GL_CHECK("Failed to draw");
+    }
+
+    /** render a number of instances of indexed verticies using this vertex
+     * array as the data for each vertex
+     * @param primitive the type of the primitives to draw
+     * @param indexCount the number of indices to render per instance
+     * @param indexType the type of the indices in the element array
+     * @param instanceCount the number of instances to render
+     * @param firstIndex the index in the element array to start at
+     */
+    inline void drawIndexedInstanced(Primitives primitive, unsigned int indexCount,
+        DataTypes indexType, unsigned int instanceCount, unsigned int firstIndex = 0) const
+    {
+        this->bind();
+        glDrawElementsInstanced(primitive, indexCount, indexType,
+            getIndexOffset(indexType, firstIndex), instanceCount);
+        MAGIC_GL_CHECK("Failed to draw instanced");
+    }
+
+private:
+    /// get the byte offset into the element array of an index, as a pointer
+    static inline const void* getIndexOffset(DataTypes indexType, unsigned int firstIndex)
+    {
+        size_t indexSize = indexType == UNSIGNED_BYTE ? 1 :
+            (indexType == UNSIGNED_SHORT ? 2 : 4);
+        return (const void*)(firstIndex * indexSize);
     }
 
 };
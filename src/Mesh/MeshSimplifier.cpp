@@ -0,0 +1,295 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Mesh\MeshSimplifier.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Magic3D
+{
+
+// smallest cosine between a triangle's normal before and after a collapse
+static const double MIN_NORMAL_COS = 0.25;
+
+/// symmetric 4x4 error matrix, upper triangle stored row by row
+struct Quadric
+{
+    double m[10];
+
+    inline Quadric()
+    {
+        std::fill(m, m + 10, 0.0);
+    }
+
+    /// quadric of the squared distance to plane ax + by + cz + d = 0, times weight
+    inline Quadric(double a, double b, double c, double d, double weight)
+    {
+        m[0] = a * a * weight; m[1] = a * b * weight; m[2] = a * c * weight; m[3] = a * d * weight;
+        m[4] = b * b * weight; m[5] = b * c * weight; m[6] = b * d * weight;
+        m[7] = c * c * weight; m[8] = c * d * weight;
+        m[9] = d * d * weight;
+    }
+
+    inline Quadric& operator+=(const Quadric& q)
+    {
+        for (int i = 0; i < 10; i++)
+            m[i] += q.m[i];
+        return *this;
+    }
+
+    inline double error(const Scalar* p) const
+    {
+        double x = p[0], y = p[1], z = p[2];
+        double e =
+            m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x +
+            m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y +
+            m[7] * z * z + 2 * m[8] * z +
+            m[9];
+        return std::max(e, 0.0);
+    }
+};
+
+/// edge collapse candidate, moves vertex 'from' onto vertex 'to'
+struct Collapse
+{
+    unsigned int from;
+    unsigned int to;
+    double cost;
+};
+
+static inline void getNormal(const Scalar* a, const Scalar* b, const Scalar* c, double normal[3])
+{
+    double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    double ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+size_t MeshSimplifier::simplify(unsigned int* indices, size_t indexCount,
+    const Scalar* positions, unsigned int positionStride, unsigned int vertexCount,
+    size_t targetIndexCount, Scalar* resultError)
+{
+    if (resultError != nullptr)
+        *resultError = 0.0f;
+    if (indexCount <= targetIndexCount || vertexCount == 0)
+        return indexCount;
+
+    auto getPosition = [&](unsigned int vertex) {
+        return positions + (size_t)vertex * positionStride;
+    };
+
+    // vertices with exactly the same position form a group
+    auto hashPosition = [&](unsigned int vertex) -> size_t {
+        const Scalar* p = getPosition(vertex);
+        std::hash<Scalar> hash;
+        return hash(p[0]) ^ (hash(p[1]) * 31) ^ (hash(p[2]) * 997);
+    };
+    auto samePosition = [&](unsigned int a, unsigned int b) -> bool {
+        const Scalar* pa = getPosition(a);
+        const Scalar* pb = getPosition(b);
+        return pa[0] == pb[0] && pa[1] == pb[1] && pa[2] == pb[2];
+    };
+    std::unordered_map<unsigned int, unsigned int, decltype(hashPosition), decltype(samePosition)>
+        groups(vertexCount, hashPosition, samePosition);
+
+    std::vector<unsigned int> group(vertexCount);
+    std::vector<unsigned int> groupSize(vertexCount, 0);
+    for (unsigned int v = 0; v < vertexCount; v++)
+    {
+        group[v] = groups.insert(std::make_pair(v, v)).first->second;
+        groupSize[group[v]]++;
+    }
+
+    // an edge between groups that is only used in one direction is on a border
+    std::unordered_set<uint64_t> edges;
+    edges.reserve(indexCount);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            uint64_t a = group[indices[i + e]], b = group[indices[i + (e + 1) % 3]];
+            edges.insert((a << 32) | b);
+        }
+    }
+
+    std::vector<bool> locked(vertexCount, false);
+    for (uint64_t edge : edges)
+    {
+        uint64_t a = edge >> 32, b = edge & 0xFFFFFFFFu;
+        if (edges.count((b << 32) | a) == 0)
+            locked[(size_t)a] = locked[(size_t)b] = true;
+    }
+    for (unsigned int v = 0; v < vertexCount; v++)
+        locked[v] = locked[group[v]] || groupSize[group[v]] > 1;
+
+    // area weighted plane quadrics of the triangles around each group
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        const Scalar* p0 = getPosition(indices[i]);
+        double normal[3];
+        getNormal(p0, getPosition(indices[i + 1]), getPosition(indices[i + 2]), normal);
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length == 0.0)
+            continue;
+
+        double a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+        Quadric q(a, b, c, -(a * p0[0] + b * p0[1] + c * p0[2]), length * 0.5);
+        for (int k = 0; k < 3; k++)
+            quadrics[group[indices[i + k]]] += q;
+    }
+
+    std::vector<unsigned int> remap(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        remap[v] = v;
+
+    std::vector<unsigned int> offsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<bool> touched(vertexCount);
+    std::vector<Collapse> collapses;
+    double maxError = 0.0;
+
+    // each pass collapses the cheapest edges that do not share a triangle
+    // with an edge collapsed before in the same pass, then rebuilds the list
+    while (indexCount > targetIndexCount)
+    {
+        // triangles using each vertex, as one list per vertex in a shared array
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (size_t i = 0; i < indexCount; i++)
+            offsets[indices[i] + 1]++;
+        for (unsigned int v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(indexCount);
+        {
+            std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < indexCount; i++)
+                adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                unsigned int a = indices[i + e], b = indices[i + (e + 1) % 3];
+                if (group[a] == group[b])
+                    continue;
+
+                Quadric q = quadrics[group[a]];
+                q += quadrics[group[b]];
+                if (!locked[a])
+                {
+                    Collapse collapse = { a, b, q.error(getPosition(b)) };
+                    collapses.push_back(collapse);
+                }
+                if (!locked[b])
+                {
+                    Collapse collapse = { b, a, q.error(getPosition(a)) };
+                    collapses.push_back(collapse);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+            return a.cost < b.cost;
+        });
+
+        size_t trianglesToRemove = (indexCount - targetIndexCount + 2) / 3;
+        size_t trianglesRemoved = 0;
+        std::fill(touched.begin(), touched.end(), false);
+        for (const Collapse& collapse : collapses)
+        {
+            if (trianglesRemoved >= trianglesToRemove)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // reject the collapse if any triangle kept would flip or fold over
+            bool flips = false;
+            for (unsigned int t = offsets[collapse.from]; t < offsets[collapse.from + 1] && !flips; t++)
+            {
+                const unsigned int* triangle = &indices[adjacency[t] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    continue;
+
+                const Scalar* p[3];
+                const Scalar* moved[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    p[k] = getPosition(triangle[k]);
+                    moved[k] = triangle[k] == collapse.from ? getPosition(collapse.to) : p[k];
+                }
+
+                double before[3], after[3];
+                getNormal(p[0], p[1], p[2], before);
+                getNormal(moved[0], moved[1], moved[2], after);
+                double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                double beforeLength = std::sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+                double afterLength = std::sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+                if (beforeLength > 0.0 && dot <= MIN_NORMAL_COS * beforeLength * afterLength)
+                    flips = true;
+            }
+            if (flips)
+                continue;
+
+            // neighbors of the moved vertex are left alone for the rest of the
+            // pass, so all checks above see the triangles as they will be
+            for (unsigned int t = offsets[collapse.from]; t < offsets[collapse.from + 1]; t++)
+            {
+                const unsigned int* triangle = &indices[adjacency[t] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                    trianglesRemoved++;
+                for (int k = 0; k < 3; k++)
+                    touched[triangle[k]] = true;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[group[collapse.to]] += quadrics[group[collapse.from]];
+            maxError = std::max(maxError, collapse.cost);
+        }
+
+        if (trianglesRemoved == 0)
+            break;
+
+        // apply the collapses and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indexCount = write;
+    }
+
+    if (resultError != nullptr)
+        *resultError = (Scalar)maxError;
+    return indexCount;
+}
+
+};
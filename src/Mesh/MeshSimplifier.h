@@ -0,0 +1,70 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for MeshSimplifier class
+ *
+ * @file MeshSimplifier.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_MESH_SIMPLIFIER_H
+#define MAGIC3D_MESH_SIMPLIFIER_H
+
+#include "../Math/MathTypes.h"
+
+#include <cstddef>
+
+namespace Magic3D
+{
+
+/** Reduces the triangle count of a mesh by collapsing edges in order of
+ * their quadric error (Garland and Heckbert). Works on plain index lists,
+ * three indices per triangle, so it needs no gpu.
+ *
+ * Collapses only move a vertex onto one of its neighbors, so no new vertices
+ * are made and all attributes of the remaining vertices stay valid. Vertices
+ * that share a position with another vertex, which after welding means they
+ * are on an attribute seam, and vertices on an open border are never moved,
+ * so seams and outlines are kept intact.
+ */
+class MeshSimplifier
+{
+public:
+    /** Simplify a triangle list in place
+     * @param indices           triangle list, the remaining triangles are
+     *                          written to the front of it
+     * @param indexCount        number of indices, a multiple of 3
+     * @param positions         vertex positions, at least 3 components each
+     * @param positionStride    scalars between consecutive positions
+     * @param vertexCount       number of vertices
+     * @param targetIndexCount  number of indices to stop at, the result can
+     *                          stay above it when no more edges can be
+     *                          collapsed without flipping triangles or
+     *                          moving seams
+     * @param resultError       if given, set to the largest quadric error of
+     *                          any collapse made, in squared distance
+     * @return the number of indices left
+     */
+    static size_t simplify(unsigned int* indices, size_t indexCount,
+        const Scalar* positions, unsigned int positionStride, unsigned int vertexCount,
+        size_t targetIndexCount, Scalar* resultError = nullptr);
+};
+
+};
+
+#endif
@@ -0,0 +1,437 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Mesh\NormalGenerator.h>
+#include <Util\RadixSort.h>
+#include <Util\simd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+namespace Magic3D
+{
+
+static const unsigned int POSITION_SIZE = 4;
+static const unsigned int TEX_COORD_SIZE = 2;
+
+// faces or vertices per chunk handed to a thread
+static const size_t GRAIN_SIZE = 2048;
+
+/* Both face passes evaluate the same expressions in the same order, one
+ * rounding per operation, so they give identical results:
+ *   normal  = (b - a) x (c - a)
+ *   tangent = ((b - a) * tCA.v - (c - a) * tBA.v) / area
+ */
+static void calculateFaceVectorsScalar(const unsigned int* indices, size_t faceBegin,
+    size_t faceEnd, const Scalar* positions, const Scalar* texCoords,
+    Scalar* faceNormals, Scalar* faceTangents)
+{
+    for (size_t f = faceBegin; f < faceEnd; f++)
+    {
+        const Scalar* a = &positions[indices[f * 3] * POSITION_SIZE];
+        const Scalar* b = &positions[indices[f * 3 + 1] * POSITION_SIZE];
+        const Scalar* c = &positions[indices[f * 3 + 2] * POSITION_SIZE];
+
+        Scalar bax = b[0] - a[0], bay = b[1] - a[1], baz = b[2] - a[2];
+        Scalar cax = c[0] - a[0], cay = c[1] - a[1], caz = c[2] - a[2];
+
+        Scalar* normal = &faceNormals[f * 3];
+        normal[0] = bay * caz - cay * baz;
+        normal[1] = cax * baz - bax * caz;
+        normal[2] = bax * cay - cax * bay;
+
+        if (faceTangents == nullptr)
+            continue;
+
+        Scalar* tangent = &faceTangents[f * 3];
+        tangent[0] = tangent[1] = tangent[2] = 0.0f;
+        if (texCoords == nullptr)
+            continue;
+
+        const Scalar* ta = &texCoords[indices[f * 3] * TEX_COORD_SIZE];
+        const Scalar* tb = &texCoords[indices[f * 3 + 1] * TEX_COORD_SIZE];
+        const Scalar* tc = &texCoords[indices[f * 3 + 2] * TEX_COORD_SIZE];
+        Scalar tbau = tb[0] - ta[0], tbav = tb[1] - ta[1];
+        Scalar tcau = tc[0] - ta[0], tcav = tc[1] - ta[1];
+
+        Scalar area = tbau * tcav - tbav * tcau;
+        if (area == 0.0f)
+            continue;
+
+        Scalar delta = 1.0f / area;
+        tangent[0] = delta * (bax * tcav - cax * tbav);
+        tangent[1] = delta * (bay * tcav - cay * tbav);
+        tangent[2] = delta * (baz * tcav - caz * tbav);
+    }
+}
+
+#ifdef MAGIC3D_SSE2
+
+/// load one component of a stream for 4 consecutive faces' corner
+static inline __m128 gather(const float* stream, unsigned int size,
+    const unsigned int* indices, size_t face, int corner, int component)
+{
+    return _mm_setr_ps(
+        stream[indices[(face + 0) * 3 + corner] * size + component],
+        stream[indices[(face + 1) * 3 + corner] * size + component],
+        stream[indices[(face + 2) * 3 + corner] * size + component],
+        stream[indices[(face + 3) * 3 + corner] * size + component]
+    );
+}
+
+/// store 3 component vectors of 4 consecutive faces
+static inline void scatter(float* out, size_t face, __m128 x, __m128 y, __m128 z)
+{
+    float xs[4], ys[4], zs[4];
+    _mm_storeu_ps(xs, x);
+    _mm_storeu_ps(ys, y);
+    _mm_storeu_ps(zs, z);
+    for (int i = 0; i < 4; i++)
+    {
+        out[(face + i) * 3 + 0] = xs[i];
+        out[(face + i) * 3 + 1] = ys[i];
+        out[(face + i) * 3 + 2] = zs[i];
+    }
+}
+
+/// simd face pass, 4 faces at a time, returns the first face not calculated
+static inline size_t calculateFaceVectorsSse(const unsigned int* indices, size_t faceBegin,
+    size_t faceEnd, const float* positions, const float* texCoords,
+    float* faceNormals, float* faceTangents)
+{
+    size_t f = faceBegin;
+    for (; f + 4 <= faceEnd; f += 4)
+    {
+        __m128 ax = gather(positions, POSITION_SIZE, indices, f, 0, 0);
+        __m128 ay = gather(positions, POSITION_SIZE, indices, f, 0, 1);
+        __m128 az = gather(positions, POSITION_SIZE, indices, f, 0, 2);
+
+        __m128 bax = _mm_sub_ps(gather(positions, POSITION_SIZE, indices, f, 1, 0), ax);
+        __m128 bay = _mm_sub_ps(gather(positions, POSITION_SIZE, indices, f, 1, 1), ay);
+        __m128 baz = _mm_sub_ps(gather(positions, POSITION_SIZE, indices, f, 1, 2), az);
+        __m128 cax = _mm_sub_ps(gather(positions, POSITION_SIZE, indices, f, 2, 0), ax);
+        __m128 cay = _mm_sub_ps(gather(positions, POSITION_SIZE, indices, f, 2, 1), ay);
+        __m128 caz = _mm_sub_ps(gather(positions, POSITION_SIZE, indices, f, 2, 2), az);
+
+        scatter(faceNormals, f,
+            _mm_sub_ps(_mm_mul_ps(bay, caz), _mm_mul_ps(cay, baz)),
+            _mm_sub_ps(_mm_mul_ps(cax, baz), _mm_mul_ps(bax, caz)),
+            _mm_sub_ps(_mm_mul_ps(bax, cay), _mm_mul_ps(cax, bay)));
+
+        if (faceTangents == nullptr)
+            continue;
+
+        __m128 zero = _mm_setzero_ps();
+        if (texCoords == nullptr)
+        {
+            scatter(faceTangents, f, zero, zero, zero);
+            continue;
+        }
+
+        __m128 tau = gather(texCoords, TEX_COORD_SIZE, indices, f, 0, 0);
+        __m128 tav = gather(texCoords, TEX_COORD_SIZE, indices, f, 0, 1);
+        __m128 tbau = _mm_sub_ps(gather(texCoords, TEX_COORD_SIZE, indices, f, 1, 0), tau);
+        __m128 tbav = _mm_sub_ps(gather(texCoords, TEX_COORD_SIZE, indices, f, 1, 1), tav);
+        __m128 tcau = _mm_sub_ps(gather(texCoords, TEX_COORD_SIZE, indices, f, 2, 0), tau);
+        __m128 tcav = _mm_sub_ps(gather(texCoords, TEX_COORD_SIZE, indices, f, 2, 1), tav);
+
+        __m128 area = _mm_sub_ps(_mm_mul_ps(tbau, tcav), _mm_mul_ps(tbav, tcau));
+        __m128 valid = _mm_cmpneq_ps(area, zero);
+        __m128 delta = _mm_div_ps(_mm_set1_ps(1.0f), area);
+
+        scatter(faceTangents, f,
+            _mm_and_ps(valid, _mm_mul_ps(delta, _mm_sub_ps(_mm_mul_ps(bax, tcav), _mm_mul_ps(cax, tbav)))),
+            _mm_and_ps(valid, _mm_mul_ps(delta, _mm_sub_ps(_mm_mul_ps(bay, tcav), _mm_mul_ps(cay, tbav)))),
+            _mm_and_ps(valid, _mm_mul_ps(delta, _mm_sub_ps(_mm_mul_ps(baz, tcav), _mm_mul_ps(caz, tbav)))));
+    }
+    return f;
+}
+
+/// double precision builds have no simd pass, all faces are left to the scalar one
+static inline size_t calculateFaceVectorsSse(const unsigned int*, size_t faceBegin,
+    size_t, const double*, const double*, double*, double*)
+{
+    return faceBegin;
+}
+
+#endif
+
+/// sum and normalize the face vectors around each vertex in [begin, end)
+static void accumulate(const NormalGenerator::Adjacency& adjacency, size_t begin, size_t end,
+    const Scalar* faceVectors, Scalar* out)
+{
+    for (size_t v = begin; v < end; v++)
+    {
+        Scalar x = 0.0f, y = 0.0f, z = 0.0f;
+        for (unsigned int i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; i++)
+        {
+            const Scalar* vector = &faceVectors[adjacency.faces[i] * 3];
+            x += vector[0];
+            y += vector[1];
+            z += vector[2];
+        }
+
+        Scalar length = std::sqrt(x * x + y * y + z * z);
+        Scalar scale = length > 0.0f ? 1.0f / length : 0.0f;
+        out[v * 3 + 0] = x * scale;
+        out[v * 3 + 1] = y * scale;
+        out[v * 3 + 2] = z * scale;
+    }
+}
+
+/// grid point of a position, rounded to the nearest cell
+struct GridPoint
+{
+    int64_t coords[4];
+
+    inline bool operator==(const GridPoint& point) const
+    {
+        return coords[0] == point.coords[0] && coords[1] == point.coords[1] &&
+            coords[2] == point.coords[2] && coords[3] == point.coords[3];
+    }
+
+    inline bool operator<(const GridPoint& point) const
+    {
+        return std::lexicographical_compare(coords, coords + 4, point.coords, point.coords + 4);
+    }
+};
+
+static inline GridPoint getGridPoint(const Scalar* position, double inverseCellSize)
+{
+    GridPoint point;
+    for (int c = 0; c < 4; c++)
+        point.coords[c] = (int64_t)std::floor(position[c] * inverseCellSize + 0.5);
+    return point;
+}
+
+/// mix all bits of the grid point into the key, so symmetric points do not collide
+static inline uint64_t hashGridPoint(const GridPoint& point)
+{
+    uint64_t hash = 0;
+    for (int c = 0; c < 4; c++)
+    {
+        hash ^= (uint64_t)point.coords[c] + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+
+        // murmur3 finalizer
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB93FE1A85EC5ULL;
+        hash ^= hash >> 33;
+    }
+    return hash;
+}
+
+bool NormalGenerator::hasSimd()
+{
+#ifdef MAGIC3D_SSE2
+    // the simd pass only handles floats
+    return std::is_same<Scalar, float>::value;
+#else
+    return false;
+#endif
+}
+
+void NormalGenerator::buildAdjacency(const unsigned int* indices, size_t faceCount,
+    unsigned int vertexCount, Adjacency& adjacency)
+{
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    for (size_t i = 0; i < faceCount * 3; i++)
+        adjacency.offsets[indices[i] + 1]++;
+    for (unsigned int v = 0; v < vertexCount; v++)
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+    // filling in face order keeps each vertex's faces ascending
+    adjacency.faces.resize(faceCount * 3);
+    std::vector<unsigned int> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < faceCount * 3; i++)
+        adjacency.faces[fill[indices[i]]++] = (unsigned int)(i / 3);
+}
+
+void NormalGenerator::calculateFaceVectors(const unsigned int* indices, size_t faceBegin,
+    size_t faceEnd, const Scalar* positions, const Scalar* texCoords,
+    Scalar* faceNormals, Scalar* faceTangents, bool useSimd)
+{
+#ifdef MAGIC3D_SSE2
+    if (useSimd && hasSimd())
+    {
+        faceBegin = calculateFaceVectorsSse(indices, faceBegin, faceEnd, positions, texCoords,
+            faceNormals, faceTangents);
+    }
+#endif
+    calculateFaceVectorsScalar(indices, faceBegin, faceEnd, positions, texCoords,
+        faceNormals, faceTangents);
+}
+
+void NormalGenerator::calculate(const unsigned int* indices, size_t faceCount,
+    unsigned int vertexCount, const Adjacency& adjacency,
+    const Scalar* positions, const Scalar* texCoords,
+    Scalar* normals, Scalar* tangents, ThreadPool& pool)
+{
+    if (normals == nullptr && tangents == nullptr)
+        return;
+
+    std::vector<Scalar> faceNormals(faceCount * 3);
+    std::vector<Scalar> faceTangents(tangents != nullptr ? faceCount * 3 : 0);
+    Scalar* faceNormalData = faceNormals.empty() ? nullptr : &faceNormals[0];
+    Scalar* faceTangentData = faceTangents.empty() ? nullptr : &faceTangents[0];
+
+    // split on groups of 4 faces so each face takes the same path on any
+    // number of threads
+    pool.parallelFor(0, (faceCount + 3) / 4, GRAIN_SIZE / 4, [&](size_t begin, size_t end) {
+        calculateFaceVectors(indices, begin * 4, std::min(end * 4, faceCount), positions,
+            texCoords, faceNormalData, faceTangentData);
+    });
+
+    pool.parallelFor(0, vertexCount, GRAIN_SIZE, [&](size_t begin, size_t end) {
+        if (normals != nullptr)
+            accumulate(adjacency, begin, end, faceNormalData, normals);
+        if (tangents != nullptr)
+            accumulate(adjacency, begin, end, faceTangentData, tangents);
+    });
+}
+
+void NormalGenerator::groupByPosition(const Scalar* positions, unsigned int vertexCount,
+    Scalar cellSize, std::vector<unsigned int>& order, std::vector<unsigned int>& groupStarts)
+{
+    struct Item
+    {
+        uint64_t key;
+        unsigned int index;
+    };
+
+    const double inverseCellSize = 1.0 / cellSize;
+    std::vector<Item> items(vertexCount), scratch;
+    for (unsigned int v = 0; v < vertexCount; v++)
+    {
+        items[v].key = hashGridPoint(getGridPoint(&positions[v * POSITION_SIZE], inverseCellSize));
+        items[v].index = v;
+    }
+    radixSort(items, scratch, [](const Item& item) { return item.key; });
+
+    order.resize(vertexCount);
+    groupStarts.clear();
+    for (size_t begin = 0; begin < items.size(); )
+    {
+        size_t end = begin + 1;
+        while (end < items.size() && items[end].key == items[begin].key)
+            end++;
+
+        for (size_t i = begin; i < end; i++)
+            order[i] = items[i].index;
+
+        // a run of equal keys is almost always one grid point, but different
+        // points can still collide, so sort those apart
+        GridPoint first = getGridPoint(&positions[order[begin] * POSITION_SIZE], inverseCellSize);
+        bool collided = false;
+        for (size_t i = begin + 1; i < end && !collided; i++)
+            collided = !(getGridPoint(&positions[order[i] * POSITION_SIZE], inverseCellSize) == first);
+
+        if (!collided)
+            groupStarts.push_back((unsigned int)begin);
+        else
+        {
+            auto byPoint = [&](unsigned int a, unsigned int b) {
+                return getGridPoint(&positions[a * POSITION_SIZE], inverseCellSize) <
+                    getGridPoint(&positions[b * POSITION_SIZE], inverseCellSize);
+            };
+            std::stable_sort(order.begin() + begin, order.begin() + end, byPoint);
+            for (size_t i = begin; i < end; i++)
+            {
+                if (i == begin || byPoint(order[i - 1], order[i]))
+                    groupStarts.push_back((unsigned int)i);
+            }
+        }
+        begin = end;
+    }
+    groupStarts.push_back(vertexCount);
+}
+
+void NormalGenerator::smoothGroups(const std::vector<unsigned int>& order,
+    const std::vector<unsigned int>& groupStarts, Scalar* normals, Scalar* tangents,
+    Scalar thresholdAngle, ThreadPool& pool)
+{
+    if (groupStarts.size() < 2)
+        return;
+
+    // normals within the threshold angle have at least this cosine between them
+    const Scalar minCos = std::cos(thresholdAngle);
+
+    pool.parallelFor(0, groupStarts.size() - 1, GRAIN_SIZE, [&](size_t first, size_t last) {
+        // scratch for one group at a time, reused across the chunk
+        std::vector<Scalar> units, merged;
+
+        for (size_t g = first; g < last; g++)
+        {
+            unsigned int begin = groupStarts[g], count = groupStarts[g + 1] - begin;
+            if (count < 2)
+                continue;
+
+            units.resize(count * 3);
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const Scalar* normal = &normals[order[begin + i] * 3];
+                Scalar length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                    normal[2] * normal[2]);
+                Scalar scale = length > 0.0f ? 1.0f / length : 0.0f;
+                for (int c = 0; c < 3; c++)
+                    units[i * 3 + c] = normal[c] * scale;
+            }
+
+            // all sums are made from the original vectors before any are written
+            merged.assign(count * 6, 0.0f);
+            for (unsigned int i = 0; i < count; i++)
+            {
+                const Scalar* unit = &units[i * 3];
+                for (unsigned int j = 0; j < count; j++)
+                {
+                    const Scalar* other = &units[j * 3];
+                    if (j != i && unit[0] * other[0] + unit[1] * other[1] + unit[2] * other[2] < minCos)
+                        continue;
+
+                    unsigned int v = order[begin + j];
+                    for (int c = 0; c < 3; c++)
+                    {
+                        merged[i * 6 + c] += normals[v * 3 + c];
+                        if (tangents != nullptr)
+                            merged[i * 6 + 3 + c] += tangents[v * 3 + c];
+                    }
+                }
+            }
+
+            for (unsigned int i = 0; i < count; i++)
+            {
+                unsigned int v = order[begin + i];
+                for (int k = 0; k < (tangents != nullptr ? 2 : 1); k++)
+                {
+                    const Scalar* sum = &merged[i * 6 + k * 3];
+                    Scalar* out = k == 0 ? &normals[v * 3] : &tangents[v * 3];
+                    Scalar length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                    Scalar scale = length > 0.0f ? 1.0f / length : 0.0f;
+                    for (int c = 0; c < 3; c++)
+                        out[c] = sum[c] * scale;
+                }
+            }
+        }
+    });
+}
+
+};
@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for NormalGenerator class
+ *
+ * @file NormalGenerator.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_NORMAL_GENERATOR_H
+#define MAGIC3D_NORMAL_GENERATOR_H
+
+#include "../Math/MathTypes.h"
+#include "../Util/ThreadPool.h"
+
+#include <vector>
+#include <cstddef>
+
+namespace Magic3D
+{
+
+/** Calculates smooth vertex normals and tangents directly on attribute
+ * streams, in two data-parallel passes: one vector per face, then a sum of
+ * the vectors of the faces around each vertex.
+ *
+ * Every vertex sums its faces in ascending order no matter how the work is
+ * split, so results are the same bit for bit on any number of threads, and
+ * the simd face pass matches the scalar one exactly.
+ *
+ * It also smooths vectors across vertices that share a location but were
+ * kept apart, like on texture seams, see groupByPosition and smoothGroups.
+ *
+ * Streams are tightly packed: positions have 4 scalars per vertex, texture
+ * coordinates 2, normals and tangents 3.
+ */
+class NormalGenerator
+{
+public:
+    /// faces using each vertex, the faces of vertex v are
+    /// faces[offsets[v]] to faces[offsets[v + 1]], in ascending order
+    struct Adjacency
+    {
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> faces;
+
+        inline bool isBuilt() const
+        {
+            return !this->offsets.empty();
+        }
+
+        inline void clear()
+        {
+            this->offsets.clear();
+            this->faces.clear();
+        }
+    };
+
+    /// whether the face pass can use simd instructions in this build
+    static bool hasSimd();
+
+    /** Build the faces around each vertex
+     * @param indices       triangle list, 3 indices per face
+     * @param faceCount     number of faces
+     * @param vertexCount   number of vertices
+     * @param adjacency     filled with the faces around each vertex
+     */
+    static void buildAdjacency(const unsigned int* indices, size_t faceCount,
+        unsigned int vertexCount, Adjacency& adjacency);
+
+    /** Calculate the area weighted normal of each face and, if texture
+     * coordinates are given, its tangent along the u axis
+     * @param indices       triangle list, 3 indices per face
+     * @param faceBegin     first face to calculate
+     * @param faceEnd       one past the last face to calculate
+     * @param positions     position stream
+     * @param texCoords     texture coordinate stream, or null
+     * @param faceNormals   3 scalars per face, written for the faces calculated
+     * @param faceTangents  3 scalars per face, or null, zero where the
+     *                      texture coordinates of a face are degenerate
+     * @param useSimd       whether to use simd instructions when available
+     */
+    static void calculateFaceVectors(const unsigned int* indices, size_t faceBegin,
+        size_t faceEnd, const Scalar* positions, const Scalar* texCoords,
+        Scalar* faceNormals, Scalar* faceTangents, bool useSimd = true);
+
+    /** Calculate normalized vertex normals and tangents from the faces
+     * around each vertex. Vertices without faces, or whose face vectors
+     * cancel out, get zero vectors.
+     * @param indices       triangle list, 3 indices per face
+     * @param faceCount     number of faces
+     * @param vertexCount   number of vertices
+     * @param adjacency     faces around each vertex, see buildAdjacency
+     * @param positions     position stream
+     * @param texCoords     texture coordinate stream, or null for zero tangents
+     * @param normals       normal stream to write, or null
+     * @param tangents      tangent stream to write, or null
+     * @param pool          threads to split the passes across
+     */
+    static void calculate(const unsigned int* indices, size_t faceCount,
+        unsigned int vertexCount, const Adjacency& adjacency,
+        const Scalar* positions, const Scalar* texCoords,
+        Scalar* normals, Scalar* tangents, ThreadPool& pool);
+
+    /** Sort vertices into groups at the same location. Positions are
+     * rounded to a grid, the grid points hashed to 64-bit keys and the keys
+     * radix sorted, so this runs in linear time.
+     * @param positions     position stream
+     * @param vertexCount   number of vertices
+     * @param cellSize      grid spacing, positions rounding to the same grid
+     *                      point are grouped
+     * @param order         filled with all vertex indices, grouped
+     * @param groupStarts   filled with the start of each group in order,
+     *                      followed by the size of order
+     */
+    static void groupByPosition(const Scalar* positions, unsigned int vertexCount,
+        Scalar cellSize, std::vector<unsigned int>& order,
+        std::vector<unsigned int>& groupStarts);
+
+    /** Smooth normals and tangents across vertices at the same location.
+     * Each vertex gets the normalized sum of the vectors of the vertices in
+     * its group whose normal is within the threshold angle of its own,
+     * itself included.
+     * @param order             vertex indices grouped, see groupByPosition
+     * @param groupStarts       start of each group, see groupByPosition
+     * @param normals           normal stream to smooth
+     * @param tangents          tangent stream to smooth, or null
+     * @param thresholdAngle    largest angle between normals to merge, in radians
+     * @param pool              threads to split the groups across
+     */
+    static void smoothGroups(const std::vector<unsigned int>& order,
+        const std::vector<unsigned int>& groupStarts, Scalar* normals, Scalar* tangents,
+        Scalar thresholdAngle, ThreadPool& pool);
+};
+
+};
+
+#endif
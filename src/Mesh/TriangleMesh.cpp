@@ -1,16 +1,306 @@
 #include <Mesh\TriangleMesh.h>
+#include <Mesh\MeshSimplifier.h>
+#include <Geometry\Sphere.h>
+#include <Geometry\Box.h>
+
+#include <unordered_map>
 
 namespace Magic3D
 {
 
 void TriangleMesh::positionTransform(const Matrix4& matrix)
 {
+    this->beginEdit();
     for (unsigned int i = 0; i < this->vertexCount; i++)
     {
         auto vert = this->getVertex<PositionAttr>(i);
         vert.position(Vector3(vert.position()).transform(matrix));
         this->setVertex(i, vert);
     }
+    this->endEdit();
+}
+
+void TriangleMesh::calculateNormalsAndTangents(ThreadPool& pool)
+{
+    static_assert(sizeof(Face) == 3 * sizeof(unsigned int), "faces must be tightly packed indices");
+    bool hasNormals = this->hasType(GpuProgram::AttributeType::NORMAL);
+    bool hasTangents = this->hasType(GpuProgram::AttributeType::TANGENT);
+    if (!this->hasType(GpuProgram::AttributeType::VERTEX) || (!hasNormals && !hasTangents) ||
+        this->vertexCount == 0)
+        return;
+    this->detachStorage();
+
+    const unsigned int* indices = this->faces.empty() ? nullptr : this->faces[0].indices;
+    if (!this->faceAdjacency.isBuilt())
+    {
+        NormalGenerator::buildAdjacency(indices, this->faces.size(), this->vertexCount,
+            this->faceAdjacency);
+    }
+
+    NormalGenerator::calculate(indices, this->faces.size(), this->vertexCount,
+        this->faceAdjacency,
+        &this->attributes[GpuProgram::AttributeType::VERTEX][0],
+        this->hasType(GpuProgram::AttributeType::TEX_COORD_0) ?
+            &this->attributes[GpuProgram::AttributeType::TEX_COORD_0][0] : nullptr,
+        hasNormals ? &this->attributes[GpuProgram::AttributeType::NORMAL][0] : nullptr,
+        hasTangents ? &this->attributes[GpuProgram::AttributeType::TANGENT][0] : nullptr,
+        pool);
+
+    if (hasNormals)
+        this->markDirty(GpuProgram::AttributeType::NORMAL, 0, this->vertexCount);
+    if (hasTangents)
+        this->markDirty(GpuProgram::AttributeType::TANGENT, 0, this->vertexCount);
+}
+
+std::vector<std::vector<unsigned int>> TriangleMesh::calculateDuplicateVertices(
+    unsigned int precision) const
+{
+    std::vector<std::vector<unsigned int>> duplicateVertexIndices;
+    if (!this->hasType(GpuProgram::AttributeType::VERTEX) || this->vertexCount == 0)
+        return duplicateVertexIndices;
+
+    std::vector<unsigned int> order, groupStarts;
+    NormalGenerator::groupByPosition(this->getStream(GpuProgram::AttributeType::VERTEX),
+        this->vertexCount, Scalar(std::pow(10.0, -int(precision))), order, groupStarts);
+
+    for (size_t g = 0; g + 1 < groupStarts.size(); g++)
+    {
+        if (groupStarts[g + 1] - groupStarts[g] > 1)
+        {
+            duplicateVertexIndices.push_back(std::vector<unsigned int>(
+                order.begin() + groupStarts[g], order.begin() + groupStarts[g + 1]));
+        }
+    }
+    return duplicateVertexIndices;
+}
+
+void TriangleMesh::mergeNormalsAndTangents(Scalar thresholdAngle, unsigned int precision,
+    ThreadPool& pool)
+{
+    if (!this->hasType(GpuProgram::AttributeType::VERTEX) ||
+        !this->hasType(GpuProgram::AttributeType::NORMAL) || this->vertexCount == 0)
+        return;
+    this->detachStorage();
+
+    std::vector<unsigned int> order, groupStarts;
+    NormalGenerator::groupByPosition(&this->attributes[GpuProgram::AttributeType::VERTEX][0],
+        this->vertexCount, Scalar(std::pow(10.0, -int(precision))), order, groupStarts);
+
+    // nothing shares a location, so nothing to merge
+    if (groupStarts.size() == (size_t)this->vertexCount + 1)
+        return;
+
+    bool hasTangents = this->hasType(GpuProgram::AttributeType::TANGENT);
+    NormalGenerator::smoothGroups(order, groupStarts,
+        &this->attributes[GpuProgram::AttributeType::NORMAL][0],
+        hasTangents ? &this->attributes[GpuProgram::AttributeType::TANGENT][0] : nullptr,
+        thresholdAngle * Scalar(M_PI / 180), pool);
+
+    this->markDirty(GpuProgram::AttributeType::NORMAL, 0, this->vertexCount);
+    if (hasTangents)
+        this->markDirty(GpuProgram::AttributeType::TANGENT, 0, this->vertexCount);
+}
+
+unsigned int TriangleMesh::weld(const WeldOptions& options)
+{
+    const Scalar epsilon = options.epsilon;
+    const Scalar cellSize = std::max(epsilon, Scalar(0.000001f));
+    const bool hasPosition = this->hasType(GpuProgram::AttributeType::VERTEX);
+    this->detachStorage();
+
+    auto getCell = [&](unsigned int vertex, int64_t cell[3]) {
+        for (int c = 0; c < 3; c++)
+        {
+            cell[c] = !hasPosition ? 0 : (int64_t)std::floor(
+                this->getAttributeDataUnchecked(vertex, GpuProgram::AttributeType::VERTEX)[c] / cellSize);
+        }
+    };
+    auto hashCell = [](int64_t x, int64_t y, int64_t z) -> uint64_t {
+        return ((uint64_t)x * 73856093ULL) ^ ((uint64_t)y * 19349663ULL) ^ ((uint64_t)z * 83492791ULL);
+    };
+    auto isEqual = [&](unsigned int a, unsigned int b) -> bool {
+        for (int t = 0; t < GpuProgram::MAX_ATTRIBUTE_TYPES; t++)
+        {
+            if (!this->hasType((GpuProgram::AttributeType)t))
+                continue;
+            const Scalar* dataA = this->getAttributeDataUnchecked(a, (GpuProgram::AttributeType)t);
+            const Scalar* dataB = this->getAttributeDataUnchecked(b, (GpuProgram::AttributeType)t);
+            for (int c = 0; c < GpuProgram::attributeTypeCompCount[t]; c++)
+            {
+                if (std::abs(dataA[c] - dataB[c]) > epsilon)
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    // map every vertex to the first equal vertex, equal vertices can only be
+    // in the same or a neighboring cell as cells are at least epsilon wide
+    std::unordered_multimap<uint64_t, unsigned int> grid;
+    grid.reserve(this->vertexCount);
+    std::vector<unsigned int> remap(this->vertexCount);
+    std::vector<unsigned int> kept;
+    kept.reserve(this->vertexCount);
+
+    for (unsigned int v = 0; v < this->vertexCount; v++)
+    {
+        int64_t cell[3];
+        getCell(v, cell);
+
+        bool found = false;
+        for (int dx = -1; dx <= 1 && !found; dx++)
+        for (int dy = -1; dy <= 1 && !found; dy++)
+        for (int dz = -1; dz <= 1 && !found; dz++)
+        {
+            auto range = grid.equal_range(hashCell(cell[0] + dx, cell[1] + dy, cell[2] + dz));
+            for (auto it = range.first; it != range.second; it++)
+            {
+                if (isEqual(kept[it->second], v))
+                {
+                    remap[v] = it->second;
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        if (!found)
+        {
+            remap[v] = (unsigned int)kept.size();
+            grid.insert(std::make_pair(hashCell(cell[0], cell[1], cell[2]), remap[v]));
+            kept.push_back(v);
+        }
+    }
+
+    unsigned int removed = this->vertexCount - (unsigned int)kept.size();
+    if (removed == 0)
+        return 0;
+
+    // compact attribute streams
+    for (int t = 0; t < GpuProgram::MAX_ATTRIBUTE_TYPES; t++)
+    {
+        if (!this->hasType((GpuProgram::AttributeType)t))
+            continue;
+        unsigned int componentCount = GpuProgram::attributeTypeCompCount[t];
+        std::vector<Scalar> welded(kept.size() * componentCount);
+        for (size_t v = 0; v < kept.size(); v++)
+        {
+            memcpy(&welded[v * componentCount], &this->attributes[t][kept[v] * componentCount],
+                componentCount * sizeof(Scalar));
+        }
+        this->attributes[t].swap(welded);
+    }
+
+    for (Face& face : this->faces)
+    {
+        for (int i = 0; i < 3; i++)
+            face.indices[i] = remap[face.indices[i]];
+    }
+
+    this->vertexCount = (unsigned int)kept.size();
+    this->normalsMesh = nullptr;
+    this->invalidateCollision();
+
+    // sizes changed, and possibly the index type
+    this->resetGpuMemory();
+    return removed;
+}
+
+void TriangleMesh::optimizeVertexOrder(const OptimizeOptions& options)
+{
+    static_assert(sizeof(Face) == 3 * sizeof(unsigned int), "faces must be tightly packed indices");
+    if (this->faces.empty())
+        return;
+    this->detachStorage();
+
+    unsigned int* indices = this->faces[0].indices;
+    size_t indexCount = this->faces.size() * 3;
+
+    TriangleMeshOptimizer::optimizeVertexCache(indices, indexCount, this->vertexCount);
+
+    if (options.overdraw && this->hasType(GpuProgram::AttributeType::VERTEX))
+    {
+        TriangleMeshOptimizer::optimizeOverdraw(indices, indexCount,
+            &this->attributes[GpuProgram::AttributeType::VERTEX][0],
+            GpuProgram::attributeTypeCompCount[GpuProgram::AttributeType::VERTEX],
+            this->vertexCount, options.overdrawThreshold);
+    }
+
+    std::vector<unsigned int> remap =
+        TriangleMeshOptimizer::optimizeVertexFetch(indices, indexCount, this->vertexCount);
+
+    for (int t = 0; t < GpuProgram::MAX_ATTRIBUTE_TYPES; t++)
+    {
+        if (!this->hasType((GpuProgram::AttributeType)t))
+            continue;
+        unsigned int componentCount = GpuProgram::attributeTypeCompCount[t];
+        std::vector<Scalar> reordered(this->attributes[t].size());
+        for (unsigned int v = 0; v < this->vertexCount; v++)
+        {
+            memcpy(&reordered[remap[v] * componentCount], &this->attributes[t][v * componentCount],
+                componentCount * sizeof(Scalar));
+        }
+        this->attributes[t].swap(reordered);
+    }
+
+    this->normalsMesh = nullptr;
+    this->invalidateCollision();
+    this->markAllDirty();
+}
+
+std::shared_ptr<TriangleMesh> TriangleMesh::simplify(unsigned int targetFaceCount,
+    Scalar* resultError) const
+{
+    MAGIC_THROW(!this->hasType(GpuProgram::AttributeType::VERTEX),
+        "Tried to simplify a mesh without positions.");
+
+    std::vector<unsigned int> indices(this->faces.size() * 3);
+    if (!this->faces.empty())
+        memcpy(&indices[0], this->faces[0].indices, indices.size() * sizeof(unsigned int));
+
+    size_t indexCount = MeshSimplifier::simplify(
+        indices.empty() ? nullptr : &indices[0], indices.size(),
+        this->getStream(GpuProgram::AttributeType::VERTEX),
+        GpuProgram::attributeTypeCompCount[GpuProgram::AttributeType::VERTEX],
+        this->vertexCount, (size_t)targetFaceCount * 3, resultError);
+    indices.resize(indexCount);
+
+    // keep only the vertices still used, in the order faces use them
+    std::vector<unsigned int> remap = TriangleMeshOptimizer::optimizeVertexFetch(
+        indices.empty() ? nullptr : &indices[0], indices.size(), this->vertexCount);
+    unsigned int usedCount = 0;
+    for (unsigned int index : indices)
+        usedCount = std::max(usedCount, index + 1);
+
+    std::set<GpuProgram::AttributeType> types;
+    for (int t = 0; t < GpuProgram::MAX_ATTRIBUTE_TYPES; t++)
+    {
+        if (this->hasType((GpuProgram::AttributeType)t))
+            types.insert((GpuProgram::AttributeType)t);
+    }
+    auto mesh = std::make_shared<TriangleMesh>(usedCount, (unsigned int)(indexCount / 3),
+        types, this->layout);
+
+    for (int t = 0; t < GpuProgram::MAX_ATTRIBUTE_TYPES; t++)
+    {
+        if (!this->hasType((GpuProgram::AttributeType)t))
+            continue;
+        unsigned int componentCount = GpuProgram::attributeTypeCompCount[t];
+        for (unsigned int v = 0; v < this->vertexCount; v++)
+        {
+            if (remap[v] >= usedCount)
+                continue;
+            memcpy(&mesh->attributes[t][remap[v] * componentCount],
+                this->getAttributeDataUnchecked(v, (GpuProgram::AttributeType)t),
+                componentCount * sizeof(Scalar));
+        }
+    }
+    if (!indices.empty())
+        memcpy(mesh->faces[0].indices, &indices[0], indices.size() * sizeof(unsigned int));
+
+    // collapses leave the face order poor for the vertex cache
+    mesh->optimizeVertexOrder();
+    return mesh;
 }
 
 const CollisionShape& TriangleMesh::getCollisionShape() const
@@ -44,4 +334,27 @@ const TriangleMesh& TriangleMesh::getTriangleMesh() const
     return *this;
 }
 
+void TriangleMesh::setBoundingVolumes(const Vector3& center, Scalar radius,
+    const Vector3& boxCenter, Scalar boxSize)
+{
+    this->boundingSphere = std::make_shared<Sphere>(radius);
+    this->boundingSphere->translate(center);
+    this->aabb = std::make_shared<Box>(boxSize, boxSize, boxSize);
+    this->aabb->translate(boxCenter);
+}
+
+const Sphere& TriangleMesh::getBoundingSphere() const
+{
+    if (this->boundingSphere != nullptr)
+        return *this->boundingSphere;
+    return Geometry::getBoundingSphere();
+}
+
+const Box& TriangleMesh::getAABB() const
+{
+    if (this->aabb != nullptr)
+        return *this->aabb;
+    return Geometry::getAABB();
+}
+
 };
\ No newline at end of file
@@ -7,12 +7,18 @@
 #include <vector>
 #include <set>
 #include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
 
 #include "Math\Math.h"
 #include "Shaders\GpuProgram.h"
 #include <Shapes\Vertex.h>
 #include <Shapes\Triangle.h>
 #include <Geometry\Geometry.h>
+#include <Mesh\TriangleMeshOptimizer.h>
+#include <Mesh\NormalGenerator.h>
+#include <Util\ThreadPool.h>
 #include <CollisionShapes\CollisionShape.h>
 
 namespace Magic3D
@@ -43,129 +49,570 @@ public:
         }
     };
 
+    /// how attributes are laid out on gpu memory
+    enum class VertexLayout
+    {
+        SEPARATE,       // one buffer per attribute, cheapest to partially update
+        INTERLEAVED     // all attributes of a vertex next to each other in one buffer
+    };
+
+    /// location of an attribute on gpu memory
+    struct AttributeLayout
+    {
+        unsigned int offset;    // byte offset of the first vertex in its buffer
+        unsigned int stride;    // bytes between consecutive vertices
+    };
+
+    /// options for weld()
+    struct WeldOptions
+    {
+        /// largest difference in any attribute component for vertices to still be equal
+        Scalar epsilon;
+
+        inline WeldOptions() : epsilon(0.00001f) {}
+    };
+
+    /// options for optimizeVertexOrder()
+    struct OptimizeOptions
+    {
+        /// whether to also reorder clusters of faces to reduce overdraw
+        bool overdraw;
+
+        /// how much vertex cache efficiency the overdraw pass may give up, see
+        /// TriangleMeshOptimizer::optimizeOverdraw
+        Scalar overdrawThreshold;
+
+        inline OptimizeOptions() : overdraw(false), overdrawThreshold(1.05f) {}
+    };
+
 private:
-    // attributes for vertices (on main memory)
-    std::map<GpuProgram::AttributeType, std::vector<Scalar>> attributes;
+    // attributes for vertices (on main memory), indexed by attribute type,
+    // only types in the attribute mask hold data
+    std::vector<Scalar> attributes[GpuProgram::MAX_ATTRIBUTE_TYPES];
+
+    // attributes for vertices owned by shared storage, like a mapped file,
+    // used instead of the vectors above until the mesh is first modified
+    const Scalar* sharedAttributes[GpuProgram::MAX_ATTRIBUTE_TYPES];
+    std::shared_ptr<const void> sharedStorage;
+
+    // attributes for vertices (on gpu memory), null for types not present
+    // or when interleaved
+    mutable std::unique_ptr<Buffer> gpuAttributes[GpuProgram::MAX_ATTRIBUTE_TYPES];
+
+    // all attributes for vertices when interleaved (on gpu memory)
+    mutable std::unique_ptr<Buffer> interleavedBuffer;
 
-    // attributes for vertices (on gpu memory)
-    mutable std::map<GpuProgram::AttributeType, Buffer> gpuAttributes;
-    // vertex array for vertices
-    VertexArray vertexArray;
+    VertexLayout layout;
+    AttributeLayout attributeLayouts[GpuProgram::MAX_ATTRIBUTE_TYPES];
+
+    // bit per attribute type present in this mesh
+    unsigned int attributeMask;
+    // vertex array for vertices, null until first uploaded
+    mutable std::unique_ptr<VertexArray> vertexArray;
 
     std::vector<Face> faces;
 
+    // faces around each vertex, built when first needed after the faces change
+    mutable NormalGenerator::Adjacency faceAdjacency;
+
+    // face indices (on gpu memory), 16-bit when the vertex count allows it
+    mutable std::unique_ptr<Buffer> indexBuffer;
+
     unsigned int vertexCount;
 
+    /// span of modified elements not yet on gpu memory, end is exclusive
+    struct DirtyRange
+    {
+        unsigned int begin;
+        unsigned int end;
+    };
+
+    /// number of ranges kept per list before they are merged early
+    static const unsigned int MAX_DIRTY_RANGES = 64;
+
+    // modified vertices per attribute and modified faces, uploaded on the next sync
+    mutable std::vector<DirtyRange> dirtyAttributes[GpuProgram::MAX_ATTRIBUTE_TYPES];
+    mutable std::vector<DirtyRange> dirtyFaces;
+
     mutable bool outOfSync;
 
+    // nesting depth of beginEdit/endEdit and whether an edit in it changed the mesh
+    unsigned int editDepth;
+    bool editedInScope;
+
     // TODO: replace with indexed version to share memory
     mutable std::shared_ptr<btTriangleIndexVertexArray> collisionMesh;
     mutable std::shared_ptr<CollisionShape> collisionShape;
 
-    inline void markDirty()
+    // bounding volumes set from outside, like from a mesh cache, instead of
+    // being taken from the collision shape
+    std::shared_ptr<Sphere> boundingSphere;
+    std::shared_ptr<Box> aabb;
+
+    /// get the stream of an attribute for reading, wherever it is stored
+    inline const Scalar* getStream(GpuProgram::AttributeType type) const
     {
-        this->outOfSync = true;
+        if (this->sharedAttributes[type] != nullptr)
+            return this->sharedAttributes[type];
+        return this->attributes[type].empty() ? nullptr : &this->attributes[type][0];
+    }
+
+    /// copy attributes out of shared storage, before they are modified
+    inline void detachStorage()
+    {
+        if (this->sharedStorage == nullptr)
+            return;
+
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+        {
+            const Scalar* data = this->sharedAttributes[i];
+            if (data != nullptr)
+                this->attributes[i].assign(data, data + GpuProgram::attributeTypeCompCount[i] * this->vertexCount);
+            this->sharedAttributes[i] = nullptr;
+        }
+        this->sharedStorage = nullptr;
+
+        // the collision mesh points at the old vertex data
         this->collisionMesh = nullptr;
         this->collisionShape = nullptr;
     }
 
-public:
-    inline TriangleMesh(unsigned int vertexCount, unsigned int faceCount,
-        const std::set<GpuProgram::AttributeType>& attributeTypes):
-        vertexCount(vertexCount), faces(faceCount), outOfSync(true)
+    /// sort ranges and merge the ones that overlap or touch
+    static inline void mergeRanges(std::vector<DirtyRange>& ranges)
     {
-        // allocate all space needed for attribute data on main memory and gpu memory
-        for (GpuProgram::AttributeType type : attributeTypes)
+        if (ranges.size() < 2)
+            return;
+
+        std::sort(ranges.begin(), ranges.end(), [](const DirtyRange& a, const DirtyRange& b) {
+            return a.begin < b.begin;
+        });
+
+        size_t last = 0;
+        for (size_t i = 1; i < ranges.size(); i++)
         {
-            unsigned int componentCount = GpuProgram::attributeTypeCompCount[(int)type];
-            unsigned int scalarCount = componentCount * vertexCount;
-            unsigned int dataSize = scalarCount * sizeof(Scalar);
+            if (ranges[i].begin <= ranges[last].end)
+                ranges[last].end = std::max(ranges[last].end, ranges[i].end);
+            else
+                ranges[++last] = ranges[i];
+        }
+        ranges.resize(last + 1);
+    }
 
-            // main memory
-            std::vector<Scalar> list(
-                scalarCount,
-                0.0f // default to 0
-            );
-            attributes.insert(std::make_pair(
-                type, std::move(list)
-            ));
-
-            // gpu memory
-            Buffer buffer;
-            buffer.allocate(
-                dataSize,
+    static inline void addRange(std::vector<DirtyRange>& ranges, unsigned int begin, unsigned int end)
+    {
+        // extending the last range keeps sequential edits to a single range
+        if (!ranges.empty() && begin <= ranges.back().end && end >= ranges.back().begin)
+        {
+            ranges.back().begin = std::min(ranges.back().begin, begin);
+            ranges.back().end = std::max(ranges.back().end, end);
+            return;
+        }
+
+        DirtyRange range = { begin, end };
+        ranges.push_back(range);
+
+        // scattered edits, merge what we have and fall back to one span if still too many
+        if (ranges.size() > MAX_DIRTY_RANGES)
+        {
+            mergeRanges(ranges);
+            if (ranges.size() > MAX_DIRTY_RANGES)
+            {
+                ranges.front().end = ranges.back().end;
+                ranges.resize(1);
+            }
+        }
+    }
+
+    inline void invalidateCollision()
+    {
+        if (this->editDepth > 0)
+        {
+            this->editedInScope = true;
+            return;
+        }
+        this->collisionMesh = nullptr;
+        this->collisionShape = nullptr;
+        this->boundingSphere = nullptr;
+        this->aabb = nullptr;
+    }
+
+    inline void markDirty(GpuProgram::AttributeType type, unsigned int begin, unsigned int end)
+    {
+        addRange(this->dirtyAttributes[type], begin, end);
+        this->outOfSync = true;
+        this->invalidateCollision();
+    }
+
+    inline void markFacesDirty(unsigned int begin, unsigned int end)
+    {
+        addRange(this->dirtyFaces, begin, end);
+        this->faceAdjacency.clear();
+        this->outOfSync = true;
+        this->invalidateCollision();
+    }
+
+    /// mark all data as needing to be copied to gpu memory
+    inline void markAllDirty()
+    {
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+        {
+            if (this->hasType((GpuProgram::AttributeType)i))
+                this->dirtyAttributes[i].assign(1, DirtyRange{ 0, this->vertexCount });
+        }
+        this->dirtyFaces.assign(1, DirtyRange{ 0, (unsigned int)this->faces.size() });
+        this->faceAdjacency.clear();
+        this->outOfSync = true;
+    }
+
+    /** Drop the gpu memory, so it is allocated again for the current sizes
+     * and layout on the next upload. Nothing is allocated on gpu memory
+     * before that, so meshes can be built on any thread.
+     */
+    inline void resetGpuMemory()
+    {
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+            this->gpuAttributes[i] = nullptr;
+        this->interleavedBuffer = nullptr;
+        this->indexBuffer = nullptr;
+        this->vertexArray = nullptr;
+
+        // work out where each attribute lives
+        unsigned int vertexSize = this->getVertexStride();
+        unsigned int offset = 0;
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+        {
+            unsigned int attributeSize = GpuProgram::attributeTypeCompCount[i] * sizeof(Scalar);
+            this->attributeLayouts[i].offset = 0;
+            this->attributeLayouts[i].stride = attributeSize;
+            if (this->layout == VertexLayout::INTERLEAVED && this->hasType((GpuProgram::AttributeType)i))
+            {
+                this->attributeLayouts[i].offset = offset;
+                this->attributeLayouts[i].stride = vertexSize;
+                offset += attributeSize;
+            }
+        }
+
+        this->markAllDirty();
+    }
+
+    /// allocate all space needed for attribute and face data on gpu memory
+    inline void allocateGpuMemory() const
+    {
+        this->vertexArray.reset(new VertexArray());
+
+        if (this->layout == VertexLayout::INTERLEAVED)
+        {
+            this->interleavedBuffer.reset(new Buffer());
+            this->interleavedBuffer->allocate(
+                this->getVertexStride() * this->vertexCount,
                 nullptr, // no data to start with
                 Buffer::STATIC_DRAW
             );
-            this->vertexArray.setAttributeArray(
-                (int)type,
+        }
+
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+        {
+            if (!this->hasType((GpuProgram::AttributeType)i))
+                continue;
+
+            unsigned int componentCount = GpuProgram::attributeTypeCompCount[i];
+            if (this->layout == VertexLayout::SEPARATE)
+            {
+                this->gpuAttributes[i].reset(new Buffer());
+                this->gpuAttributes[i]->allocate(
+                    componentCount * this->vertexCount * sizeof(Scalar),
+                    nullptr, // no data to start with
+                    Buffer::STATIC_DRAW
+                );
+            }
+
+            this->vertexArray->setAttributeArray(
+                i,
                 componentCount,
                 VertexArray::FLOAT, // TODO: make this dynamic with the type of Scalar
-                buffer
+                this->layout == VertexLayout::INTERLEAVED ? *this->interleavedBuffer : *this->gpuAttributes[i],
+                this->attributeLayouts[i].stride,
+                this->attributeLayouts[i].offset
             );
-            this->gpuAttributes.insert(std::make_pair(
-                type, std::move(buffer)
-            ));
         }
+
+        this->allocateIndexBuffer();
     }
 
-    inline TriangleMesh(const TriangleMesh& mesh) :
-        attributes(mesh.attributes), faces(mesh.faces), vertexCount(mesh.vertexCount),
-        outOfSync(true) 
+    inline unsigned int getIndexSize() const
+    {
+        return this->getIndexType() == VertexArray::UNSIGNED_SHORT ?
+            sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    inline void allocateIndexBuffer() const
+    {
+        this->indexBuffer.reset(new Buffer());
+        this->indexBuffer->allocate(
+            this->faces.size() * 3 * this->getIndexSize(),
+            nullptr, // no data to start with
+            Buffer::STATIC_DRAW
+        );
+        this->vertexArray->setElementArray(*this->indexBuffer);
+    }
+
+    inline void uploadSeparate() const
     {
-        for (auto it : this->attributes)
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
         {
-            unsigned int componentCount = GpuProgram::attributeTypeCompCount[(int)it.first];
-            unsigned int scalarCount = componentCount * vertexCount;
-            unsigned int dataSize = scalarCount * sizeof(Scalar);
-
-            // gpu memory
-            Buffer buffer;
-            buffer.allocate(
-                dataSize,
-                nullptr, // no data to start with
-                Buffer::STATIC_DRAW
-                );
-            this->vertexArray.setAttributeArray(
-                (int)it.first,
-                componentCount,
-                VertexArray::FLOAT, // TODO: make this dynamic with the type of Scalar
-                buffer
+            std::vector<DirtyRange>& ranges = this->dirtyAttributes[i];
+            if (ranges.empty())
+                continue;
+            mergeRanges(ranges);
+
+            unsigned int vertexSize = GpuProgram::attributeTypeCompCount[i] * sizeof(Scalar);
+            const Scalar* data = this->getStream((GpuProgram::AttributeType)i);
+            Buffer& buffer = *this->gpuAttributes[i];
+            for (const DirtyRange& range : ranges)
+            {
+                if (range.begin >= range.end)
+                    continue;
+                buffer.fill(
+                    range.begin * vertexSize,
+                    (range.end - range.begin) * vertexSize,
+                    &data[range.begin * (vertexSize / sizeof(Scalar))]
                 );
-            this->gpuAttributes.insert(std::make_pair(
-                it.first, std::move(buffer)
-                ));
+            }
+            ranges.clear();
+        }
+    }
+
+    inline void uploadInterleaved() const
+    {
+        // whole vertices are written, so all attributes share the dirty ranges
+        std::vector<DirtyRange> ranges;
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+        {
+            ranges.insert(ranges.end(), this->dirtyAttributes[i].begin(),
+                this->dirtyAttributes[i].end());
+            this->dirtyAttributes[i].clear();
+        }
+        mergeRanges(ranges);
+
+        unsigned int vertexScalars = this->getVertexStride() / sizeof(Scalar);
+        std::vector<Scalar> packed;
+        for (const DirtyRange& range : ranges)
+        {
+            if (range.begin >= range.end)
+                continue;
+
+            packed.resize((range.end - range.begin) * vertexScalars);
+            for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+            {
+                if (!this->hasType((GpuProgram::AttributeType)i))
+                    continue;
+
+                unsigned int componentCount = GpuProgram::attributeTypeCompCount[i];
+                const Scalar* src = this->getStream((GpuProgram::AttributeType)i) +
+                    range.begin * componentCount;
+                Scalar* dst = &packed[this->attributeLayouts[i].offset / sizeof(Scalar)];
+                for (unsigned int v = range.begin; v < range.end; v++)
+                {
+                    for (unsigned int c = 0; c < componentCount; c++)
+                        dst[c] = src[c];
+                    src += componentCount;
+                    dst += vertexScalars;
+                }
+            }
+
+            this->interleavedBuffer->fill(
+                range.begin * vertexScalars * sizeof(Scalar),
+                packed.size() * sizeof(Scalar),
+                &packed[0]
+            );
         }
     }
 
+    inline void uploadFaces(const DirtyRange& range) const
+    {
+        if (range.begin >= range.end)
+            return;
+
+        if (this->getIndexType() == VertexArray::UNSIGNED_INT)
+        {
+            this->indexBuffer->fill(
+                range.begin * sizeof(Face),
+                (range.end - range.begin) * sizeof(Face),
+                &this->faces[range.begin]
+            );
+            return;
+        }
+
+        std::vector<uint16_t> shortIndices((range.end - range.begin) * 3);
+        for (unsigned int i = range.begin; i < range.end; i++)
+        {
+            unsigned int j = (i - range.begin) * 3;
+            shortIndices[j + 0] = (uint16_t)this->faces[i].indices[0];
+            shortIndices[j + 1] = (uint16_t)this->faces[i].indices[1];
+            shortIndices[j + 2] = (uint16_t)this->faces[i].indices[2];
+        }
+        this->indexBuffer->fill(
+            range.begin * 3 * sizeof(uint16_t),
+            shortIndices.size() * sizeof(uint16_t),
+            &shortIndices[0]
+        );
+    }
+
+public:
+    inline TriangleMesh(unsigned int vertexCount, unsigned int faceCount,
+        const std::set<GpuProgram::AttributeType>& attributeTypes,
+        VertexLayout layout = VertexLayout::SEPARATE):
+        layout(layout), attributeMask(0), faces(faceCount), vertexCount(vertexCount),
+        outOfSync(true), editDepth(0), editedInScope(false)
+    {
+        // allocate all space needed for attribute data on main memory
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+            this->sharedAttributes[i] = nullptr;
+        for (GpuProgram::AttributeType type : attributeTypes)
+        {
+            this->attributes[type].assign(
+                GpuProgram::attributeTypeCompCount[(int)type] * vertexCount,
+                0.0f // default to 0
+            );
+            this->attributeMask |= 1u << type;
+        }
+
+        this->resetGpuMemory();
+    }
+
+    /** Create a mesh reading its attributes straight from storage owned by
+     * someone else, like a mapped file, without copying them to main memory.
+     * The storage is kept alive until the mesh is first modified, which
+     * copies the attributes out. Faces are copied.
+     * @param vertexCount   number of vertices
+     * @param faceCount     number of faces
+     * @param streams       tightly packed stream per attribute type, null for
+     *                      types not present
+     * @param faces         the faces
+     * @param storage       owner of the streams
+     * @param layout        gpu memory layout
+     */
+    inline TriangleMesh(unsigned int vertexCount, unsigned int faceCount,
+        const Scalar* const streams[GpuProgram::MAX_ATTRIBUTE_TYPES], const Face* faces,
+        std::shared_ptr<const void> storage, VertexLayout layout = VertexLayout::SEPARATE) :
+        sharedStorage(storage), layout(layout), attributeMask(0),
+        faces(faces, faces + faceCount), vertexCount(vertexCount), outOfSync(true), editDepth(0), editedInScope(false)
+    {
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+        {
+            this->sharedAttributes[i] = streams[i];
+            if (streams[i] != nullptr)
+                this->attributeMask |= 1u << i;
+        }
+
+        this->resetGpuMemory();
+    }
+
+    inline TriangleMesh(const TriangleMesh& mesh) :
+        sharedStorage(mesh.sharedStorage), layout(mesh.layout), attributeMask(mesh.attributeMask),
+        faces(mesh.faces), vertexCount(mesh.vertexCount),
+        outOfSync(true), editDepth(0), editedInScope(false)
+    {
+        // shared storage is read only, so the copy can share it as well
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+        {
+            this->attributes[i] = mesh.attributes[i];
+            this->sharedAttributes[i] = mesh.sharedAttributes[i];
+        }
+
+        this->resetGpuMemory();
+    }
+
     inline unsigned int getVertexCount() const
     {
         return this->vertexCount;
     }
 
+    inline VertexLayout getVertexLayout() const
+    {
+        return this->layout;
+    }
+
+    /** Change how attributes are laid out on gpu memory. Interleaved suits
+     * meshes that are not modified after loading, separate suits meshes
+     * that are partially updated often.
+     */
+    inline void setVertexLayout(VertexLayout layout)
+    {
+        if (this->layout == layout)
+            return;
+        this->layout = layout;
+        this->resetGpuMemory();
+    }
+
+    /// get where an attribute is stored on gpu memory
+    inline const AttributeLayout& getAttributeLayout(GpuProgram::AttributeType type) const
+    {
+        return this->attributeLayouts[type];
+    }
+
+    /// get the bytes between consecutive vertices when interleaved
+    inline unsigned int getVertexStride() const
+    {
+        unsigned int stride = 0;
+        for (int i = 0; i < GpuProgram::MAX_ATTRIBUTE_TYPES; i++)
+        {
+            if (this->hasType((GpuProgram::AttributeType)i))
+                stride += GpuProgram::attributeTypeCompCount[i] * sizeof(Scalar);
+        }
+        return stride;
+    }
+
     inline void setAttributeData(unsigned int vertexIndex,
         GpuProgram::AttributeType type, const Scalar* data, unsigned int vertexCount = 1)
     {
-        if ((vertexIndex + vertexCount) > this->vertexCount)
+        if ((vertexIndex + vertexCount) > this->vertexCount || !this->hasType(type))
             throw_MagicException("out of bounds");
 
-        Scalar* hereData = &this->attributes.find(type)->second[
-            vertexIndex*GpuProgram::attributeTypeCompCount[(int)type]];
-
-        memcpy(hereData, data, 
+        memcpy(this->getAttributeDataUnchecked(vertexIndex, type), data,
             GpuProgram::attributeTypeCompCount[(int)type] * sizeof(Scalar) * vertexCount);
 
-        markDirty();
+        markDirty(type, vertexIndex, vertexIndex + vertexCount);
     }
 
     inline const Scalar* getAttributeData(unsigned int vertexIndex,
         GpuProgram::AttributeType type) const
     {
-        if (vertexIndex >= this->vertexCount)
+        if (vertexIndex >= this->vertexCount || !this->hasType(type))
             throw_MagicException("out of bounds");
 
-        return &this->attributes.find(type)->second[
-            vertexIndex*GpuProgram::attributeTypeCompCount[(int)type]];
+        return this->getAttributeDataUnchecked(vertexIndex, type);
+    }
+
+    /** Get attribute data without checking the bounds or whether the
+     * type is present, for use in loops that already ensure both.
+     * Writing through the pointer is not tracked, callers need to mark
+     * the modified vertices with markAttributeDirty().
+     */
+    inline const Scalar* getAttributeDataUnchecked(unsigned int vertexIndex,
+        GpuProgram::AttributeType type) const
+    {
+        return this->getStream(type) + vertexIndex * GpuProgram::attributeTypeCompCount[type];
+    }
+
+    inline Scalar* getAttributeDataUnchecked(unsigned int vertexIndex,
+        GpuProgram::AttributeType type)
+    {
+        this->detachStorage();
+        return &this->attributes[type][vertexIndex * GpuProgram::attributeTypeCompCount[type]];
+    }
+
+    /// whether attributes are still read from shared storage, see the constructor
+    inline bool isUsingSharedStorage() const
+    {
+        return this->sharedStorage != nullptr;
+    }
+
+    /// mark vertices in [begin, end) of an attribute as modified
+    inline void markAttributeDirty(GpuProgram::AttributeType type, unsigned int begin,
+        unsigned int end)
+    {
+        this->markDirty(type, begin, end);
     }
 
     inline void setFaceData(unsigned int faceIndex, const Face* data, unsigned int count)
@@ -179,7 +626,7 @@ public:
             sizeof(Face) * count
         );
 
-        markDirty();
+        markFacesDirty(faceIndex, faceIndex + count);
     }
 
     inline const Face* getFaceData(unsigned int faceIndex) const
@@ -205,30 +652,68 @@ public:
         return this->faces.size();
     }
 
-    inline const VertexArray& getVertexArray() const
+    /// get the type of the indices in the element array of the vertex array
+    inline VertexArray::DataTypes getIndexType() const
     {
-        // copy new data to gpu memory if needed
+        return this->vertexCount < 65536 ? VertexArray::UNSIGNED_SHORT : VertexArray::UNSIGNED_INT;
+    }
+
+    /** Copy the mesh to gpu memory, allocating it the first time. Done by
+     * getVertexArray() as needed, call it ahead of time to control when
+     * the cost is paid. Needs the graphics context.
+     */
+    inline void upload() const
+    {
+        // everything is dirty since the memory was last reset
+        if (this->vertexArray == nullptr)
+            this->allocateGpuMemory();
+
+        // copy modified data to gpu memory if needed
         if (outOfSync)
         {
-            auto mainIt = this->attributes.begin();
-            for (; mainIt != this->attributes.end(); mainIt++)
-            {
-                auto gpuIt = this->gpuAttributes.find(mainIt->first);
-                gpuIt->second.fill(
-                    0,
-                    vertexCount * GpuProgram::attributeTypeCompCount[(int)mainIt->first] * sizeof(Scalar),
-                    &mainIt->second[0]
-                );
-            }
+            if (this->layout == VertexLayout::INTERLEAVED)
+                this->uploadInterleaved();
+            else
+                this->uploadSeparate();
+
+            mergeRanges(this->dirtyFaces);
+            for (const DirtyRange& range : this->dirtyFaces)
+                this->uploadFaces(range);
+            this->dirtyFaces.clear();
+
             this->outOfSync = false;
         }
+    }
+
+    inline const VertexArray& getVertexArray() const
+    {
+        this->upload();
+        return *this->vertexArray;
+    }
 
-        return this->vertexArray;
+    /** Start a bulk edit. Until the matching endEdit() modifications are
+     * only recorded, derived data like the collision shape is invalidated
+     * once when the outermost edit ends. Edits may be nested.
+     */
+    inline void beginEdit()
+    {
+        this->editDepth++;
+    }
+
+    /// end a bulk edit started with beginEdit()
+    inline void endEdit()
+    {
+        MAGIC_THROW(this->editDepth == 0, "Tried to end an edit that was not started.");
+        if (--this->editDepth == 0 && this->editedInScope)
+        {
+            this->editedInScope = false;
+            this->invalidateCollision();
+        }
     }
 
     inline bool hasType(GpuProgram::AttributeType type) const
     {
-        return this->attributes.find(type) != this->attributes.end();
+        return (this->attributeMask & (1u << type)) != 0;
     }
 
     // TODO: stop mis-using the triangle mesh to store a lines mesh
@@ -284,158 +769,28 @@ public:
         (void)_;
     }
 
-    inline void calculateNormalsAndTangents()
-    {
-        // clear any existing normal and tangent data
-        for (unsigned int i = 0; i < this->vertexCount; i++)
-        {
-            auto vert = this->getVertex<NormalAttr, TangentAttr>(i);
-            vert.normal(0,0,0);
-            vert.tangent(0,0,0);
-            this->setVertex(i, vert);
-        }
-
-        // calculate normals for unique positions
-        for (TriangleMesh::Face& face : this->faces)
-        {
-            auto a = this->getVertex<PositionAttr, TexCoordAttr, NormalAttr, TangentAttr>(face.indices[0]);
-            auto b = this->getVertex<PositionAttr, TexCoordAttr, NormalAttr, TangentAttr>(face.indices[1]);
-            auto c = this->getVertex<PositionAttr, TexCoordAttr, NormalAttr, TangentAttr>(face.indices[2]);
-
-            Vector3 faceNormal = Triangle(a.position(), b.position(), c.position()).normal;
-
-            a.normal(a.normal() + faceNormal);
-            b.normal(b.normal() + faceNormal);
-            c.normal(c.normal() + faceNormal);
-
-            Vector4 BA = b.position() - a.position();
-            Vector4 CA = c.position() - a.position();
-
-            Vector2 tBA = b.texCoord() - a.texCoord();
-            Vector2 tCA = c.texCoord() - a.texCoord();
-            Scalar area = (tBA.x() * tCA.y()) - (tBA.y() * tCA.x());
-
-            Vector3 faceTangent;
-
-            if (area != 0.0f)
-            {
-                Scalar delta = 1.0f / area;
-                faceTangent = Vector3(
-                    delta * ((BA.x() * tCA.y()) + (CA.x() * -tBA.y())),
-                    delta * ((BA.y() * tCA.y()) + (CA.y() * -tBA.y())),
-                    delta * ((BA.z() * tCA.y()) + (CA.z() * -tBA.y()))
-                    );
-            }
-
-            a.tangent(a.tangent() + faceTangent);
-            b.tangent(b.tangent() + faceTangent);
-            c.tangent(c.tangent() + faceTangent);
-
-            this->setVertex(face.indices[0], a);
-            this->setVertex(face.indices[1], b);
-            this->setVertex(face.indices[2], c);
-        }
-
-        // set calculated normals on vertices
-        for (unsigned int i = 0; i < this->vertexCount; i++)
-        {
-            auto vert = this->getVertex<NormalAttr, TangentAttr>(i);
-            vert.normal(vert.normal().normalize());
-            vert.tangent(vert.tangent().normalize());
-            this->setVertex(i, vert);
-        }
-    }
-
-    inline std::vector<std::vector<unsigned int>> calculateDuplicateVertices(unsigned int precision = 3)
-    {
-        Scalar threshold = Scalar(std::pow(10, -int(precision)));
-        Scalar inverseThreshold = Scalar(std::pow(10, precision));
-
-        std::unordered_map<
-            Vector4,
-            std::vector<unsigned int>,
-            std::function<int(const Vector4&)>,
-            std::function<bool(const Vector4&, const Vector4&)>
-        > map(
-        this->vertexCount,
-        [&](const Vector4& vec) -> int
-        {
-            return
-                std::hash<int>()(int(vec.x() * inverseThreshold)) ^
-                std::hash<int>()(int(vec.y() * inverseThreshold)) ^
-                std::hash<int>()(int(vec.z() * inverseThreshold)) ^
-                std::hash<int>()(int(vec.w() * inverseThreshold));
-        },
-        [&](const Vector4& a, const Vector4& b) -> bool
-        {
-            bool equal = 
-                std::abs(a.x() - b.x()) < threshold &&
-                std::abs(a.y() - b.y()) < threshold &&
-                std::abs(a.z() - b.z()) < threshold &&
-                std::abs(a.w() - b.w()) < threshold;
-            return equal;
-        }
-        );
-
-        for (unsigned int i = 0; i < this->vertexCount; i++)
-        {
-            auto vert = this->getVertex<PositionAttr>(i);
-            map[vert.position()].push_back(i);
-        }
-
-        std::vector<std::vector<unsigned int>> duplicateVertexIndices;
-        for (auto it : map)
-        {
-            if (it.second.size() > 1)
-            {
-                duplicateVertexIndices.push_back(std::move(it.second));
-            }
-        }
-
-        return std::move(duplicateVertexIndices);
-    }
-
-    inline void mergeNormalsAndTangents(Scalar thresholdAngle = 60.0f, unsigned int precision = 3)
-    {
-        // merge normals for different points that are at the same location,
-        // if the angle between them is smaller than the threshold angle
-        Scalar thresholdAngleRads = thresholdAngle * Scalar(M_PI / 180);
-        std::vector<std::vector<unsigned int>> duplicateVertexIndices =
-            calculateDuplicateVertices(precision);
-        for (auto& list : duplicateVertexIndices)
-        {
-            std::map<unsigned int, Vector3> joinedNormal;
-            std::map<unsigned int, Vector3> joinedTangent;
-            for (unsigned int i : list)
-            {
-                auto vert1 = this->getVertex<NormalAttr, TangentAttr>(i);
-                joinedNormal[i] += vert1.normal();
-                joinedTangent[i] += vert1.tangent();
-
-                for (unsigned int j : list)
-                {
-                    if (i == j)
-                        continue; // skip comparing vertex with self
-
-                    auto& vert2 = this->getVertex<NormalAttr, TangentAttr>(j);
-
-                    Scalar angle = vert1.normal().angleBetween(vert2.normal());
-                    if (angle <= thresholdAngleRads)
-                    {
-                        joinedNormal[i] += vert2.normal();
-                        joinedTangent[i] += vert2.tangent();
-                    }
-                }
-            }
-            for (unsigned int index : list)
-            {
-                auto vert = this->getVertex<NormalAttr, TangentAttr>(index);
-                vert.normal(joinedNormal[index].normalize());
-                vert.tangent(joinedTangent[index].normalize());
-                this->setVertex(index, vert);
-            }
-        }
-    }
+    /** Calculate smooth normals and tangents from the faces around each
+     * vertex, see NormalGenerator. Results do not depend on the number of
+     * threads used.
+     * @param pool threads to split the work across
+     */
+    void calculateNormalsAndTangents(ThreadPool& pool = ThreadPool::getSingleton());
+
+    /** Find vertices at the same location, see NormalGenerator::groupByPosition
+     * @param precision number of decimal digits positions are compared to
+     * @return the indices of each location with more than one vertex
+     */
+    std::vector<std::vector<unsigned int>> calculateDuplicateVertices(unsigned int precision = 3) const;
+
+    /** Merge normals and tangents of vertices at the same location, if the
+     * angle between their normals is within the threshold angle. Runs in
+     * linear time in the vertex count, see NormalGenerator::smoothGroups.
+     * @param thresholdAngle    largest angle between normals to merge, in degrees
+     * @param precision         number of decimal digits positions are compared to
+     * @param pool              threads to split the work across
+     */
+    void mergeNormalsAndTangents(Scalar thresholdAngle = 60.0f, unsigned int precision = 3,
+        ThreadPool& pool = ThreadPool::getSingleton());
 
     enum class TexCoordGenMode
     {
@@ -445,6 +800,7 @@ public:
 
     inline void generateTexCoords(TexCoordGenMode mode = TexCoordGenMode::SPHERE_FROM_POSITION)
     {
+        this->beginEdit();
         if (mode == TexCoordGenMode::SPHERE_FROM_NORMALS)
         {
             for (unsigned int i = 0; i < this->vertexCount; i++)
@@ -471,6 +827,44 @@ public:
                 this->setVertex(i, vert);
             }
         }
+        this->endEdit();
+    }
+
+    /** Merge vertices that are equal in all attributes, within an epsilon,
+     * remapping faces and shrinking the attribute streams. Runs in expected
+     * linear time by hashing positions into a grid of epsilon sized cells.
+     * @param options how vertices are compared
+     * @return the number of vertices removed
+     */
+    unsigned int weld(const WeldOptions& options = WeldOptions());
+
+    /** Reorder faces for the post-transform vertex cache, optionally reorder
+     * clusters of them to reduce overdraw, and then reorder vertices in the
+     * order the faces use them.
+     * @param options which passes to run
+     */
+    void optimizeVertexOrder(const OptimizeOptions& options = OptimizeOptions());
+
+    /** Make a copy of this mesh with fewer faces by collapsing edges in
+     * order of their quadric error, see MeshSimplifier. Attribute seams and
+     * open borders are kept, and the copy only has the vertices it uses.
+     * @param targetFaceCount   number of faces to aim for
+     * @param resultError       if given, set to the largest error introduced,
+     *                          in squared distance
+     * @return the simplified mesh, laid out like this one
+     */
+    std::shared_ptr<TriangleMesh> simplify(unsigned int targetFaceCount,
+        Scalar* resultError = nullptr) const;
+
+    /** Simulate rendering the faces through a post-transform vertex cache
+     * @param cacheSize number of vertices the simulated cache holds
+     */
+    inline TriangleMeshOptimizer::VertexCacheStats getVertexCacheStats(
+        unsigned int cacheSize = 16) const
+    {
+        return TriangleMeshOptimizer::analyzeVertexCache(
+            this->faces.empty() ? nullptr : this->faces[0].indices,
+            this->faces.size() * 3, this->vertexCount, cacheSize);
     }
 
     virtual void positionTransform(const Matrix4& matrix);
@@ -485,6 +879,21 @@ public:
 
     virtual const TriangleMesh& getTriangleMesh() const;
 
+    /** Set bounding volumes already known for the vertices, like ones saved
+     * with the mesh, so they are not taken from the collision shape. They are
+     * dropped again when the mesh is modified.
+     * @param center    center of the bounding sphere
+     * @param radius    radius of the bounding sphere
+     * @param boxCenter center of the axis-aligned bounding box
+     * @param boxSize   edge length of the axis-aligned bounding box
+     */
+    void setBoundingVolumes(const Vector3& center, Scalar radius,
+        const Vector3& boxCenter, Scalar boxSize);
+
+    virtual const Sphere& getBoundingSphere() const;
+
+    virtual const Box& getAABB() const;
+
 };
 
 
@@ -0,0 +1,383 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Mesh\TriangleMeshOptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+namespace Magic3D
+{
+
+// scoring from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+static const Scalar CACHE_DECAY_POWER = 1.5f;
+static const Scalar LAST_TRIANGLE_SCORE = 0.75f;
+static const Scalar VALENCE_BOOST_SCALE = 2.0f;
+static const Scalar VALENCE_BOOST_POWER = 0.5f;
+
+static Scalar getVertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    // vertex is not used by any triangle left to emit
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    Scalar score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // the last triangle's vertices get a fixed score so that the next
+        // triangle does not simply reuse its most recent edge
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else
+        {
+            const Scalar scaler = 1.0f / (TriangleMeshOptimizer::OPTIMIZE_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+        }
+    }
+
+    // boost vertices with few triangles left, to finish them off
+    score += VALENCE_BOOST_SCALE *
+        std::pow((Scalar)remainingTriangles, -VALENCE_BOOST_POWER);
+    return score;
+}
+
+void TriangleMeshOptimizer::optimizeVertexCache(unsigned int* indices, size_t indexCount,
+    unsigned int vertexCount)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    // triangles using each vertex, as one list per vertex in a shared array
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++)
+        remaining[indices[i]]++;
+
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+
+    std::vector<unsigned int> adjacency(indexCount);
+    {
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indexCount; i++)
+            adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<Scalar> vertexScores(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        vertexScores[v] = getVertexScore(-1, remaining[v]);
+
+    std::vector<Scalar> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    int best = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = vertexScores[indices[t*3]] + vertexScores[indices[t*3 + 1]] +
+            vertexScores[indices[t*3 + 2]];
+        if (triangleScores[t] > triangleScores[best])
+            best = (int)t;
+    }
+
+    std::vector<unsigned int> output;
+    output.reserve(indexCount);
+    std::vector<unsigned int> cache, newCache;
+    cache.reserve(OPTIMIZE_CACHE_SIZE + 3);
+    newCache.reserve(OPTIMIZE_CACHE_SIZE + 3);
+    size_t cursor = 0;
+
+    while (output.size() < indexCount)
+    {
+        // nothing connected to the cache is left, continue with any triangle
+        if (best < 0)
+        {
+            while (emitted[cursor])
+                cursor++;
+            best = (int)cursor;
+        }
+
+        const unsigned int* triangle = &indices[best * 3];
+        emitted[best] = true;
+        output.insert(output.end(), triangle, triangle + 3);
+
+        // remove the triangle from the lists of its vertices
+        for (int i = 0; i < 3; i++)
+        {
+            unsigned int v = triangle[i];
+            unsigned int* list = &adjacency[offsets[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++)
+            {
+                if (list[j] == (unsigned int)best)
+                {
+                    list[j] = list[remaining[v] - 1];
+                    remaining[v]--;
+                    break;
+                }
+            }
+        }
+
+        // move the triangle's vertices to the front of the cache
+        newCache.clear();
+        for (int i = 0; i < 3; i++)
+        {
+            if (std::find(newCache.begin(), newCache.end(), triangle[i]) == newCache.end())
+                newCache.push_back(triangle[i]);
+        }
+        for (unsigned int v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache.push_back(v);
+        }
+
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < OPTIMIZE_CACHE_SIZE ? (int)i : -1;
+            vertexScores[v] = getVertexScore(cachePosition[v], remaining[v]);
+        }
+
+        // rescore triangles around all touched vertices, including evicted ones
+        best = -1;
+        Scalar bestScore = -1.0f;
+        for (unsigned int v : newCache)
+        {
+            const unsigned int* list = &adjacency[offsets[v]];
+            for (unsigned int j = 0; j < remaining[v]; j++)
+            {
+                unsigned int t = list[j];
+                Scalar score = vertexScores[indices[t*3]] + vertexScores[indices[t*3 + 1]] +
+                    vertexScores[indices[t*3 + 2]];
+                triangleScores[t] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    best = (int)t;
+                }
+            }
+        }
+
+        if (newCache.size() > OPTIMIZE_CACHE_SIZE)
+            newCache.resize(OPTIMIZE_CACHE_SIZE);
+        cache.swap(newCache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void TriangleMeshOptimizer::optimizeOverdraw(unsigned int* indices, size_t indexCount,
+    const Scalar* positions, unsigned int positionStride, unsigned int vertexCount,
+    Scalar threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+
+    const unsigned int cacheSize = 16;
+    const Scalar targetAcmr =
+        analyzeVertexCache(indices, indexCount, vertexCount, cacheSize).acmr * threshold;
+
+    // split into clusters, simulating the cache from scratch for each cluster
+    // as clusters are moved around independently
+    std::vector<size_t> clusterStarts;
+    std::vector<unsigned int> stamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    unsigned int clusterMisses = 0;
+    size_t clusterTriangles = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        unsigned int misses = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            unsigned int v = indices[t*3 + i];
+            if (time - stamps[v] > cacheSize)
+            {
+                stamps[v] = time++;
+                misses++;
+            }
+        }
+
+        // all vertices missing means the cache was flushed, a free split
+        if (clusterTriangles == 0 || misses == 3)
+        {
+            clusterStarts.push_back(t);
+            clusterMisses = 0;
+            clusterTriangles = 0;
+        }
+        clusterMisses += misses;
+        clusterTriangles++;
+
+        // split once the cluster is about as cache efficient as the whole list
+        if (clusterMisses <= targetAcmr * clusterTriangles)
+        {
+            clusterTriangles = 0;
+            time += cacheSize + 1; // forget cache contents
+        }
+    }
+
+    // sort clusters so ones facing away from the center are drawn first,
+    // as they tend to occlude the rest of the mesh
+    struct Cluster
+    {
+        size_t start;
+        size_t end;
+        Scalar centroid[3];
+        Scalar normal[3];
+        Scalar area;
+        Scalar sortKey;
+    };
+    std::vector<Cluster> clusters(clusterStarts.size());
+    Scalar meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    Scalar meshArea = 0.0f;
+
+    for (size_t k = 0; k < clusters.size(); k++)
+    {
+        Cluster& cluster = clusters[k];
+        cluster.start = clusterStarts[k];
+        cluster.end = k + 1 < clusterStarts.size() ? clusterStarts[k + 1] : triangleCount;
+        cluster.area = 0.0f;
+        for (int i = 0; i < 3; i++)
+            cluster.centroid[i] = cluster.normal[i] = 0.0f;
+
+        for (size_t t = cluster.start; t < cluster.end; t++)
+        {
+            const Scalar* a = &positions[indices[t*3] * positionStride];
+            const Scalar* b = &positions[indices[t*3 + 1] * positionStride];
+            const Scalar* c = &positions[indices[t*3 + 2] * positionStride];
+
+            Scalar ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            Scalar ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            Scalar cross[3] = {
+                ab[1] * ac[2] - ab[2] * ac[1],
+                ab[2] * ac[0] - ab[0] * ac[2],
+                ab[0] * ac[1] - ab[1] * ac[0]
+            };
+            Scalar area = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+            for (int i = 0; i < 3; i++)
+            {
+                cluster.centroid[i] += (a[i] + b[i] + c[i]) * (area / 3.0f);
+                cluster.normal[i] += cross[i];
+            }
+            cluster.area += area;
+        }
+
+        for (int i = 0; i < 3; i++)
+            meshCentroid[i] += cluster.centroid[i];
+        meshArea += cluster.area;
+
+        if (cluster.area > 0.0f)
+        {
+            for (int i = 0; i < 3; i++)
+                cluster.centroid[i] /= cluster.area;
+        }
+    }
+
+    if (meshArea > 0.0f)
+    {
+        for (int i = 0; i < 3; i++)
+            meshCentroid[i] /= meshArea;
+    }
+
+    for (Cluster& cluster : clusters)
+    {
+        Scalar length = std::sqrt(cluster.normal[0] * cluster.normal[0] +
+            cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+        cluster.sortKey = 0.0f;
+        if (length > 0.0f)
+        {
+            for (int i = 0; i < 3; i++)
+                cluster.sortKey += (cluster.centroid[i] - meshCentroid[i]) * (cluster.normal[i] / length);
+        }
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<unsigned int> output;
+    output.reserve(indexCount);
+    for (const Cluster& cluster : clusters)
+        output.insert(output.end(), &indices[cluster.start * 3], &indices[cluster.end * 3]);
+    std::copy(output.begin(), output.end(), indices);
+}
+
+std::vector<unsigned int> TriangleMeshOptimizer::optimizeVertexFetch(unsigned int* indices,
+    size_t indexCount, unsigned int vertexCount)
+{
+    std::vector<unsigned int> remap(vertexCount, UINT_MAX);
+    unsigned int next = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        unsigned int& newIndex = remap[indices[i]];
+        if (newIndex == UINT_MAX)
+            newIndex = next++;
+        indices[i] = newIndex;
+    }
+
+    // keep unused vertices, after all used ones
+    for (unsigned int v = 0; v < vertexCount; v++)
+    {
+        if (remap[v] == UINT_MAX)
+            remap[v] = next++;
+    }
+    return remap;
+}
+
+TriangleMeshOptimizer::VertexCacheStats TriangleMeshOptimizer::analyzeVertexCache(
+    const unsigned int* indices, size_t indexCount, unsigned int vertexCount,
+    unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    stats.transformed = 0;
+    stats.acmr = 0.0f;
+    stats.atvr = 0.0f;
+
+    // a vertex is in a fifo cache if fewer than cacheSize vertices were
+    // added since it was added itself
+    std::vector<unsigned int> stamps(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    unsigned int time = cacheSize + 1;
+    unsigned int uniqueVertices = 0;
+
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        unsigned int v = indices[i];
+        if (time - stamps[v] > cacheSize)
+        {
+            stamps[v] = time++;
+            stats.transformed++;
+        }
+        if (!referenced[v])
+        {
+            referenced[v] = true;
+            uniqueVertices++;
+        }
+    }
+
+    if (indexCount >= 3)
+        stats.acmr = (Scalar)stats.transformed / (indexCount / 3);
+    if (uniqueVertices > 0)
+        stats.atvr = (Scalar)stats.transformed / uniqueVertices;
+    return stats;
+}
+
+
+};
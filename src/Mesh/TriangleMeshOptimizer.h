@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for TriangleMeshOptimizer class
+ *
+ * @file TriangleMeshOptimizer.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_TRIANGLE_MESH_OPTIMIZER_H
+#define MAGIC3D_TRIANGLE_MESH_OPTIMIZER_H
+
+#include "../Math/MathTypes.h"
+
+#include <vector>
+#include <cstddef>
+
+namespace Magic3D
+{
+
+/** Reorders triangle lists for faster rendering. All passes work on plain
+ * index lists, three indices per triangle, so they need no gpu.
+ *
+ * The usual order is optimizeVertexCache, then optionally optimizeOverdraw,
+ * then optimizeVertexFetch, as each pass keeps most of what the previous
+ * one gained.
+ */
+class TriangleMeshOptimizer
+{
+public:
+    /// results of simulating a post-transform vertex cache
+    struct VertexCacheStats
+    {
+        /// vertices transformed, i.e. cache misses
+        unsigned int transformed;
+
+        /// average cache miss ratio, transformed vertices per triangle (0.5 to 3)
+        Scalar acmr;
+
+        /// average transform to vertex ratio, transformed vertices per referenced vertex (1 or more)
+        Scalar atvr;
+    };
+
+    /// size of the cache the vertex cache pass optimizes for
+    static const unsigned int OPTIMIZE_CACHE_SIZE = 32;
+
+    /** Reorder triangles so that vertices are reused while they are still in
+     * the post-transform cache, using Tom Forsyth's linear-speed algorithm.
+     * The result does not depend on an exact cache size.
+     * @param indices       triangle list to reorder in place
+     * @param indexCount    number of indices, a multiple of 3
+     * @param vertexCount   number of vertices referenced by the indices
+     */
+    static void optimizeVertexCache(unsigned int* indices, size_t indexCount,
+        unsigned int vertexCount);
+
+    /** Reorder clusters of triangles so that triangles likely to occlude
+     * others are drawn first. The list is split where the vertex cache would
+     * be flushed anyway or where a cluster is close to the cache efficiency
+     * of the whole list, so the vertex cache order is mostly kept.
+     * @param indices           triangle list to reorder in place
+     * @param indexCount        number of indices, a multiple of 3
+     * @param positions         vertex positions, at least 3 components each
+     * @param positionStride    scalars between consecutive positions
+     * @param vertexCount       number of vertices
+     * @param threshold         how much worse than the whole list, in acmr, a
+     *                          cluster may be when it is split, 1.05 keeps
+     *                          the result within about 5 percent
+     */
+    static void optimizeOverdraw(unsigned int* indices, size_t indexCount,
+        const Scalar* positions, unsigned int positionStride, unsigned int vertexCount,
+        Scalar threshold = 1.05f);
+
+    /** Renumber vertices in the order they are first used so that vertex
+     * data is fetched front to back. Unused vertices are moved to the end.
+     * @param indices       triangle list to renumber in place
+     * @param indexCount    number of indices
+     * @param vertexCount   number of vertices
+     * @return the new index of each old vertex, for reordering vertex data
+     */
+    static std::vector<unsigned int> optimizeVertexFetch(unsigned int* indices,
+        size_t indexCount, unsigned int vertexCount);
+
+    /** Simulate a FIFO post-transform vertex cache over a triangle list
+     * @param indices       triangle list to analyze
+     * @param indexCount    number of indices, a multiple of 3
+     * @param vertexCount   number of vertices referenced by the indices
+     * @param cacheSize     number of vertices the cache holds
+     */
+    static VertexCacheStats analyzeVertexCache(const unsigned int* indices,
+        size_t indexCount, unsigned int vertexCount, unsigned int cacheSize = 16);
+};
+
+};
+
+#endif
@@ -42,6 +42,19 @@ protected:
 	std::shared_ptr<Geometry> collisionShape;
 	std::shared_ptr<Material> material;
 
+    /// coarser version of the meshes, used below a projected size
+    struct Lod
+    {
+        std::vector<std::shared_ptr<Geometry>> meshes;
+
+        /// fraction of the screen height the bounding sphere must cover, at
+        /// most, for this level to be used
+        Scalar screenSize;
+    };
+
+    /// levels after the first, which is the meshes themselves, coarsest last
+    std::vector<Lod> lods;
+
     mutable std::shared_ptr<CompoundGeometry> compound;
 	
 public:
@@ -72,12 +85,115 @@ public:
 	{
 		this->meshes = meshes;
         this->compound = nullptr;
+        this->lods.clear();
 	}
     inline void setMeshes(std::shared_ptr<Geometry> mesh)
     {
         meshes.clear();
         meshes.push_back(mesh);
         this->compound = nullptr;
+        this->lods.clear();
+    }
+
+    /// get the number of levels of detail, including the full detail meshes
+    inline unsigned int getLodCount() const
+    {
+        return (unsigned int)this->lods.size() + 1;
+    }
+
+    /// get the meshes of a level of detail, 0 is full detail, past the last level gives the last
+    inline std::vector<std::shared_ptr<Geometry>>& getLodMeshes(unsigned int level)
+    {
+        if (level == 0 || this->lods.empty())
+            return this->meshes;
+        return this->lods[std::min(level, (unsigned int)this->lods.size()) - 1].meshes;
+    }
+
+    /// get the largest screen size a level of detail is used at, see Lod
+    inline Scalar getLodScreenSize(unsigned int level) const
+    {
+        if (level == 0 || this->lods.empty())
+            return 1.0f;
+        return this->lods[std::min(level, (unsigned int)this->lods.size()) - 1].screenSize;
+    }
+
+    /** Add a coarser level of detail after the existing ones. Meshes should
+     * be in the same space as the full detail meshes.
+     * @param meshes        meshes to draw instead of the full detail meshes
+     * @param screenSize    fraction of the screen height the bounding sphere
+     *                      covers, at most, for the level to be used
+     */
+    inline void addLod(const std::vector<std::shared_ptr<Geometry>>& meshes, Scalar screenSize)
+    {
+        MAGIC_THROW(screenSize >= this->getLodScreenSize(this->getLodCount() - 1),
+            "Levels of detail must be added with decreasing screen sizes.");
+        Lod lod;
+        lod.meshes = meshes;
+        lod.screenSize = screenSize;
+        this->lods.push_back(lod);
+    }
+
+    inline void clearLods()
+    {
+        this->lods.clear();
+    }
+
+    /** Build a chain of levels of detail by simplifying the full detail
+     * meshes, replacing any existing levels. Each level keeps a fraction of
+     * the faces of the one before and is used at a fraction of its screen
+     * size. Stops early when meshes can no longer be simplified much.
+     * @param levels        number of levels to add after the full detail meshes
+     * @param faceRatio     fraction of faces each level keeps of the one before
+     * @param screenSize    screen size below which the first added level is used
+     * @param screenRatio   fraction of screen size each level is used at of the one before
+     */
+    inline void generateLods(unsigned int levels = 3, Scalar faceRatio = 0.5f,
+        Scalar screenSize = 0.25f, Scalar screenRatio = 0.5f)
+    {
+        this->lods.clear();
+        const std::vector<std::shared_ptr<Geometry>>* previous = &this->meshes;
+        for (unsigned int level = 0; level < levels; level++)
+        {
+            Lod lod;
+            lod.screenSize = screenSize;
+
+            unsigned int facesBefore = 0, facesAfter = 0;
+            for (const auto& geometry : *previous)
+            {
+                const TriangleMesh& mesh = geometry->getTriangleMesh();
+                auto simplified = mesh.simplify((unsigned int)(mesh.getFaceCount() * faceRatio));
+                facesBefore += mesh.getFaceCount();
+                facesAfter += simplified->getFaceCount();
+                lod.meshes.push_back(simplified);
+            }
+
+            // seams and borders hold the meshes, another level would barely help
+            if (facesAfter > facesBefore * (1.0f + faceRatio) * 0.5f)
+                break;
+
+            this->lods.push_back(lod);
+            previous = &this->lods.back().meshes;
+            screenSize *= screenRatio;
+        }
+    }
+
+    /** Select the level of detail for a projected size, only changing from
+     * the current level once the size is past its threshold by the
+     * hysteresis, so objects near a threshold do not switch every frame.
+     * @param screenSize    fraction of the screen height covered by the bounding sphere
+     * @param current       level selected last time
+     * @param hysteresis    fraction of a threshold the size must pass it by
+     */
+    inline unsigned int selectLod(Scalar screenSize, unsigned int current,
+        Scalar hysteresis = 0.1f) const
+    {
+        unsigned int level = std::min(current, this->getLodCount() - 1);
+        while (level + 1 < this->getLodCount() &&
+            screenSize < this->getLodScreenSize(level + 1) * (1.0f - hysteresis))
+            level++;
+        while (level > 0 && screenSize > this->getLodScreenSize(level) * (1.0f + hysteresis))
+            level--;
+        return level;
     }
 
     inline std::shared_ptr<Geometry> getCollisionShape()
@@ -88,7 +204,7 @@ public:
 	{
 		this->collisionShape = collisionShape;
 	}
-	inline std::shared_ptr<Material> getMaterial()
+	inline const std::shared_ptr<Material>& getMaterial() const
 	{
 		return this->material;
 	}
@@ -33,6 +33,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <CollisionShapes\CollisionShape.h>
 #include <Physics\MotionState.h>
 #include <Objects\Model.h>
+#include <World\ObjectTable.h>
 
 #include <btBulletDynamicsCommon.h>
 #include <btBulletCollisionCommon.h>
@@ -66,6 +67,7 @@ public:
 protected:
     friend class World;
 	friend class PhysicsSystem;
+	friend class MotionState;
     
 	Position position;
 	
@@ -74,6 +76,57 @@ protected:
 	std::shared_ptr<MotionState> motionState;
 	btRigidBody* body;
 
+	/// world matrix of the position and world space bounding sphere of the
+	/// model, rebuilt only after the position has changed
+	Matrix4 worldMatrix;
+	Vector3 worldSphereCenter;
+	Scalar worldSphereRadius;
+	bool transformDirty;
+
+	/// handle of the object in the world's table and the table, which is
+	/// told when the object moves, see ObjectTable
+	ObjectHandle worldHandle;
+	ObjectTable* worldTable;
+
+	/// the position changed, the world matrix and the bounds in the world
+	/// need rebuilding
+	inline void markMoved()
+	{
+		this->transformDirty = true;
+		if (this->worldTable != nullptr)
+			this->worldTable->markMoved(this->worldHandle);
+	}
+
+	/// rebuild the world matrix and bounding sphere if the position changed
+	inline void updateWorldTransform()
+	{
+		if (!this->transformDirty)
+			return;
+		this->transformDirty = false;
+
+		this->position.getTransformMatrix(this->worldMatrix);
+
+		// the sphere's center is offset in model space
+		Vector3 offset(0, 0, 0);
+		this->worldSphereRadius = 0;
+		if (this->model->getMeshes().size() > 0)
+		{
+			const Sphere& sphere = this->model->getGraphicalCompoundMesh().getBoundingSphere();
+			offset = sphere.getTranslation();
+			this->worldSphereRadius = sphere.getRadius();
+		}
+
+		Scalar center[3];
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			center[i] = this->worldMatrix.get(3, i) +
+				this->worldMatrix.get(0, i) * offset.x() +
+				this->worldMatrix.get(1, i) * offset.y() +
+				this->worldMatrix.get(2, i) * offset.z();
+		}
+		this->worldSphereCenter.set(center[0], center[1], center[2]);
+	}
+
 
 	/** sync the graphical position with the physical
 	 * position.
@@ -105,7 +158,8 @@ public:
 	inline Object(
 		std::shared_ptr<Model> model, 
 		const Properties& prop = Properties(), bool staticObject = false 
-		): model(model), body(nullptr)
+		): model(model), body(nullptr), worldSphereRadius(0), transformDirty(true),
+		worldTable(nullptr)
 	{
 		if (model->getCollisionShape() != nullptr)
 		{
@@ -125,7 +179,7 @@ public:
             else
             {
                 this->motionState = std::make_shared<MotionState>(&this->position,
-                    model->getCollisionShape()->getCollisionShape());
+                    model->getCollisionShape()->getCollisionShape(), this);
             }
 			btRigidBody::btRigidBodyConstructionInfo fallRigidBodyCI(
 				prop.mass, 
@@ -145,6 +199,7 @@ public:
 	inline void setLocation(const Vector3& location)
 	{
 		this->position.setLocation(location);
+		this->markMoved();
 		this->syncPositionToPhysics();
 	}
 
@@ -152,6 +207,7 @@ public:
 	inline void setPosition(const Position& position)
 	{
 	    this->position.set(position);
+		this->markMoved();
 		this->syncPositionToPhysics();
 	}
 	
@@ -161,6 +217,27 @@ public:
 		return this->position;
 	}
 
+	/// get the model/world matrix of the position
+	inline const Matrix4& getWorldMatrix()
+	{
+		this->updateWorldTransform();
+		return this->worldMatrix;
+	}
+
+	/// get the center of the model's bounding sphere in world space
+	inline const Vector3& getWorldSphereCenter()
+	{
+		this->updateWorldTransform();
+		return this->worldSphereCenter;
+	}
+
+	/// get the radius of the model's bounding sphere
+	inline Scalar getWorldSphereRadius()
+	{
+		this->updateWorldTransform();
+		return this->worldSphereRadius;
+	}
+
 	inline std::shared_ptr<Model> getModel()
 	{
 	     return model;
@@ -24,6 +24,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include <Physics/MotionState.h>
+#include <Objects/Object.h>
 
 namespace Magic3D
 {
@@ -105,6 +106,9 @@ void MotionState::setWorldTransform (const btTransform &worldTrans)
 		Vector3(forwardV.getX(), forwardV.getY(), forwardV.getZ()),
 		Vector3(upV.getX(), upV.getY(), upV.getZ())
 	);
+
+    if (this->object != nullptr)
+        this->object->markMoved();
 }
 	
 	
@@ -34,6 +34,8 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 namespace Magic3D
 {
 
+class Object;
+
 	
 /** Used in listener callback pattern with
  * physics library to automatically keep the
@@ -46,13 +48,18 @@ private:
 	/// reference to position to sync with
 	Position* position;
     const CollisionShape& shape;
+
+    /// object told when the physics library moves the position
+    Object* object;
 	
 public:
 	/** Standard constructor
 	 * @param position the position to keep in sync
+	 * @param object object to mark moved when the position is moved, can be
+	 * nullptr. Sleeping bodies are not moved, so they never mark it.
 	 */
-	inline MotionState(Position* position, const CollisionShape& shape): 
-        position(position), shape(shape) {}
+	inline MotionState(Position* position, const CollisionShape& shape, Object* object = nullptr): 
+        position(position), shape(shape), object(object) {}
 	
 	/// destructor
 	virtual ~MotionState();
@@ -23,6 +23,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <map>
 #include <memory>
 #include <Graphics\Image.h>
+#include "ResourceData.h"
 
 namespace Magic3D
 {
@@ -32,7 +33,14 @@ class ImageLoader
 protected:
 	inline ImageLoader() {}
 public:
-	virtual std::shared_ptr<Image> getImage(const std::string& path) const = 0;
+	/// decode an image from the contents of its file
+	virtual std::shared_ptr<Image> getImage(const ResourceData& data) const = 0;
+
+	/// decode an image file
+	inline std::shared_ptr<Image> getImageFile(const std::string& path) const
+	{
+		return this->getImage(ResourceData::mapFile(path));
+	}
 };
 
 class ImageLoaders
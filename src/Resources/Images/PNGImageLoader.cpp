@@ -35,18 +35,26 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 namespace Magic3D
 {
 
-std::shared_ptr<Image> PNGImageLoader::getImage(const std::string& path) const
+/// position of libpng in the contents of an image file
+struct PNGReader
 {
-	png_byte signiture [8];
-	
-    // open the file given, in binary mode
-	FILE* fp = fopen(path.c_str(), "rb");
-    if (!fp)
-        throw_MagicException( "Could not open PNG 2D resource file" );
-    
-    // read in the PNG signiture and check it for validity
-    fread(signiture, 1, 8, fp);
-    if (png_sig_cmp(signiture, 0, 8))
+    const ResourceData* data;
+    size_t pos;
+};
+
+static void readPNGData(png_structp png_ptr, png_bytep out, png_size_t length)
+{
+    PNGReader* reader = (PNGReader*)png_get_io_ptr(png_ptr);
+    if (length > reader->data->getSize() - reader->pos)
+        png_error(png_ptr, "Read past the end of PNG data");
+    memcpy(out, reader->data->getData() + reader->pos, length);
+    reader->pos += length;
+}
+
+std::shared_ptr<Image> PNGImageLoader::getImage(const ResourceData& data) const
+{
+    // check the PNG signiture for validity
+    if (data.getSize() < 8 || png_sig_cmp((png_bytep)data.getData(), 0, 8))
         throw_MagicException( "Attempted to create PNG resource from a non-PNG file" );
 
     png_structp png_ptr;
@@ -70,11 +78,11 @@ std::shared_ptr<Image> PNGImageLoader::getImage(const std::string& path) const
         MAGIC_ASSERT( false );
     }
 
-    // Give libpng the FILE pointer to read data from
-    png_init_io(png_ptr, fp);
+    // Give libpng the data to read from, after the signiture already checked
+    PNGReader reader = { &data, 8 };
+    png_set_read_fn(png_ptr, &reader, readPNGData);
     
-    // tell libpng that we already read the signiture in, thus the file pointer
-    // we just gave is 8 bytes ahead
+    // tell libpng that we already read the signiture in
     png_set_sig_bytes(png_ptr, 8);
 
     // Read the info for the PNG file 
@@ -159,8 +167,6 @@ std::shared_ptr<Image> PNGImageLoader::getImage(const std::string& path) const
     delete[] row_pointers;
     delete[] imageData;
 
-	fclose(fp);
-
 	return image;
 }
 	
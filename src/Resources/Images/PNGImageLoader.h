@@ -35,7 +35,7 @@ class PNGImageLoader : public Magic3D::ImageLoader
 {
 public:
 
-	virtual std::shared_ptr<Image> getImage(const std::string& path) const;
+	virtual std::shared_ptr<Image> getImage(const ResourceData& data) const;
 
 };
 
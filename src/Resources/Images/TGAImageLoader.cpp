@@ -58,17 +58,14 @@ typedef struct
 #undef PACKED
 
 
-std::shared_ptr<Image> TGAImageLoader::getImage(const std::string& path) const
+std::shared_ptr<Image> TGAImageLoader::getImage(const ResourceData& data) const
 {
-	// Attempt to open the file
-    FILE* pFile = fopen(path.c_str(), "rb");
-    if(pFile == NULL)
-        throw_ResourceNotFoundException("Could not find TGA image file");
-
     TGAHEADER tgaHeader;		// TGA file header
     
     // read in header
-    fread(&tgaHeader, sizeof(TGAHEADER), 1, pFile);
+    if (data.getSize() < sizeof(TGAHEADER))
+        throw_MagicException("Could not read TGA image header");
+    memcpy(&tgaHeader, data.getData(), sizeof(TGAHEADER));
 	
     // extract width, height, and channel count
     int width = tgaHeader.width;
@@ -88,8 +85,12 @@ std::shared_ptr<Image> TGAImageLoader::getImage(const std::string& path) const
     image->allocate(width, height, channels );
     
     // read in raw image data
-    if(fread(tempData, length, 1, pFile) != 1)
+    if ((size_t)length > data.getSize() - sizeof(TGAHEADER))
+    {
+        delete[] tempData;
 		throw_MagicException("Could not read TGA image data");
+    }
+    memcpy(tempData, data.getData() + sizeof(TGAHEADER), length);
 	
 	// change format of pixels in temporary buffer
 	// TGA format pixels are BGRA instead of RGBA
@@ -112,9 +113,6 @@ std::shared_ptr<Image> TGAImageLoader::getImage(const std::string& path) const
 	// delete temporary image data
 	delete[] tempData;
 
-	// close image file
-	fclose(pFile);
-
 	return image;
 }
 	
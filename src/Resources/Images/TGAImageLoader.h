@@ -33,7 +33,7 @@ class TGAImageLoader : public ImageLoader
 {	
 public:
 
-	virtual std::shared_ptr<Image> getImage(const std::string& path) const;
+	virtual std::shared_ptr<Image> getImage(const ResourceData& data) const;
 
 };
 
@@ -0,0 +1,357 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Resources\MeshCache.h>
+#include <Util\MappedFile.h>
+#include <Util\Hash.h>
+#include <Geometry\Sphere.h>
+#include <Geometry\Box.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace Magic3D
+{
+
+namespace
+{
+
+const char MAGIC[8] = { 'M', '3', 'D', 'M', 'E', 'S', 'H', 0 };
+
+/// start of every cache file, a byte swapped version rejects other endianness
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t scalarSize;
+    uint32_t attributeTypeCount;
+    uint32_t meshCount;         // full detail meshes
+    uint32_t lodCount;          // levels after the full detail meshes
+    uint32_t reserved;
+    uint64_t sourceHash;
+    uint64_t optionsHash;
+};
+
+/// a level of detail, its meshes follow the ones of the level before
+struct LodEntry
+{
+    double screenSize;
+    uint32_t meshCount;
+    uint32_t reserved;
+};
+
+struct MeshEntry
+{
+    uint32_t vertexCount;
+    uint32_t faceCount;
+    uint64_t faceOffset;
+    uint64_t streamOffsets[GpuProgram::MAX_ATTRIBUTE_TYPES];   // 0 for types not present
+    double sphere[4];   // center and radius
+    double box[4];      // center and edge length
+};
+
+static_assert(sizeof(FileHeader) == 48 && sizeof(LodEntry) == 16 &&
+    sizeof(MeshEntry) == 80 + 8 * GpuProgram::MAX_ATTRIBUTE_TYPES,
+    "cache structures must not have padding");
+
+const uint64_t ALIGNMENT = 16;
+
+inline uint64_t align(uint64_t offset)
+{
+    return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+inline uint64_t getStreamSize(int type, uint32_t vertexCount)
+{
+    return (uint64_t)GpuProgram::attributeTypeCompCount[type] * vertexCount * sizeof(Scalar);
+}
+
+}
+
+uint64_t MeshCache::hashFile(const std::string& path)
+{
+    MappedFile file(path);
+    return hashBytes(file.getData(), file.getSize());
+}
+
+uint64_t MeshCache::hashOptions(const MeshLoadOptions& options)
+{
+    // field by field, so padding does not end up in the hash
+    uint64_t result = hashBytes(&options.weld, sizeof(options.weld));
+    result = hashBytes(&options.weldOptions.epsilon, sizeof(Scalar), result);
+    result = hashBytes(&options.optimize, sizeof(options.optimize), result);
+    result = hashBytes(&options.optimizeOptions.overdraw, sizeof(options.optimizeOptions.overdraw), result);
+    result = hashBytes(&options.optimizeOptions.overdrawThreshold, sizeof(Scalar), result);
+    result = hashBytes(&options.lodLevels, sizeof(options.lodLevels), result);
+    return result;
+}
+
+std::string MeshCache::getCachePath(const std::string& sourcePath, const std::string& cacheDir)
+{
+    if (cacheDir.empty())
+        return sourcePath + ".m3dmesh";
+
+    // sources from different directories may share a name
+    std::ostringstream path;
+    path << cacheDir << "/" << std::hex << hashBytes(sourcePath.data(), sourcePath.size()) << ".m3dmesh";
+    return path.str();
+}
+
+std::shared_ptr<Model> MeshCache::load(const std::string& path, uint64_t sourceHash,
+    uint64_t optionsHash, TriangleMesh::VertexLayout layout)
+{
+    std::ifstream test(path.c_str());
+    if (!test.good())
+        return nullptr;
+    test.close();
+
+    ResourceData file;
+    try
+    {
+        file = ResourceData::mapFile(path);
+    }
+    catch (MagicException&)
+    {
+        return nullptr;
+    }
+    return load(file, sourceHash, optionsHash, layout);
+}
+
+std::shared_ptr<Model> MeshCache::load(const ResourceData& file, uint64_t sourceHash,
+    uint64_t optionsHash, TriangleMesh::VertexLayout layout)
+{
+    const unsigned char* data = file.getData();
+    uint64_t size = file.getSize();
+
+    // offsets are aligned from the start, which must be aligned itself
+    if ((uintptr_t)data % ALIGNMENT != 0)
+        return nullptr;
+
+    FileHeader header;
+    if (size < sizeof(header))
+        return nullptr;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.scalarSize != sizeof(Scalar) ||
+        header.attributeTypeCount != GpuProgram::MAX_ATTRIBUTE_TYPES ||
+        header.sourceHash != sourceHash || header.optionsHash != optionsHash)
+        return nullptr;
+
+    // check the tables fit before reading them
+    uint64_t offset = sizeof(header);
+    if (offset + (uint64_t)header.lodCount * sizeof(LodEntry) > size)
+        return nullptr;
+    std::vector<LodEntry> lods(header.lodCount);
+    if (!lods.empty())
+        memcpy(&lods[0], data + offset, lods.size() * sizeof(LodEntry));
+    offset += lods.size() * sizeof(LodEntry);
+
+    uint64_t meshCount = header.meshCount;
+    double screenSize = 1.0;
+    for (const LodEntry& lod : lods)
+    {
+        if (!(lod.screenSize < screenSize))
+            return nullptr;
+        screenSize = lod.screenSize;
+        meshCount += lod.meshCount;
+    }
+    if (offset + meshCount * sizeof(MeshEntry) > size)
+        return nullptr;
+    std::vector<MeshEntry> entries((size_t)meshCount);
+    if (!entries.empty())
+        memcpy(&entries[0], data + offset, entries.size() * sizeof(MeshEntry));
+
+    std::vector<std::shared_ptr<Geometry>> meshes;
+    for (const MeshEntry& entry : entries)
+    {
+        // a damaged file must not send reads past its end
+        const Scalar* streams[GpuProgram::MAX_ATTRIBUTE_TYPES];
+        for (int t = 0; t < GpuProgram::MAX_ATTRIBUTE_TYPES; t++)
+        {
+            uint64_t streamOffset = entry.streamOffsets[t];
+            streams[t] = nullptr;
+            if (streamOffset == 0)
+                continue;
+            if (streamOffset % ALIGNMENT != 0 || streamOffset > size ||
+                getStreamSize(t, entry.vertexCount) > size - streamOffset)
+                return nullptr;
+            streams[t] = (const Scalar*)(data + streamOffset);
+        }
+
+        uint64_t faceSize = (uint64_t)entry.faceCount * sizeof(TriangleMesh::Face);
+        if (entry.faceOffset % ALIGNMENT != 0 || entry.faceOffset > size ||
+            faceSize > size - entry.faceOffset)
+            return nullptr;
+        const TriangleMesh::Face* faces = (const TriangleMesh::Face*)(data + entry.faceOffset);
+        const unsigned int* indices = (const unsigned int*)faces;
+        for (uint64_t i = 0; i < (uint64_t)entry.faceCount * 3; i++)
+        {
+            if (indices[i] >= entry.vertexCount)
+                return nullptr;
+        }
+
+        auto mesh = std::make_shared<TriangleMesh>(entry.vertexCount, entry.faceCount,
+            streams, faces, file.getOwner(), layout);
+        mesh->setBoundingVolumes(
+            Vector3((Scalar)entry.sphere[0], (Scalar)entry.sphere[1], (Scalar)entry.sphere[2]),
+            (Scalar)entry.sphere[3],
+            Vector3((Scalar)entry.box[0], (Scalar)entry.box[1], (Scalar)entry.box[2]),
+            (Scalar)entry.box[3]);
+        meshes.push_back(mesh);
+    }
+
+    auto model = std::make_shared<Model>();
+    auto next = meshes.begin() + header.meshCount;
+    model->setMeshes(std::vector<std::shared_ptr<Geometry>>(meshes.begin(), next));
+    for (const LodEntry& lod : lods)
+    {
+        model->addLod(std::vector<std::shared_ptr<Geometry>>(next, next + lod.meshCount),
+            (Scalar)lod.screenSize);
+        next += lod.meshCount;
+    }
+    return model;
+}
+
+bool MeshCache::save(const std::string& path, Model& model, uint64_t sourceHash,
+    uint64_t optionsHash)
+{
+    FileHeader header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.scalarSize = sizeof(Scalar);
+    header.attributeTypeCount = GpuProgram::MAX_ATTRIBUTE_TYPES;
+    header.meshCount = (uint32_t)model.getLodMeshes(0).size();
+    header.lodCount = model.getLodCount() - 1;
+    header.reserved = 0;
+    header.sourceHash = sourceHash;
+    header.optionsHash = optionsHash;
+
+    std::vector<LodEntry> lods;
+    std::vector<const TriangleMesh*> meshes;
+    for (unsigned int level = 0; level < model.getLodCount(); level++)
+    {
+        if (level > 0)
+        {
+            LodEntry lod;
+            lod.screenSize = model.getLodScreenSize(level);
+            lod.meshCount = (uint32_t)model.getLodMeshes(level).size();
+            lod.reserved = 0;
+            lods.push_back(lod);
+        }
+        for (const auto& geometry : model.getLodMeshes(level))
+        {
+            const TriangleMesh* mesh = dynamic_cast<const TriangleMesh*>(geometry.get());
+            if (mesh == nullptr)
+                return false;
+            meshes.push_back(mesh);
+        }
+    }
+
+    // lay out the data after the tables
+    std::vector<MeshEntry> entries(meshes.size());
+    uint64_t offset = align(sizeof(header) + lods.size() * sizeof(LodEntry) +
+        entries.size() * sizeof(MeshEntry));
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        const TriangleMesh& mesh = *meshes[m];
+        MeshEntry& entry = entries[m];
+        entry.vertexCount = mesh.getVertexCount();
+        entry.faceCount = mesh.getFaceCount();
+        for (int t = 0; t < GpuProgram::MAX_ATTRIBUTE_TYPES; t++)
+        {
+            entry.streamOffsets[t] = 0;
+            if (!mesh.hasType((GpuProgram::AttributeType)t))
+                continue;
+            entry.streamOffsets[t] = offset;
+            offset = align(offset + getStreamSize(t, entry.vertexCount));
+        }
+        entry.faceOffset = offset;
+        offset = align(offset + (uint64_t)entry.faceCount * sizeof(TriangleMesh::Face));
+
+        const Sphere& sphere = mesh.getBoundingSphere();
+        Vector3 center = sphere.getTranslation();
+        for (int c = 0; c < 3; c++)
+            entry.sphere[c] = center[c];
+        entry.sphere[3] = sphere.getRadius();
+
+        const Box& box = mesh.getAABB();
+        for (int c = 0; c < 3; c++)
+            entry.box[c] = box.getTranslation()[c];
+        entry.box[3] = box.getDimensions().x();
+    }
+
+    // write next to the cache and swap it in, so a failed write never leaves
+    // a cache that looks complete
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    const char padding[ALIGNMENT] = {};
+    auto pad = [&]() {
+        uint64_t position = (uint64_t)out.tellp();
+        out.write(padding, (std::streamsize)(align(position) - position));
+    };
+
+    out.write((const char*)&header, sizeof(header));
+    if (!lods.empty())
+        out.write((const char*)&lods[0], lods.size() * sizeof(LodEntry));
+    if (!entries.empty())
+        out.write((const char*)&entries[0], entries.size() * sizeof(MeshEntry));
+    pad();
+
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        const TriangleMesh& mesh = *meshes[m];
+        for (int t = 0; t < GpuProgram::MAX_ATTRIBUTE_TYPES; t++)
+        {
+            if (entries[m].streamOffsets[t] == 0 || mesh.getVertexCount() == 0)
+                continue;
+            out.write((const char*)mesh.getAttributeDataUnchecked(0, (GpuProgram::AttributeType)t),
+                (std::streamsize)getStreamSize(t, mesh.getVertexCount()));
+            pad();
+        }
+        if (mesh.getFaceCount() > 0)
+        {
+            out.write((const char*)mesh.getFaceData(0),
+                (std::streamsize)mesh.getFaceCount() * sizeof(TriangleMesh::Face));
+            pad();
+        }
+    }
+
+    out.close();
+    if (!out.good())
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+};
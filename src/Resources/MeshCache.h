@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for MeshCache class
+ *
+ * @file MeshCache.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_MESH_CACHE_H
+#define MAGIC3D_MESH_CACHE_H
+
+#include "ModelLoader.h"
+#include "ResourceData.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Magic3D
+{
+
+/** Binary cache of the meshes of loaded models, so later runs skip parsing
+ * the source file and generating normals, welding, optimizing and
+ * simplifying. A cache file holds, in order:
+ *  - a header with the format version, the size of Scalar, and hashes of
+ *    the source file and of the load options it was made with
+ *  - a table of levels of detail and a table of meshes, each mesh with the
+ *    offset of each attribute stream, of its faces, and its bounding volumes
+ *  - the streams and faces themselves, 16 byte aligned
+ *
+ * Loading maps the file and hands the streams to the meshes as they are,
+ * nothing is copied or calculated until a mesh is modified. A cache made
+ * from another version of the source, with other options, or by a build
+ * with another format or Scalar size is not used.
+ */
+class MeshCache
+{
+public:
+    /// version of the format and of the processing loaders do, changing
+    /// either one needs a new version so old caches are not used
+    static const uint32_t VERSION = 1;
+
+    /// hash the contents of a file with hashBytes, throws if it cannot be read
+    static uint64_t hashFile(const std::string& path);
+
+    /// hash every option that changes the meshes loaded
+    static uint64_t hashOptions(const MeshLoadOptions& options);
+
+    /** Get where the cache of a source file goes
+     * @param sourcePath    full path of the source file
+     * @param cacheDir      directory for cache files, empty to keep each next to its source
+     */
+    static std::string getCachePath(const std::string& sourcePath, const std::string& cacheDir);
+
+    /** Load a model from a cache file
+     * @param path          path of the cache file
+     * @param sourceHash    hash of the source file, see hashFile
+     * @param optionsHash   hash of the load options, see hashOptions
+     * @param layout        gpu memory layout for the meshes
+     * @return the model, or null if there is no usable cache
+     */
+    static std::shared_ptr<Model> load(const std::string& path, uint64_t sourceHash,
+        uint64_t optionsHash, TriangleMesh::VertexLayout layout);
+
+    /** Load a model from the contents of a cache file, like one in a pack,
+     * the meshes share the contents rather than copy them
+     * @param data          contents of the cache file
+     * @param sourceHash    hash of the source file, see hashFile
+     * @param optionsHash   hash of the load options, see hashOptions
+     * @param layout        gpu memory layout for the meshes
+     * @return the model, or null if the contents are not a usable cache
+     */
+    static std::shared_ptr<Model> load(const ResourceData& data, uint64_t sourceHash,
+        uint64_t optionsHash, TriangleMesh::VertexLayout layout);
+
+    /** Save the meshes and levels of detail of a model to a cache file
+     * @param path          path of the cache file
+     * @param model         model to save, all its meshes must be triangle meshes
+     * @param sourceHash    hash of the source file, see hashFile
+     * @param optionsHash   hash of the load options, see hashOptions
+     * @return false if the model could not be saved
+     */
+    static bool save(const std::string& path, Model& model, uint64_t sourceHash,
+        uint64_t optionsHash);
+};
+
+};
+
+#endif
@@ -4,6 +4,8 @@
 #include "./Resource.h"
 #include "../Math/Matrix4.h"
 #include "Objects\Model.h"
+#include "Mesh\TriangleMesh.h"
+#include "ResourceData.h"
 
 #include <string>
 #include <vector>
@@ -13,10 +15,43 @@
 namespace Magic3D
 {
 
+/// options applied to the meshes of models while they are loaded
+struct MeshLoadOptions
+{
+    /// whether to merge vertices that are equal in all attributes
+    bool weld;
+    TriangleMesh::WeldOptions weldOptions;
+
+    /// whether to reorder faces and vertices for the vertex cache, after welding
+    bool optimize;
+    TriangleMesh::OptimizeOptions optimizeOptions;
+
+    /// gpu memory layout of loaded meshes
+    TriangleMesh::VertexLayout layout;
+
+    /// number of coarser levels of detail to generate, see Model::generateLods
+    unsigned int lodLevels;
+
+    /// whether to keep processed meshes in a cache file for the next load, see MeshCache
+    bool cache;
+
+    inline MeshLoadOptions() : weld(true), optimize(true),
+        layout(TriangleMesh::VertexLayout::INTERLEAVED), lodLevels(0), cache(true) {}
+};
+
 class ModelLoader
 {
 public:
-	virtual std::shared_ptr<Model> getModel(const std::string& path) const = 0; 
+	/// load a model from the contents of its file
+	virtual std::shared_ptr<Model> getModel(const ResourceData& data,
+		const MeshLoadOptions& options = MeshLoadOptions()) const = 0;
+
+	/// load a model file
+	inline std::shared_ptr<Model> getModelFile(const std::string& path,
+		const MeshLoadOptions& options = MeshLoadOptions()) const
+	{
+		return this->getModel(ResourceData::mapFile(path), options);
+	}
 
 };
 
@@ -0,0 +1,250 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ResourceCache class
+ *
+ * @file ResourceCache.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_RESOURCE_CACHE_H
+#define MAGIC3D_RESOURCE_CACHE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+namespace Magic3D
+{
+
+/** Thread safe map of loaded resources by name and type. Names are hashed
+ * to one of a fixed number of shards, each with its own lock, so threads
+ * working on different resources rarely wait on each other.
+ *
+ * A resource being loaded holds the future of its load, so everyone asking
+ * for it meanwhile shares that one load instead of starting another. Only
+ * weak references to loaded resources are kept, entries of resources that
+ * were since destroyed are pruned as the shards grow.
+ */
+class ResourceCache
+{
+public:
+    /// result of a load
+    template<class T>
+    using Future = std::shared_future<std::shared_ptr<T>>;
+
+    /// what acquire() found for a resource
+    template<class T>
+    struct Claim
+    {
+        /// the resource, if it was loaded already
+        std::shared_ptr<T> loaded;
+
+        /// the load in flight, if not loaded
+        Future<T> loading;
+
+        /// whether the load finishes asynchronously, on the graphics thread
+        bool async;
+
+        /// set if the caller claimed the load, and must fulfil it and call
+        /// complete() or fail()
+        std::shared_ptr<std::promise<std::shared_ptr<T>>> promise;
+
+        inline Claim() : async(false) {}
+    };
+
+private:
+    static const unsigned int SHARD_COUNT = 16;
+
+    /// shards are pruned once they hold this many entries, at least
+    static const size_t MIN_PRUNE_SIZE = 64;
+
+    struct Key
+    {
+        std::type_index type;
+        std::string name;
+
+        inline bool operator==(const Key& key) const
+        {
+            return this->type == key.type && this->name == key.name;
+        }
+    };
+
+    struct KeyHash
+    {
+        inline size_t operator()(const Key& key) const
+        {
+            size_t hash = std::hash<std::string>()(key.name);
+            return hash ^ (key.type.hash_code() + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+        }
+    };
+
+    struct Entry
+    {
+        std::weak_ptr<void> resource;
+        std::shared_ptr<void> loading;  // Future of the type, null once loaded
+        bool async;
+
+        inline Entry() : async(false) {}
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<Key, Entry, KeyHash> entries;
+        size_t pruneSize;
+
+        inline Shard() : pruneSize(MIN_PRUNE_SIZE) {}
+    };
+
+    Shard shards[SHARD_COUNT];
+
+    inline Shard& getShard(const Key& key)
+    {
+        return this->shards[KeyHash()(key) % SHARD_COUNT];
+    }
+
+    /// remove entries of destroyed resources from a locked shard
+    static inline size_t pruneShard(Shard& shard)
+    {
+        size_t removed = 0;
+        for (auto it = shard.entries.begin(); it != shard.entries.end();)
+        {
+            if (it->second.loading == nullptr && it->second.resource.expired())
+            {
+                it = shard.entries.erase(it);
+                removed++;
+            }
+            else
+                it++;
+        }
+        return removed;
+    }
+
+    template<class T>
+    static inline Key makeKey(const std::string& name)
+    {
+        Key key = { std::type_index(typeid(T)), name };
+        return key;
+    }
+
+public:
+    /** Get a resource if loaded, join its load if in flight, or claim its
+     * load otherwise
+     * @param name  name of the resource
+     * @param async whether the load would be asynchronous, if claimed
+     * @return what was found, see Claim
+     */
+    template<class T>
+    inline Claim<T> acquire(const std::string& name, bool async)
+    {
+        Key key = makeKey<T>(name);
+        Shard& shard = this->getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        Claim<T> claim;
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end())
+        {
+            if (it->second.loading != nullptr)
+            {
+                claim.loading = *std::static_pointer_cast<Future<T>>(it->second.loading);
+                claim.async = it->second.async;
+                return claim;
+            }
+
+            claim.loaded = std::static_pointer_cast<T>(it->second.resource.lock());
+            if (claim.loaded != nullptr)
+                return claim;
+        }
+        else if (shard.entries.size() >= shard.pruneSize)
+        {
+            pruneShard(shard);
+            shard.pruneSize = std::max<size_t>(shard.entries.size() * 2, +MIN_PRUNE_SIZE);
+        }
+
+        claim.promise = std::make_shared<std::promise<std::shared_ptr<T>>>();
+        claim.loading = claim.promise->get_future().share();
+        claim.async = async;
+
+        Entry& entry = shard.entries[key];
+        entry.resource.reset();
+        entry.loading = std::make_shared<Future<T>>(claim.loading);
+        entry.async = async;
+        return claim;
+    }
+
+    /// record a claimed load as done, before fulfilling its promise
+    template<class T>
+    inline void complete(const std::string& name, const std::shared_ptr<T>& resource)
+    {
+        Key key = makeKey<T>(name);
+        Shard& shard = this->getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        Entry& entry = shard.entries[key];
+        entry.resource = resource;
+        entry.loading = nullptr;
+    }
+
+    /// record a claimed load as failed, so the next request tries again
+    template<class T>
+    inline void fail(const std::string& name)
+    {
+        Key key = makeKey<T>(name);
+        Shard& shard = this->getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.erase(key);
+    }
+
+    /** Remove the entries of all resources that were destroyed
+     * @return the number of entries removed
+     */
+    inline size_t prune()
+    {
+        size_t removed = 0;
+        for (Shard& shard : this->shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            removed += pruneShard(shard);
+        }
+        return removed;
+    }
+
+    /// get the number of entries, including ones not pruned yet
+    inline size_t getSize()
+    {
+        size_t size = 0;
+        for (Shard& shard : this->shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size += shard.entries.size();
+        }
+        return size;
+    }
+};
+
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ResourceData class
+ *
+ * @file ResourceData.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_RESOURCE_DATA_H
+#define MAGIC3D_RESOURCE_DATA_H
+
+#include <Util\MappedFile.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace Magic3D
+{
+
+/** Read-only contents of a resource file, from a file on its own or an
+ * entry of a resource pack. Copies share the bytes, which stay valid for
+ * as long as any copy does.
+ */
+class ResourceData
+{
+    const unsigned char* data;
+    size_t size;
+    std::shared_ptr<const void> owner;
+
+public:
+    inline ResourceData() : data(nullptr), size(0) {}
+
+    /** Wrap bytes
+     * @param data  the bytes
+     * @param size  number of bytes
+     * @param owner keeps the bytes valid
+     */
+    inline ResourceData(const unsigned char* data, size_t size, std::shared_ptr<const void> owner) :
+        data(data), size(size), owner(owner) {}
+
+    /// map a whole file, throws if it cannot be
+    static inline ResourceData mapFile(const std::string& path)
+    {
+        auto file = std::make_shared<MappedFile>(path);
+        return ResourceData(file->getData(), file->getSize(), file);
+    }
+
+    /// get the bytes, null if there are none
+    inline const unsigned char* getData() const
+    {
+        return this->data;
+    }
+
+    inline size_t getSize() const
+    {
+        return this->size;
+    }
+
+    /// get what keeps the bytes valid, for sharing them further
+    inline const std::shared_ptr<const void>& getOwner() const
+    {
+        return this->owner;
+    }
+};
+
+};
+
+#endif
@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Resources\ResourceIndex.h>
+
+#include <algorithm>
+#include <cctype>
+
+// include dependent on OS (Windows or everyone else)
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace Magic3D
+{
+
+/// add the paths, relative to a directory, of the files in one of its subdirectories
+static void listDir(const std::string& dir, const std::string& relative,
+    std::vector<std::string>& files)
+{
+    std::string path = relative.empty() ? dir : dir + "/" + relative;
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA((path + "/*").c_str(), &found);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        std::string name = found.cFileName;
+        if (name == "." || name == "..")
+            continue;
+        std::string child = relative.empty() ? name : relative + "/" + name;
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            listDir(dir, child, files);
+        else
+            files.push_back(child);
+    } while (FindNextFileA(find, &found));
+    FindClose(find);
+#else
+    DIR* handle = opendir(path.c_str());
+    if (handle == nullptr)
+        return;
+    while (dirent* entry = readdir(handle))
+    {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string child = relative.empty() ? name : relative + "/" + name;
+
+        // follows links, like opening the file would
+        struct stat info;
+        if (stat((path + "/" + name).c_str(), &info) != 0)
+            continue;
+        if (S_ISDIR(info.st_mode))
+            listDir(dir, child, files);
+        else if (S_ISREG(info.st_mode))
+            files.push_back(child);
+    }
+    closedir(handle);
+#endif
+}
+
+std::string ResourceIndex::normalize(const std::string& path)
+{
+    std::string key = path;
+    std::replace(key.begin(), key.end(), '\\', '/');
+    while (key.compare(0, 2, "./") == 0)
+        key.erase(0, 2);
+#ifdef _WIN32
+    std::transform(key.begin(), key.end(), key.begin(),
+        [](char c) { return (char)tolower((unsigned char)c); });
+#endif
+    return key;
+}
+
+std::vector<std::string> ResourceIndex::listFiles(const std::string& dir)
+{
+    std::vector<std::string> files;
+    listDir(dir, "", files);
+    return files;
+}
+
+void ResourceIndex::scan(const Mount& mount, FileMap& files)
+{
+    // emplace keeps files of directories and packs added before
+    if (mount.pack != nullptr)
+    {
+        for (size_t i = 0; i < mount.pack->getEntryCount(); i++)
+        {
+            std::string name = mount.pack->getName(i);
+            files.emplace(normalize(name), File(mount.pack->getPath() + "/" + name, mount.pack, i));
+        }
+        return;
+    }
+
+    for (const std::string& relative : listFiles(mount.dir))
+        files.emplace(normalize(relative), File(mount.dir + "/" + relative));
+}
+
+void ResourceIndex::addDir(const std::string& dir)
+{
+    Mount mount;
+    mount.dir = dir;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->mounts.push_back(mount);
+    scan(mount, this->files);
+}
+
+void ResourceIndex::addPack(std::shared_ptr<const ResourcePack> pack)
+{
+    Mount mount;
+    mount.pack = pack;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->mounts.push_back(mount);
+    scan(mount, this->files);
+}
+
+void ResourceIndex::refresh()
+{
+    std::vector<Mount> mounts;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        mounts = this->mounts;
+    }
+
+    // scan without the lock, so lookups meanwhile use the old index
+    FileMap files;
+    for (const Mount& mount : mounts)
+        scan(mount, files);
+
+    // directories and packs added meanwhile come after the ones scanned
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (size_t i = mounts.size(); i < this->mounts.size(); i++)
+        scan(this->mounts[i], files);
+    this->files.swap(files);
+}
+
+ResourceIndex::File ResourceIndex::find(const std::string& path) const
+{
+    std::string key = normalize(path);
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->files.find(key);
+    if (it == this->files.end())
+        return File();
+    return it->second;
+}
+
+size_t ResourceIndex::getSize() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->files.size();
+}
+
+};
@@ -0,0 +1,167 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ResourceIndex class
+ *
+ * @file ResourceIndex.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_RESOURCE_INDEX_H
+#define MAGIC3D_RESOURCE_INDEX_H
+
+#include "ResourceData.h"
+#include "ResourcePack.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Magic3D
+{
+
+/** Index of the files in resource directories and packs, so finding a
+ * resource is a hash lookup instead of trying to open it in each
+ * directory. Directories are scanned, recursively, when added and when
+ * refreshed; files added or removed in between are not seen until
+ * refresh() is called. When several directories or packs have the same
+ * file, the one added first is used.
+ *
+ * Paths use '/' separators, '\' in lookups is treated the same. Lookups
+ * ignore case on Windows, as its file system does.
+ */
+class ResourceIndex
+{
+public:
+    /// a file found, either on its own or in a pack
+    class File
+    {
+        std::string fullPath;
+        std::shared_ptr<const ResourcePack> pack;
+        size_t entry;
+
+    public:
+        /// no file
+        inline File() : entry(0) {}
+
+        /// a file on its own
+        inline File(const std::string& fullPath) : fullPath(fullPath), entry(0) {}
+
+        /// an entry of a pack
+        inline File(const std::string& fullPath, std::shared_ptr<const ResourcePack> pack,
+            size_t entry) : fullPath(fullPath), pack(pack), entry(entry) {}
+
+        inline bool exists() const
+        {
+            return !this->fullPath.empty();
+        }
+
+        /// get the path of the file, for a pack entry the path of the pack
+        /// followed by the name of the entry
+        inline const std::string& getFullPath() const
+        {
+            return this->fullPath;
+        }
+
+        inline bool isPacked() const
+        {
+            return this->pack != nullptr;
+        }
+
+        /// find the entry of the same pack named like this one plus a
+        /// suffix, does not exist if there is none or this is not packed
+        inline File getPackedSibling(const std::string& suffix) const
+        {
+            size_t sibling;
+            if (this->pack == nullptr ||
+                !this->pack->find(this->pack->getName(this->entry) + suffix, sibling))
+                return File();
+            return File(this->fullPath + suffix, this->pack, sibling);
+        }
+
+        /// read the file, throws if it cannot be
+        inline ResourceData read() const
+        {
+            if (this->pack != nullptr)
+                return this->pack->read(this->entry);
+            return ResourceData::mapFile(this->fullPath);
+        }
+    };
+
+private:
+    /// a directory or a pack
+    struct Mount
+    {
+        std::string dir;
+        std::shared_ptr<const ResourcePack> pack;
+    };
+
+    /// directories and packs, in order
+    std::vector<Mount> mounts;
+
+    /// files by path relative to their directory or pack
+    typedef std::unordered_map<std::string, File> FileMap;
+    FileMap files;
+
+    /// guards mounts and files, lookups come from loader threads
+    mutable std::mutex mutex;
+
+    /// add the files of a directory or pack not found in ones added before
+    static void scan(const Mount& mount, FileMap& files);
+
+    /// get the key of a relative path
+    static std::string normalize(const std::string& path);
+
+public:
+    /** List the files of a directory and all its subdirectories
+     * @param dir   the directory
+     * @return '/' separated paths of the files relative to the directory,
+     *         empty if it cannot be read
+     */
+    static std::vector<std::string> listFiles(const std::string& dir);
+
+    /// add a directory and index its files
+    void addDir(const std::string& dir);
+
+    /// add a pack and index its files
+    void addPack(std::shared_ptr<const ResourcePack> pack);
+
+    /// scan all directories again, to see files added or removed since
+    void refresh();
+
+    /** Find a file
+     * @param path  path relative to the resource directories
+     * @return the file, which does not exist if there is none
+     */
+    File find(const std::string& path) const;
+
+    /// check if a file is in any resource directory
+    inline bool contains(const std::string& path) const
+    {
+        return this->find(path).exists();
+    }
+
+    /// get the number of files indexed
+    size_t getSize() const;
+};
+
+};
+
+#endif
@@ -31,6 +31,17 @@ namespace Magic3D
 {
 	
 	
+ResourceManager::ResourceManager() : asyncLoadCount(0), programCacheEnabled(true),
+    loadThreadCount(2)
+{
+	// singletons are created on first use, which must not be on several
+	// loader threads at once
+	ImageLoaders::getSingleton();
+	ModelLoaders::getSingleton();
+	ColorParser::getSingleton();
+	GpuProgramParser::getSingleton();
+}
+
 /// destructor
 ResourceManager::~ResourceManager()
 {
@@ -35,14 +35,31 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 #include <map>
 #include <memory>
-#include <fstream>
+#include <cstring>
 #include <vector>
+#include <deque>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
 #include <tinyxml2.h>
 #include <Util/Color.h>
+#include <Util/ThreadPool.h>
+#include <Util/Hash.h>
 #include <Graphics\Material.h>
+#include <Graphics\CompressedImage.h>
+#include <Graphics\MipmapBuilder.h>
 #include <Graphics\MaterialBuilder.h>
 #include <CollisionShapes\CollisionShape.h>
 #include "ModelLoader.h"
+#include "MeshCache.h"
+#include "ResourceCache.h"
+#include "ResourceIndex.h"
+#include "ResourcePack.h"
+#include <Shaders\ProgramCache.h>
+#include <Shaders\FrameUniforms.h>
 
 
 namespace Magic3D
@@ -50,142 +67,500 @@ namespace Magic3D
 
 
 /** Manages access to resources (text, image, raw data, models, etc.)
+ *
+ * Resources load in two stages, reading and decoding, which can run on
+ * any thread, and creating the graphics objects, which needs the graphics
+ * context. get() runs both right away. getAsync() runs the first on loader
+ * threads and queues the second for processUploads(), which the graphics
+ * thread calls once a frame. Resources a load depends on, like the shaders
+ * of a gpu program, are loaded the same way as the load itself.
+ *
+ * Any thread may ask for resources. A resource is only ever loaded once at
+ * a time, everyone asking for it while it loads waits for that load.
  */
 class ResourceManager
 {
+public:
+	/// result of an asynchronous load, see getAsync
+	template<class T>
+	using Future = ResourceCache::Future<T>;
+
 private:
-	/// mapping of resource names and resources
-	std::map<std::string, std::weak_ptr<Resource>> resources;
-	
-	/// directory where resources are contained
-	std::vector<std::string> resourceDirs;
+	/** Resources a load depends on, got right away for synchronous loads or
+	 * started loading for asynchronous ones, which only finish once all of
+	 * them are ready
+	 */
+	class LoadContext
+	{
+		ResourceManager& manager;
+		bool async;
+		std::vector<std::function<bool()>> dependencies;
+
+	public:
+		inline LoadContext(ResourceManager& manager, bool async) :
+			manager(manager), async(async) {}
+
+		template<class T>
+		inline Future<T> depend(const std::string& path)
+		{
+			if (!this->async)
+				return ResourceManager::makeReady(this->manager.get<T>(path));
+
+			Future<T> future = this->manager.getAsync<T>(path);
+			this->dependencies.push_back([future]() {
+				return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+			});
+			return future;
+		}
+
+		inline bool isReady() const
+		{
+			for (const auto& dependency : this->dependencies)
+			{
+				if (!dependency())
+					return false;
+			}
+			return true;
+		}
+	};
 
+	/// second stage of a load, creates the resource with the graphics context
 	template<class T>
-	inline std::shared_ptr<T> _get(const std::string& fullPath)
+	using Finish = std::function<std::shared_ptr<T>()>;
+
+	/// second stage of an asynchronous load, waiting for its dependencies
+	struct Upload
+	{
+		std::function<bool()> isReady;
+		std::function<void()> run;
+	};
+
+	/// resources loaded and loading, by name and type
+	ResourceCache cache;
+
+	/// number of asynchronous loads not finished yet
+	std::atomic<unsigned int> asyncLoadCount;
+
+	/// guards uploads
+	std::mutex mutex;
+
+	/// asynchronous loads waiting for the graphics thread, in order
+	std::deque<Upload> uploads;
+
+	/// files in the directories and packs resources are contained in
+	ResourceIndex resourceIndex;
+
+	/// options used when loading models
+	MeshLoadOptions meshLoadOptions;
+
+	/// directory for mesh cache files, empty to keep them next to the models
+	std::string meshCacheDir;
+
+	/// whether linked programs are cached, see ProgramCache
+	bool programCacheEnabled;
+
+	/// directory for program cache files, empty to keep them next to the programs
+	std::string programCacheDir;
+
+	/// number of threads for asynchronous loads
+	unsigned int loadThreadCount;
+
+	/// threads for asynchronous loads, created with the first one, last so
+	/// queued loads finish before anything else is destroyed
+	std::unique_ptr<ThreadPool> loadPool;
+
+	/// first stage of a load, returns the second stage
+	template<class T>
+	inline Finish<T> _prepare(const ResourceIndex::File& file, LoadContext& context)
 	{
 		/* intentionally left blank, always need a specialization */
 	}
 
-	inline std::string getFullPath(const std::string& path)
+	template<class T>
+	static inline Future<T> makeReady(std::shared_ptr<T> resource)
 	{
-		for (const std::string& basePath : resourceDirs)
+		std::promise<std::shared_ptr<T>> promise;
+		promise.set_value(resource);
+		return promise.get_future().share();
+	}
+
+	/// find the file of a resource, throws if there is none
+	inline ResourceIndex::File findFile(const std::string& path)
+	{
+		ResourceIndex::File file = this->resourceIndex.find(path);
+		if (!file.exists())
+			throw_ResourceNotFoundException(path);
+		return file;
+	}
+
+	/// read a whole file as text
+	std::shared_ptr<TextResource> readText(const ResourceData& data);
+
+	/// both stages of an asynchronous load
+	template<class T>
+	inline void loadAsync(const std::string& path,
+		std::shared_ptr<std::promise<std::shared_ptr<T>>> promise)
+	{
+		try
+		{
+			ResourceIndex::File file = this->findFile(path);
+			auto context = std::make_shared<LoadContext>(*this, true);
+			Finish<T> finish = this->_prepare<T>(file, *context);
+
+			Upload upload;
+			upload.isReady = [context]() { return context->isReady(); };
+			upload.run = [this, path, promise, finish]() {
+				try
+				{
+					std::shared_ptr<T> resource = finish();
+					this->cache.complete(path, resource);
+					this->asyncLoadCount--;
+					promise->set_value(resource);
+				}
+				catch (...)
+				{
+					this->failLoad<T>(path, promise);
+				}
+			};
+
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->uploads.push_back(upload);
+		}
+		catch (...)
 		{
-			std::ifstream test;
-			std::string fullPath = basePath + "/" + path;
-			test.open(fullPath.c_str());
-			if (test.is_open() && test.good())
-				return fullPath;
+			this->failLoad<T>(path, promise);
 		}
-		return "";
 	}
-	
+
+	/// end an asynchronous load with the exception being handled
+	template<class T>
+	inline void failLoad(const std::string& path,
+		std::shared_ptr<std::promise<std::shared_ptr<T>>> promise)
+	{
+		this->cache.fail<T>(path);
+		this->asyncLoadCount--;
+		promise->set_exception(std::current_exception());
+	}
+
 public:
 
-	inline ResourceManager() {}
-		
+	ResourceManager();
+
 	/// destructor
 	virtual ~ResourceManager();
 
+	/// add a directory resources are contained in, its files are indexed
+	/// right away, see refreshResourceDirs
 	inline void addResourceDir(const std::string& dir)
 	{
-		this->resourceDirs.push_back(dir);
+		this->resourceIndex.addDir(dir);
 	}
-		
+
+	/** add a resource pack, see ResourcePack. Its files are found like
+	 * those of directories, the directory or pack added first wins.
+	 * @param path  path of the pack, throws if it is not a valid pack
+	 */
+	inline void addResourcePack(const std::string& path)
+	{
+		this->resourceIndex.addPack(std::make_shared<ResourcePack>(path));
+	}
+
+	/// index the resource directories again, to find files added or
+	/// removed since they were added
+	inline void refreshResourceDirs()
+	{
+		this->resourceIndex.refresh();
+	}
+
+	/// set the options used for models loaded from now on
+	inline void setMeshLoadOptions(const MeshLoadOptions& options)
+	{
+		this->meshLoadOptions = options;
+	}
+
+	inline const MeshLoadOptions& getMeshLoadOptions() const
+	{
+		return this->meshLoadOptions;
+	}
+
+	/// set the directory mesh cache files are kept in, empty to keep them next to the models
+	inline void setMeshCacheDir(const std::string& dir)
+	{
+		this->meshCacheDir = dir;
+	}
+
+	inline const std::string& getMeshCacheDir() const
+	{
+		return this->meshCacheDir;
+	}
+
+	/// set whether linked programs are cached for the next run, on by default
+	inline void setProgramCacheEnabled(bool enabled)
+	{
+		this->programCacheEnabled = enabled;
+	}
+
+	inline bool isProgramCacheEnabled() const
+	{
+		return this->programCacheEnabled;
+	}
+
+	/// set the directory program cache files are kept in, empty to keep them next to the programs
+	inline void setProgramCacheDir(const std::string& dir)
+	{
+		this->programCacheDir = dir;
+	}
+
+	inline const std::string& getProgramCacheDir() const
+	{
+		return this->programCacheDir;
+	}
+
+	/// set the number of threads for asynchronous loads, before the first one
+	inline void setLoadThreadCount(unsigned int count)
+	{
+		MAGIC_THROW(this->loadPool != nullptr,
+			"Tried to set the number of load threads after loading started.");
+		this->loadThreadCount = std::max(count, 1u);
+	}
+
 	/** Check if a resource exists, to be to avoid exceptions for optional resources
 	 * @param name the name of the resource
 	 * @return true for exists, false otherwise
 	 */
 	inline bool doesResourceExist(const std::string& path)
 	{
-		return (this->getFullPath(path) != "");
+		return this->resourceIndex.contains(path);
 	}
-		
-	/** get a resource
+
+	/** get a resource, loading it on the calling thread if needed, which
+	 * must have the graphics context. If another thread is loading it
+	 * already, waits for that load instead.
 	 * @param name the name of the resource including any extra path info
 	 * @return handle to resource
 	 */
 	template <class T>
 	inline std::shared_ptr<T> get(const std::string& path)
 	{
-		// check if resource is already loaded
-		auto it = resources.find(path);
-		if (it != resources.end() && !it->second.expired())
+		ResourceCache::Claim<T> claim = this->cache.acquire<T>(path, false);
+		if (claim.loaded != nullptr)
+			return claim.loaded;
+
+		if (claim.promise == nullptr)
 		{
-			std::shared_ptr<Resource> ptr = std::shared_ptr<Resource>(it->second);
-			return std::dynamic_pointer_cast<T>(ptr);
+			// the graphics objects of asynchronous loads are created by this
+			// thread, so keep creating them while waiting
+			if (claim.async)
+			{
+				while (claim.loading.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready)
+					this->processUploads(0);
+			}
+			return claim.loading.get();
 		}
-		
+
 		// otherwise, create new resource
+		std::shared_ptr<T> resource;
+		try
+		{
+			// make sure file exists
+			ResourceIndex::File file = this->findFile(path);
 
-		// make sure file exists
-		std::string fullPath = this->getFullPath(path);
-		if (fullPath == "")
-			throw_ResourceNotFoundException(path);
+			// load resource
+			LoadContext context(*this, false);
+			resource = this->_prepare<T>(file, context)();
+		}
+		catch (...)
+		{
+			this->cache.fail<T>(path);
+			claim.promise->set_exception(std::current_exception());
+			throw;
+		}
 
-		// load resource
-		std::shared_ptr<T> resource = this->_get<T>(fullPath);
-		resources.insert(std::pair<std::string, std::weak_ptr<Resource>>(
-			path, std::weak_ptr<Resource>(std::dynamic_pointer_cast<Resource>(resource))));
+		this->cache.complete(path, resource);
+		claim.promise->set_value(resource);
 		return resource;
 	}
-	
-};
 
+	/** get a resource without waiting for it to load. Files are read and
+	 * decoded on loader threads, graphics objects are created during
+	 * processUploads(). Asking again for a resource still loading gives
+	 * the same load.
+	 * @param path the name of the resource including any extra path info
+	 * @return future for the resource, holding the exception if loading fails
+	 */
+	template <class T>
+	inline Future<T> getAsync(const std::string& path)
+	{
+		ResourceCache::Claim<T> claim = this->cache.acquire<T>(path, true);
+		if (claim.loaded != nullptr)
+			return makeReady(claim.loaded);
+		if (claim.promise == nullptr)
+			return claim.loading;
+
+		this->asyncLoadCount++;
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			if (this->loadPool == nullptr)
+				this->loadPool.reset(new ThreadPool(this->loadThreadCount + 1)); // counts the caller
+		}
 
-template<>
-inline std::shared_ptr<TextResource> ResourceManager::_get<TextResource>(const std::string& fullPath)
-{
-	std::ifstream file;
-	file.open (fullPath, std::ios::binary );
-	
-	if (!file.is_open() || !file.good())
+		// outside the lock, a pool without workers runs the load right here
+		auto promise = claim.promise;
+		this->loadPool->submit([this, path, promise]() {
+			this->loadAsync<T>(path, promise);
+		});
+		return claim.loading;
+	}
+
+	/** Forget resources that were destroyed since they were loaded. Happens
+	 * on its own as more resources are loaded, this frees it all at once,
+	 * like after unloading a level.
+	 * @return the number of resources forgotten
+	 */
+	inline size_t pruneCache()
+	{
+		return this->cache.prune();
+	}
+
+	/** Create the graphics objects of asynchronous loads whose files are
+	 * read and whose dependencies are ready, in the order they got ready.
+	 * Must be called on the thread with the graphics context, once a frame.
+	 * Stops once the time spent passes the budget, but always finishes at
+	 * least one load if any is ready, so loads keep going.
+	 * @param budget seconds to spend
+	 * @return the number of asynchronous loads not finished yet
+	 */
+	inline unsigned int processUploads(double budget = 0.002)
 	{
-		file.close();
-		throw_MagicException("Failed to open text resource");
+		auto start = std::chrono::steady_clock::now();
+		while (true)
+		{
+			Upload upload;
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				auto it = std::find_if(this->uploads.begin(), this->uploads.end(),
+					[](const Upload& candidate) { return candidate.isReady(); });
+				if (it == this->uploads.end())
+					break;
+				upload = *it;
+				this->uploads.erase(it);
+			}
+			upload.run();
+
+			std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+			if (spent.count() >= budget)
+				break;
+		}
+
+		return this->asyncLoadCount;
 	}
 
-	// get length of file:
-	file.seekg (0, std::ios::end);
-	int length = (int)file.tellg();
-	file.seekg (0, std::ios::beg);
+};
+
 
-	// read all data into memory
+inline std::shared_ptr<TextResource> ResourceManager::readText(const ResourceData& data)
+{
+	// copy all data, null terminated
+	size_t length = data.getSize();
 	char* text = new char [length+1];
-	file.read (text,length);
+	if (length > 0)
+		memcpy(text, data.getData(), length);
 	text[length] = 0; // null terminated string
-  
+
 	return std::make_shared<TextResource>(text);
 }
 
 template<>
-inline std::shared_ptr<Image> ResourceManager::_get<Image>(const std::string& fullPath)
+inline ResourceManager::Finish<TextResource> ResourceManager::_prepare<TextResource>(
+	const ResourceIndex::File& file, LoadContext& context)
 {
+	auto text = this->readText(file.read());
+	return [text]() { return text; };
+}
+
+template<>
+inline ResourceManager::Finish<Image> ResourceManager::_prepare<Image>(
+	const ResourceIndex::File& file, LoadContext& context)
+{
+	const std::string& fullPath = file.getFullPath();
 	std::string ext = fullPath.substr(fullPath.find_last_of(".")+1);
 	auto loader = ImageLoaders::getSingleton().get(ext);
 	// TODO: add exception
-	return loader->getImage(fullPath);
+	auto image = loader->getImage(file.read());
+	return [image]() { return image; };
 }
 
 template<>
-inline std::shared_ptr<FontResource> ResourceManager::_get<FontResource>(const std::string& fullPath)
+inline ResourceManager::Finish<FontResource> ResourceManager::_prepare<FontResource>(
+	const ResourceIndex::File& file, LoadContext& context)
 {
 	// TODO: add loaders for other formats
-	return std::make_shared<TTFontResource>(fullPath, fullPath);
+	// freetype is not safe to use from several threads, so open the font
+	// on the graphics thread with everything else
+	ResourceData data = file.read();
+	std::string fullPath = file.getFullPath();
+	return [data, fullPath]() -> std::shared_ptr<FontResource> {
+		return std::make_shared<TTFontResource>(data, fullPath);
+	};
 }
 
 template<>
-inline std::shared_ptr<Model> ResourceManager::_get<Model>(const std::string& fullPath)
+inline ResourceManager::Finish<Model> ResourceManager::_prepare<Model>(
+	const ResourceIndex::File& file, LoadContext& context)
 {
+	const std::string& fullPath = file.getFullPath();
 	std::string ext = fullPath.substr(fullPath.find_last_of(".")+1);
-	return ModelLoaders::getSingleton().get(ext)->getModel(fullPath);
+	auto loader = ModelLoaders::getSingleton().get(ext);
+	MeshLoadOptions options = this->meshLoadOptions;
+	ResourceData data = file.read();
+
+	std::shared_ptr<Model> model;
+	std::string cachePath;
+	uint64_t sourceHash = 0;
+	uint64_t optionsHash = 0;
+	if (options.cache)
+	{
+		// use the meshes processed last time, if the file and options did not change
+		sourceHash = hashBytes(data.getData(), data.getSize());
+		optionsHash = MeshCache::hashOptions(options);
+
+		// packs cannot be written to, caches of packed models are packed
+		// beside them or kept in the cache directory
+		ResourceIndex::File packedCache = file.getPackedSibling(".m3dmesh");
+		if (packedCache.exists())
+			model = MeshCache::load(packedCache.read(), sourceHash, optionsHash, options.layout);
+		if (!file.isPacked() || !this->meshCacheDir.empty())
+			cachePath = MeshCache::getCachePath(fullPath, this->meshCacheDir);
+		if (model == nullptr && !cachePath.empty())
+			model = MeshCache::load(cachePath, sourceHash, optionsHash, options.layout);
+	}
+
+	if (model == nullptr)
+	{
+		model = loader->getModel(data, options);
+		if (!cachePath.empty())
+			MeshCache::save(cachePath, *model, sourceHash, optionsHash); // a missing cache only costs time
+	}
+
+	return [model]() {
+		// copy the meshes to gpu memory now, rather than on their first draw
+		for (unsigned int level = 0; level < model->getLodCount(); level++)
+		{
+			for (const auto& mesh : model->getLodMeshes(level))
+				mesh->getTriangleMesh().upload();
+		}
+		return model;
+	};
 }
 
 template<>
-inline std::shared_ptr<Shader> ResourceManager::_get<Shader>(const std::string& fullPath)
+inline ResourceManager::Finish<Shader> ResourceManager::_prepare<Shader>(
+	const ResourceIndex::File& file, LoadContext& context)
 {
-	auto text = this->_get<TextResource>(fullPath);
+	auto text = this->readText(file.read());
+	const std::string& fullPath = file.getFullPath();
 	std::string ext = fullPath.substr(fullPath.find_last_of(".")+1);
-	
+
 	// TODO: add else case and exception
 	Shader::Type type = Shader::Type::COMPUTE;
 	if (ext == "vp")
@@ -193,7 +568,7 @@ inline std::shared_ptr<Shader> ResourceManager::_get<Shader>(const std::string&
 	else if (ext == "fp")
 		type = Shader::Type::FRAGMENT;
 
-	return std::make_shared<Shader>(text->getText(), type);
+	return [text, type]() { return std::make_shared<Shader>(text->getText(), type); };
 }
 
 class ColorParser
@@ -242,10 +617,12 @@ public:
 };
 
 template<>
-inline std::shared_ptr<Texture> ResourceManager::_get<Texture>(const std::string& fullPath)
+inline ResourceManager::Finish<Texture> ResourceManager::_prepare<Texture>(
+	const ResourceIndex::File& file, LoadContext& context)
 {
 	tinyxml2::XMLDocument doc;
-	tinyxml2::XMLError error = doc.LoadFile(fullPath.c_str());
+	ResourceData data = file.read();
+	tinyxml2::XMLError error = doc.Parse((const char*)data.getData(), data.getSize());
 	// TODO: check doc load error and throw exception
 
 	// TODO: check nodes for null and throw exception
@@ -254,9 +631,44 @@ inline std::shared_ptr<Texture> ResourceManager::_get<Texture>(const std::string
 	tinyxml2::XMLElement* imageNode = textureNode->FirstChildElement("image");
 	const char* imageRef = imageNode->Attribute("ref");
 
+    bool removeGammaCorrection = true;
+    auto gammaNode = textureNode->FirstChildElement("removeGammaCorrection");
+    if (gammaNode != nullptr)
+    {
+        auto gammaVal = gammaNode->GetText();
+        if (gammaVal != nullptr && std::string(gammaVal) == "false")
+            removeGammaCorrection = false;
+    }
+
+	// images compressed when resources were built sit beside them, with
+	// all their mipmaps, see CompressedImage. They are used unless the
+	// image changed since, then the image is loaded as if there were none
+	ResourceIndex::File imageFile = this->resourceIndex.find(imageRef);
+	ResourceIndex::File compressedFile = this->resourceIndex.find(std::string(imageRef) + ".dds");
+	if (compressedFile.exists())
+	{
+		auto compressed = std::make_shared<CompressedImage>(
+			CompressedImage::readDds(compressedFile.read()));
+		bool current = true;
+		if (imageFile.exists())
+		{
+			ResourceData imageData = imageFile.read();
+			current = compressed->getSourceHash() ==
+				hashBytes(imageData.getData(), imageData.getSize());
+		}
+		if (current)
+		{
+			return [compressed, removeGammaCorrection]() {
+				return std::make_shared<Texture>(*compressed, removeGammaCorrection);
+			};
+		}
+	}
+
+	// the image is read here rather than depended on, as its mipmaps are
+	// built right away on this loading thread
 	std::shared_ptr<Image> image;
-	if (this->doesResourceExist(imageRef))
-		image = this->get<Image>(imageRef);
+	if (imageFile.exists())
+		image = this->_prepare<Image>(imageFile, context)();
 	else
 	{
 		tinyxml2::XMLElement* fallbackNode = textureNode->FirstChildElement("fallback");
@@ -265,20 +677,37 @@ inline std::shared_ptr<Texture> ResourceManager::_get<Texture>(const std::string
 		image = std::make_shared<Image>(1, 1, color.getChannelCount(), color);
 	}
 
-    bool removeGammaCorrection = true;
-    auto gammaNode = textureNode->FirstChildElement("removeGammaCorrection");
-    if (gammaNode != nullptr)
-    {
-        auto gammaVal = gammaNode->GetText();
-        if (gammaVal != nullptr && std::string(gammaVal) == "false")
-            removeGammaCorrection = false;
-    }
+	// normal maps are named *.normals.tex.xml
+	const std::string& texturePath = file.getFullPath();
+	size_t suffix = texturePath.rfind(".normals.tex.xml");
+	bool normalMap = suffix != std::string::npos && suffix + 16 == texturePath.size();
+
+	// mipmaps are kaiser filtered unless told otherwise, NONE for no mipmaps
+	bool mipmapped = true;
+	MipmapBuilder::Options options(MipmapBuilder::Filter::KAISER, removeGammaCorrection, normalMap);
+	auto filterNode = textureNode->FirstChildElement("mipmapFilter");
+	if (filterNode != nullptr && filterNode->GetText() != nullptr)
+	{
+		std::string filter = filterNode->GetText();
+		if (filter == "NONE")
+			mipmapped = false;
+		else if (filter == "BOX")
+			options.filter = MipmapBuilder::Filter::BOX;
+	}
+
+	auto wrapNode = textureNode->FirstChildElement("wrapMode");
+	if (wrapNode != nullptr && wrapNode->GetText() != nullptr)
+		options.wrap = std::string(wrapNode->GetText()) == "REPEAT";
+
+	auto mipmaps = std::make_shared<std::vector<std::shared_ptr<Image>>>();
+	if (mipmapped)
+		*mipmaps = MipmapBuilder::build(*image, options);
 
-    auto texture = std::make_shared<Texture>(*image, removeGammaCorrection);
-	
 	// TODO: parse wrap mode and other texture properties
 
-	return texture;
+	return [image, mipmaps, removeGammaCorrection]() {
+		return std::make_shared<Texture>(*image, *mipmaps, removeGammaCorrection);
+	};
 }
 
 
@@ -286,6 +715,8 @@ class GpuProgramParser
 {
 	std::map<std::string, GpuProgram::AttributeType> attributeMap;
 	std::map<std::string, GpuProgram::AutoUniformType> uniformMap;
+	std::map<std::string, GpuProgram::Feature> featureMap;
+	std::map<std::string, GpuProgram::UniformBlockType> uniformBlockMap;
 
 	GpuProgramParser()
 	{
@@ -319,6 +750,12 @@ class GpuProgramParser
         uniformMap.insert(std::make_pair("SHADOW_MAP", GpuProgram::AutoUniformType::SHADOW_MAP));
 		uniformMap.insert(std::make_pair("FLAT_PROJECTION", GpuProgram::AutoUniformType::FLAT_PROJECTION));
         uniformMap.insert(std::make_pair("NORMAL_MAP", GpuProgram::AutoUniformType::NORMAL_MAP));
+        uniformMap.insert(std::make_pair("INSTANCE_TRANSFORMS", GpuProgram::AutoUniformType::INSTANCE_TRANSFORMS));
+
+		uniformBlockMap.insert(std::make_pair("FRAME_UNIFORMS", GpuProgram::UniformBlockType::FRAME_UNIFORMS));
+
+		for (int i = 0; i < GpuProgram::MAX_FEATURES; i++)
+			featureMap.insert(std::make_pair(GpuProgram::featureNames[i], (GpuProgram::Feature)i));
 
 	}
 
@@ -342,33 +779,58 @@ public:
 		// TODO: add possible exception
 		return this->uniformMap.find(text)->second;
 	}
+
+	inline GpuProgram::UniformBlockType parseUniformBlockType(const std::string& text)
+	{
+		auto it = this->uniformBlockMap.find(text);
+		if (it == this->uniformBlockMap.end())
+			throw_MagicException(("Unknown uniform block: " + text).c_str());
+		return it->second;
+	}
+
+	inline GpuProgram::Feature parseFeature(const std::string& text)
+	{
+		auto it = this->featureMap.find(text);
+		if (it == this->featureMap.end())
+			throw_MagicException(("Unknown gpu program feature: " + text).c_str());
+		return it->second;
+	}
 	
 };
 
 template<>
-inline std::shared_ptr<GpuProgram> ResourceManager::_get<GpuProgram>(const std::string& fullPath)
+inline ResourceManager::Finish<GpuProgram> ResourceManager::_prepare<GpuProgram>(
+	const ResourceIndex::File& file, LoadContext& context)
 {
 	tinyxml2::XMLDocument doc;
-	tinyxml2::XMLError error = doc.LoadFile(fullPath.c_str());
+	ResourceData data = file.read();
+	tinyxml2::XMLError error = doc.Parse((const char*)data.getData(), data.getSize());
 	// TODO: check doc load error and throw exception
 
 	// TODO: check nodes for null and throw exception
 	tinyxml2::XMLElement* programNode = doc.FirstChildElement("GpuProgram");
 
-	auto vertexProgram = this->get<Shader>(programNode->FirstChildElement("vertexShader")->Attribute("ref"));
-	auto fragmentProgram = this->get<Shader>(programNode->FirstChildElement("fragmentShader")->Attribute("ref"));
+	// the sources are read rather than depended on as shaders, so a cached
+	// program is not compiled at all
+	auto vertexSource = this->readText(this->findFile(
+		programNode->FirstChildElement("vertexShader")->Attribute("ref")).read());
+	auto fragmentSource = this->readText(this->findFile(
+		programNode->FirstChildElement("fragmentShader")->Attribute("ref")).read());
 
-	auto program = std::make_shared<GpuProgram>(vertexProgram, fragmentProgram);
+	auto& parser = GpuProgramParser::getSingleton();
 
-	auto parser = GpuProgramParser::getSingleton();
+	// the document is gone by the time the program is created, keep what it says
+	std::vector<std::pair<std::string, GpuProgram::AttributeType>> attributes;
+	std::vector<std::pair<std::string, GpuProgram::AutoUniformType>> autoUniforms;
+	std::vector<std::pair<std::string, std::vector<float>>> namedUniforms;
+	std::vector<std::pair<std::string, GpuProgram::UniformBlockType>> uniformBlocks;
 
 	auto attributeNode = programNode->FirstChildElement("attribute");
 	while (attributeNode != nullptr)
 	{
 		auto name = attributeNode->FirstChildElement("name")->GetText();
 		auto typeText = attributeNode->FirstChildElement("type")->GetText();
-		auto type = parser.parseAttributeType(typeText);
-		program->bindAttrib(name, type);
+		attributes.push_back(std::make_pair(std::string(name), parser.parseAttributeType(typeText)));
 
 		attributeNode = attributeNode->NextSiblingElement("attribute");
 	}
@@ -382,8 +844,7 @@ inline std::shared_ptr<GpuProgram> ResourceManager::_get<GpuProgram>(const std::
 		auto valueRef = valueNode->Attribute("ref");
 		if (valueRef != nullptr)
 		{
-			auto value = parser.parseAutoUniformType(valueRef);
-			program->addAutoUniform(name, value);
+			autoUniforms.push_back(std::make_pair(std::string(name), parser.parseAutoUniformType(valueRef)));
 		}
 		else
 		{
@@ -394,54 +855,148 @@ inline std::shared_ptr<GpuProgram> ResourceManager::_get<GpuProgram>(const std::
 				components.push_back(std::stof(componentNode->GetText()));
 				componentNode = componentNode->NextSiblingElement("c");
 			}
-
-			float* data = new float[components.size()];
-			for(unsigned int i=0; i < components.size(); i++)
-				data[i] = components[i];
-			program->addNamedUniform(name, VertexArray::FLOAT, components.size(), data);
-			delete[] data;
+			namedUniforms.push_back(std::make_pair(std::string(name), components));
 		}
 
 		uniformNode = uniformNode->NextSiblingElement("uniform");
 	}
 
-	program->link();
-	return program;
+	auto blockNode = programNode->FirstChildElement("uniformBlock");
+	while (blockNode != nullptr)
+	{
+		auto name = blockNode->FirstChildElement("name")->GetText();
+		auto typeText = blockNode->FirstChildElement("value")->Attribute("ref");
+		uniformBlocks.push_back(std::make_pair(std::string(name), parser.parseUniformBlockType(typeText)));
+
+		blockNode = blockNode->NextSiblingElement("uniformBlock");
+	}
+
+	unsigned int variantFeatures = 0;
+	auto featureNode = programNode->FirstChildElement("feature");
+	while (featureNode != nullptr)
+	{
+		variantFeatures |= GpuProgram::getFeatureMask(parser.parseFeature(featureNode->GetText()));
+		featureNode = featureNode->NextSiblingElement("feature");
+	}
+
+	// the frame block is declared once here for every shader reading it,
+	// so it always matches FrameUniforms::Block
+	std::string declarations;
+	for (const auto& block : uniformBlocks)
+	{
+		if (block.second == GpuProgram::FRAME_UNIFORMS)
+			declarations = FrameUniforms::DECLARATION;
+	}
+
+	// packs cannot be written to, caches of packed programs are only kept
+	// in the cache directory
+	bool useCache = this->programCacheEnabled && (!file.isPacked() || !this->programCacheDir.empty());
+	std::string sourcePath = file.getFullPath();
+	std::string cacheDir = this->programCacheDir;
+
+	return [=]() {
+		// builds the program with a mask of features, variants are built
+		// with it when first used
+		GpuProgram::VariantBuilder build = [=](unsigned int features) {
+			std::vector<std::string> defines;
+			for (int i = 0; i < GpuProgram::MAX_FEATURES; i++)
+			{
+				if ((features & GpuProgram::getFeatureMask((GpuProgram::Feature)i)) != 0)
+					defines.push_back(GpuProgram::featureNames[i]);
+			}
+			std::string vertexText = Shader::addDefines(vertexSource->getText(), defines, declarations);
+			std::string fragmentText = Shader::addDefines(fragmentSource->getText(), defines, declarations);
+
+			auto addUniforms = [&](GpuProgram& program) {
+				for (const auto& uniform : autoUniforms)
+					program.addAutoUniform(uniform.first.c_str(), uniform.second);
+				for (const auto& uniform : namedUniforms)
+				{
+					program.addNamedUniform(uniform.first.c_str(), VertexArray::FLOAT, uniform.second.size(),
+						uniform.second.empty() ? nullptr : &uniform.second[0]);
+				}
+				for (const auto& block : uniformBlocks)
+					program.addUniformBlock(block.first.c_str(), block.second);
+			};
+
+			// the driver is only known with the graphics context, each variant
+			// is cached on its own
+			std::shared_ptr<GpuProgram> program;
+			std::string cachePath;
+			uint64_t key = 0;
+			if (useCache)
+			{
+				cachePath = ProgramCache::getCachePath(features == 0 ? sourcePath :
+					sourcePath + "." + std::to_string(features), cacheDir);
+				key = ProgramCache::hashDriver(ProgramCache::hashSources(vertexText, fragmentText,
+					attributes));
+				program = std::make_shared<GpuProgram>();
+				addUniforms(*program);
+				if (!ProgramCache::load(cachePath, key, *program))
+					program = nullptr;
+			}
+
+			if (program == nullptr)
+			{
+				program = std::make_shared<GpuProgram>(
+					std::make_shared<Shader>(vertexText.c_str(), Shader::Type::VERTEX),
+					std::make_shared<Shader>(fragmentText.c_str(), Shader::Type::FRAGMENT));
+				for (const auto& attribute : attributes)
+					program->bindAttrib(attribute.first.c_str(), attribute.second);
+				addUniforms(*program);
+				program->link();
+
+				if (!cachePath.empty())
+					ProgramCache::save(cachePath, key, *program);
+			}
+			return program;
+		};
+
+		// the program itself has no features
+		std::shared_ptr<GpuProgram> program = build(0);
+		program->setVariantBuilder(0, variantFeatures, build);
+
+		return program;
+	};
 }
 
 
 template<>
-inline std::shared_ptr<Material> ResourceManager::_get<Material>(const std::string& fullPath)
+inline ResourceManager::Finish<Material> ResourceManager::_prepare<Material>(
+	const ResourceIndex::File& file, LoadContext& context)
 {
 	tinyxml2::XMLDocument doc;
-	tinyxml2::XMLError error = doc.LoadFile(fullPath.c_str());
+	ResourceData data = file.read();
+	tinyxml2::XMLError error = doc.Parse((const char*)data.getData(), data.getSize());
 	// TODO: check doc load error and throw exception
 
 	// TODO: check nodes for null and throw exception
 	tinyxml2::XMLElement* programNode = doc.FirstChildElement("Material");
 
 	auto gpuProgramRef = programNode->FirstChildElement("gpuProgram")->Attribute("ref");
-	auto gpuProgram = this->get<GpuProgram>(gpuProgramRef);
+	auto gpuProgram = context.depend<GpuProgram>(gpuProgramRef);
 
 	auto textureRef = programNode->FirstChildElement("texture")->Attribute("ref");
-	auto texture = this->get<Texture>(textureRef);
+	auto texture = context.depend<Texture>(textureRef);
 
     auto normalMapNode = programNode->FirstChildElement("normalMap");
-    std::shared_ptr<Texture> normalMap = nullptr;
+    Future<Texture> normalMap;
     if (normalMapNode != nullptr)
     {
-        normalMap = this->get<Texture>(normalMapNode->Attribute("ref"));
+        normalMap = context.depend<Texture>(normalMapNode->Attribute("ref"));
     }
 
-	auto material = std::make_shared<Material>();
-	MaterialBuilder builder;
-	builder.begin(material.get());
-	builder.setGpuProgram(gpuProgram);
-	builder.setTexture(texture);
-    builder.setNormalMap(normalMap);
-	builder.end();
-
-	return material;
+	return [gpuProgram, texture, normalMap]() {
+		auto material = std::make_shared<Material>();
+		MaterialBuilder builder;
+		builder.begin(material.get());
+		builder.setGpuProgram(gpuProgram.get());
+		builder.setTexture(texture.get());
+		builder.setNormalMap(normalMap.valid() ? normalMap.get() : nullptr);
+		builder.end();
+
+		return material;
+	};
 }
 
 };
@@ -457,6 +1012,3 @@ inline std::shared_ptr<Material> ResourceManager::_get<Material>(const std::stri
 
 
 
-
-
-
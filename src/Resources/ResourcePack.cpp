@@ -0,0 +1,291 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Resources\ResourcePack.h>
+#include <Resources\ResourceIndex.h>
+#include <Exceptions\MagicException.h>
+#include <Util\Lz4.h>
+#include <Util\Hash.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace Magic3D
+{
+
+static const char MAGIC[8] = { 'M', '3', 'D', 'P', 'A', 'K', 0, 0 };
+static const uint64_t ALIGNMENT = 16;
+
+struct ResourcePack::Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+struct ResourcePack::Entry
+{
+    uint64_t nameHash;
+    uint64_t offset;
+    uint64_t storedSize;
+    uint64_t size;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+/// hash a name, with either separator
+static uint64_t hashName(const std::string& name)
+{
+    uint64_t hash = HASH_SEED;
+    for (char c : name)
+    {
+        char byte = c == '\\' ? '/' : c;
+        hash = hashBytes(&byte, 1, hash);
+    }
+    return hash;
+}
+
+static inline uint64_t align(uint64_t offset)
+{
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+ResourcePack::ResourcePack(const std::string& path) : path(path), entries(nullptr),
+    entryCount(0), names(nullptr)
+{
+    this->file = std::make_shared<MappedFile>(path);
+    const unsigned char* data = this->file->getData();
+    uint64_t size = this->file->getSize();
+
+    // a damaged pack must not send reads past its end
+    Header header;
+    if (size < sizeof(header))
+        throw_MagicException("Resource pack is too small");
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw_MagicException("File is not a resource pack");
+    if (header.version != VERSION)
+        throw_MagicException("Resource pack is of another version");
+
+    uint64_t tableSize = (uint64_t)header.entryCount * sizeof(Entry);
+    if (tableSize > size - sizeof(header) || header.namesOffset > size ||
+        header.namesSize > size - header.namesOffset)
+        throw_MagicException("Resource pack is corrupt");
+
+    this->entries = (const Entry*)(data + sizeof(header));
+    this->entryCount = header.entryCount;
+    this->names = (const char*)(data + header.namesOffset);
+
+    for (uint32_t i = 0; i < this->entryCount; i++)
+    {
+        const Entry& entry = this->entries[i];
+        if ((uint64_t)entry.nameOffset + entry.nameLength > header.namesSize ||
+            entry.offset % ALIGNMENT != 0 || entry.offset > size ||
+            entry.storedSize > size - entry.offset ||
+            (i > 0 && entry.nameHash < this->entries[i - 1].nameHash))
+            throw_MagicException("Resource pack is corrupt");
+        if (entry.compression == (uint32_t)Compression::NONE ? entry.storedSize != entry.size :
+            entry.compression != (uint32_t)Compression::LZ4)
+            throw_MagicException("Resource pack is corrupt");
+    }
+}
+
+std::string ResourcePack::getName(size_t entry) const
+{
+    const Entry& e = this->entries[entry];
+    return std::string(this->names + e.nameOffset, e.nameLength);
+}
+
+uint64_t ResourcePack::getSize(size_t entry) const
+{
+    return this->entries[entry].size;
+}
+
+ResourcePack::Compression ResourcePack::getCompression(size_t entry) const
+{
+    return (Compression)this->entries[entry].compression;
+}
+
+bool ResourcePack::find(const std::string& name, size_t& entry) const
+{
+    uint64_t hash = hashName(name);
+    const Entry* end = this->entries + this->entryCount;
+    const Entry* it = std::lower_bound(this->entries, end, hash,
+        [](const Entry& e, uint64_t hash) { return e.nameHash < hash; });
+
+    for (; it != end && it->nameHash == hash; it++)
+    {
+        if (it->nameLength != name.size())
+            continue;
+
+        // compare as hashed, with either separator
+        const char* stored = this->names + it->nameOffset;
+        bool same = true;
+        for (size_t i = 0; i < name.size() && same; i++)
+            same = stored[i] == (name[i] == '\\' ? '/' : name[i]);
+        if (same)
+        {
+            entry = it - this->entries;
+            return true;
+        }
+    }
+    return false;
+}
+
+ResourceData ResourcePack::read(size_t entry) const
+{
+    const Entry& e = this->entries[entry];
+    const unsigned char* stored = this->file->getData() + e.offset;
+    if (e.compression == (uint32_t)Compression::NONE)
+        return ResourceData(e.size == 0 ? nullptr : stored, (size_t)e.size, this->file);
+
+    auto buffer = std::make_shared<std::vector<unsigned char>>((size_t)e.size);
+    if (!Lz4::decompress(stored, (size_t)e.storedSize, buffer->data(), buffer->size()))
+        throw_MagicException("Resource pack entry is corrupt");
+    return ResourceData(buffer->empty() ? nullptr : buffer->data(), buffer->size(), buffer);
+}
+
+ResourcePack::BuildStats ResourcePack::build(const std::string& dir, const std::string& path,
+    bool compress)
+{
+    struct Packed
+    {
+        Entry entry;
+        std::string name;
+        ResourceData data;
+        std::vector<unsigned char> compressed;
+    };
+
+    BuildStats stats = { 0, 0, 0, 0 };
+    std::vector<Packed> files;
+    for (const std::string& name : ResourceIndex::listFiles(dir))
+    {
+        // never pack packs, like one being built in the directory itself
+        if (name.size() >= 7 && name.compare(name.size() - 7, 7, ".m3dpak") == 0)
+            continue;
+
+        Packed file;
+        file.name = name;
+        file.data = ResourceData::mapFile(dir + "/" + name);
+        memset(&file.entry, 0, sizeof(file.entry));
+        file.entry.nameHash = hashName(name);
+        file.entry.size = file.data.getSize();
+        file.entry.storedSize = file.data.getSize();
+        file.entry.nameLength = (uint32_t)name.size();
+        file.entry.compression = (uint32_t)Compression::NONE;
+
+        // keep compressed only what saves enough to be worth decompressing
+        if (compress && file.data.getSize() > 0)
+        {
+            file.compressed = Lz4::compress(file.data.getData(), file.data.getSize());
+            if (file.compressed.size() < file.data.getSize() - file.data.getSize() / 8)
+            {
+                file.entry.storedSize = file.compressed.size();
+                file.entry.compression = (uint32_t)Compression::LZ4;
+                stats.compressedCount++;
+            }
+            else
+                file.compressed.clear();
+        }
+
+        stats.fileCount++;
+        stats.size += file.entry.size;
+        files.push_back(std::move(file));
+    }
+
+    std::sort(files.begin(), files.end(), [](const Packed& a, const Packed& b) {
+        return a.entry.nameHash < b.entry.nameHash ||
+            (a.entry.nameHash == b.entry.nameHash && a.name < b.name);
+    });
+
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.entryCount = (uint32_t)files.size();
+    header.namesOffset = sizeof(Header) + files.size() * sizeof(Entry);
+    header.namesSize = 0;
+    for (Packed& file : files)
+    {
+        file.entry.nameOffset = (uint32_t)header.namesSize;
+        header.namesSize += file.name.size();
+    }
+    uint64_t offset = align(header.namesOffset + header.namesSize);
+    for (Packed& file : files)
+    {
+        file.entry.offset = offset;
+        offset = align(offset + file.entry.storedSize);
+    }
+
+    // write beside the pack and move it in place once complete, so a
+    // failed build never leaves a damaged pack behind
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out.good())
+        throw_MagicException("Could not write resource pack");
+
+    uint64_t written = 0;
+    auto write = [&out, &written](const void* data, uint64_t size) {
+        out.write((const char*)data, (std::streamsize)size);
+        written += size;
+    };
+    auto pad = [&write, &written]() {
+        static const char zeros[ALIGNMENT] = { 0 };
+        write(zeros, align(written) - written);
+    };
+
+    write(&header, sizeof(header));
+    for (const Packed& file : files)
+        write(&file.entry, sizeof(file.entry));
+    for (const Packed& file : files)
+        write(file.name.data(), file.name.size());
+    pad();
+    for (const Packed& file : files)
+    {
+        if (!file.compressed.empty())
+            write(file.compressed.data(), file.compressed.size());
+        else if (file.data.getSize() > 0)
+            write(file.data.getData(), file.data.getSize());
+        pad();
+    }
+
+    out.close();
+    if (!out.good())
+    {
+        std::remove(tempPath.c_str());
+        throw_MagicException("Could not write resource pack");
+    }
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        throw_MagicException("Could not write resource pack");
+    }
+
+    stats.packedSize = written;
+    return stats;
+}
+
+};
@@ -0,0 +1,128 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ResourcePack class
+ *
+ * @file ResourcePack.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_RESOURCE_PACK_H
+#define MAGIC3D_RESOURCE_PACK_H
+
+#include "ResourceData.h"
+#include <Util\MappedFile.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Magic3D
+{
+
+/** Archive of resource files (.m3dpak), so a whole resource tree is one
+ * file opened once instead of thousands. A pack holds, in order:
+ *  - a header with the format version and the number of entries
+ *  - a table of entries sorted by the hash of their names, each with its
+ *    offset, size and compression
+ *  - the names, '/' separated paths relative to the packed directory
+ *  - the entries themselves, 16 byte aligned
+ *
+ * The pack is mapped, not read. Entries stored as they are, which is done
+ * for files that do not compress well, are handed out without copying.
+ * Compressed entries are LZ4 blocks, see Lz4, decompressed when read.
+ */
+class ResourcePack
+{
+public:
+    /// version of the format, readers only open packs of their version
+    static const uint32_t VERSION = 1;
+
+    /// how an entry is stored
+    enum class Compression : uint32_t
+    {
+        NONE = 0,
+        LZ4 = 1
+    };
+
+    /// totals of a pack built, see build
+    struct BuildStats
+    {
+        size_t fileCount;
+        size_t compressedCount;
+        uint64_t size;          // of all files
+        uint64_t packedSize;    // of the pack
+    };
+
+private:
+    struct Header;
+    struct Entry;
+
+    std::string path;
+    std::shared_ptr<MappedFile> file;
+    const Entry* entries;
+    uint32_t entryCount;
+    const char* names;
+
+public:
+    /** Open a pack, throws if it cannot be mapped or is not a valid pack
+     * @param path  the path to the pack
+     */
+    ResourcePack(const std::string& path);
+
+    inline const std::string& getPath() const
+    {
+        return this->path;
+    }
+
+    inline size_t getEntryCount() const
+    {
+        return this->entryCount;
+    }
+
+    /// get the name of an entry
+    std::string getName(size_t entry) const;
+
+    /// get the size of an entry once read
+    uint64_t getSize(size_t entry) const;
+
+    /// get how an entry is stored
+    Compression getCompression(size_t entry) const;
+
+    /** Find an entry
+     * @param name  name of the entry, '\' is treated as '/'
+     * @param entry set to the index of the entry if found
+     * @return false if the pack has no entry of the name
+     */
+    bool find(const std::string& name, size_t& entry) const;
+
+    /// read an entry, throws if it is corrupt
+    ResourceData read(size_t entry) const;
+
+    /** Pack the files of a directory and all its subdirectories
+     * @param dir       directory to pack
+     * @param path      path of the pack to write
+     * @param compress  whether to compress the files that get smaller for it
+     * @return totals of the pack, throws if it cannot be written
+     */
+    static BuildStats build(const std::string& dir, const std::string& path, bool compress);
+};
+
+};
+
+#endif
@@ -33,7 +33,12 @@ extern void quit_Freetype();
     
 /// standard constructor
 TTFontResource::TTFontResource(const std::string& path, const std::string& name):
-    FontResource(name), face(NULL)
+    TTFontResource(ResourceData::mapFile(path), name)
+{
+}
+
+TTFontResource::TTFontResource(const ResourceData& data, const std::string& name):
+    FontResource(name), face(NULL), data(data)
 {
     // we need freetype library
     FT_Library library;
@@ -42,7 +47,8 @@ TTFontResource::TTFontResource(const std::string& path, const std::string& name)
         throw_MagicException("Failed to initalize freetype library");
     
     // create face for this font
-	error = FT_New_Face(library, path.c_str(),
+	error = FT_New_Memory_Face(library, (const FT_Byte*)this->data.getData(),
+	    (FT_Long)this->data.getSize(),
 	    0, // only want face index 0, some fonts have more than 1 index 
 	    &this->face );
 	if ( error == FT_Err_Unknown_File_Format ) 
@@ -27,6 +27,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../FontResource.h"
 #include "../../Util/Character.h"
+#include "../ResourceData.h"
 
 // include freetype
 #include <ft2build.h>
@@ -41,6 +42,9 @@ class TTFontResource : public FontResource
 {
 protected:
     FT_Face face;
+
+    /// contents of the font file, freetype reads them for as long as the face lives
+    ResourceData data;
     
     void getGlyph(Character* c, int glyphIndex, int width, int height) const;
 		
@@ -48,6 +52,9 @@ public:
 	/// standard constructor
     TTFontResource(const std::string& path, const std::string& name);
 
+	/// create from the contents of a font file
+    TTFontResource(const ResourceData& data, const std::string& name);
+
 	/// destructor
 	virtual ~TTFontResource();
 	
@@ -2,17 +2,75 @@
 #include "ModelLoader3DS.h"
 #include <string.h>
 #include <lib3ds/mesh.h>
+#include <lib3ds/io.h>
 #include <Mesh/TriangleMesh.h>
 
 namespace Magic3D
 {
 
+/// position of lib3ds in the contents of a model file
+struct MemoryReader
+{
+	const ResourceData* data;
+	long pos;
+};
+
+static Lib3dsBool memoryError(void* self)
+{
+	return LIB3DS_FALSE;
+}
+
+static long memorySeek(void* self, long offset, Lib3dsIoSeek origin)
+{
+	MemoryReader* reader = (MemoryReader*)self;
+	long base = origin == LIB3DS_SEEK_SET ? 0 :
+		origin == LIB3DS_SEEK_CUR ? reader->pos : (long)reader->data->getSize();
+	if (base + offset < 0 || base + offset > (long)reader->data->getSize())
+		return -1;
+	reader->pos = base + offset;
+	return 0;
+}
+
+static long memoryTell(void* self)
+{
+	return ((MemoryReader*)self)->pos;
+}
 
-std::shared_ptr<Model> ModelLoader3DS::getModel(const std::string& path) const
+static size_t memoryRead(void* self, void* buffer, size_t size)
+{
+	MemoryReader* reader = (MemoryReader*)self;
+	size_t left = reader->data->getSize() - (size_t)reader->pos;
+	if (size > left)
+		size = left;
+	if (size > 0)
+		memcpy(buffer, reader->data->getData() + reader->pos, size);
+	reader->pos += (long)size;
+	return size;
+}
+
+static size_t memoryWrite(void* self, const void* buffer, size_t size)
+{
+	return 0;
+}
+
+
+std::shared_ptr<Model> ModelLoader3DS::getModel(const ResourceData& data,
+	const MeshLoadOptions& options) const
 {	
-	Lib3dsFile* file = lib3ds_file_load(path.c_str());
-	if (!file)
+	// lib3ds reads through callbacks, so files need not be on disk
+	MemoryReader reader = { &data, 0 };
+	Lib3dsIo* io = lib3ds_io_new(&reader, memoryError, memorySeek, memoryTell,
+		memoryRead, memoryWrite);
+	Lib3dsFile* file = lib3ds_file_new();
+	bool loaded = io != nullptr && file != nullptr && lib3ds_file_read(file, io);
+	if (io != nullptr)
+		lib3ds_io_free(io);
+	if (!loaded)
+	{
+		if (file != nullptr)
+			lib3ds_file_free(file);
 		throw_MagicException("Could not load model file");
+	}
 
     std::vector<std::shared_ptr<Geometry>> meshes;
 
@@ -32,7 +90,8 @@ std::shared_ptr<Model> ModelLoader3DS::getModel(const std::string& path) const
             "Can only load meshes that have the same number of points and texels");
 
 	    // allocate the batch
-        auto batch = std::make_shared<TriangleMesh>(mesh->points, mesh->faces, attrs);
+        auto batch = std::make_shared<TriangleMesh>(mesh->points, mesh->faces, attrs,
+            options.layout);
     
         for (unsigned int i = 0; i < mesh->points; i++)
         {
@@ -62,6 +121,11 @@ std::shared_ptr<Model> ModelLoader3DS::getModel(const std::string& path) const
 
         // TODO: add options on how these are done and thresholds
         batch->mergeNormalsAndTangents();
+
+        if (options.weld)
+            batch->weld(options.weldOptions);
+        if (options.optimize)
+            batch->optimizeVertexOrder(options.optimizeOptions);
         
 		meshes.push_back(batch);
 	}
@@ -70,6 +134,8 @@ std::shared_ptr<Model> ModelLoader3DS::getModel(const std::string& path) const
 
     auto model = std::make_shared<Model>();
     model->setMeshes(meshes);
+    if (options.lodLevels > 0)
+        model->generateLods(options.lodLevels);
     return model;
 }
 	
@@ -19,7 +19,8 @@ namespace Magic3D
 class ModelLoader3DS : public ModelLoader
 {
 public:
-	virtual std::shared_ptr<Model> getModel(const std::string& path) const;
+	virtual std::shared_ptr<Model> getModel(const ResourceData& data,
+		const MeshLoadOptions& options = MeshLoadOptions()) const;
 
 };
 
@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for FrameUniforms class
+ *
+ * @file FrameUniforms.cpp
+ * @author Andrew Keating
+ */
+
+#include <Shaders\FrameUniforms.h>
+#include <Shaders\GpuProgram.h>
+
+#include <cstring>
+
+namespace Magic3D
+{
+
+static_assert(sizeof(FrameUniforms::Block) == 4 * 64 + 64,
+    "FrameUniforms::Block does not match the std140 layout of the block");
+
+const char* const FrameUniforms::DECLARATION =
+    "struct Light\n"
+    "{\n"
+    "    vec4    position;           // w is 0 for location-less (directional) lights\n"
+    "    vec3    direction;\n"
+    "    float   angle;\n"
+    "    vec3    color;\n"
+    "    float   intensity;\n"
+    "    float   attenuationFactor;\n"
+    "    float   ambientFactor;\n"
+    "};\n"
+    "layout(std140) uniform Frame\n"
+    "{\n"
+    "    mat4    vMatrix;            // transforms from world space to view space\n"
+    "    mat4    pMatrix;            // transforms from view space to clip space\n"
+    "    mat4    vpMatrix;           // transforms from world space to clip space\n"
+    "    mat4    shadowMatrix;       // transforms from world space to light view space\n"
+    "    Light   light;\n"
+    "} frame;\n";
+
+/// copy a matrix, which may have double components
+static void copyMatrix(float* dest, const Matrix4& matrix)
+{
+    const Scalar* data = matrix.getArray();
+    for (int i = 0; i < 16; i++)
+        dest[i] = (float)data[i];
+}
+
+FrameUniforms::FrameUniforms() : buffer(sizeof(Block), Buffer::DYNAMIC_DRAW)
+{
+    memset(&this->block, 0, sizeof(this->block));
+}
+
+void FrameUniforms::set(const Matrix4& view, const Matrix4& projection,
+    const Matrix4* shadowMatrix, const Light& light)
+{
+    Matrix4 viewProjection;
+    viewProjection.multiply(projection, view);
+
+    copyMatrix(this->block.viewMatrix, view);
+    copyMatrix(this->block.projectionMatrix, projection);
+    copyMatrix(this->block.viewProjectionMatrix, viewProjection);
+    copyMatrix(this->block.shadowMatrix, shadowMatrix != nullptr ? *shadowMatrix : Matrix4());
+
+    this->block.lightPosition[0] = (float)light.location.x();
+    this->block.lightPosition[1] = (float)light.location.y();
+    this->block.lightPosition[2] = (float)light.location.z();
+    this->block.lightPosition[3] = light.locationLess ? 0.0f : 1.0f;
+    this->block.lightDirection[0] = (float)light.direction.x();
+    this->block.lightDirection[1] = (float)light.direction.y();
+    this->block.lightDirection[2] = (float)light.direction.z();
+    this->block.lightAngle = (float)light.angle;
+    for (int i = 0; i < 3; i++)
+        this->block.lightColor[i] = (float)light.lightColor.getChannel(i, true);
+    this->block.lightIntensity = (float)light.intensity;
+    this->block.lightAttenuationFactor = (float)light.attenuationFactor;
+    this->block.lightAmbientFactor = (float)light.ambientFactor;
+}
+
+void FrameUniforms::upload()
+{
+    this->buffer.fill(0, sizeof(this->block), &this->block);
+    this->bind();
+}
+
+void FrameUniforms::bind() const
+{
+    this->buffer.bindBase(Buffer::UNIFORM_BUFFER, GpuProgram::FRAME_UNIFORMS);
+}
+
+};
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for FrameUniforms class
+ *
+ * @file FrameUniforms.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_FRAME_UNIFORMS_H
+#define MAGIC3D_FRAME_UNIFORMS_H
+
+#include "../Graphics/Buffer.h"
+#include "../Math/Matrix4.h"
+#include "../Lights/Light.h"
+
+namespace Magic3D
+{
+
+/** Uniforms that are the same for every draw of a frame (or pass), kept
+ * in a uniform buffer so they are set once instead of for every object.
+ * Programs read them from a std140 block they declare as consumed with
+ * the FRAME_UNIFORMS uniform block type, see GpuProgram. The block is
+ * declared for their shaders by the resource manager from DECLARATION,
+ * as "frame", and must match Block.
+ */
+class FrameUniforms
+{
+public:
+    /// GLSL declaration of the Light struct and the std140 Frame block
+    static const char* const DECLARATION;
+
+    /// the block as laid out by std140, matrices in columns
+    struct Block
+    {
+        float viewMatrix[16];
+        float projectionMatrix[16];
+        float viewProjectionMatrix[16];
+        float shadowMatrix[16];
+
+        float lightPosition[4];
+        float lightDirection[3];
+        float lightAngle;
+        float lightColor[3];
+        float lightIntensity;
+        float lightAttenuationFactor;
+        float lightAmbientFactor;
+        float padding[2];       // structs are padded to 16 bytes
+    };
+
+private:
+    Block block;
+    Buffer buffer;
+
+public:
+    /// constructor, allocates the buffer
+    FrameUniforms();
+
+    /** Set the data for a frame
+     * @param view          transforms from world space to view space
+     * @param projection    transforms from view space to clip space
+     * @param shadowMatrix  transforms from world space to shadow map space,
+     *                      nullptr if there is no shadow map
+     * @param light         the light of the frame
+     */
+    void set(const Matrix4& view, const Matrix4& projection, const Matrix4* shadowMatrix,
+        const Light& light);
+
+    inline const Block& getBlock() const
+    {
+        return this->block;
+    }
+
+    /// upload the data to the buffer and bind it for programs consuming it
+    void upload();
+
+    /// bind the buffer for programs consuming it, without uploading
+    void bind() const;
+};
+
+};
+
+#endif
@@ -42,6 +42,24 @@ const int GpuProgram::attributeTypeCompCount[ MAX_ATTRIBUTE_TYPES ] =
     3  // binormal
 };
 
+const char* const GpuProgram::featureNames[ MAX_FEATURES ] =
+{
+    "NORMAL_MAPPING",
+    "SHADOW_MAPPING",
+    "SPECULAR_HIGHLIGHT",
+    "INSTANCED"
+};
+
+
+GpuProgram::GpuProgram()
+{
+	programId = glCreateProgram();
+
+    nextIndex = 0;
+    instanceOffsetLocation = -1;
+    features = 0;
+    variantFeatures = 0;
+}
 
 GpuProgram::GpuProgram(std::shared_ptr<Shader> vertexShader, std::shared_ptr<Shader> fragmentShader)
 {   
@@ -51,6 +69,9 @@ GpuProgram::GpuProgram(std::shared_ptr<Shader> vertexShader, std::shared_ptr<Sha
     glAttachShader(programId, fragmentShader->id);
     
     nextIndex = 0;
+    instanceOffsetLocation = -1;
+    features = 0;
+    variantFeatures = 0;
 }
 
 /// destructor
@@ -58,6 +79,7 @@ GpuProgram::~GpuProgram()
 {
     // delete the shader from opengl memory
     glDeleteProgram(this->programId);
+    GraphicsState::getSingleton().programDeleted(this->programId);
 }
 
 /** Enable this shader to be used on the next drawing operation
@@ -66,9 +88,8 @@ GpuProgram::~GpuProgram()
 void GpuProgram::use()
 {
     // set opengl to use this shader
-    glUseProgram(this->programId);
-    if (glGetError() != GL_NO_ERROR)
-        throw_MagicException("Could not use shader program");
+    GraphicsState::getSingleton().useProgram(this->programId);
+    MAGIC_GL_CHECK("Could not use shader program");
 }
 
 
@@ -25,6 +25,7 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <memory>
 #include <sstream>
+#include <functional>
 
 // include opengl
 #ifdef _WIN32
@@ -39,8 +40,11 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include "../Math/MathTypes.h"
 #include "../Exceptions/MagicException.h"
 #include "../Graphics/Texture.h"
+#include "../Graphics/GraphicsState.h"
+#include "../Graphics/TextureBuffer.h"
 #include "../Exceptions/ShaderCompileException.h"
 #include "../Util/magic_throw.h"
+#include "../Util/magic_gl_check.h"
 #include <Graphics\VertexArray.h>
 #include "Shader.h"
 
@@ -109,12 +113,44 @@ public:
         SHADOW_MATRIX,                  // mat4
         SHADOW_MAP,                     // sampler2DShadow
 
+        // instancing
+        INSTANCE_TRANSFORMS,            // samplerBuffer, 4 texels per model matrix
+
         MAX_AUTO_UNIFORM_TYPE
     };
 
+    /** uniform blocks filled by the engine, the values are the indices of
+     * the uniform buffer binding points they are read from
+     */
+    enum UniformBlockType
+    {
+        FRAME_UNIFORMS = 0,             // see FrameUniforms
+        MAX_UNIFORM_BLOCK_TYPE
+    };
+
+    /** optional features a program can be built with, each is a #define of
+     * its name in the shaders of the variant with it, see getVariant. Which
+     * features a program has is declared in its resource.
+     */
+    enum Feature
+    {
+        NORMAL_MAPPING = 0,             // sample the material's normal map
+        SHADOW_MAPPING,                 // sample the light's shadow map
+        SPECULAR_HIGHLIGHT,             // add the specular term of lighting
+        INSTANCED,                      // draw many instances with one draw call, reading
+                                        // model matrices from INSTANCE_TRANSFORMS
+        MAX_FEATURES
+    };
+
 	/// number of components for shader variables for each of the auto-bound attribute types
     static const int attributeTypeCompCount[ MAX_ATTRIBUTE_TYPES ];
 
+    /// names of the features, as defined in shaders
+    static const char* const featureNames[ MAX_FEATURES ];
+
+    /// builds the variant of a program with a mask of features
+    typedef std::function<std::shared_ptr<GpuProgram>(unsigned int features)> VariantBuilder;
+
 protected:
 	friend class World;
 
@@ -122,16 +158,20 @@ protected:
     {
 		std::string varName;
         AutoUniformType type;
+
+        /// location of uniform in linked program, -1 if not present
+        GLint location;
         
-        inline AutoUniform() {}
+        inline AutoUniform(): location(-1) {}
 
         inline AutoUniform(const AutoUniform& u): varName(u.varName), 
-			type(u.type) {}
+			type(u.type), location(u.location) {}
 
         inline void set(const AutoUniform& u)
         {
             this->type = u.type;
 			this->varName = u.varName;
+            this->location = u.location;
         }
     };
     
@@ -142,8 +182,11 @@ protected:
         VertexArray::DataTypes datatype;
         int comp_count;
         void* data;
+
+        /// location of uniform in linked program, -1 if not present
+        GLint location;
         
-        inline NamedUniform(): comp_count(0), data(NULL) {}
+        inline NamedUniform(): comp_count(0), data(NULL), location(-1) {}
 
         inline ~NamedUniform()
         {
@@ -161,13 +204,49 @@ protected:
 
 	std::vector<std::shared_ptr<NamedUniform>> namedUniforms;
 
+    /// uniform blocks consumed, by name in the shaders
+    std::vector<std::pair<std::string, UniformBlockType>> uniformBlocks;
+
+    /// location of the instance offset of instanced programs, -1 if not present
+    GLint instanceOffsetLocation;
+
+    /// mask of the features this program was built with
+    unsigned int features;
+
+    /// mask of the features variants can be built with
+    unsigned int variantFeatures;
+    VariantBuilder variantBuilder;
+
+    /// variants built so far, by mask of features
+    std::unordered_map<unsigned int, std::shared_ptr<GpuProgram>> variants;
+
 	std::shared_ptr<Shader> vertexShader;
 	std::shared_ptr<Shader> fragmentShader;
-    
-	/// default constructor
-	inline GpuProgram() { /* intentionally left blank */ }
+
+    /// resolve uniform locations once, so setting them is only a GL call
+    inline void resolveLocations()
+    {
+        for (auto u : this->autoUniforms)
+            u->location = glGetUniformLocation(programId, u->varName.c_str());
+        for (auto u : this->namedUniforms)
+            u->location = glGetUniformLocation(programId, u->varName.c_str());
+        this->instanceOffsetLocation = glGetUniformLocation(programId, "instanceOffset");
+
+        // bind blocks to their binding points, also after loading a binary
+        // as bindings are reset by linking
+        for (const auto& block : this->uniformBlocks)
+        {
+            GLuint index = glGetUniformBlockIndex(programId, block.first.c_str());
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(programId, index, (GLuint)block.second);
+        }
+    }
 
 public:
+	/// constructor for a program with no shaders, to load a binary into
+	/// with loadBinary()
+	GpuProgram();
+
 	GpuProgram(std::shared_ptr<Shader> vertexShader, std::shared_ptr<Shader> fragmentShader);
     
 	/// destructor
@@ -182,7 +261,7 @@ public:
 	{
 	    glBindAttribLocation(programId, (int)type, name);
 	    
-	    MAGIC_THROW( glGetError() != GL_NO_ERROR, "Failed to bind attribute." );
+	    MAGIC_GL_CHECK("Failed to bind attribute.");
 	    
 	    nextIndex++;
 	}
@@ -216,12 +295,36 @@ public:
 	{
 		return this->namedUniforms;
 	}
+
+    /** Declare that this program reads a uniform block filled by the engine,
+     * must be called before linking as named and auto uniforms are
+     * @param blockName the name of the block in the shaders
+     * @param type      the block
+     */
+    inline void addUniformBlock(const char* blockName, UniformBlockType type)
+    {
+        this->uniformBlocks.push_back(std::make_pair(std::string(blockName), type));
+    }
+
+    /// check if this program reads a uniform block filled by the engine
+    inline bool hasUniformBlock(UniformBlockType type) const
+    {
+        for (const auto& block : this->uniformBlocks)
+        {
+            if (block.second == type)
+                return true;
+        }
+        return false;
+    }
 	
 	inline void link()
 	{
 	    GLint ret;
 	    
-	    // link the compiled shader program
+	    // link the compiled shader program, keeping its binary around in
+	    // case it is cached, see ProgramCache
+        if (GLEW_ARB_get_program_binary)
+            glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glLinkProgram(programId);
         
         // check for link errors
@@ -241,105 +344,200 @@ public:
 
             throw_ShaderCompileException(stream.str().c_str());
         }
+
+        this->resolveLocations();
 	}
 
+    /** Link this program from a binary of a linked program instead of
+     * shaders, uniforms must be added first as with link()
+     * @param format    the driver's format of the binary
+     * @param binary    the binary, see getBinary
+     * @param size      bytes of the binary
+     * @return false if the driver did not accept the binary
+     */
+    inline bool loadBinary(GLenum format, const void* binary, GLsizei size)
+    {
+        glProgramBinary(programId, format, binary, size);
+
+        GLint ret;
+        glGetProgramiv(programId, GL_LINK_STATUS, &ret);
+        if (ret == GL_FALSE)
+            return false;
+
+        this->resolveLocations();
+        return true;
+    }
+
+    /** Get the binary of this linked program
+     * @param format    set to the driver's format of the binary
+     * @return the binary, empty if the driver has none
+     */
+    inline std::vector<unsigned char> getBinary(GLenum& format) const
+    {
+        GLint length = 0;
+        glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+
+        std::vector<unsigned char> binary(length > 0 ? length : 0);
+        GLsizei written = 0;
+        format = 0;
+        if (length > 0)
+            glGetProgramBinary(programId, length, &written, &format, &binary[0]);
+        binary.resize(written);
+        return binary;
+    }
+
+    /// get the mask of a feature
+    inline static unsigned int getFeatureMask(Feature feature)
+    {
+        return 1u << (unsigned int)feature;
+    }
+
+    /// get the mask of the features this program was built with
+    inline unsigned int getFeatures() const
+    {
+        return this->features;
+    }
+
+    /// check if variants of this program can be built with a feature
+    inline bool hasVariantFeature(Feature feature) const
+    {
+        return (this->variantFeatures & getFeatureMask(feature)) != 0;
+    }
+
+    /** Set how variants of this program with other features are built
+     * @param features  mask of the features this program was built with
+     * @param variantFeatures mask of the features variants can have
+     * @param builder   builds a variant with a mask of features
+     */
+    inline void setVariantBuilder(unsigned int features, unsigned int variantFeatures,
+        VariantBuilder builder)
+    {
+        this->features = features;
+        this->variantFeatures = variantFeatures;
+        this->variantBuilder = builder;
+        this->variants.clear();
+    }
+
+    /** Get the variant of this program with a set of features, building
+     * it the first time it is asked for. Features the program does not
+     * have are ignored, so with none this program itself is returned.
+     * @param features  mask of the wanted features
+     * @return the variant, owned by this program
+     */
+    inline GpuProgram* getVariant(unsigned int features)
+    {
+        features &= this->variantFeatures;
+        if (features == this->features || !this->variantBuilder)
+            return this;
+
+        auto it = this->variants.find(features);
+        if (it != this->variants.end())
+            return it->second.get();
+
+        auto variant = this->variantBuilder(features);
+        this->variants[features] = variant;
+        return variant.get();
+    }
+
+    /** Get the location of a uniform in the linked program. Locations should
+     * be looked up once and then used with the uniform setters.
+     * @param name the name of the uniform
+     * @return the location of the uniform
+     */
+    inline GLint getUniformLocation(const char* name) const
+    {
+        GLint location = glGetUniformLocation(this->programId, name);
+        MAGIC_THROW( location < 0, "Tried to get a uniform that is not present in shader." );
+        return location;
+    }
+
     
-    inline void setUniformfv( const char* name, int components, const Scalar* values, int count = 1 )
+    inline void setUniformfv( GLint location, int components, const Scalar* values, int count = 1 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
+        MAGIC_THROW( location < 0, "Tried to set a uniform that is not present in shader." );
         switch( components )
         {
-            case 1: glUniform1fv(id, count, values); break;
-            case 2: glUniform2fv(id, count, values); break;
-            case 3: glUniform3fv(id, count, values); break;
-            case 4: glUniform4fv(id, count, values); break;
+            case 1: glUniform1fv(location, count, values); break;
+            case 2: glUniform2fv(location, count, values); break;
+            case 3: glUniform3fv(location, count, values); break;
+            case 4: glUniform4fv(location, count, values); break;
             default:
                 throw_MagicException("Attempt to set uniform with invalid component size");
         }
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformf( const char* name, const Scalar v1 )
+    inline void setUniformf( GLint location, const Scalar v1 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform1f( id, v1);
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_THROW( location < 0, "Tried to set a uniform that is not present in shader." );
+        glUniform1f( location, v1);
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformf( const char* name, const Scalar v1, const Scalar v2 )
+    inline void setUniformf( GLint location, const Scalar v1, const Scalar v2 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform2f( id, v1, v2);
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_THROW( location < 0, "Tried to set a uniform that is not present in shader." );
+        glUniform2f( location, v1, v2);
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformf( const char* name, const Scalar v1, const Scalar v2, const Scalar v3 )
+    inline void setUniformf( GLint location, const Scalar v1, const Scalar v2, const Scalar v3 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform3f( id, v1, v2, v3);
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_THROW( location < 0, "Tried to set a uniform that is not present in shader." );
+        glUniform3f( location, v1, v2, v3);
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformf( const char* name, const Scalar v1, const Scalar v2, const Scalar v3, Scalar v4 )
+    inline void setUniformf( GLint location, const Scalar v1, const Scalar v2, const Scalar v3, Scalar v4 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform4f( id, v1, v2, v3, v4);
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind float uniform for shader");    
+        MAGIC_THROW( location < 0, "Tried to set a uniform that is not present in shader." );
+        glUniform4f( location, v1, v2, v3, v4);
+        MAGIC_GL_CHECK("Could not bind float uniform for shader");
     }
     
-    inline void setUniformiv( const char* name, int components, const int* values, int count = 1 )
+    inline void setUniformiv( GLint location, int components, const int* values, int count = 1 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
+        MAGIC_THROW( location < 0, "Tried to set a uniform that is not present in shader." );
         switch( components )
         {
-            case 1: glUniform1iv(id, count, values); break;
-            case 2: glUniform2iv(id, count, values); break;
-            case 3: glUniform3iv(id, count, values); break;
-            case 4: glUniform4iv(id, count, values); break;
+            case 1: glUniform1iv(location, count, values); break;
+            case 2: glUniform2iv(location, count, values); break;
+            case 3: glUniform3iv(location, count, values); break;
+            case 4: glUniform4iv(location, count, values); break;
             default:
                 throw_MagicException("Attempt to set uniform with invalid component size");
         }
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind integer uniform for shader");    
+        MAGIC_GL_CHECK("Could not bind integer uniform for shader");
     }
     
-    inline void setUniformMatrix( const char* name, int components, const Scalar* values, int count = 1 )
+    inline void setUniformMatrix( GLint location, int components, const Scalar* values, int count = 1 )
     {
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
+        MAGIC_THROW( location < 0, "Tried to set a uniform that is not present in shader." );
         switch( components )
         {
-            case 2: glUniformMatrix2fv(id, count, GL_FALSE, values); break;
-            case 3: glUniformMatrix3fv(id, count, GL_FALSE, values); break;
-            case 4: glUniformMatrix4fv(id, count, GL_FALSE, values); break;
+            case 2: glUniformMatrix2fv(location, count, GL_FALSE, values); break;
+            case 3: glUniformMatrix3fv(location, count, GL_FALSE, values); break;
+            case 4: glUniformMatrix4fv(location, count, GL_FALSE, values); break;
             default:
                 throw_MagicException("Attempt to set matrix uniform with invalid component size");
         }
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind matrix uniform for shader");    
+        MAGIC_GL_CHECK("Could not bind matrix uniform for shader");
     }
     
-    inline void setTexture( const char* name, Texture* tex, int index)
+    inline void setTexture( GLint location, Texture* tex, int index)
     {
-        glActiveTexture(GL_TEXTURE0 + index);
-        tex->bind();
-        GLint id = glGetUniformLocation(this->programId, name);
-        MAGIC_THROW( id < 0, "Tried to set a uniform that is not present in shader." );
-        glUniform1i( id, index );
-    
-        if (glGetError() != GL_NO_ERROR)
-            throw_MagicException("Could not bind texture uniform for shader");
+        MAGIC_THROW( location < 0, "Tried to set a uniform that is not present in shader." );
+        GraphicsState::getSingleton().bindTexture(index, GL_TEXTURE_2D, tex->getID());
+        glUniform1i( location, index );
+        MAGIC_GL_CHECK("Could not bind texture uniform for shader");
+    }
+
+    inline void setTexture( GLint location, TextureBuffer* tex, int index)
+    {
+        MAGIC_THROW( location < 0, "Tried to set a uniform that is not present in shader." );
+        GraphicsState::getSingleton().bindTexture(index, GL_TEXTURE_BUFFER, tex->getID());
+        glUniform1i( location, index );
+        MAGIC_GL_CHECK("Could not bind texture buffer uniform for shader");
     }
     
 	
@@ -0,0 +1,190 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for ProgramCache class
+ *
+ * @file ProgramCache.cpp
+ * @author Andrew Keating
+ */
+#include <Shaders\ProgramCache.h>
+#include <Resources\ResourceData.h>
+#include <Exceptions\MagicException.h>
+#include <Util\Hash.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace Magic3D
+{
+
+static const char MAGIC[8] = { 'M', '3', 'D', 'P', 'R', 'O', 'G', 0 };
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t binaryFormat;
+    uint64_t key;
+    uint64_t size;
+};
+
+static std::atomic<unsigned int> hits(0);
+static std::atomic<unsigned int> misses(0);
+
+/// hash a string and its end, so "ab" "c" and "a" "bc" differ
+static uint64_t hashString(const char* text, uint64_t seed)
+{
+    if (text == nullptr)
+        text = "";
+    return hashBytes(text, strlen(text) + 1, seed);
+}
+
+uint64_t ProgramCache::hashSources(const std::string& vertexSource, const std::string& fragmentSource,
+    const std::vector<std::pair<std::string, GpuProgram::AttributeType>>& attributes)
+{
+    uint32_t version = VERSION;
+    uint64_t key = hashString(vertexSource.c_str(), hashBytes(&version, sizeof(version)));
+    key = hashString(fragmentSource.c_str(), key);
+    for (const auto& attribute : attributes)
+    {
+        int32_t index = (int32_t)attribute.second;
+        key = hashString(attribute.first.c_str(), key);
+        key = hashBytes(&index, sizeof(index), key);
+    }
+    return key;
+}
+
+uint64_t ProgramCache::hashDriver(uint64_t sourceHash)
+{
+    static const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+    uint64_t key = sourceHash;
+    for (GLenum name : names)
+        key = hashString((const char*)glGetString(name), key);
+    return key;
+}
+
+bool ProgramCache::isSupported()
+{
+    if (!GLEW_ARB_get_program_binary)
+        return false;
+
+    // drivers may support the calls but no formats at all
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+}
+
+std::string ProgramCache::getCachePath(const std::string& sourcePath, const std::string& cacheDir)
+{
+    if (cacheDir.empty())
+        return sourcePath + ".m3dprog";
+
+    // sources from different directories may share a name
+    std::ostringstream path;
+    path << cacheDir << "/" << std::hex << hashBytes(sourcePath.data(), sourcePath.size()) << ".m3dprog";
+    return path.str();
+}
+
+bool ProgramCache::load(const std::string& path, uint64_t key, GpuProgram& program)
+{
+    bool loaded = false;
+    std::ifstream test(path.c_str());
+    if (test.good() && isSupported())
+    {
+        test.close();
+        try
+        {
+            ResourceData file = ResourceData::mapFile(path);
+            Header header;
+            if (file.getSize() >= sizeof(header))
+            {
+                memcpy(&header, file.getData(), sizeof(header));
+                loaded = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                    header.version == VERSION && header.key == key &&
+                    header.size == file.getSize() - sizeof(header) &&
+                    program.loadBinary(header.binaryFormat, file.getData() + sizeof(header),
+                        (GLsizei)header.size);
+            }
+        }
+        catch (MagicException&)
+        {
+            // unreadable caches are built again like stale ones
+        }
+    }
+
+    if (loaded)
+        hits++;
+    else
+        misses++;
+    return loaded;
+}
+
+bool ProgramCache::save(const std::string& path, uint64_t key, const GpuProgram& program)
+{
+    if (!isSupported())
+        return false;
+
+    Header header;
+    GLenum format;
+    std::vector<unsigned char> binary = program.getBinary(format);
+    if (binary.empty())
+        return false;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.binaryFormat = format;
+    header.key = key;
+    header.size = binary.size();
+
+    // write beside the file and move it in place once complete, so a
+    // failed write never leaves a damaged cache behind
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out.good())
+        return false;
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)&binary[0], (std::streamsize)binary.size());
+    out.close();
+
+    std::remove(path.c_str());
+    if (!out.good() || std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+ProgramCache::Stats ProgramCache::getStats()
+{
+    Stats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    return stats;
+}
+
+void ProgramCache::resetStats()
+{
+    hits = 0;
+    misses = 0;
+}
+
+};
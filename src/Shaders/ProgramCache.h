@@ -0,0 +1,103 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ProgramCache class
+ *
+ * @file ProgramCache.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_PROGRAM_CACHE_H
+#define MAGIC3D_PROGRAM_CACHE_H
+
+#include "GpuProgram.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Magic3D
+{
+
+/** Cache of linked program binaries, so later runs skip compiling and
+ * linking shaders. A cache file holds a header with the format version,
+ * the key of the program and the driver's binary format, followed by the
+ * binary itself.
+ *
+ * Binaries only work with the driver that made them, so the key covers
+ * the driver as well as the shader sources and attribute bindings. A
+ * cache with another key, or one the driver no longer accepts, is stale:
+ * the program is built from source and the cache written again.
+ *
+ * All but the hashing of sources needs the graphics context.
+ */
+class ProgramCache
+{
+public:
+    /// version of the format, changing it needs a new version
+    static const uint32_t VERSION = 1;
+
+    /// loads from the cache since the start or the last reset
+    struct Stats
+    {
+        unsigned int hits;
+        unsigned int misses;
+    };
+
+    /// hash what a program is built from
+    static uint64_t hashSources(const std::string& vertexSource, const std::string& fragmentSource,
+        const std::vector<std::pair<std::string, GpuProgram::AttributeType>>& attributes);
+
+    /// hash the vendor, renderer and version of the driver into a hash of sources
+    static uint64_t hashDriver(uint64_t sourceHash);
+
+    /// check if the driver can give and take program binaries
+    static bool isSupported();
+
+    /** Get where the cache of a program goes
+     * @param sourcePath    full path of the program resource
+     * @param cacheDir      directory for cache files, empty to keep each next to its source
+     */
+    static std::string getCachePath(const std::string& sourcePath, const std::string& cacheDir);
+
+    /** Load a cached binary into a program with no shaders attached,
+     * counting a hit if it links and a miss otherwise
+     * @param path      path of the cache file
+     * @param key       hash of sources and driver, see hashDriver
+     * @param program   the program
+     * @return true if the program is linked
+     */
+    static bool load(const std::string& path, uint64_t key, GpuProgram& program);
+
+    /** Save the binary of a linked program to a cache file
+     * @param path      path of the cache file
+     * @param key       hash of sources and driver, see hashDriver
+     * @param program   the program
+     * @return false if it could not be saved
+     */
+    static bool save(const std::string& path, uint64_t key, const GpuProgram& program);
+
+    static Stats getStats();
+
+    static void resetStats();
+};
+
+};
+
+#endif
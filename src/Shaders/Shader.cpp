@@ -21,6 +21,9 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <Shaders/Shader.h>
 #include <Exceptions\ShaderCompileException.h>
 
+#include <algorithm>
+#include <cctype>
+
 
 namespace Magic3D
 {
@@ -50,5 +53,51 @@ Shader::~Shader()
     glDeleteShader(id);
 }
 
+std::string Shader::addDefines(const std::string& source, const std::vector<std::string>& defines,
+    const std::string& declarations)
+{
+    if (defines.empty() && declarations.empty())
+        return source;
+
+    // skip leading white space and comments to find the #version line
+    size_t pos = 0;
+    while (pos < source.size())
+    {
+        if (isspace((unsigned char)source[pos]))
+            pos++;
+        else if (source.compare(pos, 2, "//") == 0)
+            pos = source.find('\n', pos);
+        else if (source.compare(pos, 2, "/*") == 0)
+        {
+            pos = source.find("*/", pos + 2);
+            if (pos != std::string::npos)
+                pos += 2;
+        }
+        else
+            break;
+    }
+
+    size_t insert = 0;
+    int line = 1;
+    if (pos != std::string::npos && source.compare(pos, 8, "#version") == 0)
+    {
+        insert = source.find('\n', pos);
+        insert = insert == std::string::npos ? source.size() : insert + 1;
+        line += (int)std::count(source.begin(), source.begin() + insert, '\n');
+    }
+
+    std::string result = source.substr(0, insert);
+    if (!result.empty() && result.back() != '\n')
+        result += '\n';
+    for (const auto& define : defines)
+        result += "#define " + define + "\n";
+    result += declarations;
+    if (!declarations.empty() && declarations.back() != '\n')
+        result += '\n';
+    result += "#line " + std::to_string(line) + "\n";
+    result += source.substr(insert);
+    return result;
+}
+
 
 };
\ No newline at end of file
@@ -29,6 +29,9 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include <gl.h>
 #endif
 
+#include <string>
+#include <vector>
+
 
 namespace Magic3D
 {
@@ -59,6 +62,18 @@ protected:
 
 public:
     Shader(const char* shaderText, Type type);
+
+    /** Add #define lines and shared declarations to shader source, after
+     * its #version line if it has one, as #version must come first. Line
+     * numbers of the source are kept for compile errors.
+     * @param source        the shader source
+     * @param defines       names to define
+     * @param declarations  GLSL to add after the defines, such as
+     *                      FrameUniforms::DECLARATION
+     * @return the source with the defines and declarations
+     */
+    static std::string addDefines(const std::string& source,
+        const std::vector<std::string>& defines, const std::string& declarations = std::string());
     
 	virtual ~Shader();
 
@@ -0,0 +1,57 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for hashing helpers
+ *
+ * @file Hash.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_HASH_H
+#define MAGIC3D_HASH_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Magic3D
+{
+
+/// hash of no bytes, to start hashing from
+static const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+/** Hash bytes with 64-bit FNV-1a. Hashes are saved in cache files and packs,
+ * so this must never change without changing their versions.
+ * @param data  bytes to hash
+ * @param size  number of bytes
+ * @param seed  hash to continue from, to hash pieces as if they were one
+ */
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = HASH_SEED)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Util\Lz4.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace Magic3D
+{
+
+// limits of the format
+static const size_t MIN_MATCH = 4;
+static const size_t LAST_LITERALS = 5;  // last bytes are always literals
+static const size_t MATCH_START_LIMIT = 12; // last match starts before this many bytes from the end
+static const size_t MAX_OFFSET = 65535;
+
+static const unsigned int HASH_BITS = 12;
+
+static inline uint32_t read32(const unsigned char* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/// write the rest of a length that did not fit its token
+static inline void writeLength(std::vector<unsigned char>& out, size_t length)
+{
+    while (length >= 255)
+    {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back((unsigned char)length);
+}
+
+/// read the rest of a length that did not fit its token
+static inline bool readLength(const unsigned char* data, size_t size, size_t& pos, size_t& length)
+{
+    unsigned char byte;
+    do
+    {
+        if (pos >= size)
+            return false;
+        byte = data[pos++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/// write literals, followed by a match if its length is not zero
+static inline void writeSequence(std::vector<unsigned char>& out, const unsigned char* literals,
+    size_t literalCount, size_t offset, size_t matchLength)
+{
+    size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+    out.push_back((unsigned char)(((literalCount < 15 ? literalCount : 15) << 4) |
+        (matchCode < 15 ? matchCode : 15)));
+    if (literalCount >= 15)
+        writeLength(out, literalCount - 15);
+    out.insert(out.end(), literals, literals + literalCount);
+
+    if (matchLength == 0)
+        return;
+    out.push_back((unsigned char)(offset & 0xFF));
+    out.push_back((unsigned char)(offset >> 8));
+    if (matchCode >= 15)
+        writeLength(out, matchCode - 15);
+}
+
+size_t Lz4::getMaxCompressedSize(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+std::vector<unsigned char> Lz4::compress(const unsigned char* data, size_t size)
+{
+    std::vector<unsigned char> out;
+    out.reserve(getMaxCompressedSize(size));
+
+    size_t anchor = 0;
+    if (size > MATCH_START_LIMIT)
+    {
+        // last position each 4 byte sequence was seen at, plus one
+        std::vector<size_t> table((size_t)1 << HASH_BITS, 0);
+
+        size_t matchEndLimit = size - LAST_LITERALS;
+        size_t pos = 0;
+        while (pos + MATCH_START_LIMIT <= size)
+        {
+            uint32_t sequence = read32(data + pos);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+            size_t candidate = table[hash];
+            table[hash] = pos + 1;
+
+            if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET ||
+                read32(data + candidate - 1) != sequence)
+            {
+                pos++;
+                continue;
+            }
+            candidate--;
+
+            // grow the match forwards, then backwards over pending literals
+            size_t end = pos + MIN_MATCH;
+            while (end < matchEndLimit && data[end] == data[candidate + end - pos])
+                end++;
+            while (pos > anchor && candidate > 0 && data[pos - 1] == data[candidate - 1])
+            {
+                pos--;
+                candidate--;
+            }
+
+            writeSequence(out, data + anchor, pos - anchor, pos - candidate, end - pos);
+            pos = end;
+            anchor = pos;
+        }
+    }
+
+    writeSequence(out, data + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+bool Lz4::decompress(const unsigned char* data, size_t size,
+    unsigned char* out, size_t outSize)
+{
+    size_t pos = 0;
+    size_t outPos = 0;
+    while (pos < size)
+    {
+        unsigned char token = data[pos++];
+
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !readLength(data, size, pos, literalCount))
+            return false;
+        if (literalCount > size - pos || literalCount > outSize - outPos)
+            return false;
+        memcpy(out + outPos, data + pos, literalCount);
+        pos += literalCount;
+        outPos += literalCount;
+
+        // the last sequence has no match
+        if (pos == size)
+            break;
+
+        if (size - pos < 2)
+            return false;
+        size_t offset = data[pos] | ((size_t)data[pos + 1] << 8);
+        pos += 2;
+        if (offset == 0 || offset > outPos)
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(data, size, pos, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+        if (matchLength > outSize - outPos)
+            return false;
+
+        // byte by byte, matches can overlap what they write
+        const unsigned char* match = out + outPos - offset;
+        for (size_t i = 0; i < matchLength; i++)
+            out[outPos + i] = match[i];
+        outPos += matchLength;
+    }
+
+    return outPos == outSize;
+}
+
+};
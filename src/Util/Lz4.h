@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for Lz4 class
+ *
+ * @file Lz4.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_LZ4_H
+#define MAGIC3D_LZ4_H
+
+#include <cstddef>
+#include <vector>
+
+namespace Magic3D
+{
+
+/** Compression in the LZ4 block format, which decompresses at close to the
+ * speed of copying memory. Compression is a single greedy pass, it trades
+ * ratio for speed like the reference fast mode. Blocks are compatible with
+ * other LZ4 implementations, but hold no size, so the size decompressed
+ * must be kept beside them.
+ */
+class Lz4
+{
+public:
+    /// get the most a block of the given size can grow by compressing
+    static size_t getMaxCompressedSize(size_t size);
+
+    /** Compress a block
+     * @param data  bytes to compress
+     * @param size  number of bytes
+     * @return the compressed block
+     */
+    static std::vector<unsigned char> compress(const unsigned char* data, size_t size);
+
+    /** Decompress a block, checking every length and offset against the
+     * buffers, so corrupt data cannot read or write out of them
+     * @param data      compressed block
+     * @param size      size of the compressed block
+     * @param out       where to put the bytes decompressed
+     * @param outSize   number of bytes the block decompresses to
+     * @return false if the block is corrupt or not of the size given
+     */
+    static bool decompress(const unsigned char* data, size_t size,
+        unsigned char* out, size_t outSize);
+};
+
+};
+
+#endif
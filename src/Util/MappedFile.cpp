@@ -0,0 +1,120 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Util\MappedFile.h>
+#include <Exceptions\MagicException.h>
+
+// include dependent on OS (Windows or everyone else)
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Magic3D
+{
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) : data(nullptr), size(0),
+    file(INVALID_HANDLE_VALUE), mapping(nullptr)
+{
+    this->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (this->file == INVALID_HANDLE_VALUE)
+        throw_MagicException("Failed to open file to map");
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(this->file, &fileSize))
+    {
+        CloseHandle(this->file);
+        throw_MagicException("Failed to get size of file to map");
+    }
+    this->size = (size_t)fileSize.QuadPart;
+
+    // empty files cannot be mapped, there is nothing to read anyway
+    if (this->size == 0)
+        return;
+
+    this->mapping = CreateFileMappingA(this->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (this->mapping != nullptr)
+        this->data = (const unsigned char*)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (this->data == nullptr)
+    {
+        if (this->mapping != nullptr)
+            CloseHandle(this->mapping);
+        CloseHandle(this->file);
+        throw_MagicException("Failed to map file");
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (this->data != nullptr)
+        UnmapViewOfFile(this->data);
+    if (this->mapping != nullptr)
+        CloseHandle(this->mapping);
+    CloseHandle(this->file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) : data(nullptr), size(0)
+{
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        throw_MagicException("Failed to open file to map");
+
+    struct stat info;
+    if (fstat(file, &info) != 0)
+    {
+        close(file);
+        throw_MagicException("Failed to get size of file to map");
+    }
+    this->size = (size_t)info.st_size;
+
+    // empty files cannot be mapped, there is nothing to read anyway
+    if (this->size == 0)
+    {
+        close(file);
+        return;
+    }
+
+    // the mapping keeps its own reference to the file
+    void* mapped = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapped == MAP_FAILED)
+        throw_MagicException("Failed to map file");
+    this->data = (const unsigned char*)mapped;
+}
+
+MappedFile::~MappedFile()
+{
+    if (this->data != nullptr)
+        munmap((void*)this->data, this->size);
+}
+
+#endif
+
+};
@@ -0,0 +1,75 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for MappedFile class
+ *
+ * @file MappedFile.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_MAPPED_FILE_H
+#define MAGIC3D_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace Magic3D
+{
+
+/** Read-only view of a whole file mapped into memory. Pages are read from
+ * disk as they are first touched, and shared with the os file cache, so
+ * nothing is copied up front.
+ */
+class MappedFile
+{
+    const unsigned char* data;
+    size_t size;
+
+    // os handles, dependent on OS (Windows or everyone else)
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+public:
+    /** Map a file, throws if it cannot be opened or mapped
+     * @param path the path to the file
+     */
+    MappedFile(const std::string& path);
+
+    ~MappedFile();
+
+    /// get the contents of the file, null if the file is empty
+    inline const unsigned char* getData() const
+    {
+        return this->data;
+    }
+
+    /// get the size of the file in bytes
+    inline size_t getSize() const
+    {
+        return this->size;
+    }
+};
+
+};
+
+#endif
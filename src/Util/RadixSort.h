@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for radix sort helpers
+ *
+ * @file RadixSort.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_RADIX_SORT_H
+#define MAGIC3D_RADIX_SORT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace Magic3D
+{
+
+/** Sort items by an unsigned 64-bit key using a least-significant-digit
+ * radix sort with 8-bit digits.
+ *
+ * All digit histograms are built in a single pass over the items and any
+ * digit that is identical across every item is skipped, so keys that only
+ * use some of their bits cost proportionally less. The sort is stable.
+ *
+ * @param items     the items to sort, sorted in place
+ * @param scratch   scratch storage, kept by the caller to avoid reallocating
+ *                  every time a sort is done
+ * @param getKey    functor returning the uint64_t key of an item
+ */
+template<typename T, typename KeyFunc>
+inline void radixSort(std::vector<T>& items, std::vector<T>& scratch, KeyFunc getKey)
+{
+    const size_t count = items.size();
+    if (count < 2)
+        return;
+
+    unsigned int histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t key = getKey(items[i]);
+        for (int digit = 0; digit < 8; digit++)
+            histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+    }
+
+    scratch.resize(count);
+    std::vector<T>* src = &items;
+    std::vector<T>* dst = &scratch;
+
+    for (int digit = 0; digit < 8; digit++)
+    {
+        unsigned int* histogram = histograms[digit];
+
+        // every item has the same value for this digit, nothing to do
+        uint64_t firstKey = getKey((*src)[0]);
+        if (histogram[(firstKey >> (digit * 8)) & 0xFF] == count)
+            continue;
+
+        // turn counts into starting offsets
+        unsigned int offset = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            unsigned int c = histogram[b];
+            histogram[b] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const T& item = (*src)[i];
+            (*dst)[histogram[(getKey(item) >> (digit * 8)) & 0xFF]++] = item;
+        }
+
+        std::swap(src, dst);
+    }
+
+    // make sure sorted result ends up in items
+    if (src != &items)
+        items.swap(scratch);
+}
+
+
+};
+
+#endif
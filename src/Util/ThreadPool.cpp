@@ -0,0 +1,173 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <Util\ThreadPool.h>
+
+#include <algorithm>
+#include <exception>
+
+namespace Magic3D
+{
+
+ThreadPool::ThreadPool(unsigned int threadCount) : stopping(false)
+{
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (unsigned int i = 1; i < threadCount; i++)
+        this->workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->taskAdded.notify_all();
+    for (std::thread& worker : this->workers)
+        worker.join();
+}
+
+ThreadPool& ThreadPool::getSingleton()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->taskAdded.wait(lock, [this] { return this->stopping || !this->tasks.empty(); });
+            if (this->tasks.empty())
+                return;
+            task = std::move(this->tasks.front());
+            this->tasks.pop_front();
+        }
+        task();
+    }
+}
+
+bool ThreadPool::runQueuedTask()
+{
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->tasks.empty())
+            return false;
+        task = std::move(this->tasks.front());
+        this->tasks.pop_front();
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grainSize,
+    const std::function<void(size_t, size_t)>& func)
+{
+    if (end <= begin)
+        return;
+
+    size_t count = end - begin;
+    size_t chunks = std::min((size_t)this->getThreadCount(),
+        std::max(count / std::max(grainSize, (size_t)1), (size_t)1));
+    if (chunks == 1)
+    {
+        func(begin, end);
+        return;
+    }
+
+    // state shared with the tasks, which all finish before this returns
+    std::mutex doneMutex;
+    std::condition_variable doneChanged;
+    size_t remaining = chunks - 1;
+    std::exception_ptr error;
+
+    auto runChunk = [&](size_t chunk) {
+        size_t chunkBegin = begin + count * chunk / chunks;
+        size_t chunkEnd = begin + count * (chunk + 1) / chunks;
+        try
+        {
+            func(chunkBegin, chunkEnd);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (error == nullptr)
+                error = std::current_exception();
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (size_t chunk = 1; chunk < chunks; chunk++)
+        {
+            this->tasks.push_back([&, chunk] {
+                runChunk(chunk);
+                std::lock_guard<std::mutex> doneLock(doneMutex);
+                if (--remaining == 0)
+                    doneChanged.notify_all();
+            });
+        }
+    }
+    this->taskAdded.notify_all();
+
+    runChunk(0);
+
+    // help with queued work instead of idling, which also keeps nested
+    // loops from waiting on tasks no thread is free to run
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (remaining == 0)
+                break;
+        }
+        if (!this->runQueuedTask())
+        {
+            std::unique_lock<std::mutex> lock(doneMutex);
+            doneChanged.wait(lock, [&] { return remaining == 0; });
+            break;
+        }
+    }
+
+    if (error != nullptr)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::submit(const std::function<void()>& task)
+{
+    if (this->workers.empty())
+    {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->tasks.push_back(task);
+    }
+    this->taskAdded.notify_one();
+}
+
+};
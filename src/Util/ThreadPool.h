@@ -0,0 +1,96 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ThreadPool class
+ *
+ * @file ThreadPool.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_THREAD_POOL_H
+#define MAGIC3D_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Magic3D
+{
+
+/** Fixed set of worker threads for splitting data-parallel loops. The
+ * thread calling parallelFor() works on the loop as well, so a pool of one
+ * thread has no workers and runs everything on the caller.
+ */
+class ThreadPool
+{
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable taskAdded;
+    std::deque<std::function<void()>> tasks;
+    bool stopping;
+
+    void workerLoop();
+
+    /// run one queued task on the calling thread, false if none were queued
+    bool runQueuedTask();
+
+public:
+    /** @param threadCount number of threads to split loops across, including
+     *                     the calling thread, 0 means one per hardware thread
+     */
+    ThreadPool(unsigned int threadCount = 0);
+
+    ~ThreadPool();
+
+    /// shared pool, one thread per hardware thread
+    static ThreadPool& getSingleton();
+
+    /// get the number of threads loops are split across, including the caller
+    inline unsigned int getThreadCount() const
+    {
+        return (unsigned int)this->workers.size() + 1;
+    }
+
+    /** Call func on consecutive chunks of [begin, end) spread across the
+     * threads and wait for all of them to finish. Chunks are never smaller
+     * than the grain size, so small loops run on the caller alone. If any
+     * call throws, the first exception is rethrown once all chunks are done.
+     * @param begin     first index
+     * @param end       one past the last index
+     * @param grainSize smallest number of indices worth handing to a thread
+     * @param func      called with the [begin, end) of each chunk
+     */
+    void parallelFor(size_t begin, size_t end, size_t grainSize,
+        const std::function<void(size_t, size_t)>& func);
+
+    /** Run a task on a worker thread without waiting for it, or right away
+     * on the caller if the pool has no workers. Tasks must not throw.
+     * Threads waiting in parallelFor() may pick up submitted tasks as well.
+     * @param task the task to run
+     */
+    void submit(const std::function<void()>& task);
+};
+
+};
+
+#endif
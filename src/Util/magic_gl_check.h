@@ -0,0 +1,52 @@
+/* 
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for the magic GL error check, that is
+ * a glGetError check that is only done in debug builds.
+ * glGetError forces a round trip to the driver, so it is
+ * far too expensive to do after every call in release.
+ *
+ * Checks are enabled for debug builds (_DEBUG) or when
+ * MAGIC3D_DEBUG_GL is defined.
+ *
+ * @file magic_gl_check.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_MAGIC_GL_CHECK_H
+#define MAGIC3D_MAGIC_GL_CHECK_H
+
+#include "magic_throw.h"
+
+
+#if defined( _DEBUG ) || defined( MAGIC3D_DEBUG_GL )
+#define MAGIC3D_GL_CHECKS_ENABLED
+
+// throw if there is any pending GL error
+#define MAGIC_GL_CHECK(msg) \
+    MAGIC_THROW( glGetError() != GL_NO_ERROR, msg )
+
+// GL errors are not checked
+#else
+#define MAGIC_GL_CHECK(msg) {}
+
+#endif
+
+
+
+#endif
@@ -0,0 +1,49 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for the simd setup shared by passes with a scalar and an
+ * sse2 version that must give the same results.
+ *
+ * Defines MAGIC3D_SSE2 and includes the sse2 intrinsics when the target
+ * has them, and turns off contracting multiplies and adds into fused
+ * multiply-adds for the rest of the including file, as the scalar
+ * versions would otherwise round differently than the simd ones. Only
+ * include it from source files.
+ *
+ * @file simd.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_SIMD_H
+#define MAGIC3D_SIMD_H
+
+// sse2 is part of every x86-64 target
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAGIC3D_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#endif
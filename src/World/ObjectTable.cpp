@@ -0,0 +1,180 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Implementation file for ObjectTable class
+ *
+ * @file ObjectTable.cpp
+ * @author Andrew Keating
+ */
+
+#include <World\ObjectTable.h>
+
+namespace Magic3D
+{
+
+ObjectHandle ObjectTable::add(Object* object, Model* model, bool isStatic)
+{
+    uint32_t slot;
+    if (!this->freeSlots.empty())
+    {
+        slot = this->freeSlots.back();
+        this->freeSlots.pop_back();
+    }
+    else
+    {
+        slot = (uint32_t)this->slotRow.size();
+        this->slotRow.push_back(0);
+        this->slotGeneration.push_back(1);
+    }
+
+    this->slotRow[slot] = (uint32_t)this->objects.size();
+    this->objects.push_back(object);
+    this->models.push_back(model);
+    this->centerX.push_back(0);
+    this->centerY.push_back(0);
+    this->centerZ.push_back(0);
+    this->radius.push_back(0);
+    this->depth.push_back(0);
+    this->lodLevel.push_back(0);
+    this->flags.push_back(isStatic ? STATIC : 0);
+    this->rowSlot.push_back(slot);
+
+    return ObjectHandle(slot, this->slotGeneration[slot]);
+}
+
+bool ObjectTable::remove(ObjectHandle handle)
+{
+    if (!this->contains(handle))
+        return false;
+
+    // move the last row into the removed one
+    size_t row = this->slotRow[handle.slot];
+    size_t last = this->objects.size() - 1;
+    if (row != last)
+    {
+        this->objects[row] = this->objects[last];
+        this->models[row] = this->models[last];
+        this->centerX[row] = this->centerX[last];
+        this->centerY[row] = this->centerY[last];
+        this->centerZ[row] = this->centerZ[last];
+        this->radius[row] = this->radius[last];
+        this->depth[row] = this->depth[last];
+        this->lodLevel[row] = this->lodLevel[last];
+        this->flags[row] = this->flags[last];
+        this->rowSlot[row] = this->rowSlot[last];
+        this->slotRow[this->rowSlot[row]] = (uint32_t)row;
+    }
+
+    this->objects.pop_back();
+    this->models.pop_back();
+    this->centerX.pop_back();
+    this->centerY.pop_back();
+    this->centerZ.pop_back();
+    this->radius.pop_back();
+    this->depth.pop_back();
+    this->lodLevel.pop_back();
+    this->flags.pop_back();
+    this->rowSlot.pop_back();
+
+    // old handles of the slot are no longer valid
+    this->slotGeneration[handle.slot]++;
+    this->freeSlots.push_back(handle.slot);
+    return true;
+}
+
+void ObjectTable::clear()
+{
+    for (uint32_t slot : this->rowSlot)
+    {
+        this->slotGeneration[slot]++;
+        this->freeSlots.push_back(slot);
+    }
+
+    this->objects.clear();
+    this->models.clear();
+    this->centerX.clear();
+    this->centerY.clear();
+    this->centerZ.clear();
+    this->radius.clear();
+    this->depth.clear();
+    this->lodLevel.clear();
+    this->flags.clear();
+    this->rowSlot.clear();
+    this->moved.clear();
+}
+
+void ObjectTable::takeMoved(std::vector<uint32_t>& rows)
+{
+    // handles of objects removed since they were marked are no longer valid
+    rows.clear();
+    for (ObjectHandle handle : this->moved)
+    {
+        if (!this->contains(handle))
+            continue;
+        uint32_t row = this->slotRow[handle.slot];
+        this->flags[row] &= (uint8_t)~MOVED;
+        rows.push_back(row);
+    }
+    this->moved.clear();
+}
+
+void ObjectTable::computeDepths(const Vector3& eye, const Vector3& forward)
+{
+    const Scalar fx = forward.x(), fy = forward.y(), fz = forward.z();
+    const Scalar offset = -(eye.x() * fx + eye.y() * fy + eye.z() * fz);
+    const Scalar* x = this->centerX.data();
+    const Scalar* y = this->centerY.data();
+    const Scalar* z = this->centerZ.data();
+    Scalar* d = this->depth.data();
+
+    size_t count = this->objects.size();
+    for (size_t i = 0; i < count; i++)
+        d[i] = x[i] * fx + y[i] * fy + z[i] * fz + offset;
+}
+
+void ObjectTable::cull(const Scalar (*planes)[4], unsigned int planeCount,
+    std::vector<uint32_t>& visible)
+{
+    size_t count = this->objects.size();
+    this->inside.assign(count, 1);
+
+    const Scalar* x = this->centerX.data();
+    const Scalar* y = this->centerY.data();
+    const Scalar* z = this->centerZ.data();
+    const Scalar* r = this->radius.data();
+    uint8_t* in = this->inside.data();
+
+    // a plane at a time over all spheres, the inner loop has no branches
+    // so the compiler can vectorize it
+    for (unsigned int p = 0; p < planeCount; p++)
+    {
+        const Scalar a = planes[p][0], b = planes[p][1], c = planes[p][2], d = planes[p][3];
+        for (size_t i = 0; i < count; i++)
+            in[i] &= (uint8_t)(x[i] * a + y[i] * b + z[i] * c + d >= -r[i]);
+    }
+
+    visible.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        if (in[i] != 0)
+            visible.push_back((uint32_t)i);
+    }
+}
+
+};
@@ -0,0 +1,250 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for ObjectTable class
+ *
+ * @file ObjectTable.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_OBJECT_TABLE_H
+#define MAGIC3D_OBJECT_TABLE_H
+
+#include "../Math/MathTypes.h"
+#include "../Math/Vector.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace Magic3D
+{
+
+class Object;
+class Model;
+
+/** Handle of an object in an ObjectTable. A handle stays valid while its
+ * object is in the table, even as other objects are added and removed,
+ * and is never valid again once its object is removed.
+ */
+struct ObjectHandle
+{
+    uint32_t slot;
+    uint32_t generation;
+
+    /// a handle of no object
+    inline ObjectHandle() : slot(UINT32_MAX), generation(0) {}
+
+    inline ObjectHandle(uint32_t slot, uint32_t generation) : slot(slot), generation(generation) {}
+
+    inline bool operator==(const ObjectHandle& h) const
+    {
+        return this->slot == h.slot && this->generation == h.generation;
+    }
+
+    inline bool operator!=(const ObjectHandle& h) const
+    {
+        return !(*this == h);
+    }
+};
+
+/** Render state of the objects of a world, as a structure of arrays. Each
+ * column is a dense array with a row per object, so the per frame loops
+ * (depth, level of detail and culling) are linear scans over only the data they
+ * need instead of chasing pointers from object to model to mesh.
+ *
+ * Rows are not stable, removing an object moves the last row into its
+ * place; objects are kept track of with handles instead. Adding and
+ * removing are O(1).
+ *
+ * Objects mark themselves moved, see markMoved, so only the bounds of
+ * those are brought up to date each frame and objects at rest cost
+ * nothing.
+ *
+ * Objects and models are only kept, never used, by the table. Materials
+ * are not kept, as models can change theirs at any time, while the model
+ * of an object never changes.
+ */
+class ObjectTable
+{
+    // columns, by row
+    std::vector<Object*> objects;
+    std::vector<Model*> models;
+    std::vector<Scalar> centerX;
+    std::vector<Scalar> centerY;
+    std::vector<Scalar> centerZ;
+    std::vector<Scalar> radius;
+    std::vector<Scalar> depth;
+    std::vector<unsigned int> lodLevel;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> rowSlot;
+
+    /// scratch of cull(), non zero for rows inside all planes
+    std::vector<uint8_t> inside;
+
+    // rows and generations of the handle slots, and slots not in use
+    std::vector<uint32_t> slotRow;
+    std::vector<uint32_t> slotGeneration;
+    std::vector<uint32_t> freeSlots;
+
+    /// objects marked moved since the last takeMoved(), each once
+    std::vector<ObjectHandle> moved;
+
+    enum Flags
+    {
+        STATIC = 1,
+        MOVED = 2
+    };
+
+public:
+    /** Add an object
+     * @param object    the object
+     * @param model     the object's model
+     * @param isStatic  whether the object is static, its bounds are in
+     *                  world space already and never change
+     * @return the handle of the object
+     */
+    ObjectHandle add(Object* object, Model* model, bool isStatic);
+
+    /** Remove an object
+     * @param handle the handle of the object
+     * @return false if the handle is not valid
+     */
+    bool remove(ObjectHandle handle);
+
+    /// check if a handle is of an object in the table
+    inline bool contains(ObjectHandle handle) const
+    {
+        return handle.slot < this->slotGeneration.size() &&
+            this->slotGeneration[handle.slot] == handle.generation;
+    }
+
+    /// get the row of an object, the handle must be valid
+    inline size_t getRow(ObjectHandle handle) const
+    {
+        return this->slotRow[handle.slot];
+    }
+
+    /// get the object of a handle, nullptr if the handle is not valid
+    inline Object* get(ObjectHandle handle) const
+    {
+        return this->contains(handle) ? this->objects[this->getRow(handle)] : nullptr;
+    }
+
+    /// get the number of objects
+    inline size_t getSize() const
+    {
+        return this->objects.size();
+    }
+
+    /// remove all objects, all handles become invalid
+    void clear();
+
+    inline Object* getObject(size_t row) const
+    {
+        return this->objects[row];
+    }
+
+    inline Model* getModel(size_t row) const
+    {
+        return this->models[row];
+    }
+
+    inline bool isStatic(size_t row) const
+    {
+        return (this->flags[row] & STATIC) != 0;
+    }
+
+    inline Vector3 getCenter(size_t row) const
+    {
+        return Vector3(this->centerX[row], this->centerY[row], this->centerZ[row]);
+    }
+
+    inline Scalar getRadius(size_t row) const
+    {
+        return this->radius[row];
+    }
+
+    /// get the depth of a row, as of the last computeDepths()
+    inline Scalar getDepth(size_t row) const
+    {
+        return this->depth[row];
+    }
+
+    /// get the level of detail of the model selected for a row
+    inline unsigned int getLodLevel(size_t row) const
+    {
+        return this->lodLevel[row];
+    }
+
+    inline void setLodLevel(size_t row, unsigned int level)
+    {
+        this->lodLevel[row] = level;
+    }
+
+    /// mark an object moved, its bounds need bringing up to date. Objects
+    /// not in the table are ignored
+    inline void markMoved(ObjectHandle handle)
+    {
+        if (!this->contains(handle))
+            return;
+        uint8_t& rowFlags = this->flags[this->getRow(handle)];
+        if ((rowFlags & MOVED) == 0)
+        {
+            rowFlags |= MOVED;
+            this->moved.push_back(handle);
+        }
+    }
+
+    /** Get the objects marked moved since the last call and clear the marks
+     * @param rows  set to the rows of the objects still in the table
+     */
+    void takeMoved(std::vector<uint32_t>& rows);
+
+    /** Set the world space bounding sphere of a row
+     * @param row       the row
+     * @param center    center of the sphere
+     * @param radius    radius of the sphere
+     */
+    inline void setBounds(size_t row, const Vector3& center, Scalar radius)
+    {
+        this->centerX[row] = center.x();
+        this->centerY[row] = center.y();
+        this->centerZ[row] = center.z();
+        this->radius[row] = radius;
+    }
+
+    /** Compute the depth of the centers of all rows along a view direction
+     * @param eye       location of the viewer
+     * @param forward   direction of the view, normalized
+     */
+    void computeDepths(const Vector3& eye, const Vector3& forward);
+
+    /** Find the rows with bounding spheres not entirely outside any of a set
+     * of planes
+     * @param planes    a, b, c and d of each plane ax + by + cz + d = 0,
+     *                  with normals pointing inside
+     * @param planeCount the number of planes
+     * @param visible   set to the rows inside, in order
+     */
+    void cull(const Scalar (*planes)[4], unsigned int planeCount, std::vector<uint32_t>& visible);
+};
+
+};
+
+#endif
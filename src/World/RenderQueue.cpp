@@ -0,0 +1,95 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <World\RenderQueue.h>
+#include <Util\RadixSort.h>
+
+namespace Magic3D
+{
+
+unsigned int RenderQueue::getId(std::unordered_map<const void*, unsigned int>& ids,
+    const void* object, int bits)
+{
+    if (object == nullptr)
+        return 0;
+
+    auto it = ids.find(object);
+    if (it != ids.end())
+        return it->second;
+
+    // 0 is reserved for 'no object'
+    unsigned int id = ((unsigned int)ids.size() % ((1u << bits) - 1)) + 1;
+    ids.insert(std::make_pair(object, id));
+    return id;
+}
+
+void RenderQueue::sort()
+{
+    radixSort(this->items, this->scratch, [](const Item& item) -> uint64_t {
+        return item.key;
+    });
+}
+
+uint64_t RenderQueue::makeKey(bool transparent, const void* program, const void* texture,
+    const void* material, const void* mesh, Scalar depth, Scalar maxDepth)
+{
+    return packKey(transparent,
+        getId(this->programIds, program, PROGRAM_BITS),
+        getId(this->textureIds, texture, TEXTURE_BITS),
+        getId(this->materialIds, material, MATERIAL_BITS),
+        getId(this->meshIds, mesh, MESH_BITS),
+        quantizeDepth(depth, maxDepth)
+    );
+}
+
+uint64_t RenderQueue::packKey(bool transparent, unsigned int programId,
+    unsigned int textureId, unsigned int materialId, unsigned int meshId,
+    unsigned int depth)
+{
+    const uint64_t depthMask = (1ULL << DEPTH_BITS) - 1;
+
+    uint64_t state =
+        ((uint64_t)(programId & ((1u << PROGRAM_BITS) - 1)) << (TEXTURE_BITS + MATERIAL_BITS)) |
+        ((uint64_t)(textureId & ((1u << TEXTURE_BITS) - 1)) << MATERIAL_BITS) |
+        ((uint64_t)(materialId & ((1u << MATERIAL_BITS) - 1)));
+    uint64_t mesh = meshId & ((1u << MESH_BITS) - 1);
+    const int stateBits = PROGRAM_BITS + TEXTURE_BITS + MATERIAL_BITS;
+
+    // opaque: state first to minimize changes, then front to back within a state
+    if (!transparent)
+        return (state << (MESH_BITS + DEPTH_BITS)) | (mesh << DEPTH_BITS) | (depth & depthMask);
+
+    // transparent: back to front first, as blending depends on it
+    uint64_t inverted = depthMask - (depth & depthMask);
+    return TRANSPARENT_BIT | (inverted << (stateBits + MESH_BITS)) |
+        (state << MESH_BITS) | mesh;
+}
+
+unsigned int RenderQueue::quantizeDepth(Scalar depth, Scalar maxDepth)
+{
+    const unsigned int maxValue = (1u << DEPTH_BITS) - 1;
+    if (depth <= 0 || maxDepth <= 0)
+        return 0;
+    if (depth >= maxDepth)
+        return maxValue;
+    return (unsigned int)((depth / maxDepth) * maxValue);
+}
+
+
+};
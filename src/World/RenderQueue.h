@@ -0,0 +1,167 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Header file for RenderQueue class
+ *
+ * @file RenderQueue.h
+ * @author Andrew Keating
+ */
+#ifndef MAGIC3D_RENDER_QUEUE_H
+#define MAGIC3D_RENDER_QUEUE_H
+
+#include "../Math/MathTypes.h"
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+namespace Magic3D
+{
+
+/** Queue of draw items for a single frame, ordered by a packed 64-bit sort
+ * key so that state changes are minimized and depth ordering is kept.
+ *
+ * Opaque key layout (most significant bit first):
+ *  - 1 bit bucket (0 = opaque)
+ *  - 8 bits gpu program id
+ *  - 10 bits texture id
+ *  - 12 bits material id
+ *  - 13 bits mesh id
+ *  - 20 bits quantized view depth, front to back
+ *
+ * Transparent key layout (most significant bit first):
+ *  - 1 bit bucket (1 = transparent)
+ *  - 20 bits inverted quantized view depth, back to front
+ *  - 8 bits gpu program id
+ *  - 10 bits texture id
+ *  - 12 bits material id
+ *  - 13 bits mesh id
+ *
+ * Ids are handed out the first time a state object is seen in a frame and
+ * wrap around when a field overflows. They are forgotten by clear(), so
+ * the maps stay as small as one frame and objects allocated where freed
+ * ones were do not inherit their ids. Key collisions only cost batching,
+ * never correctness, as the renderer still compares the actual state.
+ * The mesh id keeps items that can be drawn instanced next to each other.
+ */
+class RenderQueue
+{
+public:
+    /// single entry in the queue, index refers to caller-owned data
+    struct Item
+    {
+        uint64_t key;
+        unsigned int index;
+    };
+
+    static const int DEPTH_BITS = 20;
+    static const int MATERIAL_BITS = 12;
+    static const int TEXTURE_BITS = 10;
+    static const int PROGRAM_BITS = 8;
+    static const int MESH_BITS = 13;
+
+    static const uint64_t TRANSPARENT_BIT = 1ULL << 63;
+
+private:
+    std::vector<Item> items;
+    std::vector<Item> scratch;
+
+    std::unordered_map<const void*, unsigned int> programIds;
+    std::unordered_map<const void*, unsigned int> textureIds;
+    std::unordered_map<const void*, unsigned int> materialIds;
+    std::unordered_map<const void*, unsigned int> meshIds;
+
+    unsigned int getId(std::unordered_map<const void*, unsigned int>& ids,
+        const void* object, int bits);
+
+public:
+    inline RenderQueue() {}
+
+    /** Remove all items from the queue and forget the ids of state
+     * objects, keeping allocated storage
+     */
+    inline void clear()
+    {
+        this->items.clear();
+        this->programIds.clear();
+        this->textureIds.clear();
+        this->materialIds.clear();
+        this->meshIds.clear();
+    }
+
+    inline void reserve(size_t count)
+    {
+        this->items.reserve(count);
+        this->scratch.reserve(count);
+    }
+
+    inline void push(uint64_t key, unsigned int index)
+    {
+        Item item;
+        item.key = key;
+        item.index = index;
+        this->items.push_back(item);
+    }
+
+    /** Sort the queue by key. Items with equal keys keep the order they
+     * were pushed in.
+     */
+    void sort();
+
+    inline size_t size() const
+    {
+        return this->items.size();
+    }
+
+    inline const Item& operator[](size_t i) const
+    {
+        return this->items[i];
+    }
+
+    /** Build a sort key for a draw item, mapping the given state objects
+     * to ids that are stable until the queue is cleared.
+     *
+     * @param transparent   whether the item is drawn in the transparent bucket
+     * @param program       gpu program used, only used for identity
+     * @param texture       primary texture used, only used for identity
+     * @param material      material used, only used for identity
+     * @param mesh          mesh drawn, only used for identity
+     * @param depth         distance along the camera forward vector
+     * @param maxDepth      largest depth of the frame, used for quantizing
+     */
+    uint64_t makeKey(bool transparent, const void* program, const void* texture,
+        const void* material, const void* mesh, Scalar depth, Scalar maxDepth);
+
+    /** Pack already assigned ids and a quantized depth into a sort key.
+     * Ids and depth are truncated to their field widths.
+     */
+    static uint64_t packKey(bool transparent, unsigned int programId,
+        unsigned int textureId, unsigned int materialId, unsigned int meshId,
+        unsigned int depth);
+
+    /** Quantize a depth into the range [0, 2^DEPTH_BITS). Depths outside
+     * of [0, maxDepth] are clamped.
+     */
+    static unsigned int quantizeDepth(Scalar depth, Scalar maxDepth);
+};
+
+};
+
+#endif
@@ -46,13 +46,26 @@ void World::stepPhysics()
 }
   
 
-void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
+GpuProgram* World::setupMaterial(Material& material, const Matrix4& modelMatrix,
     const Matrix4& viewMatrix, const Matrix4& projectionMatrix, bool wireframe,
-    Matrix4* shadowMatrix, std::shared_ptr<Texture> shadowMap)
+    Matrix4* shadowMatrix, std::shared_ptr<Texture> shadowMap, bool instanced)
 {
-    auto gpuProgram = material.gpuProgram;
+    GpuProgram* gpuProgram = material.gpuProgram.get();
     MAGIC_ASSERT(gpuProgram != nullptr);
 
+    // pick the variant of the program with just the features in use, so
+    // the shaders do not branch on them
+    unsigned int features = 0;
+    if (material.normalMap != nullptr && this->useNormalMaps)
+        features |= GpuProgram::getFeatureMask(GpuProgram::NORMAL_MAPPING);
+    if (shadowMap != nullptr && this->light.canCastShadows && this->castShadows)
+        features |= GpuProgram::getFeatureMask(GpuProgram::SHADOW_MAPPING);
+    if (this->showSpecularHighlight)
+        features |= GpuProgram::getFeatureMask(GpuProgram::SPECULAR_HIGHLIGHT);
+    if (instanced)
+        features |= GpuProgram::getFeatureMask(GpuProgram::INSTANCED);
+    gpuProgram = gpuProgram->getVariant(features);
+
     // 'use' gpuProgram
     gpuProgram->use();
 
@@ -60,13 +73,15 @@ void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
     for (unsigned int i = 0; i < gpuProgram->namedUniforms.size(); i++)
     {
         GpuProgram::NamedUniform& u = *gpuProgram->namedUniforms[i];
+        if (u.location < 0)
+            continue;
         switch (u.datatype)
         {
         case VertexArray::FLOAT:
-            gpuProgram->setUniformfv(u.varName.c_str(), u.comp_count, (const float*)u.data);
+            gpuProgram->setUniformfv(u.location, u.comp_count, (const float*)u.data);
             break;
         case VertexArray::INT:
-            gpuProgram->setUniformiv(u.varName.c_str(), u.comp_count, (const int*)u.data);
+            gpuProgram->setUniformiv(u.location, u.comp_count, (const int*)u.data);
             break;
         default:
             throw_MagicException("Unsupported Auto Uniform datatype.");
@@ -80,76 +95,87 @@ void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
     Matrix3 temp3m;
     Vector3 tempp3;
     Scalar tempf;
+
+    // several uniforms need the model view matrix, multiply it once
+    Matrix4 modelViewMatrix;
+    bool modelViewSet = false;
+    auto getModelView = [&]() -> const Matrix4& {
+        if (!modelViewSet)
+        {
+            modelViewMatrix.multiply(viewMatrix, modelMatrix);
+            modelViewSet = true;
+        }
+        return modelViewMatrix;
+    };
+
     for (unsigned int i = 0; i < gpuProgram->autoUniforms.size(); i++)
     {
         GpuProgram::AutoUniform& u = *gpuProgram->autoUniforms[i];
+
+        // uniforms of features left out of the variant are not present
+        if (u.location < 0)
+            continue;
         switch (u.type)
         {
         case GpuProgram::MODEL_MATRIX:                   // mat4
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, modelMatrix.getArray());
+            gpuProgram->setUniformMatrix(u.location, 4, modelMatrix.getArray());
             break;
         case GpuProgram::VIEW_MATRIX:                    // mat4
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, viewMatrix.getArray());
+            gpuProgram->setUniformMatrix(u.location, 4, viewMatrix.getArray());
             break;
         case GpuProgram::PROJECTION_MATRIX:              // mat4
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, projectionMatrix.getArray());
+            gpuProgram->setUniformMatrix(u.location, 4, projectionMatrix.getArray());
             break;
 
-            // TODO: stop multiplying these matrices for every individual mesh
+            // these are multiplied for every mesh, programs reading the view
+            // and projection from the frame block (see FrameUniforms) avoid it
         case GpuProgram::MODEL_VIEW_MATRIX:              // mat4
-            temp4m.multiply(viewMatrix, modelMatrix);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m.getArray());
+            gpuProgram->setUniformMatrix(u.location, 4, getModelView().getArray());
             break;
         case GpuProgram::VIEW_PROJECTION_MATRIX:         // mat4
             temp4m.multiply(projectionMatrix, viewMatrix);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m.getArray());
+            gpuProgram->setUniformMatrix(u.location, 4, temp4m.getArray());
             break;
         case GpuProgram::MODEL_PROJECTION_MATRIX:        // mat4
             temp4m.multiply(projectionMatrix, modelMatrix);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m.getArray());
+            gpuProgram->setUniformMatrix(u.location, 4, temp4m.getArray());
             break;
         case GpuProgram::MODEL_VIEW_PROJECTION_MATRIX:   // mat4
-            temp4m.multiply(viewMatrix, modelMatrix);
-            temp4m2.multiply(projectionMatrix, temp4m);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m2.getArray());
+            temp4m2.multiply(projectionMatrix, getModelView());
+            gpuProgram->setUniformMatrix(u.location, 4, temp4m2.getArray());
             break;
         case GpuProgram::NORMAL_MATRIX:                  // mat3
-            temp4m.multiply(viewMatrix, modelMatrix);
+            temp4m.set(getModelView());
             temp4m.extractRotation(temp3m);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 3, temp3m.getArray());
+            gpuProgram->setUniformMatrix(u.location, 3, temp3m.getArray());
             break;
 
         case GpuProgram::TEXTURE0:                       // sampler2D
             MAGIC_THROW(material.textures[0] == NULL, "Material has auto-bound "
                 "texture set, but no texture set for the index.");
             if (this->useTextures)
-                gpuProgram->setTexture(u.varName.c_str(), material.textures[0].get(), 0);
+                gpuProgram->setTexture(u.location, material.textures[0].get(), 0);
             else
-                gpuProgram->setTexture(u.varName.c_str(), fallbackTexture.get(), 0);
+                gpuProgram->setTexture(u.location, fallbackTexture.get(), 0);
             break;
         case GpuProgram::NORMAL_MAP:                       // sampler2D
             if (material.normalMap != nullptr && this->useNormalMaps)
-            {
-                gpuProgram->setTexture(u.varName.c_str(), material.normalMap.get(), 8);
-                gpuProgram->setUniformf("normalMapping", 1.0f);
-            }
-            else
-                gpuProgram->setUniformf("normalMapping", 0.0f);
+                gpuProgram->setTexture(u.location, material.normalMap.get(), 8);
             break;
         case GpuProgram::SHININESS:                 // float
-            gpuProgram->setUniformf(u.varName.c_str(), material.shininess);
+            gpuProgram->setUniformf(u.location, material.shininess);
             break;
         case GpuProgram::SPECULAR_COLOR:                  // vec3
             if (this->showSpecularHighlight)
             {
-                gpuProgram->setUniformf(u.varName.c_str(),
+                gpuProgram->setUniformf(u.location,
                     material.specularColor.getChannel(0, true),
                     material.specularColor.getChannel(1, true),
                     material.specularColor.getChannel(2, true)
                     );
             }
             else
-                gpuProgram->setUniformf(u.varName.c_str(), 0.0f, 0.0f, 0.0f);
+                gpuProgram->setUniformf(u.location, 0.0f, 0.0f, 0.0f);
             break;
 
 
@@ -159,28 +185,28 @@ void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
             tempf = 1.0f;
             if (light.locationLess)
                 tempf = 0.0f;
-            gpuProgram->setUniformf(u.varName.c_str(), tempp3.x(),
+            gpuProgram->setUniformf(u.location, tempp3.x(),
                 tempp3.y(), tempp3.z(), tempf);
             break;
         case GpuProgram::LIGHT_DIRECTION:                 // vec3
             tempp3 = light.direction;
-            gpuProgram->setUniformf(u.varName.c_str(), tempp3.x(),
+            gpuProgram->setUniformf(u.location, tempp3.x(),
                 tempp3.y(), tempp3.z());
             break;
         case GpuProgram::LIGHT_ANGLE:                 // float
-            gpuProgram->setUniformf(u.varName.c_str(), this->light.angle);
+            gpuProgram->setUniformf(u.location, this->light.angle);
             break;
         case GpuProgram::LIGHT_INTENSITY:                 // float
-            gpuProgram->setUniformf(u.varName.c_str(), this->light.intensity);
+            gpuProgram->setUniformf(u.location, this->light.intensity);
             break;
         case GpuProgram::LIGHT_ATTENUATION_FACTOR:                 // float
-            gpuProgram->setUniformf(u.varName.c_str(), this->light.attenuationFactor);
+            gpuProgram->setUniformf(u.location, this->light.attenuationFactor);
             break;
         case GpuProgram::LIGHT_AMBIENT_FACTOR:                 // float
-            gpuProgram->setUniformf(u.varName.c_str(), this->light.ambientFactor);
+            gpuProgram->setUniformf(u.location, this->light.ambientFactor);
             break;
         case GpuProgram::LIGHT_COLOR:                           // vec3
-            gpuProgram->setUniformf(u.varName.c_str(), 
+            gpuProgram->setUniformf(u.location, 
                 light.lightColor.getChannel(0, true),
                 light.lightColor.getChannel(1, true),
                 light.lightColor.getChannel(2, true)
@@ -190,24 +216,23 @@ void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
         case GpuProgram::FLAT_PROJECTION:   // mat4
             temp4m.createOrthographicMatrix(0, (Scalar)this->graphics.getDisplayWidth(),
                 0, (Scalar)this->graphics.getDisplayHeight(), -1.0, 1.0);
-            gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m.getArray());
+            gpuProgram->setUniformMatrix(u.location, 4, temp4m.getArray());
             break;
 
         case GpuProgram::SHADOW_MATRIX:   // mat4
             if (shadowMatrix != nullptr)
             {
                 temp4m.multiply(*shadowMatrix, modelMatrix);
-                gpuProgram->setUniformMatrix(u.varName.c_str(), 4, temp4m.getArray());
+                gpuProgram->setUniformMatrix(u.location, 4, temp4m.getArray());
             }
             break;
         case GpuProgram::SHADOW_MAP:    // sampler2D
             if (shadowMap != nullptr && this->light.canCastShadows && this->castShadows)
-            {
-                gpuProgram->setTexture(u.varName.c_str(), shadowMap.get(), 9);
-                gpuProgram->setUniformf("shadowMapping", 1.0f);
-            }
-            else
-                gpuProgram->setUniformf("shadowMapping", 0.0f);
+                gpuProgram->setTexture(u.location, shadowMap.get(), 9);
+            break;
+
+        case GpuProgram::INSTANCE_TRANSFORMS:   // samplerBuffer
+            gpuProgram->setTexture(u.location, this->instanceBuffer.get(), 10);
             break;
 
         default:
@@ -216,55 +241,130 @@ void World::setupMaterial(Material& material, const Matrix4& modelMatrix,
         }
     }
 
+    GraphicsState& state = GraphicsState::getSingleton();
+
     // check for a depth lie
     if (material.depthBufferLie)
     {
-        glPolygonOffset(material.depthBufferLie, 1.0f);
-        glEnable(GL_POLYGON_OFFSET_FILL);
+        state.setPolygonOffset(material.depthBufferLie, 1.0f);
+        state.enable(GraphicsState::POLYGON_OFFSET_FILL);
     }
 
     // disable depth buffer writes if mesh is transparent
     if (material.transparent)
-        glDepthMask(GL_FALSE);
+        state.setDepthMask(false);
 
     // setup wireframe if set to
     if (wireframe)
     {
-        glEnable(GL_BLEND);
-        glEnable(GL_LINE_SMOOTH);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glDisable(GL_CULL_FACE);
+        state.enable(GraphicsState::BLEND);
+        state.enable(GraphicsState::LINE_SMOOTH);
+        state.setPolygonMode(GL_LINE);
+        state.disable(GraphicsState::CULL_FACE);
     }
+
+    return gpuProgram;
 }
 
 void World::tearDownMaterial(Material& material, bool wireframe)
 {
+    GraphicsState& state = GraphicsState::getSingleton();
+
     // disable depth lie if it was enabled
     if (material.depthBufferLie)
-        glDisable(GL_POLYGON_OFFSET_FILL);
+        state.disable(GraphicsState::POLYGON_OFFSET_FILL);
 
     // re-enabled depth buffer write
     if (material.transparent)
-        glDepthMask(GL_TRUE);
+        state.setDepthMask(true);
 
     // restore after wireframe
     if (wireframe)
     {
-        glDisable(GL_LINE_SMOOTH);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glEnable(GL_CULL_FACE);
+        state.disable(GraphicsState::LINE_SMOOTH);
+        state.setPolygonMode(GL_FILL);
+        state.enable(GraphicsState::CULL_FACE);
     }
 }
 
-void World::renderMesh(const TriangleMesh& mesh)
+void World::renderMesh(const TriangleMesh& mesh, unsigned int instanceCount)
 {
     // draw mesh
-    mesh.getVertexArray().drawIndexed(
-        VertexArray::TRIANGLES, 
-        mesh.getFaceCount() * 3,
-        (unsigned int*)mesh.getFaceData(0)
-    );
-    vertexCount += mesh.getVertexCount();   
+    if (instanceCount == 1)
+    {
+        mesh.getVertexArray().drawIndexed(
+            VertexArray::TRIANGLES, 
+            mesh.getFaceCount() * 3,
+            mesh.getIndexType()
+        );
+    }
+    else
+    {
+        mesh.getVertexArray().drawIndexedInstanced(
+            VertexArray::TRIANGLES, 
+            mesh.getFaceCount() * 3,
+            mesh.getIndexType(),
+            instanceCount
+        );
+    }
+    vertexCount += mesh.getVertexCount() * instanceCount;
+    drawCallCount++;
+}
+
+unsigned int World::getInstanceRunLength(const RenderQueue& queue,
+    const std::vector<RenderItem>& items, size_t start, bool sameMaterial) const
+{
+    const RenderItem& first = items[queue[start].index];
+    if (first.isStatic)
+        return 1;
+
+    size_t end = start + 1;
+    for (; end < queue.size(); end++)
+    {
+        const RenderItem& item = items[queue[end].index];
+        if (item.isStatic || item.mesh != first.mesh)
+            break;
+        if (sameMaterial && item.material != first.material)
+            break;
+    }
+    return (unsigned int)(end - start);
+}
+
+void World::setInstanceOffset(GpuProgram& program, unsigned int offset)
+{
+    if (program.instanceOffsetLocation < 0)
+        return;
+    int value = (int)offset;
+    program.setUniformiv(program.instanceOffsetLocation, 1, &value);
+}
+
+void World::addInstanceTransform(RenderItem& item)
+{
+    item.transformIndex = this->instanceTransforms.size() / 16;
+    const Scalar* data = this->objectTable.getObject(item.row)->getWorldMatrix().getArray();
+    this->instanceTransforms.insert(this->instanceTransforms.end(), data, data + 16);
+}
+
+void World::updateLod(size_t row, const Matrix4& projection)
+{
+    const Model& model = *this->objectTable.getModel(row);
+    if (!this->useLods || model.getLodCount() == 1)
+    {
+        this->objectTable.setLodLevel(row, 0);
+        return;
+    }
+
+    // fraction of the screen height covered by the bounding sphere, the
+    // projection's y scale maps the sphere to clip space at the given depth
+    const Scalar* p = projection.getArray();
+    Scalar radius = this->objectTable.getRadius(row);
+    Scalar depth = this->objectTable.getDepth(row);
+    Scalar screenSize = radius * p[5];
+    if (p[15] == 0.0f) // perspective
+        screenSize = depth > radius ? screenSize / depth : 1.0f;
+
+    this->objectTable.setLodLevel(row, model.selectLod(screenSize,
+        this->objectTable.getLodLevel(row), this->lodHysteresis));
 }
     
 void World::renderObjects()
@@ -282,78 +382,132 @@ void World::renderObjects()
     camera->getPosition().getCameraMatrix(view);
     const Matrix4& projection = camera->getProjectionMatrix();
 
-	std::vector<Object*> sortedObjects;
-	sortedObjects.reserve(this->objects.size());
-	//sortedObjects.insert(sortedObjects.begin(), this->objects.begin(), this->objects.end());
+    // gather all visible objects, static and dynamic, into a single list
+    this->renderItems.clear();
+    Vector3 camLoc = camera->getPosition().getLocation();
+    const Vector3& camForward = camera->getPosition().getForwardVector();
+    Scalar maxDepth = 0;
+
+    // bring the bounds of dynamic objects that moved up to date, objects
+    // mark themselves in the table when they move, so objects at rest
+    // (sleeping bodies) are not touched at all
+    this->objectTable.takeMoved(this->movedRows);
+    for (uint32_t row : this->movedRows)
+    {
+        if (this->objectTable.isStatic(row))
+            continue;
+        Object* o = this->objectTable.getObject(row);
+        const Vector3& center = o->getWorldSphereCenter();
+        this->objectTable.setBounds(row, center, o->getWorldSphereRadius());
+    }
+
+    // level of detail is kept up to date for objects out of view too, as
+    // the shadow pass draws them as well
+    this->objectTable.computeDepths(camLoc, camForward);
+    for (size_t row = 0; row < this->objectTable.getSize(); row++)
+        updateLod(row, projection);
 
     // only render objects that exist in the view frustum of the camera
-    auto viewFrustum = camera->getViewFrustum();
-    for (Object* o : this->objects)
+    Scalar planes[6][4];
+    camera->getViewFrustum().getPlanes(planes);
+    this->objectTable.cull(planes, 6, this->visibleRows);
+    for (uint32_t row : this->visibleRows)
     {
-        if (o->getModel()->getMeshes().size() == 0)
+        Model* model = this->objectTable.getModel(row);
+        if (model->getMeshes().size() == 0)
             continue;
 
-        auto& sphere = o->getModel()->getGraphicalCompoundMesh().getBoundingSphere();
-        // TODO: add in bounding sphere offset for this to work correctly
-        auto loc = o->getPosition().getLocation() + sphere.getTranslation();
-        if (viewFrustum.sphereInFrustum(Vector3(loc.x(), loc.y(), loc.z()), sphere.getRadius()))
-            sortedObjects.push_back(o);
-        else
-            continue;
+        RenderItem item;
+        item.row = row;
+        item.material = model->getMaterial().get();
+        item.isStatic = this->objectTable.isStatic(row);
+        item.lod = this->objectTable.getLodLevel(row);
+        item.mesh = getInstanceKey(*model, item.lod);
+        item.depth = this->objectTable.getDepth(row);
+        maxDepth = std::max(maxDepth, item.depth);
+        this->renderItems.push_back(item);
     }
 
-    std::vector<std::shared_ptr<Object>> sortedStaticObjects;
-    sortedStaticObjects.reserve(this->staticObjectCount);
+    // build sort keys and sort once for the whole frame; opaque objects are
+    // grouped by state then front to back, transparent objects back to front
+    this->renderQueue.clear();
+    this->renderQueue.reserve(this->renderItems.size());
+    for (unsigned int i = 0; i < this->renderItems.size(); i++)
+    {
+        const RenderItem& item = this->renderItems[i];
+        Material* material = item.material;
+        this->renderQueue.push(this->renderQueue.makeKey(
+            material->transparent,
+            material->gpuProgram.get(),
+            material->textures[0].get(),
+            material,
+            item.mesh,
+            item.depth,
+            maxDepth
+        ), i);
+    }
+    this->renderQueue.sort();
 
-    // only render objects that exist in the view frustum of the camera
-    for (auto it : this->staticObjects)
+    // model matrices of dynamic objects are written in queue order, so that
+    // runs of objects sharing a mesh and material can be drawn as instances
+    this->instanceTransforms.clear();
+    for (size_t i = 0; i < this->renderQueue.size(); i++)
+    {
+        RenderItem& item = this->renderItems[this->renderQueue[i].index];
+        if (!item.isStatic && this->useInstancing)
+            addInstanceTransform(item);
+    }
+
+    // the shadow pass draws all dynamic objects, grouped by mesh, at a
+    // coarser level of detail than the view as shadows hide the difference,
+    // unless levels of detail are off
+    bool shadowsEnabled = this->light.canCastShadows && this->castShadows;
+    unsigned int shadowLodBias = this->useLods ? this->shadowLodBias : 0;
+    this->shadowItems.clear();
+    this->shadowQueue.clear();
+    if (shadowsEnabled)
     {
-        for (std::shared_ptr<Object> o : *it.second)
+        for (size_t row = 0; row < this->objectTable.getSize(); row++)
         {
-            if (o->getModel()->getMeshes().size() == 0)
+            Model* model = this->objectTable.getModel(row);
+            if (this->objectTable.isStatic(row) || model->getMeshes().size() == 0)
                 continue;
 
-            auto sphere = o->getModel()->getGraphicalCompoundMesh().getBoundingSphere();
-            auto loc = sphere.getTranslation();
-            if (viewFrustum.sphereInFrustum(Vector3(loc.x(), loc.y(), loc.z()), sphere.getRadius()))
-                sortedStaticObjects.push_back(o);
-            else
-                continue;
+            RenderItem item;
+            item.row = (uint32_t)row;
+            item.material = nullptr;
+            item.isStatic = false;
+            item.lod = this->objectTable.getLodLevel(row) + shadowLodBias;
+            item.mesh = getInstanceKey(*model, item.lod);
+            item.depth = 0;
+            this->shadowQueue.push(this->shadowQueue.makeKey(
+                false, nullptr, nullptr, nullptr, item.mesh, 0, 0), this->shadowItems.size());
+            this->shadowItems.push_back(item);
         }
+        this->shadowQueue.sort();
+
+        for (size_t i = 0; this->useInstancing && i < this->shadowQueue.size(); i++)
+            addInstanceTransform(this->shadowItems[this->shadowQueue[i].index]);
     }
 
-	Vector3 loc = camera->getPosition().getLocation();
-	std::sort(sortedObjects.begin(), sortedObjects.end(), [&](Object* a, Object* b) -> bool {
-		auto aTrans = a->getModel()->getMaterial()->transparent;
-		auto bTrans = b->getModel()->getMaterial()->transparent;
-
-		// sort transparent objects to back
-		if (!aTrans && bTrans)
-			return true; // a should go before as it's not transparent
-		else if (aTrans && !bTrans)
-			return false; // b should go before as it's not transparent
-
-		// sort opaque objects from front to back, to take advantage of depth buffer
-		if (!aTrans)
-		{
-			return loc.distanceTo(a->getPosition().getLocation()) <
-				loc.distanceTo(b->getPosition().getLocation());
-		}
-		// sort transparent objects from back to front, to ensure rendering works
-		else
-		{
-			return loc.distanceTo(a->getPosition().getLocation()) >
-				loc.distanceTo(b->getPosition().getLocation());
-		}
-	});
+    // upload all model matrices for the frame at once
+    if (this->useInstancing && this->instanceTransforms.size() > 0)
+    {
+        this->instanceBuffer->getBuffer().allocate(
+            this->instanceTransforms.size() * sizeof(Scalar),
+            &this->instanceTransforms[0],
+            Buffer::STREAM_DRAW
+        );
+    }
 
     vertexCount = 0;
+    drawCallCount = 0;
 
 
 
 
     Matrix4 shadowMatrix;
-    if (this->light.canCastShadows && this->castShadows)
+    if (shadowsEnabled)
     {
         glBindFramebuffer(GL_FRAMEBUFFER, this->shadowFBO);
 
@@ -388,12 +542,15 @@ void World::renderObjects()
         lightCamera.getPosition().getCameraMatrix(lightViewMatrix);
         const Matrix4& lightProjectionMatrix = lightCamera.getProjectionMatrix();
 
+        this->shadowFrameUniforms->set(lightViewMatrix, lightProjectionMatrix, nullptr, this->light);
+        this->shadowFrameUniforms->upload();
+
         Matrix4 identityMatrix;
         Material* material = this->shadowPassMaterial.get();
 
         glViewport(0, 0, this->shadowTex->getWidth(), this->shadowTex->getHeight());
-        glEnable(GL_POLYGON_OFFSET_FILL);
-        glPolygonOffset(4.0f, 4.0f);
+        GraphicsState::getSingleton().enable(GraphicsState::POLYGON_OFFSET_FILL);
+        GraphicsState::getSingleton().setPolygonOffset(4.0f, 4.0f);
 
         setupMaterial(*material, identityMatrix, lightViewMatrix, lightProjectionMatrix, false);
 
@@ -402,37 +559,53 @@ void World::renderObjects()
         static const GLfloat ones[] = { 1.0f };
         glClearBufferfv(GL_DEPTH, 0, ones);
 
-        for (auto it : this->staticObjects)
+        for (const std::shared_ptr<Object>& ob : this->staticObjects)
         {
-            for (std::shared_ptr<Object> ob : *it.second)
+            size_t row = this->objectTable.getRow(ob->worldHandle);
+            unsigned int lod = this->objectTable.getLodLevel(row);
+            for (auto mesh : this->objectTable.getModel(row)->getLodMeshes(lod + shadowLodBias))
             {
-                for (auto mesh : ob->getModel()->getMeshes())
-                {
-                    renderMesh(mesh->getTriangleMesh());
-                }
+                renderMesh(mesh->getTriangleMesh());
             }
         }
         tearDownMaterial(*material, false);
 
 
-        for (Object* ob : this->objects)
+        // render dynamic objects, objects sharing a mesh are drawn as instances
+        bool canInstance = this->useInstancing &&
+            this->shadowPassProgram->hasVariantFeature(GpuProgram::INSTANCED);
+        for (size_t i = 0; i < this->shadowQueue.size(); )
         {
-            const auto& meshes = ob->getModel()->getMeshes();
+            const RenderItem& item = this->shadowItems[this->shadowQueue[i].index];
+            const auto& meshes = this->objectTable.getModel(item.row)->getLodMeshes(item.lod);
 
-            // get model/world matrix for object (same for all meshes in object)
-            Matrix4 model;
-            ob->getPosition().getTransformMatrix(model);
+            unsigned int instances = 1;
+            if (canInstance)
+                instances = getInstanceRunLength(this->shadowQueue, this->shadowItems, i, false);
+
+            if (instances > 1)
+            {
+                GpuProgram* program = setupMaterial(*material, identityMatrix, lightViewMatrix,
+                    lightProjectionMatrix, false, nullptr, nullptr, true);
+                setInstanceOffset(*program, item.transformIndex);
+            }
+            else
+            {
+                // get model/world matrix for object (same for all meshes in object)
+                const Matrix4& model = this->objectTable.getObject(item.row)->getWorldMatrix();
+                setupMaterial(*material, model, lightViewMatrix, lightProjectionMatrix, false);
+            }
 
-            setupMaterial(*material, model, lightViewMatrix, lightProjectionMatrix, false);
             for (auto mesh : meshes)
             {
-                renderMesh(mesh->getTriangleMesh());
+                renderMesh(mesh->getTriangleMesh(), instances);
             }
             tearDownMaterial(*material, false);
+            i += instances;
         }
 
 
-        glDisable(GL_POLYGON_OFFSET_FILL);
+        GraphicsState::getSingleton().disable(GraphicsState::POLYGON_OFFSET_FILL);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glViewport(0, 0, graphics.getDisplayWidth(), graphics.getDisplayHeight());
 
@@ -447,62 +620,75 @@ void World::renderObjects()
         shadowMatrix.multiply(lightViewMatrix);
     }
 
+    // constants of the frame are set once, programs reading them from the
+    // frame block only have per object uniforms left to set for each draw
+    this->frameUniforms->set(view, projection, shadowsEnabled ? &shadowMatrix : nullptr, this->light);
+    this->frameUniforms->upload();
 
 
 
 
 
 
-    // render static objects (aka scenery)
+
+    // render all queued objects in sorted order
     Matrix4 identityMatrix;
     Material* material = nullptr;
-    for (auto ob : sortedStaticObjects)
+    bool materialIsStatic = false;
+    for (size_t i = 0; i < this->renderQueue.size(); )
     {
-        if (material == nullptr || material != ob->getModel()->getMaterial().get())
+        const RenderItem& item = this->renderItems[this->renderQueue[i].index];
+        Model* obModel = this->objectTable.getModel(item.row);
+        Material* obMaterial = item.material;
+
+        // draw runs of dynamic objects sharing a mesh and material as instances,
+        // normals debug lines are drawn per object so disable instancing for them
+        unsigned int instances = 1;
+        if (this->useInstancing && !this->showNormals &&
+            obMaterial->gpuProgram->hasVariantFeature(GpuProgram::INSTANCED))
+            instances = getInstanceRunLength(this->renderQueue, this->renderItems, i, true);
+        if (instances > 1)
         {
             if (material != nullptr)
                 tearDownMaterial(*material, this->wireframeEnabled);
-            material = ob->getModel()->getMaterial().get();
-            setupMaterial(*material, identityMatrix, view, projection, this->wireframeEnabled, 
-                &shadowMatrix, shadowTex);
+            material = nullptr;
+
+            GpuProgram* program = setupMaterial(*obMaterial, identityMatrix, view, projection,
+                this->wireframeEnabled, &shadowMatrix, shadowTex, true);
+            setInstanceOffset(*program, item.transformIndex);
+            for (const auto& mesh : obModel->getLodMeshes(item.lod))
+                renderMesh(mesh->getTriangleMesh(), instances);
+            tearDownMaterial(*obMaterial, this->wireframeEnabled);
+
+            i += instances;
+            continue;
         }
 
-        for (auto mesh : ob->getModel()->getMeshes())
+        // static objects are already in world space, so runs of static objects
+        // sharing a material only need the material setup once
+        if (!item.isStatic || !materialIsStatic || material != obMaterial)
         {
-            renderMesh(mesh->getTriangleMesh());
-            if (showNormals)
+            if (material != nullptr)
+                tearDownMaterial(*material, this->wireframeEnabled);
+            material = obMaterial;
+            materialIsStatic = item.isStatic;
+
+            if (item.isStatic)
             {
-                mesh->getTriangleMesh().getNormalsMesh(this->normalsLength).getVertexArray().draw(
-                    VertexArray::LINES,
-                    mesh->getTriangleMesh().getNormalsMesh(this->normalsLength).getVertexCount()
-                );
+                setupMaterial(*material, identityMatrix, view, projection, this->wireframeEnabled,
+                    &shadowMatrix, shadowTex);
+            }
+            else
+            {
+                // get model/world matrix for object (same for all meshes in object)
+                const Matrix4& model = this->objectTable.getObject(item.row)->getWorldMatrix();
+                setupMaterial(*material, model, view, projection, this->wireframeEnabled,
+                    &shadowMatrix, shadowTex);
             }
         }
-    }
-    if (material != nullptr)
-        tearDownMaterial(*material, this->wireframeEnabled);
 
-	// render all objects
-	std::vector<Object*>::iterator it = sortedObjects.begin();
-	Object* ob;
-	for(; it != sortedObjects.end(); it++)
-	{
-	    // get object and entity
-	    ob = (*it);
-	    
-		const auto& meshes = ob->getModel()->getMeshes();
-
-        // get mesh and material data
-		auto material = ob->getModel()->getMaterial();
-            
-        // get model/world matrix for object (same for all meshes in object)
-        Matrix4 model;
-        ob->getPosition().getTransformMatrix(model);
-        
-        setupMaterial(*material, model, view, projection, this->wireframeEnabled,
-            &shadowMatrix, shadowTex);
-		for(const auto mesh : meshes)
-		{   
+        for (const auto& mesh : obModel->getLodMeshes(item.lod))
+        {
             renderMesh(mesh->getTriangleMesh());
             if (showNormals && mesh->getTriangleMesh().hasType(GpuProgram::AttributeType::NORMAL))
             {
@@ -511,43 +697,38 @@ void World::renderObjects()
                     mesh->getTriangleMesh().getNormalsMesh(this->normalsLength).getVertexCount()
                     );
             }
-		}
+        }
+        i++;
+    }
+    if (material != nullptr)
         tearDownMaterial(*material, this->wireframeEnabled);
-	} // end of all objects
 
     // render bounding spheres, if requested
     if (this->showBoundingSpheres)
     {
-        for (auto it : this->staticObjects)
+        for (const std::shared_ptr<Object>& ob : this->staticObjects)
         {
-            auto material = it.first;
-            if (material == nullptr)
+            auto material = ob->getModel()->getMaterial();
+            if (material == nullptr || ob->getModel()->getMeshes().size() == 0)
                 continue;
             setupMaterial(*material, identityMatrix, view, projection, true);
-            for (unsigned int i = 0; i < it.second->size(); i++)
-            {
-                if (it.second->at(i)->getModel()->getMeshes().size() == 0)
-                    continue;
-                renderMesh(it.second->at(i)->getModel()->getGraphicalCompoundMesh().getBoundingSphere().getTriangleMesh());
-                //renderMesh(it.second->at(i)->getModel()->getGraphicalAABB().getTriangleMesh());
-            }
+            renderMesh(ob->getModel()->getGraphicalCompoundMesh().getBoundingSphere().getTriangleMesh());
+            //renderMesh(ob->getModel()->getGraphicalAABB().getTriangleMesh());
             tearDownMaterial(*material, true);
         }
 
-        std::set<Object*>::iterator it2 = this->objects.begin();
-        for (; it2 != this->objects.end(); it2++)
+        for (size_t row = 0; row < this->objectTable.getSize(); row++)
         {
             // get object and entity
-            ob = (*it2);
-            if (ob->getModel()->getMeshes().size() == 0)
+            Object* ob = this->objectTable.getObject(row);
+            if (this->objectTable.isStatic(row) || ob->getModel()->getMeshes().size() == 0)
                 continue;
 
             // get mesh and material data
             auto material = ob->getModel()->getMaterial();
 
             // get model/world matrix for object (same for all meshes in object)
-            Matrix4 model;
-            ob->getPosition().getTransformMatrix(model);
+            const Matrix4& model = ob->getWorldMatrix();
 
             // render bounding sphere
             setupMaterial(*material, model, view, projection, true);
@@ -561,20 +742,18 @@ void World::renderObjects()
     {
         // TODO: add rendering for static object collision shapes
 
-        std::set<Object*>::iterator it2 = this->objects.begin();
-        for (; it2 != this->objects.end(); it2++)
+        for (size_t row = 0; row < this->objectTable.getSize(); row++)
         {
             // get object and entity
-            ob = (*it2);
-            if (ob->getModel()->getCollisionShape() == nullptr)
+            Object* ob = this->objectTable.getObject(row);
+            if (this->objectTable.isStatic(row) || ob->getModel()->getCollisionShape() == nullptr)
                 continue;
 
             // get mesh and material data
             auto material = ob->getModel()->getMaterial();
 
             // get model/world matrix for object (same for all meshes in object)
-            Matrix4 model;
-            ob->getPosition().getTransformMatrix(model);
+            const Matrix4& model = ob->getWorldMatrix();
 
             // render bounding sphere
             setupMaterial(*material, model, view, projection, true);
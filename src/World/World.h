@@ -30,11 +30,14 @@ along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
 #include "../Physics/PhysicsSystem.h"
 #include "../Objects/Object.h"
 #include "../Time/StopWatch.h"
+#include "RenderQueue.h"
+#include "ObjectTable.h"
+#include "../Graphics/TextureBuffer.h"
+#include "../Shaders/FrameUniforms.h"
 #include <Lights\Light.h>
 
 #include <Resources\ResourceManager.h>
 
-#include <set>
 #include <unordered_map>
 
 
@@ -49,10 +52,16 @@ namespace Magic3D
 class World
 {
 private:
-    std::set<Object*> objects;
+    /// render state of all objects, dynamic and static, see ObjectTable
+    ObjectTable objectTable;
 
-    std::unordered_map<Material*, std::vector<std::shared_ptr<Object>>*> staticObjects;
-    int staticObjectCount;
+    /// static objects are kept alive by the world
+    std::vector<std::shared_ptr<Object>> staticObjects;
+
+    /// rows of the object table in view this frame, and of the objects
+    /// that moved since the last
+    std::vector<uint32_t> visibleRows;
+    std::vector<uint32_t> movedRows;
     
     GraphicsSystem& graphics;
     
@@ -103,11 +112,73 @@ private:
     GLuint shadowFBO;
     std::shared_ptr<Texture> shadowTex;
 
-    void renderMesh(const TriangleMesh& mesh);
+    /// visible object gathered for rendering in the current frame
+    struct RenderItem
+    {
+        /// row of the object in objectTable
+        uint32_t row;
+
+        /// material of the object's model, looked up once per frame
+        Material* material;
+
+        bool isStatic;
+        Scalar depth;
+
+        /// level of detail of the model to draw
+        unsigned int lod;
+
+        /// objects with the same mesh key can be drawn as instances of each other
+        const void* mesh;
+
+        /// index of the model matrix in instanceTransforms
+        unsigned int transformIndex;
+    };
+    std::vector<RenderItem> renderItems;
+    RenderQueue renderQueue;
+
+    std::vector<RenderItem> shadowItems;
+    RenderQueue shadowQueue;
+
+    bool useInstancing;
+    int drawCallCount;
+
+    /// model matrices of all dynamic objects for the frame, 16 scalars each
+    std::vector<Scalar> instanceTransforms;
+    std::shared_ptr<TextureBuffer> instanceBuffer;
+
+    /// uniforms of the main pass and of the shadow pass, set once per frame
+    std::shared_ptr<FrameUniforms> frameUniforms;
+    std::shared_ptr<FrameUniforms> shadowFrameUniforms;
+
+    bool useLods;
+    Scalar lodHysteresis;
+    unsigned int shadowLodBias;
+
+    /// objects with a single mesh share by the mesh, otherwise by the level of the model
+    static inline const void* getInstanceKey(Model& model, unsigned int lod)
+    {
+        const auto& meshes = model.getLodMeshes(lod);
+        if (meshes.size() == 1)
+            return meshes[0].get();
+        return &meshes;
+    }
+
+    void updateLod(size_t row, const Matrix4& projection);
+
+    unsigned int getInstanceRunLength(const RenderQueue& queue,
+        const std::vector<RenderItem>& items, size_t start, bool sameMaterial) const;
+    void setInstanceOffset(GpuProgram& program, unsigned int offset);
+    void addInstanceTransform(RenderItem& item);
+
+    void renderMesh(const TriangleMesh& mesh, unsigned int instanceCount = 1);
 
-    void setupMaterial(Material& material, const Matrix4& modelMatrix,
+    /** set up drawing with a material, returns the variant of the program used,
+     * which is the INSTANCED one when instanced is set
+     */
+    GpuProgram* setupMaterial(Material& material, const Matrix4& modelMatrix,
         const Matrix4& viewMatrix, const Matrix4& projectionMatrix, bool wireframe,
-        Matrix4* shadowMatrix = nullptr, std::shared_ptr<Texture> shadowMap = nullptr);
+        Matrix4* shadowMatrix = nullptr, std::shared_ptr<Texture> shadowMap = nullptr,
+        bool instanced = false);
     void tearDownMaterial(Material& material, bool wireframe);
     
 public:
@@ -115,9 +186,11 @@ public:
         ResourceManager& manager):
         graphics(*graphics), physics(*physics), fps(60), physicsStepTime(1.0f/60.0f),
         alignPStep2FPS(true), physicsStepsPerFrame(1), actualFPS(0), vertexCount(0), camera(NULL),
-        wireframeEnabled(false), showBoundingSpheres(false), staticObjectCount(0),
+        wireframeEnabled(false), showBoundingSpheres(false),
         showNormals(false), useNormalMaps(true), useTextures(true), castShadows(true),
-        showSpecularHighlight(true), showCollisionShape(false), normalsLength(1.0f)
+        showSpecularHighlight(true), showCollisionShape(false), normalsLength(1.0f),
+        useInstancing(true), drawCallCount(0), useLods(true), lodHysteresis(0.1f),
+        shadowLodBias(1)
     {
         Image fallbackImage(1, 1, 4, Color::WHITE);
         fallbackTexture = std::make_shared<Texture>(fallbackImage);
@@ -130,6 +203,11 @@ public:
         b.setGpuProgram(this->shadowPassProgram);
         b.end();
 
+        instanceBuffer = std::make_shared<TextureBuffer>(GL_RGBA32F);
+
+        frameUniforms = std::make_shared<FrameUniforms>();
+        shadowFrameUniforms = std::make_shared<FrameUniforms>();
+
         shadowTex = std::make_shared<Texture>(GL_DEPTH_COMPONENT32F, 4096, 4096);
         shadowTex->setMinFilter(Texture::MinFilters::LINEAR);
         shadowTex->setMagFilter(Texture::MagFilters::LINEAR);
@@ -141,38 +219,73 @@ public:
         glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowTex->getID(), 0);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
+
+    /// dynamic objects outlive the world, they stop telling it when they move
+    inline ~World()
+    {
+        for (size_t row = 0; row < this->objectTable.getSize(); row++)
+            this->objectTable.getObject(row)->worldTable = nullptr;
+    }
     
-	inline void addObject(Object* object)
+	/** Add a dynamic object, the world does not take ownership
+	 * @param object the object
+	 * @return the handle of the object, see removeObject
+	 */
+	inline ObjectHandle addObject(Object* object)
 	{
-		objects.insert(object);
+		if (this->objectTable.get(object->worldHandle) == object)
+			return object->worldHandle;
+
+		object->worldHandle = this->objectTable.add(object, object->getModel().get(), false);
+		object->worldTable = &this->objectTable;
+		object->markMoved();
 		physics.addBody(*object);
+		return object->worldHandle;
 	}
 
-    inline void addStaticObject(std::shared_ptr<Object> object)
+    /// add an object that never moves, its model is in world space already
+    inline ObjectHandle addStaticObject(std::shared_ptr<Object> object)
     {
-        auto material = object->getModel()->getMaterial().get();
-        auto it = this->staticObjects.find(object->getModel()->getMaterial().get());
-        if (it == this->staticObjects.end())
+        object->worldHandle = this->objectTable.add(object.get(), object->getModel().get(), true);
+        this->staticObjects.push_back(object);
+
+        // the bounds of static objects never change
+        if (object->getModel()->getMeshes().size() > 0)
         {
-            auto objectList = new std::vector<std::shared_ptr<Object>>();
-            objectList->push_back(object);
-            this->staticObjects.insert(std::make_pair(material, objectList));
+            auto& sphere = object->getModel()->getGraphicalCompoundMesh().getBoundingSphere();
+            this->objectTable.setBounds(this->objectTable.getRow(object->worldHandle),
+                sphere.getTranslation(), sphere.getRadius());
         }
-        else
-            it->second->push_back(object);
-        staticObjectCount++;
 
         physics.addBody(*object);
+        return object->worldHandle;
     }
    
+	/// remove a dynamic object
 	inline void removeObject(Object* object)
 	{
-		std::set<Object*>::iterator it = objects.find(object);
-		if ( it != objects.end() )
-		{
-			objects.erase(it);
-			physics.removeBody(*object);
-		}
+		if (this->objectTable.get(object->worldHandle) != object ||
+			this->objectTable.isStatic(this->objectTable.getRow(object->worldHandle)))
+			return;
+
+		this->objectTable.remove(object->worldHandle);
+		object->worldHandle = ObjectHandle();
+		object->worldTable = nullptr;
+		physics.removeBody(*object);
+	}
+
+	/// remove a dynamic object by its handle
+	inline void removeObject(ObjectHandle handle)
+	{
+		Object* object = this->objectTable.get(handle);
+		if (object != nullptr)
+			this->removeObject(object);
+	}
+
+	/// get the object of a handle, nullptr if it is not in the world
+	inline Object* getObject(ObjectHandle handle) const
+	{
+		return this->objectTable.get(handle);
 	}
    
 	inline void setCamera(Camera* camera)
@@ -253,9 +366,15 @@ public:
 		return vertexCount;
 	}
 
+	/// get the number of draw calls issued for objects in the last frame
+	inline int getDrawCallCount()
+	{
+		return drawCallCount;
+	}
+
 	inline int getObjectCount()
 	{
-        return this->objects.size() + staticObjectCount;
+        return (int)this->objectTable.getSize();
 	}
     
 	inline float getRenderTimeElapsed()
@@ -292,6 +411,44 @@ public:
         return this->useNormalMaps;
     }
 
+    inline void setUseInstancing(bool use)
+    {
+        this->useInstancing = use;
+    }
+    inline bool isUseInstancing()
+    {
+        return this->useInstancing;
+    }
+
+    inline void setUseLods(bool use)
+    {
+        this->useLods = use;
+    }
+    inline bool isUseLods()
+    {
+        return this->useLods;
+    }
+
+    /// set the fraction of a level of detail threshold an object's size must pass it by to switch
+    inline void setLodHysteresis(Scalar hysteresis)
+    {
+        this->lodHysteresis = hysteresis;
+    }
+    inline Scalar getLodHysteresis()
+    {
+        return this->lodHysteresis;
+    }
+
+    /// set how many levels coarser than in the view objects are drawn in the shadow pass
+    inline void setShadowLodBias(unsigned int bias)
+    {
+        this->shadowLodBias = bias;
+    }
+    inline unsigned int getShadowLodBias()
+    {
+        return this->shadowLodBias;
+    }
+
     inline void setUseTextures(bool use)
     {
         this->useTextures = use;
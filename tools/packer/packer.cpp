@@ -0,0 +1,58 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Packs a resource directory into a resource pack (.m3dpak), which
+ * ResourceManager::addResourcePack mounts in place of the directory.
+ * Files that get smaller for it are compressed, unless told to store all.
+ *
+ * usage: M3DPacker <directory> <pack> [--store]
+ */
+
+#include <Resources/ResourcePack.h>
+#include <Exceptions/MagicException.h>
+using namespace Magic3D;
+
+#include <cstring>
+#include <iostream>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || (argc > 3 && strcmp(argv[3], "--store") != 0))
+    {
+        cerr << "usage: " << argv[0] << " <directory> <pack> [--store]" << endl;
+        return 1;
+    }
+    bool compress = argc == 3;
+
+    try
+    {
+        ResourcePack::BuildStats stats = ResourcePack::build(argv[1], argv[2], compress);
+        cout << "packed " << stats.fileCount << " files, " << stats.compressedCount
+            << " compressed, " << stats.size << " bytes into " << stats.packedSize << endl;
+    }
+    catch (MagicException& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+/*
+Copyright (c) 2015 Andrew Keating
+
+This file is part of 3DMagic.
+
+3DMagic is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+3DMagic is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with 3DMagic.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/** Compresses the images of the textures in a resource directory to BC
+ * formats, with all mipmap levels, written beside each image as
+ * <image>.dds. Textures load those in place of the images when present,
+ * as long as the image did not change since; rerun after editing images.
+ * Normal maps (*.normals.tex.xml) are compressed to BC5.
+ *
+ * usage: M3DTexCompress <directory>
+ */
+
+#include <Graphics/CompressedImage.h>
+#include <Graphics/MipmapBuilder.h>
+#include <Resources/ImageLoaders.h>
+#include <Resources/MeshCache.h>
+#include <Resources/ResourceIndex.h>
+#include <Exceptions/MagicException.h>
+using namespace Magic3D;
+
+#include <tinyxml2.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static const char* formatNames[] = { "BC1", "BC3", "BC4", "BC5" };
+
+static bool endsWith(const std::string& text, const std::string& suffix)
+{
+    return text.size() >= suffix.size() &&
+        text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        cerr << "usage: " << argv[0] << " <directory>" << endl;
+        return 1;
+    }
+    std::string dir = argv[1];
+
+    std::set<std::string> done;
+    size_t imageCount = 0, size = 0, compressedSize = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string& name : ResourceIndex::listFiles(dir))
+    {
+        if (!endsWith(name, ".tex.xml"))
+            continue;
+
+        tinyxml2::XMLDocument doc;
+        if (doc.LoadFile((dir + "/" + name).c_str()) != tinyxml2::XML_SUCCESS)
+        {
+            cerr << name << ": could not be parsed" << endl;
+            continue;
+        }
+        tinyxml2::XMLElement* textureNode = doc.FirstChildElement("Texture");
+        tinyxml2::XMLElement* imageNode = textureNode != nullptr ?
+            textureNode->FirstChildElement("image") : nullptr;
+        const char* imageRef = imageNode != nullptr ? imageNode->Attribute("ref") : nullptr;
+        if (imageRef == nullptr || !done.insert(imageRef).second)
+            continue;
+
+        std::string imagePath = dir + "/" + imageRef;
+        if (!std::ifstream(imagePath.c_str()).good())
+            continue;   // textures fall back to a color without their image
+
+        std::string ext = imagePath.substr(imagePath.rfind('.') + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        std::shared_ptr<ImageLoader> loader = ImageLoaders::getSingleton().get(ext);
+        if (loader == nullptr)
+        {
+            cerr << imageRef << ": no loader for the image" << endl;
+            continue;
+        }
+
+        try
+        {
+            // mipmaps of colors are filtered in linear space, like the
+            // texture loader does
+            tinyxml2::XMLElement* gammaNode = textureNode->FirstChildElement("removeGammaCorrection");
+            const char* gamma = gammaNode != nullptr ? gammaNode->GetText() : nullptr;
+            bool normalMap = endsWith(name, ".normals.tex.xml");
+            tinyxml2::XMLElement* wrapNode = textureNode->FirstChildElement("wrapMode");
+            const char* wrap = wrapNode != nullptr ? wrapNode->GetText() : nullptr;
+            MipmapBuilder::Options options(MipmapBuilder::Filter::KAISER,
+                gamma == nullptr || strcmp(gamma, "false") != 0, normalMap,
+                wrap != nullptr && strcmp(wrap, "REPEAT") == 0);
+
+            std::shared_ptr<Image> image = loader->getImageFile(imagePath);
+            CompressedImage::Format format = CompressedImage::chooseFormat(*image, normalMap);
+            CompressedImage compressed = CompressedImage::encode(*image,
+                MipmapBuilder::build(*image, options), format);
+            compressed.setSourceHash(MeshCache::hashFile(imagePath));  // stale files are skipped
+            compressed.writeDds(imagePath + ".dds");
+
+            size_t imageSize = (size_t)image->getWidth() * image->getHeight() * 4;
+            size_t ddsSize = 0;
+            for (size_t i = 0; i < compressed.getLevelCount(); i++)
+                ddsSize += compressed.getLevel(i).size;
+            cout << imageRef << ": " << formatNames[(int)format] << ", "
+                << compressed.getLevelCount() << " levels, " << ddsSize << " bytes" << endl;
+
+            imageCount++;
+            size += imageSize + imageSize / 3;
+            compressedSize += ddsSize;
+        }
+        catch (MagicException& e)
+        {
+            cerr << imageRef << ": " << e.what() << endl;
+            return 1;
+        }
+    }
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    cout << "compressed " << imageCount << " images in " << seconds << "s, " << size
+        << " bytes of mipmapped rgba into " << compressedSize << endl;
+    return 0;
+}